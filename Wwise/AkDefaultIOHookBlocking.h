@@ -21,7 +21,11 @@
 // The AK::StreamMgr::IAkIOHookBlocking interface is meant to be used with
 // AK_SCHEDULER_BLOCKING streaming devices. 
 //
-// Init() creates a streaming device (by calling AK::StreamMgr::CreateDevice()).
+// Files opened for reading may be kept opened after they are closed, to be reused
+// on subsequent opens (see CAkFileHandleCache, and in_uHandleCacheSize in Init()).
+//
+// Init() creates a streaming device (by calling AK::StreamMgr::CreateDevice(), or
+// AK::StreamMgr::CreateDeviceEx() if optional device settings are passed).
 // AkDeviceSettings::uSchedulerTypeFlags is set inside to AK_SCHEDULER_BLOCKING.
 // If there was no AK::StreamMgr::IAkFileLocationResolver previously registered 
 // to the Stream Manager, this object registers itself as the File Location Resolver.
@@ -80,6 +84,7 @@
 
 #include <AK/SoundEngine/Common/AkStreamMgrModule.h>
 #include "../Common/AkFileLocationBase.h"
+#include "AkFileHandleCache.h"
 
 //-----------------------------------------------------------------------------
 // Name: class CAkDefaultIOHookBlocking.
@@ -103,7 +108,9 @@ public:
 	// it creates a streaming device with scheduler type AK_SCHEDULER_BLOCKING.
 	AKRESULT Init(
 		const AkDeviceSettings &	in_deviceSettings,	// Device settings.
-		bool						in_bAsyncOpen=false	// If true, files are opened asynchronously when possible.
+		bool						in_bAsyncOpen=false,// If true, files are opened asynchronously when possible.
+		AkUInt32					in_uHandleCacheSize=0,	// Number of file handles kept opened for reading (see CAkFileHandleCache). 0 disables the cache.
+		const AkDeviceSettingsEx *	in_pDeviceSettingsEx=NULL	// Optional device settings (e.g. AkDeviceSettingsEx::uNumIOWorkers). Pass NULL to use defaults.
 		);
 	void Term();
 
@@ -169,6 +176,7 @@ public:
 protected:
 	AkDeviceID	m_deviceID;
 	bool		m_bAsyncOpen;	// If true, opens files asynchronously when it can.
+	CAkFileHandleCache	m_handleCache;	// Handles of files opened for reading.
 };
 
 #endif //_AK_DEFAULT_IO_HOOK_BLOCKING_H_
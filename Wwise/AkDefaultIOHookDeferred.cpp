@@ -22,7 +22,8 @@
 // The AK::StreamMgr::IAkIOHookDeferred interface is meant to be used with
 // AK_SCHEDULER_DEFERRED_LINED_UP streaming devices. 
 //
-// Init() creates a streaming device (by calling AK::StreamMgr::CreateDevice()).
+// Init() creates a streaming device (by calling AK::StreamMgr::CreateDevice(), or
+// AK::StreamMgr::CreateDeviceEx() if optional device settings are passed).
 // AkDeviceSettings::uSchedulerTypeFlags is set inside to AK_SCHEDULER_DEFERRED_LINED_UP.
 // If there was no AK::StreamMgr::IAkFileLocationResolver previously registered 
 // to the Stream Manager, this object registers itself as the File Location Resolver.
@@ -63,16 +64,22 @@ CAkDefaultIOHookDeferred::~CAkDefaultIOHookDeferred()
 // it creates a streaming device with scheduler type AK_SCHEDULER_DEFERRED_LINED_UP.
 AKRESULT CAkDefaultIOHookDeferred::Init(
 	const AkDeviceSettings &	in_deviceSettings,		// Device settings.
-	bool						in_bAsyncOpen/*=false*/	// If true, files are opened asynchronously when possible.
+	bool						in_bAsyncOpen/*=false*/,// If true, files are opened asynchronously when possible.
+	AkUInt32					in_uHandleCacheSize/*=0*/,	// Number of file handles kept opened for reading. 0 disables the cache.
+	const AkDeviceSettingsEx *	in_pDeviceSettingsEx/*=NULL*/	// Optional device settings. Pass NULL to use defaults.
 	)
 {
-	if ( in_deviceSettings.uSchedulerTypeFlags != AK_SCHEDULER_DEFERRED_LINED_UP )
+	if ( ( in_deviceSettings.uSchedulerTypeFlags & ~AK_SCHEDULER_ELEVATOR ) != AK_SCHEDULER_DEFERRED_LINED_UP )
 	{
 		assert( !"CAkDefaultIOHookDeferred I/O hook only works with AK_SCHEDULER_DEFERRED_LINED_UP devices" );
 		return AK_Fail;
 	}
 	
 	m_bAsyncOpen = in_bAsyncOpen;
+
+	// Files are opened with FILE_FLAG_OVERLAPPED and FILE_FLAG_NO_BUFFERING flags.
+	if ( m_handleCache.Init( in_uHandleCacheSize, true, true ) != AK_Success )
+		return AK_Fail;
 	
 	// If the Stream Manager's File Location Resolver was not set yet, set this object as the 
 	// File Location Resolver (this I/O hook is also able to resolve file location).
@@ -80,7 +87,10 @@ AKRESULT CAkDefaultIOHookDeferred::Init(
 		AK::StreamMgr::SetFileLocationResolver( this );
 
 	// Create a device in the Stream Manager, specifying this as the hook.
-	m_deviceID = AK::StreamMgr::CreateDevice( in_deviceSettings, this );
+	if ( in_pDeviceSettingsEx )
+		m_deviceID = AK::StreamMgr::CreateDeviceEx( in_deviceSettings, *in_pDeviceSettingsEx, this );
+	else
+		m_deviceID = AK::StreamMgr::CreateDevice( in_deviceSettings, this );
 	if ( m_deviceID != AK_INVALID_DEVICE_ID )
 	{
 		// Initialize structures needed to perform deferred transfers.
@@ -106,6 +116,9 @@ void CAkDefaultIOHookDeferred::Term()
 
 	AK::StreamMgr::DestroyDevice( m_deviceID );
 
+	// Streams are destroyed: close cached file handles.
+	m_handleCache.Term();
+
 	if ( m_poolID != AK_INVALID_POOL_ID )
 	{
 		AK::MemoryMgr::DestroyPool( m_poolID );
@@ -137,19 +150,14 @@ AKRESULT CAkDefaultIOHookDeferred::Open(
 	    AkOSChar szFullFilePath[AK_MAX_PATH];
 	    if ( GetFullFilePath( in_pszFileName, in_pFlags, in_eOpenMode, szFullFilePath ) == AK_Success )
 		{
-			// Open the file with FILE_FLAG_OVERLAPPED and FILE_FLAG_NO_BUFFERING flags.
-			AKRESULT eResult = CAkFileHelpers::OpenFile( 
+			// Open the file, or get its handle and size from the cache.
+			AKRESULT eResult = m_handleCache.Open( 
 				szFullFilePath,
 				in_eOpenMode,
-				true,
-				true,
-				out_fileDesc.hFile );
+				out_fileDesc.hFile,
+				out_fileDesc.iFileSize );
 			if ( eResult == AK_Success )
 			{
-				ULARGE_INTEGER Temp;
-				Temp.LowPart = ::GetFileSize( out_fileDesc.hFile,(LPDWORD)&Temp.HighPart );
-	
-				out_fileDesc.iFileSize			= Temp.QuadPart;
 				out_fileDesc.uSector			= 0;
 				out_fileDesc.deviceID			= m_deviceID;
 				out_fileDesc.pCustomParam		= NULL;
@@ -193,19 +201,14 @@ AKRESULT CAkDefaultIOHookDeferred::Open(
 	    AkOSChar szFullFilePath[AK_MAX_PATH];
 	    if ( GetFullFilePath( in_fileID, in_pFlags, in_eOpenMode, szFullFilePath ) == AK_Success )
 		{
-			// Open the file with FILE_FLAG_OVERLAPPED and FILE_FLAG_NO_BUFFERING flags.
-			AKRESULT eResult = CAkFileHelpers::OpenFile( 
+			// Open the file, or get its handle and size from the cache.
+			AKRESULT eResult = m_handleCache.Open( 
 				szFullFilePath,
 				in_eOpenMode,
-				true,
-				true,
-				out_fileDesc.hFile );
+				out_fileDesc.hFile,
+				out_fileDesc.iFileSize );
 			if ( eResult == AK_Success )
 			{
-				ULARGE_INTEGER Temp;
-				Temp.LowPart = ::GetFileSize( out_fileDesc.hFile,(LPDWORD)&Temp.HighPart );
-	
-				out_fileDesc.iFileSize			= Temp.QuadPart;
 				out_fileDesc.uSector			= 0;
 				out_fileDesc.deviceID			= m_deviceID;
 				out_fileDesc.pCustomParam		= NULL;
@@ -350,7 +353,7 @@ AKRESULT CAkDefaultIOHookDeferred::Close(
     AkFileDesc & in_fileDesc      // File descriptor.
     )
 {
-    return CAkFileHelpers::CloseFile( in_fileDesc.hFile );
+    return m_handleCache.Close( in_fileDesc.hFile );
 }
 
 // Returns the block size for the file or its storage device. 
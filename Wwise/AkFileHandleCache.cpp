@@ -0,0 +1,259 @@
+//////////////////////////////////////////////////////////////////////
+//
+// AkFileHandleCache.cpp
+//
+// Cache of opened file handles for the default low-level I/O hooks
+// on Windows.
+//
+// Copyright (c) 2006 Audiokinetic Inc. / All Rights Reserved
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "AkFileHandleCache.h"
+#include "AkFileHelpers.h"
+#include <AK/SoundEngine/Common/AkMemoryMgr.h>
+#include <AK/Tools/Common/AkAutoLock.h>
+#include <AK/Tools/Common/AkFNVHash.h>
+#include <AK/Tools/Common/AkPlatformFuncs.h>
+
+CAkFileHandleCache::CAkFileHandleCache()
+: m_poolID( AK_INVALID_POOL_ID )
+, m_uMaxHandles( 0 )
+, m_uNumHandles( 0 )
+, m_bOverlappedIO( false )
+, m_bUnbufferedIO( false )
+, m_pLeastRecentlyUsed( NULL )
+, m_pMostRecentlyUsed( NULL )
+{
+	memset( m_arPathBuckets, 0, sizeof( m_arPathBuckets ) );
+	memset( m_arHandleBuckets, 0, sizeof( m_arHandleBuckets ) );
+}
+
+CAkFileHandleCache::~CAkFileHandleCache()
+{
+}
+
+// Creates the memory pool of the cache.
+// With in_uMaxHandles equal to 0, the cache is disabled: Open() and Close() open and close files directly.
+AKRESULT CAkFileHandleCache::Init(
+	AkUInt32			in_uMaxHandles,		// Maximum number of cached handles (in use or idle).
+	bool				in_bOverlappedIO,	// Open files with FILE_FLAG_OVERLAPPED flag.
+	bool				in_bUnbufferedIO	// Open files with FILE_FLAG_NO_BUFFERING flag.
+	)
+{
+	m_bOverlappedIO = in_bOverlappedIO;
+	m_bUnbufferedIO = in_bUnbufferedIO;
+	m_uMaxHandles = 0;
+
+	if ( in_uMaxHandles > 0 )
+	{
+		m_poolID = AK::MemoryMgr::CreatePool( NULL, in_uMaxHandles * sizeof( AkCachedHandle ), sizeof( AkCachedHandle ), AkMalloc | AkFixedSizeBlocksMode );
+		if ( m_poolID == AK_INVALID_POOL_ID )
+		{
+			assert( !"Failed creating pool for file handle cache" );
+			return AK_Fail;
+		}
+		AK_SETPOOLNAME( m_poolID, L"File handle cache" );
+		m_uMaxHandles = in_uMaxHandles;
+	}
+	return AK_Success;
+}
+
+// Closes all handles and destroys the pool. All files should have been closed.
+void CAkFileHandleCache::Term()
+{
+	CloseIdleHandles();
+	assert( m_uNumHandles == 0 || !"Files are still opened" );
+
+	if ( m_poolID != AK_INVALID_POOL_ID )
+	{
+		AK::MemoryMgr::DestroyPool( m_poolID );
+		m_poolID = AK_INVALID_POOL_ID;
+	}
+	m_uMaxHandles = 0;
+}
+
+// Returns a handle to a file, and its size. Uses a cached handle if possible.
+AKRESULT CAkFileHandleCache::Open(
+	const AkOSChar *	in_pszFullFilePath,	// Full file path.
+	AkOpenMode			in_eOpenMode,		// Open mode. Only AK_OpenModeRead files are cached.
+	AkFileHandle &		out_hFile,			// Returned file handle.
+	AkInt64 &			out_iFileSize		// Returned file size.
+	)
+{
+	if ( m_uMaxHandles == 0 || in_eOpenMode != AK_OpenModeRead )
+		return OpenFile( in_pszFullFilePath, in_eOpenMode, out_hFile, out_iFileSize );
+
+	AkUInt32 uLength;
+	AkUInt32 uPathHash = HashPath( in_pszFullFilePath, uLength );
+	if ( uLength >= AK_MAX_PATH )
+		return OpenFile( in_pszFullFilePath, in_eOpenMode, out_hFile, out_iFileSize );
+
+	AkAutoLock<CAkLock> lock( m_lock );
+
+	// Search cached handles.
+	AkCachedHandle * pItem = m_arPathBuckets[ uPathHash % AK_FILE_HANDLE_CACHE_NUM_BUCKETS ];
+	while ( pItem )
+	{
+		if ( pItem->uPathHash == uPathHash
+			&& wcscmp( pItem->szPath, in_pszFullFilePath ) == 0 )
+		{
+			if ( pItem->uRefCount++ == 0 )
+				RemoveIdle( pItem );
+			out_hFile = pItem->hFile;
+			out_iFileSize = pItem->iFileSize;
+			return AK_Success;
+		}
+		pItem = pItem->pNextByPath;
+	}
+
+	// Not cached. Open the file first: opens fail often (the dispatcher probes several locations), and
+	// idle handles should not be evicted for nothing.
+	AKRESULT eResult = OpenFile( in_pszFullFilePath, in_eOpenMode, out_hFile, out_iFileSize );
+	if ( eResult != AK_Success )
+		return eResult;
+
+	// Make room if needed.
+	if ( m_uNumHandles == m_uMaxHandles )
+	{
+		if ( !m_pLeastRecentlyUsed )
+			return AK_Success;	// All cached handles are in use: do not cache this one. It will be closed directly.
+		Evict( m_pLeastRecentlyUsed );
+	}
+
+	pItem = (AkCachedHandle*)AK::MemoryMgr::GetBlock( m_poolID );
+	if ( !pItem )
+		return AK_Success;	// Not cached: it will be closed directly.
+
+	pItem->hFile		= out_hFile;
+	pItem->iFileSize	= out_iFileSize;
+	pItem->uPathHash	= uPathHash;
+	pItem->uRefCount	= 1;
+	pItem->pPrevIdle	= NULL;
+	pItem->pNextIdle	= NULL;
+	memcpy( pItem->szPath, in_pszFullFilePath, ( uLength + 1 ) * sizeof( AkOSChar ) );
+
+	AkCachedHandle *& pPathBucket = m_arPathBuckets[ uPathHash % AK_FILE_HANDLE_CACHE_NUM_BUCKETS ];
+	pItem->pNextByPath = pPathBucket;
+	pPathBucket = pItem;
+	AkCachedHandle *& pHandleBucket = m_arHandleBuckets[ HashHandle( out_hFile ) ];
+	pItem->pNextByHandle = pHandleBucket;
+	pHandleBucket = pItem;
+	++m_uNumHandles;
+
+	return AK_Success;
+}
+
+// Releases a handle returned by Open(). Cached handles remain opened.
+AKRESULT CAkFileHandleCache::Close(
+	AkFileHandle		in_hFile			// File handle.
+	)
+{
+	if ( m_uMaxHandles > 0 )
+	{
+		AkAutoLock<CAkLock> lock( m_lock );
+
+		AkCachedHandle * pItem = m_arHandleBuckets[ HashHandle( in_hFile ) ];
+		while ( pItem )
+		{
+			if ( pItem->hFile == in_hFile )
+			{
+				assert( pItem->uRefCount > 0 );
+				if ( --pItem->uRefCount == 0 )
+					PushIdle( pItem );
+				return AK_Success;
+			}
+			pItem = pItem->pNextByHandle;
+		}
+	}
+
+	// Not cached.
+	return CAkFileHelpers::CloseFile( in_hFile );
+}
+
+// Closes all handles that are not currently in use.
+void CAkFileHandleCache::CloseIdleHandles()
+{
+	AkAutoLock<CAkLock> lock( m_lock );
+	while ( m_pLeastRecentlyUsed )
+		Evict( m_pLeastRecentlyUsed );
+}
+
+AkUInt32 CAkFileHandleCache::HashPath( const AkOSChar * in_pszPath, AkUInt32 & out_uLength )
+{
+	out_uLength = (AkUInt32)AKPLATFORM::OsStrLen( in_pszPath );
+	AK::FNVHash<AK::Hash32> hash;
+	return hash.Compute( in_pszPath, out_uLength * sizeof( AkOSChar ) );
+}
+
+// Opens a file with the cache flags, and gets its size.
+AKRESULT CAkFileHandleCache::OpenFile(
+	const AkOSChar *	in_pszFullFilePath,	// Full file path.
+	AkOpenMode			in_eOpenMode,		// Open mode.
+	AkFileHandle &		out_hFile,			// Returned file handle.
+	AkInt64 &			out_iFileSize		// Returned file size.
+	)
+{
+	AKRESULT eResult = CAkFileHelpers::OpenFile(
+		in_pszFullFilePath,
+		in_eOpenMode,
+		m_bOverlappedIO,
+		m_bUnbufferedIO,
+		out_hFile );
+	if ( eResult == AK_Success )
+	{
+		ULARGE_INTEGER Temp;
+		Temp.LowPart = ::GetFileSize( out_hFile,(LPDWORD)&Temp.HighPart );
+		out_iFileSize = Temp.QuadPart;
+	}
+	return eResult;
+}
+
+// Idle list management: handles are pushed at the most recently used end.
+void CAkFileHandleCache::PushIdle( AkCachedHandle * in_pItem )
+{
+	in_pItem->pNextIdle = NULL;
+	in_pItem->pPrevIdle = m_pMostRecentlyUsed;
+	if ( m_pMostRecentlyUsed )
+		m_pMostRecentlyUsed->pNextIdle = in_pItem;
+	else
+		m_pLeastRecentlyUsed = in_pItem;
+	m_pMostRecentlyUsed = in_pItem;
+}
+
+void CAkFileHandleCache::RemoveIdle( AkCachedHandle * in_pItem )
+{
+	if ( in_pItem->pPrevIdle )
+		in_pItem->pPrevIdle->pNextIdle = in_pItem->pNextIdle;
+	else
+		m_pLeastRecentlyUsed = in_pItem->pNextIdle;
+	if ( in_pItem->pNextIdle )
+		in_pItem->pNextIdle->pPrevIdle = in_pItem->pPrevIdle;
+	else
+		m_pMostRecentlyUsed = in_pItem->pPrevIdle;
+	in_pItem->pPrevIdle = NULL;
+	in_pItem->pNextIdle = NULL;
+}
+
+// Closes an idle handle and frees its entry.
+void CAkFileHandleCache::Evict( AkCachedHandle * in_pItem )
+{
+	assert( in_pItem->uRefCount == 0 );
+	RemoveIdle( in_pItem );
+
+	// Unlink from buckets.
+	AkCachedHandle ** ppItem = &m_arPathBuckets[ in_pItem->uPathHash % AK_FILE_HANDLE_CACHE_NUM_BUCKETS ];
+	while ( *ppItem != in_pItem )
+		ppItem = &(*ppItem)->pNextByPath;
+	*ppItem = in_pItem->pNextByPath;
+
+	ppItem = &m_arHandleBuckets[ HashHandle( in_pItem->hFile ) ];
+	while ( *ppItem != in_pItem )
+		ppItem = &(*ppItem)->pNextByHandle;
+	*ppItem = in_pItem->pNextByHandle;
+
+	CAkFileHelpers::CloseFile( in_pItem->hFile );
+	AK::MemoryMgr::ReleaseBlock( m_poolID, in_pItem );
+	--m_uNumHandles;
+}
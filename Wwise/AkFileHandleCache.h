@@ -0,0 +1,123 @@
+//////////////////////////////////////////////////////////////////////
+//
+// AkFileHandleCache.h
+//
+// Cache of opened file handles for the default low-level I/O hooks
+// on Windows. Files that are opened for reading are kept opened after
+// they are closed by the Stream Manager, so that opening them again
+// requires neither ::CreateFile() nor ::GetFileSize().
+//
+// Handles are reference counted: a file that is opened many times at
+// once shares the same handle (transfers are positioned with OVERLAPPED
+// offsets, so the file pointer is never used). When the last reference
+// is released, the handle becomes idle. Idle handles are closed in least
+// recently used order when the cache is full.
+//
+// Note: Files with an idle handle remain opened, and thus cannot be
+// modified or deleted by other processes. Call CloseIdleHandles() if
+// needed.
+//
+// Copyright (c) 2006 Audiokinetic Inc. / All Rights Reserved
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef _AK_FILE_HANDLE_CACHE_H_
+#define _AK_FILE_HANDLE_CACHE_H_
+
+#include <AK/SoundEngine/Common/IAkStreamMgr.h>
+#include <AK/Tools/Common/AkLock.h>
+
+// Number of buckets of the hash tables of cached handles.
+#define AK_FILE_HANDLE_CACHE_NUM_BUCKETS	(256)
+
+//-----------------------------------------------------------------------------
+// Name: class CAkFileHandleCache.
+// Desc: LRU cache of file handles opened for reading, keyed by full file path.
+//		 All handles are opened with the same flags, given at Init().
+//		 Files opened for writing are not cached.
+//		 Thread-safe: files may be opened and closed from any thread.
+//-----------------------------------------------------------------------------
+class CAkFileHandleCache
+{
+public:
+	CAkFileHandleCache();
+	~CAkFileHandleCache();
+
+	// Creates the memory pool of the cache.
+	// With in_uMaxHandles equal to 0, the cache is disabled: Open() and Close() open and close files directly.
+	AKRESULT Init(
+		AkUInt32			in_uMaxHandles,		// Maximum number of cached handles (in use or idle).
+		bool				in_bOverlappedIO,	// Open files with FILE_FLAG_OVERLAPPED flag.
+		bool				in_bUnbufferedIO	// Open files with FILE_FLAG_NO_BUFFERING flag.
+		);
+
+	// Closes all handles and destroys the pool. All files should have been closed.
+	void Term();
+
+	// Returns a handle to a file, and its size. Uses a cached handle if possible.
+	AKRESULT Open(
+		const AkOSChar *	in_pszFullFilePath,	// Full file path.
+		AkOpenMode			in_eOpenMode,		// Open mode. Only AK_OpenModeRead files are cached.
+		AkFileHandle &		out_hFile,			// Returned file handle.
+		AkInt64 &			out_iFileSize		// Returned file size.
+		);
+
+	// Releases a handle returned by Open(). Cached handles remain opened.
+	AKRESULT Close(
+		AkFileHandle		in_hFile			// File handle.
+		);
+
+	// Closes all handles that are not currently in use.
+	void CloseIdleHandles();
+
+protected:
+
+	struct AkCachedHandle
+	{
+		AkCachedHandle *	pNextByPath;	// Next handle in path bucket.
+		AkCachedHandle *	pNextByHandle;	// Next handle in handle bucket.
+		AkCachedHandle *	pPrevIdle;		// Previous idle handle (less recently used).
+		AkCachedHandle *	pNextIdle;		// Next idle handle (more recently used).
+		AkFileHandle		hFile;			// File handle.
+		AkInt64				iFileSize;		// File size.
+		AkUInt32			uPathHash;		// Hash of szPath.
+		AkUInt32			uRefCount;		// Number of users. 0 when idle.
+		AkOSChar			szPath[AK_MAX_PATH];	// Full file path.
+	};
+
+	// Helpers.
+	static AkUInt32 HashPath( const AkOSChar * in_pszPath, AkUInt32 & out_uLength );
+	static inline AkUInt32 HashHandle( AkFileHandle in_hFile )
+	{
+		return (AkUInt32)( ( (AkUIntPtr)in_hFile >> 2 ) % AK_FILE_HANDLE_CACHE_NUM_BUCKETS );
+	}
+
+	// Opens a file with the cache flags, and gets its size.
+	AKRESULT OpenFile(
+		const AkOSChar *	in_pszFullFilePath,	// Full file path.
+		AkOpenMode			in_eOpenMode,		// Open mode.
+		AkFileHandle &		out_hFile,			// Returned file handle.
+		AkInt64 &			out_iFileSize		// Returned file size.
+		);
+
+	// Idle list management. Sync: Cache lock must be held.
+	void PushIdle( AkCachedHandle * in_pItem );
+	void RemoveIdle( AkCachedHandle * in_pItem );
+
+	// Closes an idle handle and frees its entry. Sync: Cache lock must be held.
+	void Evict( AkCachedHandle * in_pItem );
+
+protected:
+	CAkLock				m_lock;
+	AkMemPoolId			m_poolID;			// Pool of AkCachedHandle entries.
+	AkUInt32			m_uMaxHandles;
+	AkUInt32			m_uNumHandles;
+	bool				m_bOverlappedIO;
+	bool				m_bUnbufferedIO;
+	AkCachedHandle *	m_pLeastRecentlyUsed;	// Oldest idle handle (first to be closed).
+	AkCachedHandle *	m_pMostRecentlyUsed;	// Latest idle handle.
+	AkCachedHandle *	m_arPathBuckets[AK_FILE_HANDLE_CACHE_NUM_BUCKETS];
+	AkCachedHandle *	m_arHandleBuckets[AK_FILE_HANDLE_CACHE_NUM_BUCKETS];
+};
+
+#endif //_AK_FILE_HANDLE_CACHE_H_
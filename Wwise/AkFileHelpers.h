@@ -142,10 +142,14 @@ public:
 		assert( in_uSizeToRead % s_uRequiredBlockSize == 0 
 			&& in_uPosition % s_uRequiredBlockSize == 0 );
 
-		if ( SetFilePointer( in_hFile, in_uPosition, NULL, FILE_BEGIN ) != in_uPosition )
-			return AK_Fail;
-
-		if ( ::ReadFile( in_hFile, in_pBuffer, in_uSizeToRead, &out_uSizeRead, NULL ) )
+		// Positioned read: the offset is passed along with the request instead of moving the
+		// file pointer, so that a handle may be shared by several threads.
+		OVERLAPPED overlapped;
+		overlapped.Offset = in_uPosition;
+		overlapped.OffsetHigh = 0;
+		overlapped.hEvent = NULL;
+
+		if ( ::ReadFile( in_hFile, in_pBuffer, in_uSizeToRead, &out_uSizeRead, &overlapped ) )
 			return AK_Success;
 		return AK_Fail;		
 	}
@@ -16,7 +16,8 @@
 // the dispatcher asks the first file resolver hook to open the file. If it 
 // fails, then it tries with the second, and so on, until a hook succeeds. 
 // This is inefficient. In your game, you should implement a strategy of 
-// your own (see CAkDefaultLowLevelIODispatcher::Open()). 
+// your own (see CAkDefaultLowLevelIODispatcher::Open()), or use the 
+// routing table (see InitRouting()). 
 //
 // Copyright (c) 2006 Audiokinetic Inc. / All Rights Reserved
 //
@@ -24,17 +25,35 @@
 
 #include "stdafx.h"
 #include "AkDefaultLowLevelIODispatcher.h"
+#include <AK/SoundEngine/Common/AkMemoryMgr.h>
+#include <AK/Tools/Common/AkAutoLock.h>
+#include <AK/Tools/Common/AkFNVHash.h>
+#include <AK/Tools/Common/AkPlatformFuncs.h>
 #include <assert.h>
 
+// Minimum number of slots of the routing table.
+#define AK_MIN_ROUTING_TABLE_SLOTS	(64)
+
 
 CAkDefaultLowLevelIODispatcher::CAkDefaultLowLevelIODispatcher()
 :m_uNumDevices( 0 )
+,m_pRoutes( NULL )
+,m_routesPoolID( AK_INVALID_POOL_ID )
+,m_uNumSlots( 0 )
+,m_uMaxRoutes( 0 )
+,m_uNumRoutes( 0 )
+,m_uNumNamePrefixes( 0 )
+,m_iRouteHits( 0 )
+,m_iRouteMisses( 0 )
+,m_iStaleRoutes( 0 )
+,m_bLearnRoutes( false )
 {
 	RemoveAllDevices();
 }
 
 CAkDefaultLowLevelIODispatcher::~CAkDefaultLowLevelIODispatcher()
 {
+	TermRouting();
 }
 
 // Returns a file descriptor for a given file name (string).
@@ -49,19 +68,41 @@ AKRESULT CAkDefaultLowLevelIODispatcher::Open(
 	// Here, you need to define a strategy to determine which device is going to handle this file's I/O.
 	// You could use some naming convention, or use the AkFileSystemFlags or file name extension if it depends 
 	// on file type, or define a map, or read the mapping from an XML file... it is up to the game's organization.
-	// Since this default implementation doesn't know anything about that, it forwards the calls to each 
-	// device until one of them succeeds. 
+	// Since this default implementation doesn't know anything about that, it asks the device found in the
+	// routing table, if any, and otherwise forwards the calls to each device until one of them succeeds. 
 
 	// Disable deferred opening because devices may usually return AK_Success if io_bSyncOpen=false,
 	// and we count on the fact that they will return AK_Fail to select the proper device.
 	io_bSyncOpen = true;
 
+	AkUInt32 uKey = HashFileName( in_pszFileName );
+	AkUInt32 uFlags = GetRouteFlags( in_pFlags, true );
+	AkUInt32 uRoutedDevice = FindRoute( uKey, uFlags, in_pszFileName );
+
 	AKRESULT eResult = AK_FileNotFound;
+	if ( uRoutedDevice < AK_MAX_IO_DEVICES )
+	{
+		eResult = m_arDevices[uRoutedDevice]->Open( 
+			in_pszFileName,     // File name.
+			in_eOpenMode,       // Open mode.
+			in_pFlags,			// Special flags. Can pass NULL.
+			io_bSyncOpen,		// If true, the file must be opened synchronously. Otherwise it is left at the File Location Resolver's discretion. Return false if Open needs to be deferred.
+			out_fileDesc        // Returned file descriptor.
+			);
+		assert( io_bSyncOpen || !"It is illegal to reset io_bSyncOpen" );
+		if ( eResult == AK_Success )
+		{
+			AKPLATFORM::AkInterlockedIncrement( &m_iRouteHits );
+			return AK_Success;
+		}
+	}
+
+	// No route, or stale route: probe other devices.
 	AkUInt32 uDevice = 0;
-	while ( uDevice < AK_MAX_IO_DEVICES
-			&& eResult != AK_Success )
+	while ( uDevice < AK_MAX_IO_DEVICES )
 	{
-		if ( m_arDevices[uDevice] )
+		if ( m_arDevices[uDevice] 
+			&& uDevice != uRoutedDevice )
 		{
 			eResult = m_arDevices[uDevice]->Open( 
 				in_pszFileName,     // File name.
@@ -71,10 +112,14 @@ AKRESULT CAkDefaultLowLevelIODispatcher::Open(
 				out_fileDesc        // Returned file descriptor.
 				);
 			assert( io_bSyncOpen || !"It is illegal to reset io_bSyncOpen" );
+			if ( eResult == AK_Success )
+				break;
 		}
 		++uDevice;
 	}
 
+	OnFileProbed( uKey, uFlags, ( eResult == AK_Success ) ? uDevice : AK_MAX_IO_DEVICES, uRoutedDevice < AK_MAX_IO_DEVICES );
+
 	return eResult; 
 }
 
@@ -90,19 +135,40 @@ AKRESULT CAkDefaultLowLevelIODispatcher::Open(
     // Here, you need to define a strategy to determine which device is going to handle this file's I/O.
 	// You could use the AkFileSystemFlags if it depends on file type, or define a map, or read the mapping 
 	// from an XML file... it is up to the game's organization.
-	// Since this default implementation doesn't know anything about that, it forwards the calls to each 
-	// device until one of them succeeds. 
+	// Since this default implementation doesn't know anything about that, it asks the device found in the
+	// routing table, if any, and otherwise forwards the calls to each device until one of them succeeds. 
 
 	// Disable deferred opening because devices may usually return AK_Success if io_bSyncOpen=false,
 	// and we count on the fact that they will return AK_Fail to select the proper device.
 	io_bSyncOpen = true;
-    
+
+	AkUInt32 uFlags = GetRouteFlags( in_pFlags, false );
+	AkUInt32 uRoutedDevice = FindRoute( in_fileID, uFlags, NULL );
+
 	AKRESULT eResult = AK_FileNotFound;
+	if ( uRoutedDevice < AK_MAX_IO_DEVICES )
+	{
+		eResult = m_arDevices[uRoutedDevice]->Open( 
+			in_fileID,          // File ID.
+			in_eOpenMode,       // Open mode.
+			in_pFlags,			// Special flags. Can pass NULL.
+			io_bSyncOpen,		// If true, the file must be opened synchronously. Otherwise it is left at the File Location Resolver's discretion. Return false if Open needs to be deferred.
+			out_fileDesc        // Returned file descriptor.
+			);
+		assert( io_bSyncOpen || !"It is illegal to reset io_bSyncOpen" );
+		if ( eResult == AK_Success )
+		{
+			AKPLATFORM::AkInterlockedIncrement( &m_iRouteHits );
+			return AK_Success;
+		}
+	}
+    
+	// No route, or stale route: probe other devices.
 	AkUInt32 uDevice = 0;
-	while ( uDevice < AK_MAX_IO_DEVICES
-			&& eResult != AK_Success )
+	while ( uDevice < AK_MAX_IO_DEVICES )
 	{
-		if ( m_arDevices[uDevice] )
+		if ( m_arDevices[uDevice] 
+			&& uDevice != uRoutedDevice )
 		{
 			eResult = m_arDevices[uDevice]->Open( 
 				in_fileID,          // File ID.
@@ -112,10 +178,14 @@ AKRESULT CAkDefaultLowLevelIODispatcher::Open(
 				out_fileDesc        // Returned file descriptor.
 				);
 			assert( io_bSyncOpen || !"It is illegal to reset io_bSyncOpen" );
+			if ( eResult == AK_Success )
+				break;
 		}
 		++uDevice;
 	}
 
+	OnFileProbed( in_fileID, uFlags, ( eResult == AK_Success ) ? uDevice : AK_MAX_IO_DEVICES, uRoutedDevice < AK_MAX_IO_DEVICES );
+
 	return eResult; 
 }
 
@@ -139,8 +209,330 @@ AKRESULT CAkDefaultLowLevelIODispatcher::AddDevice(
 
 void CAkDefaultLowLevelIODispatcher::RemoveAllDevices()
 {
+	AkAutoLock<CAkLock> lock( m_lockRoutes );
 	for ( AkUInt32 uRecord = 0; uRecord < AK_MAX_IO_DEVICES; uRecord++ )
+	{
+		RemoveDeviceRoutes( uRecord );
 		m_arDevices[uRecord] = NULL;
+	}
 	m_uNumDevices = 0;
 }
 
+// Creates the routing table, which can hold up to in_uMaxRoutes routes (explicit or learned).
+// If in_bLearnRoutes is true, devices that successfully open files without a route are remembered.
+// Returns AK_Success, or AK_InsufficientMemory. The dispatcher probes devices when there is no routing table.
+AKRESULT CAkDefaultLowLevelIODispatcher::InitRouting(
+	AkUInt32					in_uMaxRoutes,			// Maximum number of routes.
+	bool						in_bLearnRoutes			// Learn routes of files opened by probing devices.
+	)
+{
+	TermRouting();
+
+	if ( in_uMaxRoutes == 0 )
+		return AK_InvalidParameter;
+
+	// Keep load factor below 1/2.
+	AkUInt32 uNumSlots = AK_MIN_ROUTING_TABLE_SLOTS;
+	while ( uNumSlots < 2 * in_uMaxRoutes )
+		uNumSlots *= 2;
+
+	AkUInt32 uMemSize = uNumSlots * sizeof( AkRoute );
+	AkMemPoolId poolID = AK::MemoryMgr::CreatePool( NULL, uMemSize, uMemSize, AkMalloc | AkFixedSizeBlocksMode );
+	if ( poolID == AK_INVALID_POOL_ID )
+		return AK_InsufficientMemory;
+	AK_SETPOOLNAME( poolID, L"I/O dispatcher routes" );
+
+	AkRoute * pRoutes = (AkRoute*)AK::MemoryMgr::GetBlock( poolID );
+	if ( !pRoutes )
+	{
+		AKVERIFY( AK::MemoryMgr::DestroyPool( poolID ) == AK_Success );
+		return AK_InsufficientMemory;
+	}
+	memset( pRoutes, 0, uMemSize );
+
+	AkAutoLock<CAkLock> lock( m_lockRoutes );
+	m_pRoutes		= pRoutes;
+	m_routesPoolID	= poolID;
+	m_uNumSlots		= uNumSlots;
+	m_uMaxRoutes	= in_uMaxRoutes;
+	m_uNumRoutes	= 0;
+	m_bLearnRoutes	= in_bLearnRoutes;
+	return AK_Success;
+}
+
+// Destroys the routing table. Name prefixes are kept.
+void CAkDefaultLowLevelIODispatcher::TermRouting()
+{
+	AkAutoLock<CAkLock> lock( m_lockRoutes );
+	if ( m_pRoutes )
+	{
+		AK::MemoryMgr::ReleaseBlock( m_routesPoolID, m_pRoutes );
+		AKVERIFY( AK::MemoryMgr::DestroyPool( m_routesPoolID ) == AK_Success );
+		m_pRoutes = NULL;
+		m_routesPoolID = AK_INVALID_POOL_ID;
+	}
+	m_uNumSlots = 0;
+	m_uMaxRoutes = 0;
+	m_uNumRoutes = 0;
+	m_bLearnRoutes = false;
+}
+
+// Routes a file ID to a device. The device must have been added with AddDevice().
+// Returns AK_Success, AK_InvalidParameter if the device is unknown, or AK_Fail if the table is full (or not initialized).
+AKRESULT CAkDefaultLowLevelIODispatcher::AddFileRoute(
+	AkFileID					in_fileID,				// File ID.
+	bool						in_bIsSoundBank,		// True if the file is a soundbank (AKCODECID_BANK), false otherwise.
+	AK::StreamMgr::IAkFileLocationResolver *	in_pHook	// Device that owns the file.
+	)
+{
+	AkUInt32 uDevice = GetDeviceIndex( in_pHook );
+	if ( uDevice == AK_MAX_IO_DEVICES )
+		return AK_InvalidParameter;
+
+	AkAutoLock<CAkLock> lock( m_lockRoutes );
+	return SetRoute( in_fileID, AK_ROUTE_VALID | ( in_bIsSoundBank ? AK_ROUTE_SOUNDBANK : 0 ), uDevice );
+}
+
+// Routes all file names that begin with in_pszPrefix to a device (string overload of Open() only).
+// Prefixes are searched in the order in which they were added, after the routes of the routing table.
+// Returns AK_Success, AK_InvalidParameter if the device is unknown or the prefix is too long, or AK_Fail if there are too many prefixes.
+AKRESULT CAkDefaultLowLevelIODispatcher::AddNamePrefix(
+	const AkOSChar *			in_pszPrefix,			// File name prefix.
+	AK::StreamMgr::IAkFileLocationResolver *	in_pHook	// Device that owns the files.
+	)
+{
+	AkUInt32 uDevice = GetDeviceIndex( in_pHook );
+	if ( uDevice == AK_MAX_IO_DEVICES
+		|| !in_pszPrefix
+		|| AKPLATFORM::OsStrLen( in_pszPrefix ) >= AK_MAX_IO_NAME_PREFIX_LENGTH )
+		return AK_InvalidParameter;
+
+	AkAutoLock<CAkLock> lock( m_lockRoutes );
+	if ( m_uNumNamePrefixes == AK_MAX_IO_NAME_PREFIXES )
+	{
+		assert( !"Cannot hold any more name prefixes" );
+		return AK_Fail;
+	}
+	AkNamePrefix & prefix = m_arNamePrefixes[m_uNumNamePrefixes++];
+	AKPLATFORM::SafeStrCpy( prefix.szPrefix, in_pszPrefix, AK_MAX_IO_NAME_PREFIX_LENGTH );
+	prefix.uLength = (AkUInt32)AKPLATFORM::OsStrLen( in_pszPrefix );
+	prefix.uDevice = uDevice;
+	return AK_Success;
+}
+
+// Removes all the routes and name prefixes of a device (for e.g. after its membership changed).
+void CAkDefaultLowLevelIODispatcher::RemoveRoutes(
+	AK::StreamMgr::IAkFileLocationResolver *	in_pHook	// Device.
+	)
+{
+	AkUInt32 uDevice = GetDeviceIndex( in_pHook );
+	if ( uDevice < AK_MAX_IO_DEVICES )
+	{
+		AkAutoLock<CAkLock> lock( m_lockRoutes );
+		RemoveDeviceRoutes( uDevice );
+	}
+}
+
+// Returns routing statistics.
+void CAkDefaultLowLevelIODispatcher::GetRoutingStats(
+	AkDispatcherRoutingStats &	out_stats				// Returned statistics.
+	)
+{
+	AkAutoLock<CAkLock> lock( m_lockRoutes );
+	out_stats.uRouteHits	= (AkUInt32)m_iRouteHits;
+	out_stats.uRouteMisses	= (AkUInt32)m_iRouteMisses;
+	out_stats.uStaleRoutes	= (AkUInt32)m_iStaleRoutes;
+	out_stats.uNumRoutes	= m_uNumRoutes;
+}
+
+// Returns the route flags of a file.
+AkUInt32 CAkDefaultLowLevelIODispatcher::GetRouteFlags(
+	AkFileSystemFlags *			in_pFlags,	// Special flags. Can be NULL.
+	bool						in_bByName	// True for the string overload.
+	)
+{
+	AkUInt32 uFlags = AK_ROUTE_VALID;
+	if ( in_bByName )
+		uFlags |= AK_ROUTE_BY_NAME;
+	if ( in_pFlags 
+		&& in_pFlags->uCompanyID == AKCOMPANYID_AUDIOKINETIC 
+		&& in_pFlags->uCodecID == AKCODECID_BANK )
+		uFlags |= AK_ROUTE_SOUNDBANK;
+	return uFlags;
+}
+
+// Returns the key of a file name.
+AkUInt32 CAkDefaultLowLevelIODispatcher::HashFileName(
+	const AkOSChar *			in_pszFileName	// File name.
+	)
+{
+	AK::FNVHash<AK::Hash32> hash;
+	return hash.Compute( in_pszFileName, (unsigned int)( AKPLATFORM::OsStrLen( in_pszFileName ) * sizeof( AkOSChar ) ) );
+}
+
+// Returns the index of a device in m_arDevices, or AK_MAX_IO_DEVICES if it was not added.
+AkUInt32 CAkDefaultLowLevelIODispatcher::GetDeviceIndex(
+	AK::StreamMgr::IAkFileLocationResolver *	in_pHook
+	)
+{
+	AkUInt32 uDevice = 0;
+	while ( uDevice < AK_MAX_IO_DEVICES 
+			&& ( !in_pHook || m_arDevices[uDevice] != in_pHook ) )
+		++uDevice;
+	return uDevice;
+}
+
+// Returns the device of a file, or AK_MAX_IO_DEVICES if it has no route.
+AkUInt32 CAkDefaultLowLevelIODispatcher::FindRoute(
+	AkUInt32					in_uKey,	// File ID, or hash of the file name.
+	AkUInt32					in_uFlags,	// Route flags.
+	const AkOSChar *			in_pszFileName	// File name, to search name prefixes. NULL for file IDs.
+	)
+{
+	AkAutoLock<CAkLock> lock( m_lockRoutes );
+
+	if ( m_pRoutes )
+	{
+		AkRoute * pRoute = FindSlot( in_uKey, in_uFlags );
+		if ( pRoute->uFlags )
+			return pRoute->uDevice;
+	}
+
+	if ( in_pszFileName )
+	{
+		for ( AkUInt32 uPrefix = 0; uPrefix < m_uNumNamePrefixes; uPrefix++ )
+		{
+			const AkNamePrefix & prefix = m_arNamePrefixes[uPrefix];
+			AkUInt32 uChar = 0;
+			while ( uChar < prefix.uLength 
+					&& in_pszFileName[uChar] == prefix.szPrefix[uChar] )
+				++uChar;
+			if ( uChar == prefix.uLength )
+				return prefix.uDevice;
+		}
+	}
+
+	return AK_MAX_IO_DEVICES;
+}
+
+// Adds or replaces a route. Returns AK_Fail if the table is full or not initialized.
+// Sync: Routing lock must be held.
+AKRESULT CAkDefaultLowLevelIODispatcher::SetRoute(
+	AkUInt32					in_uKey,	// File ID, or hash of the file name.
+	AkUInt32					in_uFlags,	// Route flags.
+	AkUInt32					in_uDevice	// Index of the device in m_arDevices.
+	)
+{
+	if ( !m_pRoutes )
+		return AK_Fail;
+
+	AkRoute * pRoute = FindSlot( in_uKey, in_uFlags );
+	if ( !pRoute->uFlags )
+	{
+		if ( m_uNumRoutes == m_uMaxRoutes )
+			return AK_Fail;
+		pRoute->uKey	= in_uKey;
+		pRoute->uFlags	= in_uFlags;
+		++m_uNumRoutes;
+	}
+	pRoute->uDevice = in_uDevice;
+	return AK_Success;
+}
+
+// Called after a file was opened by probing devices. Learns or fixes its route.
+void CAkDefaultLowLevelIODispatcher::OnFileProbed(
+	AkUInt32					in_uKey,	// File ID, or hash of the file name.
+	AkUInt32					in_uFlags,	// Route flags.
+	AkUInt32					in_uDevice,	// Device that opened the file. AK_MAX_IO_DEVICES if none.
+	bool						in_bWasRouted	// True if the file had a (stale) route.
+	)
+{
+	AkAutoLock<CAkLock> lock( m_lockRoutes );
+
+	if ( in_bWasRouted )
+		++m_iStaleRoutes;
+	else
+		++m_iRouteMisses;
+
+	if ( !m_pRoutes )
+		return;
+
+	if ( in_uDevice < AK_MAX_IO_DEVICES )
+	{
+		// Learn the route, or fix it if it was stale.
+		if ( m_bLearnRoutes || in_bWasRouted )
+			SetRoute( in_uKey, in_uFlags, in_uDevice );
+	}
+	else if ( in_bWasRouted )
+	{
+		// No device owns this file anymore.
+		AkRoute * pRoute = FindSlot( in_uKey, in_uFlags );
+		if ( pRoute->uFlags )
+			EraseSlot( pRoute );
+	}
+}
+
+// Returns the slot of a route, or the free slot where it should be inserted.
+// Sync: Routing lock must be held.
+CAkDefaultLowLevelIODispatcher::AkRoute * CAkDefaultLowLevelIODispatcher::FindSlot(
+	AkUInt32					in_uKey,	// File ID, or hash of the file name.
+	AkUInt32					in_uFlags	// Route flags.
+	)
+{
+	assert( m_pRoutes && m_uNumRoutes < m_uNumSlots );
+	return RouteTable::FindSlot( m_pRoutes, m_uNumSlots, in_uKey, in_uFlags );
+}
+
+// Frees a slot, and shifts back the routes that follow it in their probing sequence.
+// Sync: Routing lock must be held.
+void CAkDefaultLowLevelIODispatcher::EraseSlot(
+	AkRoute *					in_pSlot	// Slot to free.
+	)
+{
+	RouteTable::EraseSlot( m_pRoutes, m_uNumSlots, in_pSlot );
+	--m_uNumRoutes;
+}
+
+// Removes all routes and prefixes of a device. Sync: Routing lock must be held.
+void CAkDefaultLowLevelIODispatcher::RemoveDeviceRoutes(
+	AkUInt32					in_uDevice	// Index of the device in m_arDevices.
+	)
+{
+	if ( m_pRoutes )
+	{
+		// EraseSlot() may shift another route into this slot, or into a slot already visited
+		// when the probing sequence wraps around: repeat until nothing is erased.
+		bool bErased;
+		do
+		{
+			bErased = false;
+			AkUInt32 uSlot = 0;
+			while ( uSlot < m_uNumSlots )
+			{
+				if ( m_pRoutes[uSlot].uFlags 
+					&& m_pRoutes[uSlot].uDevice == in_uDevice )
+				{
+					EraseSlot( &m_pRoutes[uSlot] );
+					bErased = true;
+				}
+				else
+					++uSlot;
+			}
+		}
+		while ( bErased );
+	}
+
+	// Keep the order of the other prefixes.
+	AkUInt32 uNumPrefixes = 0;
+	for ( AkUInt32 uPrefix = 0; uPrefix < m_uNumNamePrefixes; uPrefix++ )
+	{
+		if ( m_arNamePrefixes[uPrefix].uDevice != in_uDevice )
+		{
+			if ( uNumPrefixes != uPrefix )
+				m_arNamePrefixes[uNumPrefixes] = m_arNamePrefixes[uPrefix];
+			++uNumPrefixes;
+		}
+	}
+	m_uNumNamePrefixes = uNumPrefixes;
+}
+
@@ -18,6 +18,15 @@
 // This is inefficient. In your game, you should implement a strategy of 
 // your own (see CAkDefaultLowLevelIODispatcher::Open()). 
 //
+// To avoid most of the failed attempts, the dispatcher may use a routing 
+// table (see InitRouting()), which maps file IDs and file names (hashed)
+// to the device that owns them. Routes can be added explicitly (for e.g. 
+// from the LUT of a file package or from a directory scan, with 
+// AddFileRoute()), by file name prefix (AddNamePrefix()), or learned: 
+// when probing the devices succeeds, the device that opened the file is 
+// remembered. Devices are only probed when a file has no route, or when 
+// its routed device fails to open it (in which case the route is updated).
+//
 // Copyright (c) 2006 Audiokinetic Inc. / All Rights Reserved
 //
 //////////////////////////////////////////////////////////////////////
@@ -26,9 +35,24 @@
 #define _AK_DEFAULT_LOW_LEVEL_IO_DISPATCHER_H_
 
 #include <AK/SoundEngine/Common/AkStreamMgrModule.h>
+#include <AK/Tools/Common/AkLock.h>
+#include "AkOpenAddressingTable.h"
 
 #define AK_MAX_IO_DEVICES	(3)
 
+// Name prefixes routing.
+#define AK_MAX_IO_NAME_PREFIXES			(8)		// Maximum number of name prefixes.
+#define AK_MAX_IO_NAME_PREFIX_LENGTH	(32)	// Maximum length of a name prefix, including NULL character.
+
+// Routing statistics (see CAkDefaultLowLevelIODispatcher::GetRoutingStats()).
+struct AkDispatcherRoutingStats
+{
+	AkUInt32	uRouteHits;		// Files opened by their routed device.
+	AkUInt32	uRouteMisses;	// Files without a route: devices were probed.
+	AkUInt32	uStaleRoutes;	// Files that could not be opened by their routed device: other devices were probed.
+	AkUInt32	uNumRoutes;		// Number of routes currently in the routing table.
+};
+
 //-----------------------------------------------------------------------------
 // Name: class CAkDefaultLowLevelIODispatcher.
 // Desc: Register this object to the Stream Manager as the File Location Resolver.
@@ -71,14 +95,158 @@ public:
 		AK::StreamMgr::IAkFileLocationResolver *	in_pHook
         );
 
-	// Remove all devices from the dispatcher's array.
+	// Remove all devices from the dispatcher's array. Their routes are removed as well.
 	void RemoveAllDevices();
+
+	//
+	// Routing services.
+	//-----------------------------------------------------------------------------
+
+	// Creates the routing table, which can hold up to in_uMaxRoutes routes (explicit or learned).
+	// If in_bLearnRoutes is true, devices that successfully open files without a route are remembered.
+	// Returns AK_Success, or AK_InsufficientMemory. The dispatcher probes devices when there is no routing table.
+	AKRESULT InitRouting(
+		AkUInt32					in_uMaxRoutes,			// Maximum number of routes.
+		bool						in_bLearnRoutes = true	// Learn routes of files opened by probing devices.
+		);
+
+	// Destroys the routing table. Name prefixes are kept.
+	void TermRouting();
+
+	// Routes a file ID to a device. The device must have been added with AddDevice().
+	// Returns AK_Success, AK_InvalidParameter if the device is unknown, or AK_Fail if the table is full (or not initialized).
+	AKRESULT AddFileRoute(
+		AkFileID					in_fileID,				// File ID.
+		bool						in_bIsSoundBank,		// True if the file is a soundbank (AKCODECID_BANK), false otherwise.
+		AK::StreamMgr::IAkFileLocationResolver *	in_pHook	// Device that owns the file.
+		);
+
+	// Routes all file names that begin with in_pszPrefix to a device (string overload of Open() only).
+	// Prefixes are searched in the order in which they were added, after the routes of the routing table.
+	// Returns AK_Success, AK_InvalidParameter if the device is unknown or the prefix is too long, or AK_Fail if there are too many prefixes.
+	AKRESULT AddNamePrefix(
+		const AkOSChar *			in_pszPrefix,			// File name prefix.
+		AK::StreamMgr::IAkFileLocationResolver *	in_pHook	// Device that owns the files.
+		);
+
+	// Removes all the routes and name prefixes of a device (for e.g. after its membership changed).
+	void RemoveRoutes(
+		AK::StreamMgr::IAkFileLocationResolver *	in_pHook	// Device.
+		);
+
+	// Returns routing statistics.
+	void GetRoutingStats(
+		AkDispatcherRoutingStats &	out_stats				// Returned statistics.
+		);
     
+protected:
+
+	// Route flags.
+	enum AkRouteFlags
+	{
+		AK_ROUTE_VALID			= 0x1,	// Slot is used.
+		AK_ROUTE_BY_NAME		= 0x2,	// Key is the hash of a file name (file ID otherwise).
+		AK_ROUTE_SOUNDBANK		= 0x4	// File is a soundbank.
+	};
+
+	struct AkRoute
+	{
+		AkUInt32					uKey;		// File ID, or hash of the file name.
+		AkUInt32					uFlags;		// Combination of AkRouteFlags. 0 if the slot is free.
+		AkUInt32					uDevice;	// Index of the device in m_arDevices.
+	};
+
+	// Access to the keys of a route (see AkOpenAddressingTable).
+	struct AkRouteKeys
+	{
+		static inline AkUInt32 GetID( const AkRoute & in_route ) { return in_route.uKey; }
+		static inline AkUInt32 & Flags( AkRoute & in_route ) { return in_route.uFlags; }
+	};
+	typedef AkOpenAddressingTable<AkRoute,AkRouteKeys> RouteTable;
+
+	struct AkNamePrefix
+	{
+		AkOSChar					szPrefix[AK_MAX_IO_NAME_PREFIX_LENGTH];
+		AkUInt32					uLength;	// Length of szPrefix, excluding NULL character.
+		AkUInt32					uDevice;	// Index of the device in m_arDevices.
+	};
+
+	// Returns the route flags of a file.
+	static AkUInt32 GetRouteFlags(
+		AkFileSystemFlags *			in_pFlags,	// Special flags. Can be NULL.
+		bool						in_bByName	// True for the string overload.
+		);
+
+	// Returns the key of a file name.
+	static AkUInt32 HashFileName(
+		const AkOSChar *			in_pszFileName	// File name.
+		);
+
+	// Returns the index of a device in m_arDevices, or AK_MAX_IO_DEVICES if it was not added.
+	AkUInt32 GetDeviceIndex(
+		AK::StreamMgr::IAkFileLocationResolver *	in_pHook
+		);
+
+	// Returns the device of a file, or AK_MAX_IO_DEVICES if it has no route.
+	AkUInt32 FindRoute(
+		AkUInt32					in_uKey,	// File ID, or hash of the file name.
+		AkUInt32					in_uFlags,	// Route flags.
+		const AkOSChar *			in_pszFileName	// File name, to search name prefixes. NULL for file IDs.
+		);
+
+	// Adds or replaces a route. Returns AK_Fail if the table is full or not initialized.
+	// Sync: Routing lock must be held.
+	AKRESULT SetRoute(
+		AkUInt32					in_uKey,	// File ID, or hash of the file name.
+		AkUInt32					in_uFlags,	// Route flags.
+		AkUInt32					in_uDevice	// Index of the device in m_arDevices.
+		);
+
+	// Called after a file was opened by probing devices. Learns or fixes its route.
+	void OnFileProbed(
+		AkUInt32					in_uKey,	// File ID, or hash of the file name.
+		AkUInt32					in_uFlags,	// Route flags.
+		AkUInt32					in_uDevice,	// Device that opened the file.
+		bool						in_bWasRouted	// True if the file had a (stale) route.
+		);
+
+	// Returns the slot of a route, or the free slot where it should be inserted.
+	// Sync: Routing lock must be held.
+	AkRoute * FindSlot(
+		AkUInt32					in_uKey,	// File ID, or hash of the file name.
+		AkUInt32					in_uFlags	// Route flags.
+		);
+
+	// Frees a slot, and shifts back the routes that follow it in their probing sequence.
+	// Sync: Routing lock must be held.
+	void EraseSlot(
+		AkRoute *					in_pSlot	// Slot to free.
+		);
+
+	// Removes all routes and prefixes of a device. Sync: Routing lock must be held.
+	void RemoveDeviceRoutes(
+		AkUInt32					in_uDevice	// Index of the device in m_arDevices.
+		);
+
 protected:
 
 	// List of devices.
 	AK::StreamMgr::IAkFileLocationResolver *	m_arDevices[AK_MAX_IO_DEVICES];
 	AkUInt32									m_uNumDevices;
+
+	// Routing.
+	CAkLock						m_lockRoutes;
+	AkRoute *					m_pRoutes;			// Routing table (open addressing, linear probing). NULL if routing was not initialized.
+	AkMemPoolId					m_routesPoolID;		// Memory pool of the routing table.
+	AkUInt32					m_uNumSlots;		// Number of slots of the routing table (power of 2).
+	AkUInt32					m_uMaxRoutes;		// Maximum number of routes.
+	AkUInt32					m_uNumRoutes;		// Number of used slots.
+	AkNamePrefix				m_arNamePrefixes[AK_MAX_IO_NAME_PREFIXES];
+	AkUInt32					m_uNumNamePrefixes;
+	AkInt32						m_iRouteHits;
+	AkInt32						m_iRouteMisses;
+	AkInt32						m_iStaleRoutes;
+	bool						m_bLearnRoutes;
 };
 
 #endif //_AK_DEFAULT_LOW_LEVEL_IO_DISPATCHER_H_
@@ -25,6 +25,12 @@ using namespace AK::StreamMgr;
 //-------------------------------------------------------------------
 
 #define AK_INFINITE_DEADLINE            (100000)    // 100 seconds.
+#define AK_THROUGHPUT_SAMPLE_PERIOD		(100.f)		// Minimum duration of a consumption rate sample of automatic streams, in ms.
+#define AK_IO_MODEL_SMOOTHING			(0.05f)		// Weight of a new transfer in the I/O model of devices (exponential moving average).
+#define AK_IO_MODEL_MIN_SIZE_DEVIATION	(0.1f)		// Relative deviation of transfer sizes required to tell latency from bandwidth.
+#define AK_ELEVATOR_DEFAULT_IO_LATENCY	(20.f)		// Latency assumed by the elevator policy until a transfer has been measured, in ms.
+#define AK_ELEVATOR_DEFAULT_IO_COST_PER_BYTE	(1.f/1024.f)	// Cost of a byte assumed by the elevator policy until a transfer has been measured, in ms (1 KB/ms).
+#define AK_THROUGHPUT_SMOOTHING			(0.25f)		// Weight of a new sample in the measured consumption rate of automatic streams (exponential moving average).
 
 
 //-------------------------------------------------------------------
@@ -36,8 +42,23 @@ CAkDeviceBase::CAkDeviceBase(
 	IAkLowLevelIOHook *	in_pLowLevelHook
 	)
 : m_pLowLevelHook( in_pLowLevelHook )
+, m_pResidentDataHook( NULL )
+, m_pTaskInbox( NULL )
+, m_uNumTasks( 0 )
+, m_iHighestStarvingPriority( -1 )
+, m_uHeadPosition( 0 )
+, m_fElevatorBatchTime( 0 )
 , m_streamIOPoolId( AK_INVALID_POOL_ID )
 , m_pBufferMem( NULL )
+, m_pIOMemory( NULL )
+, m_uCachedSize( 0 )
+, m_fIOMeanSize( 0 )
+, m_fIOMeanDuration( 0 )
+, m_fIOSizeVariance( 0 )
+, m_fIOCovariance( 0 )
+, m_uNumIOSamples( 0 )
+, m_fIOLatency( 0 )
+, m_fIOCostPerByte( 0 )
 #ifndef AK_OPTIMIZED
 , m_streamIOPoolSize( 0 )
 #endif
@@ -51,6 +72,7 @@ CAkDeviceBase::~CAkDeviceBase( )
 // Init.
 AKRESULT CAkDeviceBase::Init( 
     const AkDeviceSettings &	in_settings,
+    const AkDeviceSettingsEx &	in_settingsEx,
     AkDeviceID					in_deviceID 
     )
 {
@@ -64,6 +86,12 @@ AKRESULT CAkDeviceBase::Init(
     {
         AKASSERT( !"Invalid automatic stream average buffering value" );
         return AK_InvalidParameter;
+    }
+    if ( in_settingsEx.fMeasuredThroughputWeight < 0 || 
+         in_settingsEx.fMeasuredThroughputWeight > 1 )
+    {
+        AKASSERT( !"Invalid measured throughput weight: must be between 0 and 1" );
+        return AK_InvalidParameter;
     }
 	if ( in_settings.uSchedulerTypeFlags & AK_SCHEDULER_DEFERRED_LINED_UP 
 		&& ( in_settings.uMaxConcurrentIO < 1 || in_settings.uMaxConcurrentIO > 1024 ) )
@@ -73,22 +101,30 @@ AKRESULT CAkDeviceBase::Init(
     }
 
 	m_listTasks.Init();
+	m_listTasksToDestroy.Init();
 	m_listFreeBufferHolders.Init();
+	for ( AkInt32 iPriority = AK_MIN_PRIORITY; iPriority <= AK_MAX_PRIORITY; ++iPriority )
+		m_arStarvingTasks[iPriority].Init();
 
     m_uGranularity			= in_settings.uGranularity;
     m_fTargetAutoStmBufferLength  = in_settings.fTargetAutoStmBufferLength;
+    m_fMeasuredThroughputWeight	= in_settingsEx.fMeasuredThroughputWeight;
     m_uIdleWaitTime			= in_settings.uIdleWaitTime;
 	m_uMaxConcurrentIO		= in_settings.uMaxConcurrentIO;
+	m_bElevator				= ( in_settings.uSchedulerTypeFlags & AK_SCHEDULER_ELEVATOR ) != 0;
+	m_pResidentDataHook		= in_settingsEx.pResidentDataHook;
 
 	m_deviceID				= in_deviceID;
     
-    // Create stream memory pool.
+    // Create stream memory pool. 
+	// Its memory is obtained in a single block, which is divided in stream buffers of various sizes by the 
+	// I/O memory manager.
     if ( in_settings.uIOMemorySize > 0 )
     {		
 		m_streamIOPoolId = AK::MemoryMgr::CreatePool( 
             in_settings.pIOMemory,
 			in_settings.uIOMemorySize,
-			in_settings.uGranularity,
+			in_settings.uIOMemorySize,
 			in_settings.ePoolAttributes | AkFixedSizeBlocksMode,
 			in_settings.uIOMemoryAlignment );        
     }
@@ -101,9 +137,21 @@ AKRESULT CAkDeviceBase::Init(
             false );
         AK_SETPOOLNAME( m_streamIOPoolId, L"Stream I/O" );
 
+		m_pIOMemory = AK::MemoryMgr::GetBlock( m_streamIOPoolId );
+		if ( !m_pIOMemory )
+			return AK_Fail;
+		AKRESULT eResult = m_ioMemMgr.Init( m_pIOMemory, in_settings.uIOMemorySize, in_settings.uGranularity, in_settings.uIOMemoryAlignment );
+		if ( eResult != AK_Success )
+			return eResult;
+		if ( m_ioMemMgr.GetMaxAllocSize() < in_settings.uGranularity )
+		{
+			AKASSERT( !"I/O memory size is smaller than granularity" );
+			return AK_InvalidParameter;
+		}
+
 		// Cache buffer holder structures. 
-		// The maximum amount of buffers is IO pool size / granularity.
-		AkUInt32 uNumBuffers = ( in_settings.uIOMemorySize + in_settings.uGranularity - 1 ) / in_settings.uGranularity;
+		// The maximum amount of buffers is the number of blocks of the smallest size.
+		AkUInt32 uNumBuffers = m_ioMemMgr.GetMaxNumBlocks();
 		m_pBufferMem = (AkStmBuffer*)AkAlloc( CAkStreamMgr::GetObjPoolID(), uNumBuffers * sizeof( AkStmBuffer ) );
 		if ( !m_pBufferMem )
 			return AK_Fail;
@@ -141,6 +189,15 @@ void CAkDeviceBase::Destroy()
 #endif
 	CAkIOThread::Term();
 
+	// All tasks are destroyed: release scheduler index.
+	m_arReadyAutoTasks.Term();
+	m_arReadyStdTasks.Term();
+	m_arTasksByPosition.Term();
+	for ( AkInt32 iPriority = AK_MIN_PRIORITY; iPriority <= AK_MAX_PRIORITY; ++iPriority )
+		m_arStarvingTasks[iPriority].Term();
+	m_iHighestStarvingPriority = -1;
+	m_listTasksToDestroy.Term();
+
 	// Free cached buffer holders.
 	if ( m_pBufferMem )
 	{
@@ -150,6 +207,12 @@ void CAkDeviceBase::Destroy()
 	m_listFreeBufferHolders.Term();
 
     // Destroy IO pool.
+	m_ioMemMgr.Term();
+	if ( m_pIOMemory )
+	{
+		AK::MemoryMgr::ReleaseBlock( m_streamIOPoolId, m_pIOMemory );
+		m_pIOMemory = NULL;
+	}
     if ( m_streamIOPoolId != AK_INVALID_POOL_ID )
         AKVERIFY( AK::MemoryMgr::DestroyPool( m_streamIOPoolId ) == AK_Success );
     m_streamIOPoolId = AK_INVALID_POOL_ID;
@@ -166,16 +229,22 @@ AkDeviceID CAkDeviceBase::GetDeviceID()
 // Destroys all streams remaining to be destroyed.
 bool CAkDeviceBase::ClearStreams()
 {
+	AkAutoLock<CAkLock> gate( m_lockTasksList );
+	DrainTaskInbox();
+
 	TaskList::IteratorEx it = m_listTasks.BeginEx();
 	while ( it != m_listTasks.End() )
 	{
 		CAkStmTask * pTask = (*it);
 		it = m_listTasks.Erase( it );
-		if ( !pTask->ForceInstantDestroy() )
+		if ( IsTaskClaimed( pTask ) 
+			|| !pTask->ForceInstantDestroy() )
 		{
 			m_listTasks.AddFirst( pTask );
 			return false;
 		}
+		AkAutoLock<CAkLock> index( m_lockSchedIndex );
+		--m_uNumTasks;
 	}
 	m_listTasks.Term();
 	return true;
@@ -188,15 +257,27 @@ void CAkDeviceBase::OnThreadStart()
     AKPLATFORM::PerformanceCounter( &m_time );
 }
 
-// Helper: adds a new task to the list.
-// Sync: task list lock.
-void CAkDeviceBase::AddTask( 
+// Helper: adds a new task to the inbox.
+// Sync: Index lock, to reserve room in the scheduler index. The task list is not locked.
+AKRESULT CAkDeviceBase::AddTask(
     CAkStmTask * in_pStmTask
     )
 {
-    AkAutoLock<CAkLock> gate( m_lockTasksList );
-    
-    m_listTasks.AddFirst( in_pStmTask );
+	// Ensure that the scheduler index can hold all tasks, so that indexing never needs to allocate.
+	{
+		AkAutoLock<CAkLock> index( m_lockSchedIndex );
+		if ( m_uNumTasks >= m_arReadyAutoTasks.Reserved()
+			&& !m_arReadyAutoTasks.GrowArray() )
+			return AK_InsufficientMemory;
+		if ( m_uNumTasks >= m_arReadyStdTasks.Reserved()
+			&& !m_arReadyStdTasks.GrowArray() )
+			return AK_InsufficientMemory;
+		if ( m_bElevator 
+			&& m_uNumTasks >= m_arTasksByPosition.Reserved()
+			&& !m_arTasksByPosition.GrowArray() )
+			return AK_InsufficientMemory;
+		++m_uNumTasks;
+	}
 
 #ifndef AK_OPTIMIZED
     // Compute and assign a new unique stream ID.
@@ -204,6 +285,613 @@ void CAkDeviceBase::AddTask(
 		CAkStreamMgr::GetNewStreamID() // Gen stream ID.
         );
 #endif
+
+	// Push to inbox.
+	CAkStmTask * pFirst;
+	do
+	{
+		pFirst = m_pTaskInbox;
+		in_pStmTask->pNextLightItem = pFirst;
+	}
+	while ( AKPLATFORM::AkInterlockedCompareExchangePointer( (void * volatile *)&m_pTaskInbox, in_pStmTask, pFirst ) != pFirst );
+
+	return AK_Success;
+}
+
+// Moves tasks of the inbox to the task list.
+// Sync: Task list must be locked. The inbox is emptied atomically.
+void CAkDeviceBase::DrainTaskInbox()
+{
+	if ( !m_pTaskInbox )
+		return;
+
+	CAkStmTask * pTask = (CAkStmTask*)AKPLATFORM::AkInterlockedExchangePointer( (void * volatile *)&m_pTaskInbox, NULL );
+	while ( pTask )
+	{
+		CAkStmTask * pNext = pTask->pNextLightItem;
+		m_listTasks.AddFirst( pTask );
+		pTask = pNext;
+	}
+}
+
+// Destroys tasks of the deferred reclamation list.
+// Sync: Task list must be locked. 
+// Tasks are taken out of the reclamation list one at a time with the index lock, but they are 
+// inspected outside (lock order).
+void CAkDeviceBase::CleanupDestroyedTasks()
+{
+	DestroyedTaskList listTasksRemaining;
+	listTasksRemaining.Init();
+
+	for (;;)
+	{
+		CAkStmTask * pTask;
+		{
+			AkAutoLock<CAkLock> index( m_lockSchedIndex );
+			pTask = m_listTasksToDestroy.First();
+			if ( !pTask )
+				break;
+			m_listTasksToDestroy.RemoveFirst();
+		}
+
+		AKASSERT( pTask->bDestructionQueued );
+		if ( pTask->IsToBeDestroyed() 
+			&& !IsTaskClaimed( pTask ) 
+			&& pTask->CanBeDestroyed() )
+		{
+			DestroyTask( pTask );
+		}
+		else
+		{
+			// Not ready to be destroyed: wait until next turn.
+			listTasksRemaining.AddLast( pTask );
+		}
+	}
+
+	if ( !listTasksRemaining.IsEmpty() )
+	{
+		AkAutoLock<CAkLock> index( m_lockSchedIndex );
+		while ( CAkStmTask * pTask = listTasksRemaining.First() )
+		{
+			listTasksRemaining.RemoveFirst();
+			m_listTasksToDestroy.AddLast( pTask );
+		}
+	}
+}
+
+// Removes a task from the task list and destroys it.
+// Sync: Task list must be locked.
+void CAkDeviceBase::DestroyTask(
+	CAkStmTask *		in_pTask
+	)
+{
+	if ( m_listTasks.Remove( in_pTask ) != AK_Success )
+	{
+		// Task was added after the inbox was drained.
+		DrainTaskInbox();
+		AKVERIFY( m_listTasks.Remove( in_pTask ) == AK_Success );
+	}
+	{
+		AkAutoLock<CAkLock> index( m_lockSchedIndex );
+		--m_uNumTasks;
+	}
+	in_pTask->InstantDestroy();
+}
+
+// Scheduler index: inserts, repositions or removes a task according to its current scheduling status.
+// Sync: Index lock.
+void CAkDeviceBase::UpdateSchedulingIndex(
+	CAkStmTask *	in_pTask		// Task whose scheduling status changed.
+	)
+{
+	AkAutoLock<CAkLock> index( m_lockSchedIndex );
+	ReindexTask( in_pTask );
+	OnSchedulingIndexChange();
+}
+
+// Scheduler index: releases the claim of a task whose transfer was performed by another thread, and puts
+// it back in the index.
+// Sync: Index lock. The task may be destroyed by the I/O thread as soon as the lock is released.
+void CAkDeviceBase::ReleaseTaskClaim(
+	CAkStmTask *	in_pTask		// Task whose transfer was completed (Update() was called).
+	)
+{
+	AkAutoLock<CAkLock> index( m_lockSchedIndex );
+	AKASSERT( in_pTask->bIOClaimed );
+	in_pTask->bIOClaimed = false;
+	ReindexTask( in_pTask );
+}
+
+// Returns true if a task is claimed by a thread that performs its transfer. Claimed tasks cannot be destroyed.
+// Sync: Index lock.
+bool CAkDeviceBase::IsTaskClaimed(
+	CAkStmTask *	in_pTask		// Task.
+	)
+{
+	AkAutoLock<CAkLock> index( m_lockSchedIndex );
+	return in_pTask->bIOClaimed;
+}
+
+// Buffer reassignment: returns a buffer of in_uBufferSize bytes in place of a buffer that was taken from
+// another stream. The latter is exchanged if it is not of the right size, which fails (returns NULL) if
+// there is not enough contiguous memory yet. Memory is not idle in that case: the scheduler may take
+// another buffer on its next pass.
+// Sync: CAkIOThread lock.
+void * CAkDeviceBase::ReassignIOBuffer(
+	void *			in_pBuffer,		// Buffer taken from another stream.
+	AkUInt32		in_uBufferSize	// Required buffer size.
+	)
+{
+	if ( m_ioMemMgr.GetBlockSize( in_pBuffer ) == m_ioMemMgr.GetAllocSize( in_uBufferSize ) )
+		return in_pBuffer;
+
+	m_ioMemMgr.Free( in_pBuffer );
+	return m_ioMemMgr.Alloc( in_uBufferSize );
+}
+
+// I/O model: adds the duration of a completed transfer, and fits "latency + size * cost per byte"
+// to the running averages (least squares). Latency can only be told apart from bandwidth when transfer
+// sizes vary enough: otherwise, the whole duration is attributed to bandwidth.
+// Sync: I/O model lock.
+void CAkDeviceBase::AddTransferSample(
+	AkUInt32		in_uSize,		// Size transferred.
+	AkReal32		in_fDuration	// Time elapsed between submission and completion, in ms.
+	)
+{
+	if ( in_uSize == 0 )
+		return;
+
+	AkAutoLock<CAkLock> ioModel( m_lockIOModel );
+
+	AkReal32 fSize = (AkReal32)in_uSize;
+	if ( m_uNumIOSamples == 0 )
+	{
+		m_fIOMeanSize = fSize;
+		m_fIOMeanDuration = in_fDuration;
+	}
+	else
+	{
+		AkReal32 fDeltaSize = fSize - m_fIOMeanSize;
+		AkReal32 fDeltaDuration = in_fDuration - m_fIOMeanDuration;
+		m_fIOMeanSize += AK_IO_MODEL_SMOOTHING * fDeltaSize;
+		m_fIOMeanDuration += AK_IO_MODEL_SMOOTHING * fDeltaDuration;
+		m_fIOSizeVariance = ( 1.f - AK_IO_MODEL_SMOOTHING ) * ( m_fIOSizeVariance + AK_IO_MODEL_SMOOTHING * fDeltaSize * fDeltaSize );
+		m_fIOCovariance = ( 1.f - AK_IO_MODEL_SMOOTHING ) * ( m_fIOCovariance + AK_IO_MODEL_SMOOTHING * fDeltaSize * fDeltaDuration );
+	}
+	++m_uNumIOSamples;
+
+	AkReal32 fMaxCostPerByte = m_fIOMeanDuration / m_fIOMeanSize;	// Cost per byte with no latency.
+	AkReal32 fMinDeviation = AK_IO_MODEL_MIN_SIZE_DEVIATION * m_fIOMeanSize;
+	AkReal32 fCostPerByte = fMaxCostPerByte;
+	if ( m_fIOSizeVariance > fMinDeviation * fMinDeviation )
+	{
+		fCostPerByte = m_fIOCovariance / m_fIOSizeVariance;
+		if ( fCostPerByte < 0 )
+			fCostPerByte = 0;
+		else if ( fCostPerByte > fMaxCostPerByte )
+			fCostPerByte = fMaxCostPerByte;
+	}
+	m_fIOCostPerByte = fCostPerByte;
+	m_fIOLatency = m_fIOMeanDuration - fCostPerByte * m_fIOMeanSize;
+}
+
+// Inserts, repositions or removes a task according to its current scheduling status.
+// Claimed tasks are kept out of the index.
+// Sync: Index lock must be held.
+void CAkDeviceBase::ReindexTask(
+	CAkStmTask *	in_pTask
+	)
+{
+	if ( in_pTask->IsToBeDestroyed() 
+		&& !in_pTask->bDestructionQueued )
+	{
+		in_pTask->bDestructionQueued = true;
+		m_listTasksToDestroy.AddLast( in_pTask );
+	}
+
+	if ( !in_pTask->ReadyForIO() 
+		|| in_pTask->bIOClaimed )
+	{
+		UnindexTask( in_pTask );
+		return;
+	}
+
+	AkStmSchedulingKey & key = in_pTask->schedKey;
+
+	if ( in_pTask->StmType() == AK_StmTypeStandard )
+	{
+		// Standard streams are evaluated by the scheduler: just keep track of them. Their position does not
+		// change while they are indexed: they leave the index while their transfer is pending.
+		if ( key.uIndex == AK_SCHED_NOT_INDEXED )
+		{
+			AKVERIFY( m_arReadyStdTasks.AddLast( in_pTask ) );
+			key.uIndex = m_arReadyStdTasks.Length() - 1;
+			key.uPosition = in_pTask->NextTransferPosition();
+			AddToPositionIndex( in_pTask );
+		}
+		return;
+	}
+
+	// Automatic streams: refresh key.
+	AkStmSchedulingKey newKey;
+	in_pTask->GetSchedulingKey( newKey );
+	AKASSERT( newKey.priority >= AK_MIN_PRIORITY && newKey.priority <= AK_MAX_PRIORITY );
+	bool bIsStarving = ( newKey.bSignaled && newKey.fDeadline == 0 );
+
+	if ( key.uIndex == AK_SCHED_STARVING )
+	{
+		// Starving tasks keep their place in their bucket as long as they starve at the same priority.
+		if ( bIsStarving && newKey.priority == key.priority )
+		{
+			newKey.uIndex = AK_SCHED_STARVING;
+			key = newKey;
+			return;
+		}
+		UnindexTask( in_pTask );
+	}
+	else if ( bIsStarving )
+		UnindexTask( in_pTask );
+
+	// A task of the heap whose position changes leaves the position index before its key is updated.
+	bool bRepositioned = ( key.uIndex == AK_SCHED_NOT_INDEXED || newKey.uPosition != key.uPosition );
+	if ( bRepositioned 
+		&& key.uIndex != AK_SCHED_NOT_INDEXED )
+		RemoveFromPositionIndex( in_pTask );
+
+	newKey.uIndex = key.uIndex;
+	key = newKey;
+
+	if ( bIsStarving )
+	{
+		// Join the back of the starvation bucket of its priority.
+		m_arStarvingTasks[key.priority].AddLast( in_pTask );
+		key.uIndex = AK_SCHED_STARVING;
+		if ( key.priority > m_iHighestStarvingPriority )
+			m_iHighestStarvingPriority = key.priority;
+		return;
+	}
+
+	// Restore heap order.
+	if ( key.uIndex == AK_SCHED_NOT_INDEXED )
+	{
+		AKVERIFY( m_arReadyAutoTasks.AddLast( in_pTask ) );
+		key.uIndex = m_arReadyAutoTasks.Length() - 1;
+	}
+	HeapSiftUp( key.uIndex );
+	HeapSiftDown( key.uIndex );
+	if ( bRepositioned )
+		AddToPositionIndex( in_pTask );
+}
+
+// Scheduler index: removes a task.
+// Sync: Index lock.
+void CAkDeviceBase::RemoveFromSchedulingIndex(
+	CAkStmTask *	in_pTask		// Task to remove from the index, if applicable.
+	)
+{
+	AkAutoLock<CAkLock> index( m_lockSchedIndex );
+	UnindexTask( in_pTask );
+	if ( in_pTask->bDestructionQueued )
+		m_listTasksToDestroy.Remove( in_pTask );	// Not in the list if it is being destroyed by CleanupDestroyedTasks().
+}
+
+// Removes a task from the index if it is there.
+// Sync: Index lock must be held.
+void CAkDeviceBase::UnindexTask(
+	CAkStmTask *	in_pTask
+	)
+{
+	AkUInt32 uIndex = in_pTask->schedKey.uIndex;
+	if ( uIndex == AK_SCHED_NOT_INDEXED )
+		return;
+	in_pTask->schedKey.uIndex = AK_SCHED_NOT_INDEXED;
+
+	if ( uIndex == AK_SCHED_STARVING )
+	{
+		AKVERIFY( m_arStarvingTasks[in_pTask->schedKey.priority].Remove( in_pTask ) == AK_Success );
+		return;
+	}
+
+	RemoveFromPositionIndex( in_pTask );
+
+	TaskArray & arTasks = ( in_pTask->StmType() == AK_StmTypeStandard ) ? m_arReadyStdTasks : m_arReadyAutoTasks;
+	AKASSERT( arTasks[uIndex] == in_pTask );
+
+	// Move last task in the freed slot.
+	CAkStmTask * pLastTask = arTasks.Last();
+	arTasks.RemoveLast();
+	if ( pLastTask != in_pTask )
+	{
+		arTasks[uIndex] = pLastTask;
+		pLastTask->schedKey.uIndex = uIndex;
+		if ( &arTasks == &m_arReadyAutoTasks )
+		{
+			HeapSiftUp( uIndex );
+			HeapSiftDown( uIndex );
+		}
+	}
+}
+
+// Heap maintenance: moves task up until its parent is more urgent.
+// Sync: Index lock must be held.
+void CAkDeviceBase::HeapSiftUp(
+	AkUInt32 in_uIndex
+	)
+{
+	CAkStmTask * pTask = m_arReadyAutoTasks[in_uIndex];
+	while ( in_uIndex > 0 )
+	{
+		AkUInt32 uParent = ( in_uIndex - 1 ) / 2;
+		CAkStmTask * pParent = m_arReadyAutoTasks[uParent];
+		if ( !IsMoreUrgent( pTask->schedKey, pParent->schedKey ) )
+			break;
+		m_arReadyAutoTasks[in_uIndex] = pParent;
+		pParent->schedKey.uIndex = in_uIndex;
+		in_uIndex = uParent;
+	}
+	m_arReadyAutoTasks[in_uIndex] = pTask;
+	pTask->schedKey.uIndex = in_uIndex;
+}
+
+// Heap maintenance: moves task down until its children are less urgent.
+// Sync: Index lock must be held.
+void CAkDeviceBase::HeapSiftDown(
+	AkUInt32 in_uIndex
+	)
+{
+	AkUInt32 uNumTasks = m_arReadyAutoTasks.Length();
+	CAkStmTask * pTask = m_arReadyAutoTasks[in_uIndex];
+	for (;;)
+	{
+		AkUInt32 uChild = 2 * in_uIndex + 1;
+		if ( uChild >= uNumTasks )
+			break;
+		if ( uChild + 1 < uNumTasks
+			&& IsMoreUrgent( m_arReadyAutoTasks[uChild+1]->schedKey, m_arReadyAutoTasks[uChild]->schedKey ) )
+			++uChild;
+		CAkStmTask * pChild = m_arReadyAutoTasks[uChild];
+		if ( !IsMoreUrgent( pChild->schedKey, pTask->schedKey ) )
+			break;
+		m_arReadyAutoTasks[in_uIndex] = pChild;
+		pChild->schedKey.uIndex = in_uIndex;
+		in_uIndex = uChild;
+	}
+	m_arReadyAutoTasks[in_uIndex] = pTask;
+	pTask->schedKey.uIndex = in_uIndex;
+}
+
+// Elevator policy: inserts a task in m_arTasksByPosition. Room was reserved in AddTask().
+// Sync: Index lock must be held.
+void CAkDeviceBase::AddToPositionIndex(
+	CAkStmTask * in_pTask
+	)
+{
+	if ( !m_bElevator )
+		return;
+	CAkStmTask ** ppSlot = m_arTasksByPosition.Insert( FindInPositionIndex( in_pTask->schedKey.uPosition, in_pTask ) );
+	AKASSERT( ppSlot );
+	*ppSlot = in_pTask;
+}
+
+// Elevator policy: removes a task from m_arTasksByPosition.
+// Sync: Index lock must be held.
+void CAkDeviceBase::RemoveFromPositionIndex(
+	CAkStmTask * in_pTask
+	)
+{
+	if ( !m_bElevator )
+		return;
+	AkUInt32 uIndex = FindInPositionIndex( in_pTask->schedKey.uPosition, in_pTask );
+	AKASSERT( uIndex < m_arTasksByPosition.Length() && m_arTasksByPosition[uIndex] == in_pTask );
+	m_arTasksByPosition.Erase( uIndex );
+}
+
+// Elevator policy: binary search in m_arTasksByPosition.
+// Sync: Index lock must be held.
+AkUInt32 CAkDeviceBase::FindInPositionIndex(
+	AkUInt64			in_uPosition,		// File position (absolute).
+	CAkStmTask *		in_pTask			// Tie-breaker. Pass NULL to find the first task at or after in_uPosition.
+	)
+{
+	AkUInt32 uLow = 0;
+	AkUInt32 uHigh = m_arTasksByPosition.Length();
+	while ( uLow < uHigh )
+	{
+		AkUInt32 uMiddle = uLow + ( uHigh - uLow ) / 2;
+		CAkStmTask * pTask = m_arTasksByPosition[uMiddle];
+		if ( pTask->schedKey.uPosition < in_uPosition 
+			|| ( pTask->schedKey.uPosition == in_uPosition && (AkUIntPtr)pTask < (AkUIntPtr)in_pTask ) )
+			uLow = uMiddle + 1;
+		else
+			uHigh = uMiddle;
+	}
+	return uLow;
+}
+
+// Returns the most urgent task of the index, and its scheduling key.
+// Sync: Index lock must be held.
+CAkStmTask * CAkDeviceBase::PeekMostUrgentTask(
+	bool				in_bStdStmOnly,	// Consider standard streams only.
+	AkStmSchedulingKey & out_key		// Returned scheduling key of chosen task.
+	)
+{
+	CAkStmTask * pTask = NULL;
+
+	// Automatic streams: first starving task of the highest priority, otherwise top of heap. Keys are up-to-date.
+	if ( !in_bStdStmOnly )
+	{
+		pTask = PeekStarvingTask();
+		if ( !pTask && m_arReadyAutoTasks.Length() > 0 )
+			pTask = m_arReadyAutoTasks[0];
+		if ( pTask )
+			out_key = pTask->schedKey;
+	}
+
+	// Standard streams: their effective deadline depends on time, so it is computed now.
+	// Note: standard streams are only indexed while an operation is pending; there are few of them.
+	TaskArray::Iterator it = m_arReadyStdTasks.Begin();
+	while ( it != m_arReadyStdTasks.End() )
+	{
+		AkStmSchedulingKey key;
+		(*it)->GetSchedulingKey( key );
+		if ( !pTask || IsMoreUrgent( key, out_key ) )
+		{
+			pTask = (*it);
+			out_key = key;
+		}
+		++it;
+	}
+
+	return pTask;
+}
+
+// Returns the first task of the highest priority starvation bucket, NULL if there is none.
+// Sync: Index lock must be held.
+CAkStmTask * CAkDeviceBase::PeekStarvingTask()
+{
+	// Buckets that were emptied since last time are skipped here rather than when they are emptied.
+	while ( m_iHighestStarvingPriority >= AK_MIN_PRIORITY )
+	{
+		CAkStmTask * pTask = m_arStarvingTasks[m_iHighestStarvingPriority].First();
+		if ( pTask )
+			return pTask;
+		--m_iHighestStarvingPriority;
+	}
+	return NULL;
+}
+
+// Elevator policy: returns the task whose next transfer is nearest after the end of the previous one
+// (C-LOOK), among tasks that can go before the most urgent task without putting its deadline at risk.
+// Sync: Index lock must be held.
+CAkStmTask * CAkDeviceBase::PeekNearestTask(
+	CAkStmTask *		in_pMostUrgentTask,	// Task returned by PeekMostUrgentTask().
+	AkStmSchedulingKey & io_key				// In: Scheduling key of in_pMostUrgentTask. Out: Key of chosen task.
+	)
+{
+	// Starving tasks (including those that are predicted to starve) are never delayed. 
+	// Note: Starvation buckets are empty if the most urgent task is not starving.
+	if ( io_key.fDeadline == 0 )
+		return in_pMostUrgentTask;
+
+	// Time that can be spent on other transfers before the most urgent one must be sent. Transfers that 
+	// were already chosen in this pass go first.
+	AkElevatorIOModel ioModel;
+	GetElevatorIOModel( ioModel );
+	AkReal32 fSlack = io_key.fDeadline - m_fElevatorBatchTime - PredictElevatorTransferTime( ioModel, in_pMostUrgentTask->GetTransferSize() );
+
+	// Candidates: automatic streams of the heap (their key is up-to-date) and pending standard streams. They are
+	// swept in increasing position from the head, and once past the last one, from the smallest position (C-LOOK).
+	// The sweep stops at the first position where a task qualifies, and chooses the most urgent task there. 
+	// The most urgent task always qualifies, so it is chosen at the latest when the sweep reaches it.
+	// Unsignaled tasks never go before signaled ones.
+	CAkStmTask * pNearestTask = NULL;
+	AkStmSchedulingKey nearestKey;
+	AkUInt64 uNearestPosition = 0;
+	AkUInt32 uNumTasks = m_arTasksByPosition.Length();
+	AkUInt32 uFirst = FindInPositionIndex( m_uHeadPosition, NULL );
+	for ( AkUInt32 uSwept = 0; uSwept < uNumTasks; ++uSwept )
+	{
+		CAkStmTask * pTask = m_arTasksByPosition[( uFirst + uSwept ) % uNumTasks];
+		if ( pNearestTask 
+			&& pTask->schedKey.uPosition != uNearestPosition )
+			break;
+
+		AkStmSchedulingKey key;
+		if ( pTask == in_pMostUrgentTask )
+			key = io_key;
+		else
+		{
+			if ( pTask->StmType() == AK_StmTypeStandard )
+				pTask->GetSchedulingKey( key );
+			else
+				key = pTask->schedKey;
+
+			if ( key.bSignaled != io_key.bSignaled 
+				|| key.fDeadline == 0
+				|| PredictElevatorTransferTime( ioModel, pTask->GetTransferSize() ) > fSlack )
+				continue;
+		}
+
+		if ( !pNearestTask 
+			|| IsMoreUrgent( key, nearestKey ) )
+		{
+			pNearestTask = pTask;
+			nearestKey = key;
+			uNearestPosition = pTask->schedKey.uPosition;
+		}
+	}
+
+	if ( !pNearestTask )
+	{
+		AKASSERT( !"Most urgent task is not in the position index" );
+		return in_pMostUrgentTask;
+	}
+
+	io_key = nearestKey;
+	return pNearestTask;
+}
+
+// Elevator policy: returns a consistent copy of the I/O model. Until a transfer has been measured, the I/O 
+// model predicts 0: a slow device is assumed instead, so that urgent tasks are not passed over.
+// Sync: I/O model lock. Samples may be added concurrently (see AddTransferSample()).
+void CAkDeviceBase::GetElevatorIOModel(
+	AkElevatorIOModel &	out_model			// Returned I/O model.
+	)
+{
+	AkAutoLock<CAkLock> ioModel( m_lockIOModel );
+	if ( m_uNumIOSamples == 0 )
+	{
+		out_model.fLatency = AK_ELEVATOR_DEFAULT_IO_LATENCY;
+		out_model.fCostPerByte = AK_ELEVATOR_DEFAULT_IO_COST_PER_BYTE;
+	}
+	else
+	{
+		out_model.fLatency = m_fIOLatency;
+		out_model.fCostPerByte = m_fIOCostPerByte;
+	}
+}
+
+// Releases the segment cache of an automatic stream, when I/O memory is exhausted. Returns false if no
+// stream has cached data.
+// Note: This requires a pass over tasks, but only happens when the I/O pool is exhausted and some data is cached.
+// Sync: Task list and CAkIOThread must be locked.
+bool CAkDeviceBase::ReleaseCachedMemory()
+{
+	if ( m_uCachedSize == 0 )
+		return false;
+
+	TaskList::Iterator it = m_listTasks.Begin();
+	while ( it != m_listTasks.End() )
+	{
+		if ( (*it)->StmType() == AK_StmTypeAutomatic 
+			&& static_cast<CAkAutoStmBase*>(*it)->FlushCache() )
+			return true;
+		++it;
+	}
+	AKASSERT( !"Cached data size is inconsistent" );
+	return false;
+}
+
+// Returns the indexed automatic stream with the greatest deadline (for buffer reassignment).
+// Sync: Index lock must be held.
+CAkStmTask * CAkDeviceBase::FindMostBufferedTask(
+	AkReal32 &			out_fDeadline	// Returned deadline of this task.
+	)
+{
+	// Note: This requires a pass over automatic streams, but only happens when the I/O pool is exhausted.
+	CAkStmTask * pMostBufferedTask = NULL;
+	out_fDeadline = 0;
+	TaskArray::Iterator it = m_arReadyAutoTasks.Begin();
+	while ( it != m_arReadyAutoTasks.End() )
+	{
+		if ( !pMostBufferedTask || (*it)->schedKey.fDeadline > out_fDeadline )
+		{
+			pMostBufferedTask = (*it);
+			out_fDeadline = (*it)->schedKey.fDeadline;
+		}
+		++it;
+	}
+	return pMostBufferedTask;
 }
 
 // Scheduler algorithm.
@@ -211,187 +899,138 @@ void CAkDeviceBase::AddTask(
 // Return: If a task is found, a valid pointer to a task is returned, as well
 // as the address in/from which to perform a data transfer.
 // Otherwise, returns NULL.
-// Sync: 
+// Sync:
 // 1. Locks task list ("scheduler lock").
 // 2. If it chooses a standard stream task, the stream becomes "I/O locked" before the scheduler lock is released.
-CAkStmTask * CAkDeviceBase::SchedulerFindNextTask( 
+CAkStmTask * CAkDeviceBase::SchedulerFindNextTask(
     void *&		out_pBuffer,	// Returned I/O buffer used for this transfer.
 	AkReal32 &	out_fOpDeadline	// Returned deadline for this transfer.
     )
 {
     // Start scheduling.
     // ------------------------------------
-	
+
 	// Lock tasks list.
     AkAutoLock<CAkLock> scheduling( m_lockTasksList );
 
     // Stamp time.
     AKPLATFORM::PerformanceCounter( &m_time );
 
+	// Register tasks created since last pass, and clean up tasks that were scheduled for destruction.
+	DrainTaskInbox();
+	if ( HasTasksToDestroy() )
+		CleanupDestroyedTasks();
+
+	m_fElevatorBatchTime = 0;
+	return SchedulerPickTask( out_pBuffer, out_fOpDeadline );
+}
+
+// Scheduler algorithm: batched version.
+// Finds up to in_uMaxTransfers transfers to issue, in a single scheduler pass. A task is chosen at most once per
+// pass, since its scheduling status only changes once its transfer has been sent to the Low-Level IO.
+// With in_bClaimTasks, chosen tasks are claimed: they are not chosen again until ReleaseTaskClaim() is called.
+// Returns the number of transfers stored in out_arTransfers.
+// Sync:
+// 1. Locks task list ("scheduler lock") once for the whole pass.
+// 2. Same as SchedulerFindNextTask() for each chosen task.
+AkUInt32 CAkDeviceBase::SchedulerFindNextTasks(
+	AkStmScheduledTransfer *	out_arTransfers,	// Returned transfers. Must hold at least in_uMaxTransfers items.
+	AkUInt32					in_uMaxTransfers,	// Maximum number of transfers to schedule.
+	bool						in_bClaimTasks		// Claim chosen tasks instead of putting them back in the index.
+	)
+{
+	AkAutoLock<CAkLock> scheduling( m_lockTasksList );
+
+	AKPLATFORM::PerformanceCounter( &m_time );
+
+	DrainTaskInbox();
+	if ( HasTasksToDestroy() )
+		CleanupDestroyedTasks();
+
+	m_fElevatorBatchTime = 0;
+	AkUInt32 uNumTransfers = 0;
+	while ( uNumTransfers < in_uMaxTransfers )
+	{
+		AkStmScheduledTransfer & transfer = out_arTransfers[uNumTransfers];
+		transfer.pTask = SchedulerPickTask( transfer.pBuffer, transfer.fOpDeadline );
+		if ( !transfer.pTask )
+			break;
+		++uNumTransfers;
+
+		// Take chosen task out of the index for the rest of this pass.
+		AkAutoLock<CAkLock> index( m_lockSchedIndex );
+		transfer.pTask->bIOClaimed = in_bClaimTasks;
+		UnindexTask( transfer.pTask );
+	}
+
+	// Put chosen tasks back. Their key will be updated again once their transfer is sent.
+	if ( !in_bClaimTasks )
+	{
+		for ( AkUInt32 uTransfer = 0; uTransfer < uNumTransfers; ++uTransfer )
+			UpdateSchedulingIndex( out_arTransfers[uTransfer].pTask );
+	}
+
+	return uNumTransfers;
+}
+
+// Scheduler algorithm: chooses the next task and gets its I/O buffer.
+// Sync: Task list must be locked, time must be stamped.
+CAkStmTask * CAkDeviceBase::SchedulerPickTask(
+    void *&		out_pBuffer,	// Returned I/O buffer used for this transfer.
+	AkReal32 &	out_fOpDeadline	// Returned deadline for this transfer.
+    )
+{
     // If m_bDoWaitMemoryChange, no automatic stream operation can be scheduled because memory is full
     // and will not be reassigned until someone calls NotifyMemChange().
     // Therefore, we only look for a pending standard stream (too bad if memory is freed in the meantime).
     if ( CannotScheduleAutoStreams() )
         return ScheduleStdStmOnly( out_pBuffer, out_fOpDeadline );
 
-    TaskList::IteratorEx it = m_listTasks.BeginEx();
-    CAkStmTask * pTask = NULL;
-	CAkStmTask * pMostBufferedTask = NULL;
-	AkReal32 fSmallestDeadline;
-	AkReal32 fGreatestDeadlineAmongAutoStms = 0;
-	bool bLeastBufferedTaskRequiresScheduling = false;
-    
-    // Get first valid task's values for comparison.
-    while ( it != m_listTasks.End() )
-    {
-		// Verify that we can perform I/O on this one.
-        if ( (*it)->IsToBeDestroyed() )
-        {
-			if ( (*it)->CanBeDestroyed() )
-			{
-				// Clean up.
-				CAkStmTask * pTaskToDestroy = (*it);
-	            it = m_listTasks.Erase( it );
-				pTaskToDestroy->InstantDestroy();
-	        }
-			else 
-			{
-				// Not ready to be destroyed: wait until next turn.
-				++it;
-			}
-        }
-        else if ( !(*it)->ReadyForIO() )
-            ++it;   // Skip this one.
-        else
-        {
-            // Current iterator refers to a task that is not scheduled to be destroyed, and is ready for I/O. Proceed.
-			// pTask and fSmallestDeadline are the current task and associated effective deadline chosen for I/O.
-            pTask = (*it);
-			fSmallestDeadline = pTask->EffectiveDeadline();
-			bLeastBufferedTaskRequiresScheduling = pTask->RequiresScheduling();
-
-			// pMostBufferedTask and fGreatestDeadlineAmongAutoStms are used to determine which task is going to give a buffer away
-			// if we lack memory. They apply to automatic streams only,
-			if ( pTask->StmType() == AK_StmTypeAutomatic )
-			{
-				pMostBufferedTask = pTask;
-				fGreatestDeadlineAmongAutoStms = fSmallestDeadline;
-			}
-			break;  
-        }
-    }    
-
-    if ( !pTask )
-    {
-        // No task was ready for I/O. Leave.
-        return NULL;
-    }
-
     // Find task with smallest effective deadline.
     // If a task has a deadline equal to 0, this means we are starving; user throughtput is greater than
     // low-level bandwidth. In that situation, starving streams are chosen according to their priority.
-    // If more than one starving stream has the same priority, the scheduler chooses the one that has been 
+    // If more than one starving stream has the same priority, the scheduler chooses the one that has been
     // waiting for I/O for the longest time.
-    // Note 1: This scheduler does not have any idea of the actual low-level throughput, nor does it try to
-    // know it. It just reacts to the status of its streams at a given moment.
-    // Note 2: By choosing the highest priority stream only when we encounter starvation, we take the bet
-    // that the transfer will complete before the user has time consuming its data. Therefore it remains 
+    // Note 1: This scheduler keeps a model of the low-level latency and bandwidth, measured from completed
+    // transfers (see AddTransferSample()). Tasks whose next transfer is not expected to complete before their
+    // deadline are considered starving already (see CAkStmTask::GetSchedulingKey()).
+    // Note 2: By choosing the highest priority stream only when we encounter (predicted) starvation, we take 
+    // the bet that the transfer will complete before the user has time consuming its data. Therefore it remains
     // possible that high priority streams starve.
     // Note 3: Automatic streams that just started are considered starving. They are chosen according to
-    // their priority first, in a round robin fashion (starving mechanism).
+    // their priority first, in a round robin fashion (starving mechanism). Signaled starving automatic streams
+    // wait in a FIFO per priority level (starvation buckets) rather than being compared with each other.
     // Note 4: If starving mode lasts for a long time, low-priority streams will stop being chosen for I/O.
-	// Note 5: Tasks that are actually signaled (RequireScheduling) have priority over other tasks. A task 
+	// Note 5: Tasks that are actually signaled (RequireScheduling) have priority over other tasks. A task
 	// that is unsignaled may still have a smaller deadline than other tasks (because tasks must be double-
 	// buffered at least). However, an unsignaled task will only be chosen if there are no signaled task.
+	// Note 6: This rule is implemented by IsMoreUrgent(). Tasks that are ready for I/O are kept sorted in
+	// the scheduler index as their status changes, so that the most urgent one is readily available.
+	// Note 7: With the elevator policy (AK_SCHEDULER_ELEVATOR), the most urgent task may be passed over for
+	// the task whose transfer is nearest after the previous one, as long as its deadline is not at risk
+	// (see PeekNearestTask()).
+
+	CAkStmTask * pTask;
+	AkStmSchedulingKey key;
+	{
+		AkAutoLock<CAkLock> index( m_lockSchedIndex );
+		pTask = PeekMostUrgentTask( false, key );
+		if ( pTask && m_bElevator )
+			pTask = PeekNearestTask( pTask, key );
+	}
 
-    // Start with the following task.
-    AKASSERT( pTask );
-    ++it;
-
-    while ( it != m_listTasks.End() )
+    if ( !pTask )
     {
-        // Verify that we can perform I/O on this one.
-        if ( (*it)->IsToBeDestroyed() )
-        {
-			if ( (*it)->CanBeDestroyed() )
-			{
-				// Clean up.
-				CAkStmTask * pTaskToDestroy = (*it);
-	            it = m_listTasks.Erase( it );
-				pTaskToDestroy->InstantDestroy();
-	        }
-			else 
-			{
-				// Not ready to be destroyed: wait until next turn.
-				++it;
-			}
-        }
-        else if ( (*it)->ReadyForIO() )
-        {
-			AkReal32 fDeadline = (*it)->EffectiveDeadline();
-
-			if ( !bLeastBufferedTaskRequiresScheduling && (*it)->RequiresScheduling() )
-			{
-				// This is the first task that we run into which actually requires action from 
-				// scheduler: pick it. 
-				pTask = (*it);
-				fSmallestDeadline = fDeadline;
-				bLeastBufferedTaskRequiresScheduling = true;
-			}
-			else if ( !bLeastBufferedTaskRequiresScheduling || (*it)->RequiresScheduling() )
-			{
-				if ( fDeadline == 0 )
-				{
-					// Deadline is zero: starvation mode.
-					// Choose task with highest priority among those that are starving.
-					if ( (*it)->Priority() > pTask->Priority() || fSmallestDeadline > 0 )
-					{
-						pTask = (*it);
-						fSmallestDeadline = fDeadline;
-						bLeastBufferedTaskRequiresScheduling = pTask->RequiresScheduling();
-					}
-					else if ( (*it)->Priority() == pTask->Priority() )
-					{
-						// Same priority: choose the one that has waited the most.
-						if ( (*it)->TimeSinceLastTransfer( GetTime() ) > pTask->TimeSinceLastTransfer( GetTime() ) )
-						{
-							pTask = (*it);
-							fSmallestDeadline = fDeadline;
-							bLeastBufferedTaskRequiresScheduling = pTask->RequiresScheduling();
-						}
-					}
-				}
-				else if ( fDeadline < fSmallestDeadline )
-				{
-					// Deadline is not zero: low-level has enough bandwidth. Just take the task with smallest deadline.
-					// We take the bet that this transfer will have time to occur fast enough to properly service
-					// the others on next pass.
-					pTask = (*it);
-					fSmallestDeadline = fDeadline;
-					bLeastBufferedTaskRequiresScheduling = pTask->RequiresScheduling();
-				}
-			}
-
-            // Keep track of automatic stream tasks that have a great deadline, for eventual buffer reassignment.
-            if ( (*it)->StmType() == AK_StmTypeAutomatic &&
-                 fDeadline > fGreatestDeadlineAmongAutoStms )
-            {
-                fGreatestDeadlineAmongAutoStms = fDeadline;
-                pMostBufferedTask = (*it);
-            }
+        // No task was ready for I/O. Leave.
+        return NULL;
+    }
 
-            ++it;
-        }
-        else
-            ++it;   // Skip this task: it is not waiting for I/O.
-	}
-	
-	out_fOpDeadline = fSmallestDeadline;
+	out_fOpDeadline = key.fDeadline;
 
 	// Bail out now if the chosen task doesn't actually needs buffering, and we are not using the uIdleWaitTime
 	// feature (the one that allows the device to stream in data during its free time - usually used when there
 	// is a lot of streaming memory).
-	if ( !bLeastBufferedTaskRequiresScheduling && !CanOverBuffer() )
+	if ( !key.bSignaled && !CanOverBuffer() )
 		return NULL;
 
     // Standard streams:
@@ -404,16 +1043,17 @@ CAkStmTask * CAkDeviceBase::SchedulerFindNextTask(
         out_pBuffer = pTask->TryGetIOBuffer();
         if ( !out_pBuffer )
             return NULL;    // Task cancelled or destroyed by user. Return NULL to cancel I/O.
+		OnTaskScheduled( pTask, key );
         return pTask;
     }
-    
+
     // Automatic streams:
     // ------------------------------
 
-    // Automatic streams' TryGetIOBuffer() must be m_lockAutoSems protected, because it tries to allocate a 
+    // Automatic streams' TryGetIOBuffer() must be m_lockAutoSems protected, because it tries to allocate a
     // buffer from the memory manager.
-    // If it fails, and we decide not to reassign a buffer from another automatic stream, the automatic 
-    // streams semaphore should be notified as "memory idle" (inhibates the semaphore). 
+    // If it fails, and we decide not to reassign a buffer from another automatic stream, the automatic
+    // streams semaphore should be notified as "memory idle" (inhibates the semaphore).
     // Memory allocation and semaphore inhibition must be atomic, in case someone freed memory in the meantime.
     // Since most of the time this situation does not happen, we first try getting memory without locking.
 
@@ -421,10 +1061,17 @@ CAkStmTask * CAkDeviceBase::SchedulerFindNextTask(
 	{
 		AkAutoLock<CAkIOThread> lock( *this );
 	    out_pBuffer = pTask->TryGetIOBuffer();
+
+		// Segment caches of automatic streams are the first to give their memory away.
+		while ( !out_pBuffer 
+				&& ReleaseCachedMemory() )
+		{
+			out_pBuffer = pTask->TryGetIOBuffer();
+		}
 	}
     if ( !out_pBuffer )
     {
-        // No buffer is available. Remove a buffer from the most buffered task unless one of the following 
+        // No buffer is available. Remove a buffer from the most buffered task unless one of the following
         // conditions is met:
         // - The most buffered task is also the one that was chosen for I/O.
 		// - The chosen task is signaled.
@@ -432,25 +1079,33 @@ CAkStmTask * CAkDeviceBase::SchedulerFindNextTask(
 
         // If we decide not to remove a buffer, inhibate automatic stream semaphore (NotifyMemIdle).
 
-        if ( CanOverBuffer() &&
-			 bLeastBufferedTaskRequiresScheduling &&
-			 pMostBufferedTask &&
+		CAkStmTask * pMostBufferedTask = NULL;
+		AkReal32 fGreatestDeadlineAmongAutoStms = 0;
+		if ( CanOverBuffer() && key.bSignaled )
+		{
+			AkAutoLock<CAkLock> index( m_lockSchedIndex );
+			pMostBufferedTask = FindMostBufferedTask( fGreatestDeadlineAmongAutoStms );
+		}
+
+        if ( pMostBufferedTask &&
 			 pTask != pMostBufferedTask &&
              fGreatestDeadlineAmongAutoStms > m_fTargetAutoStmBufferLength )
         {
             // Remove a buffer from the most buffered task.
-            // Note 1. PopIOBuffer() does not free memory, it just removes a buffer from its table and passes it back. 
+            // Note 1. PopIOBuffer() does not free memory, it just removes a buffer from its table and passes it back.
+            // If the buffer is not of the size required by the chosen task, it is exchanged (see ReassignIOBuffer()).
             // Note 2. Bad citizens could be harmful to this algorithm. A stream could decide
             // not to give a buffer just because its user owns too much at a time. Technically, we could seek the next
             // "most buffered" stream, but we prefer not.
             // Note 3. If PopIOBuffer() fails returning a buffer, we must call NotifyMemIdle(). However, since PopIOBuffer()
             // needs to lock its status to manipulate its array of buffers, NotifyMemIdle() is called from within to
             // avoid potential deadlocks.
-            
-            out_pBuffer = pMostBufferedTask->PopIOBuffer();
+
+            out_pBuffer = pMostBufferedTask->PopIOBuffer( pTask->GetBufferSize() );
             if ( !out_pBuffer )
             {
                 // The stream would not let go one of its buffers. Sleep (NotifyMemIdle() was called from PopIOBuffer()).
+                // Or the buffer it let go was too small: try again on next pass.
                 return NULL;
             }
         }
@@ -461,65 +1116,41 @@ CAkStmTask * CAkDeviceBase::SchedulerFindNextTask(
             // think that there is no memory in the case a buffer was freed after our failed attempt to allocate one.
             // Therefore, we lock, try to allocate again, perform I/O if it succeeds, notify that memory is idle otherwise.
 			AkAutoLock<CAkIOThread> lock( *this );
-            
-			out_pBuffer = pTask->TryGetIOBuffer(); 
+
+			out_pBuffer = pTask->TryGetIOBuffer();
             if ( !out_pBuffer )
 			{
                 NotifyMemIdle();
 
 				// Starting now, automatic streams will not trigger I/O thread awakening until a change occurs with memory.
 				// Pending standard streams will continue notifying, so the thread might come back and execute a
-				// standard stream. 
+				// standard stream.
 				return NULL;
 			}
-            return pTask;
         }
     }
 
+	OnTaskScheduled( pTask, key );
     return pTask;
 }
 
 // Scheduler algorithm: standard stream-only version.
 // Finds next task among standard streams only (typically when there is no more memory).
 // Note: standard streams that are ready for IO are always signaled.
+// Sync: Task list must be locked.
 CAkStmTask * CAkDeviceBase::ScheduleStdStmOnly(
     void *&		out_pBuffer,	// Returned I/O buffer used for this transfer.
 	AkReal32 &	out_fOpDeadline	// Returned deadline for this transfer.
     )
 {
-    TaskList::IteratorEx it = m_listTasks.BeginEx();
-    CAkStmTask * pTask = NULL;
-    
-    // Get first valid task's values for comparison.
-    while ( it != m_listTasks.End() )
-    {
-        // Verify that we can perform I/O on this one.
-        if ( (*it)->IsToBeDestroyed() )
-        {
-            if ( (*it)->CanBeDestroyed() )
-			{
-				// Clean up.
-				CAkStmTask * pTaskToDestroy = (*it);
-	            it = m_listTasks.Erase( it );
-				pTaskToDestroy->InstantDestroy();
-	        }
-			else 
-			{
-				// Not ready to be destroyed: wait until next turn.
-				++it;
-			}
-        }
-        else if ( (*it)->StmType() == AK_StmTypeStandard &&
-                    (*it)->ReadyForIO() )
-        {
-            // Current iterator refers to a standard stream task that is not scheduled to be destroyed, 
-            // and that is pending. Proceed.
-            pTask = (*it);
-            break;
-        }
-        else
-            ++it;
-    }    
+    // Find task with smallest effective deadline.
+    // See note in SchedulerFindNextTask(). It is the same algorithm, except that automatic streams are excluded.
+	CAkStmTask * pTask;
+	AkStmSchedulingKey key;
+	{
+		AkAutoLock<CAkLock> index( m_lockSchedIndex );
+		pTask = PeekMostUrgentTask( true, key );
+	}
 
     if ( !pTask )
     {
@@ -527,86 +1158,53 @@ CAkStmTask * CAkDeviceBase::ScheduleStdStmOnly(
         return NULL;
     }
 
-    // fSmallestDeadline is the smallest effective deadline found to date. Used to find the next task for I/O.
-    AkReal32 fSmallestDeadline = pTask->EffectiveDeadline();
-    
-    // Find task with smallest effective deadline.
-    // See note in SchedulerFindNextTask(). It is the same algorithm, except that automatic streams are excluded.
-    
-    // Start with the following task.
-    AKASSERT( pTask );
-    ++it;
-
-    while ( it != m_listTasks.End() )
-    {
-        // Verify that we can perform I/O on this one.
-        if ( (*it)->IsToBeDestroyed() )
-        {
-            if ( (*it)->CanBeDestroyed() )
-			{
-				// Clean up.
-				CAkStmTask * pTaskToDestroy = (*it);
-	            it = m_listTasks.Erase( it );
-				pTaskToDestroy->InstantDestroy();
-	        }
-			else 
-			{
-				// Not ready to be destroyed: wait until next turn.
-				++it;
-			}
-        }
-        else if ( (*it)->StmType() == AK_StmTypeStandard &&
-                    (*it)->ReadyForIO() )
-        {
-            AkReal32 fDeadline = (*it)->EffectiveDeadline(); 
-
-            if ( fDeadline == 0 )
-            {
-                // Deadline is zero. Starvation mode: user throughput is greater than low-level bandwidth.
-                // Choose task with highest priority among those that are starving.
-                if ( (*it)->Priority() > pTask->Priority() || fSmallestDeadline > 0 )
-                {
-                    pTask = (*it);
-                    fSmallestDeadline = fDeadline;
-                }
-                else if ( (*it)->Priority() == pTask->Priority() )
-                {
-                    // Same priority: choose the one that has waited the most.
-                    if ( (*it)->TimeSinceLastTransfer( GetTime() ) > pTask->TimeSinceLastTransfer( GetTime() ) )
-                    {
-                        pTask = (*it);
-                        fSmallestDeadline = fDeadline;
-                    }
-                }
-            }
-            else if ( fDeadline < fSmallestDeadline )
-            {
-                // Deadline is not zero: low-level has enough bandwidth. Just take the task with smallest deadline.
-                // We take the bet that this transfer will have time to occur fast enough to properly service
-                // the others.
-                pTask = (*it);
-                fSmallestDeadline = fDeadline;
-            }
-            ++it;
-        }
-        else
-            ++it;   // Skip this task; not waiting for I/O.
-    }
-
-    // Lock task.
-    AKASSERT( pTask );
+	out_fOpDeadline = key.fDeadline;
 
-	out_fOpDeadline = fSmallestDeadline;
-    
     // IMPORTANT: If this method succeeds (returns a buffer), the task will lock itself for I/O (AkStdStmBase::m_lockIO).
     // All operations that need to wait for I/O to complete block on that lock.
-    out_pBuffer = pTask->TryGetIOBuffer(); 
+    out_pBuffer = pTask->TryGetIOBuffer();
     if ( !out_pBuffer )
         return NULL;    // Task cancelled or destroyed by user. Return NULL to cancel I/O.
+	OnTaskScheduled( pTask, key );
     return pTask;
 
 }
 
+// Called by the scheduler once it got an I/O buffer for the chosen task.
+// Sync: Index lock.
+void CAkDeviceBase::OnTaskScheduled(
+	CAkStmTask *	in_pTask,	// Task chosen for I/O.
+	const AkStmSchedulingKey & in_key	// Scheduling key with which it was chosen.
+	)
+{
+	AkAutoLock<CAkLock> index( m_lockSchedIndex );
+
+	// Elevator policy: the head moves only once the transfer is certain to be sent.
+	if ( m_bElevator )
+	{
+		AkElevatorIOModel ioModel;
+		GetElevatorIOModel( ioModel );
+		AkUInt32 uTransferSize = in_pTask->GetTransferSize();
+		m_uHeadPosition = in_key.uPosition + uTransferSize;
+		m_fElevatorBatchTime += PredictElevatorTransferTime( ioModel, uTransferSize );
+	}
+
+	// Round robin among starving tasks: the chosen task goes to the back of its bucket now, since it keeps
+	// its place when it is reindexed at the same priority (see ReindexTask()). Otherwise a task that is
+	// still starving after its transfer (or predicted to starve, see CAkStmTask::GetSchedulingKey()) would
+	// be chosen again before its peers.
+	AkStmSchedulingKey & key = in_pTask->schedKey;
+	if ( key.uIndex == AK_SCHED_STARVING )
+	{
+		StarvingTaskList & bucket = m_arStarvingTasks[key.priority];
+		if ( bucket.Last() != in_pTask )
+		{
+			AKVERIFY( bucket.Remove( in_pTask ) == AK_Success );
+			bucket.AddLast( in_pTask );
+		}
+	}
+}
+
 // Forces the device to clean up dead tasks. 
 void CAkDeviceBase::ForceCleanup(
 	bool in_bKillLowestPriorityTask,				// True if the device should kill the task with lowest priority.
@@ -615,28 +1213,20 @@ void CAkDeviceBase::ForceCleanup(
 {
 	AkAutoLock<CAkLock> scheduling( m_lockTasksList );
 
+	// Cleanup while we're at it.
+	DrainTaskInbox();
+	if ( HasTasksToDestroy() )
+		CleanupDestroyedTasks();
+
+	if ( !in_bKillLowestPriorityTask )
+		return;
+
 	CAkStmTask * pTaskToKill = NULL;
-	TaskList::IteratorEx it = m_listTasks.BeginEx();
+	TaskList::Iterator it = m_listTasks.Begin();
     while ( it != m_listTasks.End() )
     {
-        // Cleanup while we're at it.
-        if ( (*it)->IsToBeDestroyed() )
-        {
-            if ( (*it)->CanBeDestroyed() )
-			{
-				// Clean up.
-				CAkStmTask * pTaskToDestroy = (*it);
-	            it = m_listTasks.Erase( it );
-				pTaskToDestroy->InstantDestroy();
-	        }
-			else
-			{
-				// Not ready to be destroyed: wait until next turn.
-				++it;
-			}			
-        }
-		// Otherwise, check if it is a candidate to be killed.
-		else if ( in_bKillLowestPriorityTask
+		// Check if it is a candidate to be killed.
+		if ( !(*it)->IsToBeDestroyed()
 				&& ( !pTaskToKill || (*it)->Priority() < pTaskToKill->Priority() )
 				&& (*it)->Priority() < in_priority
 				&& (*it)->ReadyForIO() )
@@ -644,10 +1234,8 @@ void CAkDeviceBase::ForceCleanup(
             // Current iterator refers to a standard stream task that is not scheduled to be destroyed, 
             // and that is pending. Proceed.
             pTaskToKill = (*it);
-			++it;
         }
-        else
-            ++it;
+        ++it;
     }
 
 	// Kill the task if any.
@@ -667,6 +1255,16 @@ void CAkDeviceBase::GetDesc(
     AKVERIFY( m_pLowLevelHook->GetDeviceDesc( out_deviceDesc ) == AK_Success );
 }
 
+void CAkDeviceBase::GetIOModel(
+    AkDeviceIOModel & out_ioModel
+    )
+{
+	AkAutoLock<CAkLock> ioModel( m_lockIOModel );
+	out_ioModel.fLatency	= m_fIOLatency;
+	out_ioModel.fBandwidth	= ( m_fIOCostPerByte > 0 ) ? 1.f / m_fIOCostPerByte : 0;
+	out_ioModel.uNumSamples	= m_uNumIOSamples;
+}
+
 bool CAkDeviceBase::IsNew( )
 {
     return m_bIsNew;
@@ -687,6 +1285,17 @@ AKRESULT CAkDeviceBase::StartMonitoring( )
 void CAkDeviceBase::StopMonitoring( )
 {
     m_bIsMonitoring = false;
+
+	// Tasks that were waiting for the profiler's approbation can now be destroyed: add them to the reclamation list.
+	AkAutoLock<CAkLock> gate( m_lockTasksList );
+	DrainTaskInbox();
+	TaskList::Iterator it = m_listTasks.Begin();
+	while ( it != m_listTasks.End() )
+	{
+		if ( (*it)->ProfileIsToBeDestroyed() )
+			UpdateSchedulingIndex( *it );
+		++it;
+	}
 }
 
 // Stream profiling: GetNumStreams.
@@ -700,6 +1309,7 @@ AkUInt32 CAkDeviceBase::GetNumStreams( )
     m_arStreamProfiles.RemoveAll( );
 
     AkAutoLock<CAkLock> gate( m_lockTasksList );
+	DrainTaskInbox();
 
     TaskList::Iterator it = m_listTasks.Begin();
     while ( it != m_listTasks.End() )
@@ -747,7 +1357,9 @@ AK::IAkStreamProfile * CAkDeviceBase::GetStreamProfile(
 //       the device scheduler.
 //-----------------------------------------------------------------------------
 CAkStmTask::CAkStmTask()
-: m_pDeferredOpenData( NULL )
+: bIOClaimed( false )
+, bDestructionQueued( false )
+, m_pDeferredOpenData( NULL )
 , m_pszStreamName( NULL )
 #ifndef AK_OPTIMIZED
 //Not set m_ulStreamID;
@@ -761,11 +1373,15 @@ CAkStmTask::CAkStmTask()
 , m_bRequiresScheduling( false )
 , m_bIsReadyForIO( false )
 {
+	schedKey.uIndex = AK_SCHED_NOT_INDEXED;
 }
 CAkStmTask::~CAkStmTask()
 {
 	// Cleanup in Low-Level IO.
     AKASSERT( m_pDevice != NULL );
+
+	// Never leave a dangling reference in the scheduler index.
+	m_pDevice->RemoveFromSchedulingIndex( this );
 	if ( m_bIsFileOpen )
 	    AKVERIFY( m_pDevice->GetLowLevelHook()->Close( m_fileDesc ) == AK_Success );
 
@@ -1425,7 +2041,9 @@ void CAkStdStmBase::Kill()
 
 // PopIOBuffer.
 // Does not apply: automatic stream specific.
-void * CAkStdStmBase::PopIOBuffer()
+void * CAkStdStmBase::PopIOBuffer(
+	AkUInt32	/*in_uBufferSize*/
+	)
 {
     AKASSERT( !"Cannot pop buffer from standard stream" );
     return NULL;
@@ -1519,6 +2137,9 @@ void CAkStdStmBase::SetStatus(
 			}
 		}
 	}
+
+	// Notify scheduler index.
+	m_pDevice->UpdateSchedulingIndex( this );
 }
 
 
@@ -1528,10 +2149,25 @@ void CAkStdStmBase::SetStatus(
 //-----------------------------------------------------------------------------
 
 CAkAutoStmBase::CAkAutoStmBase()
-: m_uVirtualBufferingSize( 0 )
+: m_uNextTransferPosition( 0 )
+, m_fMeasuredThroughput( 0 )
+, m_uThroughputSampleSize( 0 )
+, m_uVirtualBufferingSize( 0 )
+, m_uAvailableDataSize( 0 )
+, m_uGrantedDataSize( 0 )
 , m_uNextToGrant( 0 )
+, m_pResidentData( NULL )
+, m_pRing( NULL )
+, m_uRingSlotsUsed( 0 )
+, m_uNumRingSlots( 0 )
+, m_uNextRingSlot( 0 )
+, m_uCachedDataSize( 0 )
+, m_uMaxCachedSize( 0 )
+, m_uNumSeekTargets( 0 )
 , m_bIsRunning( false )
 , m_bIOError( false )
+, m_bIsSamplingThroughput( false )
+, m_bSpeculating( false )
 {
 	m_eStmType = AK_StmTypeAutomatic;
 	m_bIsWriteOp = false;
@@ -1542,6 +2178,19 @@ CAkAutoStmBase::~CAkAutoStmBase( )
 	// If the stream kept asking to be scheduled, now it is time to stop.
     if ( m_bRequiresScheduling )
         m_pDevice->AutoSemDecr();
+
+	// Release resident data before the file is closed (in ~CAkStmTask()).
+	if ( m_pResidentData )
+		m_pDevice->GetResidentDataHook()->ReleaseResidentData( m_fileDesc, m_pResidentData );
+
+	// Release the ring. All transfers have completed: its slots are all free.
+	if ( m_pRing )
+	{
+		AKASSERT( m_uRingSlotsUsed == 0 );
+		AkAutoLock<CAkIOThread> lock( *m_pDevice );
+		m_pDevice->GetIOMemMgr().Free( m_pRing );
+		m_pDevice->NotifyMemChange();
+	}
 }
 
 // Init.
@@ -1578,6 +2227,7 @@ AKRESULT CAkAutoStmBase::Init(
     }
 
 	m_listBuffers.Init();
+	m_listCachedBuffers.Init();
 
 	// Heuristics.
     m_fThroughput   = in_heuristics.fThroughput;
@@ -1602,10 +2252,11 @@ AKRESULT CAkAutoStmBase::Init(
         // Buffer size constraints.
         if ( in_pBufferSettings->uBufferSize != 0 )
         {
-            // User constrained buffer size. Ensure that it is valid with device granularity and low-level IO block size.
-            if ( ( in_pBufferSettings->uBufferSize - in_uGranularity ) % m_uLLBlockSize != 0 )
+            // User constrained buffer size. Ensure that it is valid with low-level IO block size.
+			// Note: Buffers are allocated in various sizes, so it may be smaller or greater than the device granularity.
+            if ( in_pBufferSettings->uBufferSize % m_uLLBlockSize != 0 )
             {
-                AKASSERT( !"Specified buffer size is invalid with device's granularity and low-level block size" );
+                AKASSERT( !"Specified buffer size is invalid with low-level block size" );
                 return AK_InvalidParameter;
             }
             m_uBufferSize = in_pBufferSettings->uBufferSize;
@@ -1636,6 +2287,13 @@ AKRESULT CAkAutoStmBase::Init(
         m_uBufferSize += ( m_uLLBlockSize - ( m_uBufferSize % m_uLLBlockSize ) );
     }
 
+	// Buffer must fit in device's I/O memory.
+	if ( m_uBufferSize > m_pDevice->GetIOMemMgr().GetMaxAllocSize() )
+	{
+		AKASSERT( !"Stream buffer size is greater than device's I/O memory" );
+		return AK_InvalidParameter;
+	}
+
     if ( m_fileDesc.iFileSize == 0 )
 		SetReachedEof( true );
     
@@ -1670,13 +2328,17 @@ void CAkAutoStmBase::Destroy()
 	{
 		AKASSERT( it != m_listBuffers.End() );
 		m_uVirtualBufferingSize += (*it)->uDataSize;
+		m_uAvailableDataSize += (*it)->uDataSize;
+		m_uGrantedDataSize -= (*it)->uDataSize;
 		--m_uNextToGrant;
 		++it;
 	}
 
 	Flush();	// Scheduling status is updated in Flush().
+	FlushCache();
     
 	m_listBuffers.Term();
+	m_listCachedBuffers.Term();
 
 	m_lockStatus.Unlock();
 }
@@ -1721,8 +2383,13 @@ AKRESULT CAkAutoStmBase::SetHeuristics(
         return AK_InvalidParameter;
     }
 
-	// Update heuristics that have no effect on scheduling.
-    m_priority      = in_heuristics.priority;
+	// Update priority. It only affects scheduling through the scheduler index.
+	if ( m_priority != in_heuristics.priority )
+	{
+		AkAutoLock<CAkLock> stmBufferGate( m_lockStatus );
+		m_priority	= in_heuristics.priority;
+		m_pDevice->UpdateSchedulingIndex( this );
+	}
 
 	//
 	// Update heuristics that have an effect on scheduling.
@@ -1798,13 +2465,15 @@ AKRESULT CAkAutoStmBase::SetHeuristics(
 			AkAutoLock<CAkIOThread> lock( *m_pDevice );
 			while ( it != m_listBuffers.End() )
 			{
-				AKASSERT( m_uVirtualBufferingSize >= (*it)->uDataSize );
+				AKASSERT( m_uVirtualBufferingSize >= (*it)->uDataSize 
+						&& m_uAvailableDataSize >= (*it)->uDataSize );
 				m_uVirtualBufferingSize -= (*it)->uDataSize;
+				m_uAvailableDataSize -= (*it)->uDataSize;
 
 				AkStmBuffer * pBufferEntry = (*it);
 				it = m_listBuffers.Erase( it );
 		            
-				AK::MemoryMgr::ReleaseBlock( m_pDevice->GetIOPoolID(), pBufferEntry->pBuffer );
+				FreeIOBuffer( pBufferEntry->pBuffer, pBufferEntry->uDataSize );
 				m_pDevice->ReleaseCachedBufferHolder( pBufferEntry );
 			}
 
@@ -1884,6 +2553,11 @@ AKRESULT CAkAutoStmBase::Start()
 		{
 			// UpdateSchedulingStatus() will notify scheduler if required.
 			AkAutoLock<CAkLock> status( m_lockStatus );
+
+			// Reset time. Time count since last transfer starts now.
+			// Note: Set before updating scheduling status, since the scheduler index keeps track of it.
+			m_iIOStartTime = m_pDevice->GetTime();
+
 			SetRunning( true );
 			UpdateSchedulingStatus();
 		}
@@ -1893,9 +2567,6 @@ AKRESULT CAkAutoStmBase::Start()
 			AkAutoLock<CAkIOThread> lock( *m_pDevice );
 	        m_pDevice->NotifyMemChange();
 		}
-
-        // Reset time. Time count since last transfer starts now.
-        m_iIOStartTime = m_pDevice->GetTime();
     }
     return m_bIOError ? AK_Fail : AK_Success;
 }
@@ -1909,6 +2580,9 @@ AKRESULT CAkAutoStmBase::Stop()
 
     SetRunning( false );
 	Flush();
+
+	// The client does not consume data while stopped.
+	m_bIsSamplingThroughput = false;
     
     return AK_Success;
 }
@@ -2010,6 +2684,55 @@ AKRESULT CAkAutoStmBase::SetPosition(
     return AK_Success;
 }
 
+// Give hints on the positions that the stream is likely to be set to next. Replaces previous hints.
+// Hints go first in the table of seek targets; learned targets keep the remaining entries.
+// Sync: Status lock.
+AKRESULT CAkAutoStmBase::SetSeekTargets(
+    const AkUInt64 * in_puPositions,    // Array of positions (offsets from the beginning of the stream).
+    AkUInt32        in_uNumPositions    // Number of positions in array.
+    )
+{
+	if ( !in_puPositions && in_uNumPositions > 0 )
+	{
+		AKASSERT( !"Invalid seek targets" );
+		return AK_InvalidParameter;
+	}
+
+	AkAutoLock<CAkLock> statusGate( m_lockStatus );
+
+	AkSeekTarget arLearned[AK_MAX_SEEK_TARGETS];
+	AkUInt32 uNumLearned = 0;
+	for ( AkUInt32 uTarget = 0; uTarget < m_uNumSeekTargets; ++uTarget )
+	{
+		if ( !m_arSeekTargets[uTarget].bHint )
+			arLearned[uNumLearned++] = m_arSeekTargets[uTarget];
+	}
+
+	m_uNumSeekTargets = 0;
+	AkUInt32 uNumHints = AkMin( in_uNumPositions, AK_MAX_SEEK_TARGETS );
+	for ( AkUInt32 uHint = 0; uHint < uNumHints; ++uHint )
+	{
+		// Round down to block size.
+		AkSeekTarget & target = m_arSeekTargets[m_uNumSeekTargets++];
+		target.uPosition = in_puPositions[uHint] - ( in_puPositions[uHint] % m_uLLBlockSize ) + GetFileOffset();
+		target.uScore = AK_SEEK_TARGET_MAX_SCORE;
+		target.bHint = true;
+	}
+
+	for ( AkUInt32 uTarget = 0; uTarget < uNumLearned && m_uNumSeekTargets < AK_MAX_SEEK_TARGETS; ++uTarget )
+	{
+		// Skip learned targets that are now hinted.
+		AkUInt32 uHint = 0;
+		while ( uHint < uNumHints 
+				&& m_arSeekTargets[uHint].uPosition != arLearned[uTarget].uPosition )
+			++uHint;
+		if ( uHint == uNumHints )
+			m_arSeekTargets[m_uNumSeekTargets++] = arLearned[uTarget];
+	}
+
+	return AK_Success;
+}
+
 // Data/status access. 
 // -----------------------------------------
 
@@ -2054,7 +2777,7 @@ AKRESULT CAkAutoStmBase::GetBuffer(
 
 		while ( !out_pBuffer 
 				&& !m_bIOError
-				&& !NeedsNoMoreTransfer( 0 ) )	// Pass 0 "Actual buffering size": We know we don't have any.
+				&& !NeedsNoMoreTransfer() )
 		{
 			// Wait for I/O to complete if there is no error.
 			// Set as "blocked, waiting for I/O".
@@ -2115,16 +2838,33 @@ AKRESULT CAkAutoStmBase::ReleaseBuffer()
     {
 		AkStmBuffer * pFirst = m_listBuffers.First();
 		AKASSERT( pFirst );
+
+		if ( m_pResidentData )
+		{
+			// Resident data is not owned by the stream: only free the holder. Scheduling status is unchanged.
+			AKVERIFY( m_listBuffers.RemoveFirst() == AK_Success );
+			m_uGrantedDataSize -= pFirst->uDataSize;
+			AkFree( CAkStreamMgr::GetObjPoolID(), pFirst );
+			m_uNextToGrant--;
+			return AK_Success;
+		}
       
 		// Note: I/O pool access must be enclosed in scheduler lock.
 		{
 			AkAutoLock<CAkIOThread> lock( *m_pDevice );
-			AK::MemoryMgr::ReleaseBlock( m_pDevice->GetIOPoolID(), pFirst->pBuffer );
-			// Memory was released. Signal it.
-			m_pDevice->NotifyMemChange();
-
 			AKVERIFY( m_listBuffers.RemoveFirst() == AK_Success );
-			m_pDevice->ReleaseCachedBufferHolder( pFirst );
+			AKASSERT( m_uGrantedDataSize >= pFirst->uDataSize );
+			m_uGrantedDataSize -= pFirst->uDataSize;
+
+			// Keep data of the beginning of the file or of the loop region in the segment cache.
+			if ( !IsInCachedRange( pFirst->uPosition ) 
+				|| !KeepInCache( pFirst ) )
+			{
+				FreeIOBuffer( pFirst->pBuffer, pFirst->uDataSize );
+				// Memory was released. Signal it.
+				m_pDevice->NotifyMemChange();
+				m_pDevice->ReleaseCachedBufferHolder( pFirst );
+			}
 		}
         
         // Update "next to grant" index.
@@ -2139,6 +2879,53 @@ AKRESULT CAkAutoStmBase::ReleaseBuffer()
 	return AK_Fail;
 }
 
+// Storage settings.
+// -----------------------------------------
+
+// Sets the size of the ring buffer. Ring-buffer storage mode: number of slots, within the device's largest block. 
+// The ring is reserved when the stream first needs a buffer (see TryGetIOBuffer()). A ring of less than 2 slots is useless.
+// Sync: Status lock.
+AKRESULT CAkAutoStmBase::SetRingBufferSize(
+	AkUInt32		in_uRingBufferSize	// Ring size, in bytes. 0 disables the ring.
+	)
+{
+	AkAutoLock<CAkLock> statusGate( m_lockStatus );
+
+	// Buffers cannot be moved to or from the ring once the stream has started.
+	if ( m_bIsRunning 
+		|| m_pRing 
+		|| !m_listBuffers.IsEmpty() )
+		return AK_Fail;
+
+	AkUInt32 uNumSlots = ( in_uRingBufferSize + m_uBufferSize - 1 ) / m_uBufferSize;
+	uNumSlots = AkMin( uNumSlots, m_pDevice->GetIOMemMgr().GetMaxAllocSize() / m_uBufferSize );
+	uNumSlots = AkMin( uNumSlots, AK_MAX_RING_SLOTS );
+	m_uNumRingSlots = ( uNumSlots >= 2 ) ? (AkUInt8)uNumSlots : 0;
+
+	return AK_Success;
+}
+
+// Sets the maximum size of the segment cache. Evicts the oldest cached buffers that do not fit anymore.
+// Sync: Status lock, then device lock (cache).
+AKRESULT CAkAutoStmBase::SetSegmentCacheSize(
+	AkUInt32		in_uSegmentCacheSize	// Maximum size of cached data, in bytes. 0 disables the cache.
+	)
+{
+	AkAutoLock<CAkLock> statusGate( m_lockStatus );
+	AkAutoLock<CAkIOThread> lock( *m_pDevice );
+
+	m_uMaxCachedSize = in_uSegmentCacheSize;
+
+	if ( m_uCachedDataSize > m_uMaxCachedSize )
+	{
+		while ( m_uCachedDataSize > m_uMaxCachedSize )
+			m_pDevice->GetIOMemMgr().Free( PopCachedBuffer() );
+		m_pDevice->NotifyMemChange();
+	}
+
+	return AK_Success;
+}
+
 // Get the amount of buffering that the stream has. 
 // Returns
 // - AK_DataReady: Some data has been buffered (out_uNumBytesAvailable is greater than 0).
@@ -2150,41 +2937,38 @@ AKRESULT CAkAutoStmBase::QueryBufferingStatus( AkUInt32 & out_uNumBytesAvailable
 	if ( AK_EXPECT_FALSE( m_bIOError ) )
 		return AK_Fail;
 
+	// Streamed files that still require scheduling cannot have reached the end of stream: the status
+	// only depends on the running count of available data, which is read without locking. The answer
+	// may be outdated as soon as it is returned anyway.
+	if ( !m_pResidentData 
+		&& RequiresScheduling() 
+		&& !m_pDevice->CannotScheduleAutoStreams() )
+	{
+		out_uNumBytesAvailable = m_uAvailableDataSize;
+		return ( out_uNumBytesAvailable > 0 ) ? AK_DataReady : AK_NoDataReady;
+	}
+
 	// Lock status to query buffering.
 	AkAutoLock<CAkLock> stmBufferGate( m_lockStatus );
 
-	AKRESULT eRetCode;
-	out_uNumBytesAvailable = 0;
-
-	AKASSERT( m_listBuffers.Length() >= m_uNextToGrant );
-	if ( m_uNextToGrant < m_listBuffers.Length() )
-	{
-		eRetCode = AK_DataReady;
-
-		// Compute the amount of data that is available.
-		AkUInt32 uIdx = 0;
-		AkBufferList::Iterator it = m_listBuffers.Begin();
-		while ( uIdx < m_uNextToGrant )
-	    {
-			++uIdx;
-			++it;
-		}
-		while ( it != m_listBuffers.End() )
-		{
-			out_uNumBytesAvailable += (*it)->uDataSize;
-			++it;
-		}
-	}
-	else
+	// Resident streams: all the data up to the end of file is available.
+	if ( m_pResidentData )
 	{
-		// No data is available.
-		eRetCode = AK_NoDataReady;
+		out_uNumBytesAvailable = 0;
+		if ( m_uNextExpectedUserPosition >= GetFileEndPosition() )
+			return AK_NoMoreData;
+		AkUInt64 uAvailable = GetFileEndPosition() - m_uNextExpectedUserPosition;
+		out_uNumBytesAvailable = ( uAvailable < AK_UINT_MAX ) ? (AkUInt32)uAvailable : AK_UINT_MAX;
+		return AK_DataReady;
 	}
 
+	out_uNumBytesAvailable = m_uAvailableDataSize;
+	AKRESULT eRetCode = ( out_uNumBytesAvailable > 0 ) ? AK_DataReady : AK_NoDataReady;
+
 	// Deal with end of stream: return AK_NoMoreData if we are not going to stream in any more data,
 	// or if the device currently cannot stream in anymore data. Clients must be aware that the device
 	// is idle to avoid hangs.
-	if ( NeedsNoMoreTransfer( out_uNumBytesAvailable ) 
+	if ( NeedsNoMoreTransfer() 
 		|| m_pDevice->CannotScheduleAutoStreams() )
 		eRetCode = AK_NoMoreData;
 
@@ -2194,7 +2978,7 @@ AKRESULT CAkAutoStmBase::QueryBufferingStatus( AkUInt32 & out_uNumBytesAvailable
 // Returns the target buffering size based on the throughput heuristic.
 AkUInt32 CAkAutoStmBase::GetNominalBuffering()
 {
-	return (AkUInt32)( m_pDevice->GetTargetAutoStmBufferLength() * m_fThroughput );
+	return (AkUInt32)( m_pDevice->GetTargetAutoStmBufferLength() * SchedulingThroughput() );
 }
 
 
@@ -2217,6 +3001,16 @@ void CAkAutoStmBase::OnSetFileSize()
 	}
 }
 
+// This is called when the file was opened synchronously, before the stream is handed to its client.
+// If the Low-Level IO exposes the file's data in memory, buffers will be granted directly from it.
+void CAkAutoStmBase::OnSyncFileOpen()
+{
+	AKASSERT( m_bIsFileOpen && !m_bIsRunning && m_listBuffers.IsEmpty() );
+	IAkIOHookResidentData * pResidentDataHook = m_pDevice->GetResidentDataHook();
+	if ( pResidentDataHook )
+		m_pResidentData = (const AkUInt8*)pResidentDataHook->AddRefResidentData( m_fileDesc );
+}
+
 // Data buffer access.
 // Allocate a buffer from the Memory Mgr.
 // Sync: None. 
@@ -2224,9 +3018,64 @@ void CAkAutoStmBase::OnSetFileSize()
 // with CAkDeviceBase::NotifyMemIdle(). Then they both need to be enclosed in CAkDeviceBase::LockMem().
 void * CAkAutoStmBase::TryGetIOBuffer()
 {
-    // Allocate a buffer.
     AKASSERT( m_uBufferSize > 0 );
-	return AK::MemoryMgr::GetBlock( m_pDevice->GetIOPoolID() );
+
+	// Ring-buffer storage mode: use the next slot of the ring if it is free.
+	if ( m_uNumRingSlots > 0 )
+	{
+		if ( !m_pRing )
+		{
+			// Reserve the ring. Take advantage of the whole block (block sizes are rounded by the memory manager).
+			m_pRing = (AkUInt8*)m_pDevice->GetIOMemMgr().Alloc( m_uNumRingSlots * m_uBufferSize );
+			if ( m_pRing )
+				m_uNumRingSlots = (AkUInt8)AkMin( m_pDevice->GetIOMemMgr().GetBlockSize( m_pRing ) / m_uBufferSize, AK_MAX_RING_SLOTS );
+		}
+
+		if ( m_pRing 
+			&& !( m_uRingSlotsUsed & ( 1U << m_uNextRingSlot ) ) )
+		{
+			void * pBuffer = m_pRing + m_uNextRingSlot * m_uBufferSize;
+			m_uRingSlotsUsed |= ( 1U << m_uNextRingSlot );
+			m_uNextRingSlot = ( m_uNextRingSlot + 1 ) % m_uNumRingSlots;
+			return pBuffer;
+		}
+	}
+
+    // Allocate a buffer. If there is no memory left, use that of the segment cache.
+	void * pBuffer = m_pDevice->GetIOMemMgr().Alloc( m_uBufferSize );
+	while ( !pBuffer 
+			&& !m_listCachedBuffers.IsEmpty() )
+	{
+		m_pDevice->GetIOMemMgr().Free( PopCachedBuffer() );
+		pBuffer = m_pDevice->GetIOMemMgr().Alloc( m_uBufferSize );
+	}
+	return pBuffer;
+}
+
+// Frees an I/O buffer of this stream: releases its slots if it lies in the ring, frees it from
+// the device's I/O memory otherwise.
+// Sync: Device must be locked.
+void CAkAutoStmBase::FreeIOBuffer(
+	void *		in_pBuffer,				// Buffer.
+	AkUInt32	in_uDataSize			// Size of data held in buffer.
+	)
+{
+	if ( !IsInRing( in_pBuffer ) )
+	{
+		m_pDevice->GetIOMemMgr().Free( in_pBuffer );
+		return;
+	}
+
+	// Buffers of the ring start on a slot, and may span several slots if transfers were appended to them.
+	AkUInt32 uSlot = (AkUInt32)( (AkUInt8*)in_pBuffer - m_pRing ) / m_uBufferSize;
+	AkUInt32 uNumSlots = ( in_uDataSize > m_uBufferSize ) ? ( in_uDataSize + m_uBufferSize - 1 ) / m_uBufferSize : 1;
+	AKASSERT( uSlot + uNumSlots <= m_uNumRingSlots );
+	while ( uNumSlots-- > 0 )
+	{
+		AKASSERT( m_uRingSlotsUsed & ( 1U << uSlot ) );
+		m_uRingSlotsUsed &= ~( 1U << uSlot );
+		++uSlot;
+	}
 }
 
 
@@ -2250,25 +3099,40 @@ AkUInt32 CAkAutoStmBase::UpdatePosition(
     {
 		AKASSERT( in_uActualIOSize > 0 );
 
-        // Add buffer to list.
-		AkStmBuffer * pNewBuffer;
-		{
-			AkAutoLock<CAkIOThread> lock( *m_pDevice );
-	        pNewBuffer = m_pDevice->GetCachedBufferHolder();
-		}
-
-		pNewBuffer->uPosition = in_uPosition;
-		pNewBuffer->pBuffer = in_pBuffer;
-        
 		// Truncate data size if the stream is going to pass the end of file.
 		if ( ( in_uPosition + in_uActualIOSize ) > (AkUInt64)( m_fileDesc.iFileSize + m_fileDesc.uSector*m_uLLBlockSize ) )
 			uPositionOffset = (AkUInt32)( m_fileDesc.iFileSize + m_fileDesc.uSector*m_uLLBlockSize - in_uPosition );
 		else
 			uPositionOffset = in_uActualIOSize;
 
-		pNewBuffer->uDataSize = uPositionOffset;
+		// Ring-buffer storage mode: append data to the last buffer if it is not granted, and if the transfer
+		// follows it both in the ring and in the file. The last buffer must fill its slots.
+		AkStmBuffer * pLast = ( m_listBuffers.Length() > m_uNextToGrant ) ? m_listBuffers.Last() : NULL;
+		if ( pLast
+			&& IsInRing( in_pBuffer )
+			&& IsInRing( pLast->pBuffer )
+			&& (AkUInt8*)pLast->pBuffer + pLast->uDataSize == in_pBuffer
+			&& pLast->uPosition + pLast->uDataSize == in_uPosition
+			&& ( pLast->uDataSize % m_uBufferSize ) == 0 )
+		{
+			pLast->uDataSize += uPositionOffset;
+		}
+		else
+		{
+	        // Add buffer to list.
+			AkStmBuffer * pNewBuffer;
+			{
+				AkAutoLock<CAkIOThread> lock( *m_pDevice );
+		        pNewBuffer = m_pDevice->GetCachedBufferHolder();
+			}
+
+			pNewBuffer->uPosition = in_uPosition;
+			pNewBuffer->pBuffer = in_pBuffer;
+			pNewBuffer->uDataSize = uPositionOffset;
 
-		m_listBuffers.AddLast( pNewBuffer );
+			m_listBuffers.AddLast( pNewBuffer );
+		}
+		m_uAvailableDataSize += uPositionOffset;
     }
     else
     {
@@ -2276,7 +3140,7 @@ AkUInt32 CAkAutoStmBase::UpdatePosition(
         // its position was set dirty while I/O was occuring. Flush that data.
         // Note: I/O pool access must be enclosed in scheduler lock.
         AkAutoLock<CAkIOThread> lock( *m_pDevice );
-        AK::MemoryMgr::ReleaseBlock( m_pDevice->GetIOPoolID(), in_pBuffer );
+        FreeIOBuffer( in_pBuffer, in_uActualIOSize );
         m_pDevice->NotifyMemChange();
     }
     
@@ -2325,7 +3189,7 @@ void CAkAutoStmBase::Kill()
 AkReal32 CAkAutoStmBase::EffectiveDeadline()
 {
     // Copy throughput value on the stack, because it can be modified (to zero) by user.
-    AkReal32 fThroughput = m_fThroughput;
+    AkReal32 fThroughput = SchedulingThroughput();
     if ( fThroughput == 0 )
         return AK_INFINITE_DEADLINE;
     else
@@ -2362,10 +3226,10 @@ void CAkAutoStmBase::GetStreamData(
     out_streamData.uPriority = m_priority;
 	out_streamData.uFilePosition = m_uNextExpectedUserPosition - GetFileOffset();
     
-    AkUInt32 uBufferSize = static_cast<AkUInt32>( m_pDevice->GetTargetAutoStmBufferLength() * m_fThroughput );
+    AkUInt32 uBufferSize = static_cast<AkUInt32>( m_pDevice->GetTargetAutoStmBufferLength() * SchedulingThroughput() );
 	// Buffering size is the max between target buffering and double buffering.
 	// Important: Keep in sync with computation in NeedsBuffering().
-	out_streamData.uBufferSize = AkMax( uBufferSize, m_pDevice->GetGranularity() );
+	out_streamData.uBufferSize = AkMax( uBufferSize, m_uBufferSize );
 	
 	out_streamData.uAvailableData = m_uVirtualBufferingSize;
 
@@ -2397,6 +3261,8 @@ void CAkAutoStmBase::ForceFilePosition(
     // Lock status.
     AkAutoLock<CAkLock> statusGate( m_lockStatus );
 
+	AkUInt64 uPrevExpectedUserPosition = m_uNextExpectedUserPosition;
+
 	// Update position.
 	m_uNextExpectedUserPosition = in_uNewPosition;
 
@@ -2407,10 +3273,16 @@ void CAkAutoStmBase::ForceFilePosition(
 	{
 		if ( GetNextBufferToGrant()->uPosition != in_uNewPosition )
     	{
+			RecordSeek( in_uNewPosition );
+
 			// Flush everything we have, that was not already granted to user.
-			// Note: Flush() also flushes pending transfers.
+			// Note: Flush() also flushes pending transfers, and keeps flushed data in the segment cache.
 			Flush();
 			AKASSERT( m_listBuffers.Length() == m_uNextToGrant );
+
+			// Serve the new position from the segment cache if possible.
+			if ( RestoreCachedBuffers( in_uNewPosition ) )
+				UpdateSchedulingStatus();
     	}
 		else
 			UpdateSchedulingStatus();
@@ -2419,7 +3291,10 @@ void CAkAutoStmBase::ForceFilePosition(
 	{
 		// Nothing buffered. Yet, there might be pending transfers that are inconsistent with in_uNewPosition.
 		// Cancel all pending transfers if applicable.
+		if ( in_uNewPosition != uPrevExpectedUserPosition )
+			RecordSeek( in_uNewPosition );
 		CancelPendingTransfers( 0 );
+		RestoreCachedBuffers( in_uNewPosition );
 		UpdateSchedulingStatus();
 	}
 }
@@ -2430,9 +3305,15 @@ void CAkAutoStmBase::UpdateSchedulingStatus()
 {
 	CHECK_BUFFERING_CONSISTENCY();
 
+	// Position of next transfer. Transfers restart at the beginning of the loop region past its end.
+	m_uNextTransferPosition = GetVirtualFilePosition();
+	if ( m_uLoopEnd 
+		&& m_uNextTransferPosition >= m_uLoopEnd + GetFileOffset() )
+		m_uNextTransferPosition = m_uLoopStart + GetFileOffset();
+
 	// Set EOF flag.
 	if ( !m_uLoopEnd 
-		&& ( GetVirtualFilePosition() >= GetFileEndPosition() )
+		&& ( m_uNextTransferPosition >= GetFileEndPosition() )
 		&& m_bIsFileOpen )
     {
         SetReachedEof( true );
@@ -2458,6 +3339,9 @@ void CAkAutoStmBase::UpdateSchedulingStatus()
             m_pDevice->AutoSemDecr();
         }
     }
+
+	// Notify scheduler index (deadline, readiness or signaled status may have changed).
+	m_pDevice->UpdateSchedulingIndex( this );
 }
 
 // Compares in_uVirtualBufferingSize to target buffer size.
@@ -2466,11 +3350,11 @@ bool CAkAutoStmBase::NeedsBuffering(
 	AkUInt32 in_uVirtualBufferingSize
 	)
 {
-	// Needs buffering if below target buffer length, or if below granularity
+	// Needs buffering if below target buffer length, or if below buffer size
 	// (we need to ensure that the device reads a buffer, apart from what has
 	// already been granted to the client).
-	return ( in_uVirtualBufferingSize < m_pDevice->GetGranularity()
-			|| in_uVirtualBufferingSize < m_pDevice->GetTargetAutoStmBufferLength() * m_fThroughput );
+	return ( in_uVirtualBufferingSize < m_uBufferSize
+			|| in_uVirtualBufferingSize < m_pDevice->GetTargetAutoStmBufferLength() * SchedulingThroughput() );
 }
 
 // Returns a buffer filled with data. NULL if no data is ready.
@@ -2479,6 +3363,9 @@ void * CAkAutoStmBase::GetReadBuffer(
     AkUInt32 & out_uSize                // Buffer size.
     )
 {
+	if ( m_pResidentData )
+		return GetResidentBuffer( out_uSize );
+
     if ( m_uNextToGrant < m_listBuffers.Length() )
     {
 		// Get first buffer not granted.
@@ -2504,6 +3391,11 @@ void * CAkAutoStmBase::GetReadBuffer(
 
 		// Update amount of buffered data (data granted to user does not count as buffered data).
 		m_uVirtualBufferingSize -= pStmBuffer->uDataSize;
+		m_uAvailableDataSize -= pStmBuffer->uDataSize;
+		m_uGrantedDataSize += pStmBuffer->uDataSize;
+
+		// Note: Measure before updating scheduling status, since the scheduler index depends on throughput.
+		MeasureThroughput( pStmBuffer->uDataSize );
 
 		UpdateSchedulingStatus();
 
@@ -2511,12 +3403,105 @@ void * CAkAutoStmBase::GetReadBuffer(
         return pStmBuffer->pBuffer;
     }
     
-    // No data ready.
+    // No data ready. The client is starving: its demand cannot be measured until it is fed again.
+	m_bIsSamplingThroughput = false;
     out_uSize = 0;
     return NULL;
 }
 
-// Flushes all stream buffers that are not currently granted.
+// Measures the consumption rate of the client with the data granted to it.
+// Data granted at the beginning of a sample is consumed by the time the next buffer is requested: a sample
+// counts all data granted since it started, except the buffer that is being granted, which starts the next one.
+// Samples last at least AK_THROUGHPUT_SAMPLE_PERIOD ms, and are smoothed with an exponential moving average.
+// Sync: Status must be locked prior to calling this function.
+void CAkAutoStmBase::MeasureThroughput(
+	AkUInt32	in_uGrantedSize			// Size of the buffer that is being granted.
+	)
+{
+	AkInt64 iNow;
+	AKPLATFORM::PerformanceCounter( &iNow );
+
+	if ( m_bIsSamplingThroughput )
+	{
+		AkReal32 fElapsed = AKPLATFORM::Elapsed( iNow, m_iThroughputSampleStart );
+		if ( fElapsed < AK_THROUGHPUT_SAMPLE_PERIOD )
+		{
+			m_uThroughputSampleSize += in_uGrantedSize;
+			return;
+		}
+
+		AkReal32 fSample = m_uThroughputSampleSize / fElapsed;
+		if ( m_fMeasuredThroughput == 0 )
+			m_fMeasuredThroughput = fSample;
+		else
+			m_fMeasuredThroughput += AK_THROUGHPUT_SMOOTHING * ( fSample - m_fMeasuredThroughput );
+	}
+
+	// Start next sample.
+	m_iThroughputSampleStart = iNow;
+	m_uThroughputSampleSize = in_uGrantedSize;
+	m_bIsSamplingThroughput = true;
+}
+
+// Resident mode: returns a buffer pointing into resident data at the current position. NULL at end of file,
+// or if the buffer holder cannot be allocated.
+// Sync: Accessing list. Must be locked from outside.
+void * CAkAutoStmBase::GetResidentBuffer(     
+    AkUInt32 & out_uSize                // Buffer size.
+    )
+{
+	out_uSize = 0;
+
+	AKASSERT( m_listBuffers.Length() == m_uNextToGrant );
+
+	// Looping streams: data is granted up to the end of the loop region, then from its beginning, as transfers 
+	// would (see UpdateSchedulingStatus()). The loop region may have changed since the last grant.
+	AkUInt64 uEndPosition = GetFileEndPosition();
+	if ( m_uLoopEnd )
+	{
+		AkUInt64 uLoopEndPosition = m_uLoopEnd + GetFileOffset();
+		if ( m_uNextExpectedUserPosition >= uLoopEndPosition )
+			m_uNextExpectedUserPosition = m_uLoopStart + GetFileOffset();
+		if ( uLoopEndPosition < uEndPosition )
+			uEndPosition = uLoopEndPosition;
+	}
+
+	if ( m_uNextExpectedUserPosition >= uEndPosition
+		|| m_uNextToGrant == 255 )	// m_uNextToGrant is 8-bit.
+		return NULL;
+
+	AkStmBuffer * pStmBuffer = (AkStmBuffer*)AkAlloc( CAkStreamMgr::GetObjPoolID(), sizeof( AkStmBuffer ) );
+	if ( !pStmBuffer )
+		return NULL;
+
+	// Grant at most a stream buffer worth of data, as a transfer would.
+	AkUInt64 uRemaining = uEndPosition - m_uNextExpectedUserPosition;
+	pStmBuffer->uPosition = m_uNextExpectedUserPosition;
+	pStmBuffer->pBuffer = (void*)( m_pResidentData + m_uNextExpectedUserPosition );
+	pStmBuffer->uDataSize = ( uRemaining < m_uBufferSize ) ? (AkUInt32)uRemaining : m_uBufferSize;
+	m_listBuffers.AddLast( pStmBuffer );
+	m_uNextToGrant++;
+	m_uGrantedDataSize += pStmBuffer->uDataSize;
+
+	m_uNextExpectedUserPosition += pStmBuffer->uDataSize;
+	if ( m_uLoopEnd 
+		&& m_uNextExpectedUserPosition >= m_uLoopEnd + GetFileOffset() )
+		m_uNextExpectedUserPosition = m_uLoopStart + GetFileOffset();
+	
+	// Set EOF flag (there are no transfers nor buffering: the virtual file position is the user position).
+	if ( m_uNextExpectedUserPosition >= GetFileEndPosition() && !m_uLoopEnd )
+		SetReachedEof( true );
+
+#ifndef AK_OPTIMIZED
+	m_uBytesTransfered += pStmBuffer->uDataSize;
+#endif
+
+	out_uSize = pStmBuffer->uDataSize;
+	return pStmBuffer->pBuffer;
+}
+
+// Flushes all stream buffers that are not currently granted. Unless the stream is being destroyed, data is kept
+// in the segment cache from the beginning of the flushed range, up to the size of the cache.
 // Sync: None. Always called from within status-protected code.
 void CAkAutoStmBase::Flush()
 {
@@ -2536,16 +3521,32 @@ void CAkAutoStmBase::Flush()
         
 		// Lock scheduler for memory change.
 		AkAutoLock<CAkIOThread> lock( *m_pDevice );
+		AkUInt32 uSizeToCache = ( !m_bIsToBeDestroyed ) ? m_uMaxCachedSize : 0;
         while ( it != m_listBuffers.End() )
         {
 			AkStmBuffer * pBufferFlush = *it;
-            AKASSERT( m_uVirtualBufferingSize >= pBufferFlush->uDataSize );
+            AKASSERT( m_uVirtualBufferingSize >= pBufferFlush->uDataSize 
+					&& m_uAvailableDataSize >= pBufferFlush->uDataSize );
             m_uVirtualBufferingSize -= pBufferFlush->uDataSize;
+            m_uAvailableDataSize -= pBufferFlush->uDataSize;
 
             it = m_listBuffers.Erase( it );
 
-			AK::MemoryMgr::ReleaseBlock( m_pDevice->GetIOPoolID(), pBufferFlush->pBuffer );
-			m_pDevice->ReleaseCachedBufferHolder( pBufferFlush );
+			// Buffers of resident streams point into resident data and have their own holders.
+			if ( m_pResidentData )
+				AkFree( CAkStreamMgr::GetObjPoolID(), pBufferFlush );
+			else if ( pBufferFlush->uDataSize <= uSizeToCache 
+					&& KeepInCache( pBufferFlush ) )
+			{
+				// Note: Cache what this flush fits in the cache, so that it does not evict its own buffers.
+				uSizeToCache -= pBufferFlush->uDataSize;
+			}
+			else
+			{
+				uSizeToCache = 0;
+				FreeIOBuffer( pBufferFlush->pBuffer, pBufferFlush->uDataSize );
+				m_pDevice->ReleaseCachedBufferHolder( pBufferFlush );
+			}
         }
         m_pDevice->NotifyMemChange();
     }
@@ -2553,6 +3554,267 @@ void CAkAutoStmBase::Flush()
 	UpdateSchedulingStatus();
 }
 
+// Segment cache management.
+// Keeps a buffer removed from m_listBuffers in the cache, evicting the oldest cached buffers to make room.
+// Returns false if it cannot be cached: caller must free it.
+// Sync: Device must be locked.
+bool CAkAutoStmBase::KeepInCache(
+	AkStmBuffer *	in_pBuffer			// Buffer (with its holder).
+	)
+{
+	// Slots of the ring are used in turn: they cannot be held in the cache.
+	if ( in_pBuffer->uDataSize > m_uMaxCachedSize 
+		|| IsInRing( in_pBuffer->pBuffer ) )
+		return false;
+
+	// Evict data that was cached for this position before.
+	AkBufferList::IteratorEx it = m_listCachedBuffers.BeginEx();
+	while ( it != m_listCachedBuffers.End() )
+	{
+		if ( (*it)->uPosition == in_pBuffer->uPosition )
+		{
+			AkStmBuffer * pCached = *it;
+			it = m_listCachedBuffers.Erase( it );
+			m_uCachedDataSize -= pCached->uDataSize;
+			m_pDevice->OnCachedSizeChange( -(AkInt32)pCached->uDataSize );
+			m_pDevice->GetIOMemMgr().Free( pCached->pBuffer );
+			m_pDevice->ReleaseCachedBufferHolder( pCached );
+			m_pDevice->NotifyMemChange();
+		}
+		else
+			++it;
+	}
+
+	while ( m_uCachedDataSize + in_pBuffer->uDataSize > m_uMaxCachedSize )
+	{
+		m_pDevice->GetIOMemMgr().Free( PopCachedBuffer() );
+		m_pDevice->NotifyMemChange();
+	}
+
+	m_listCachedBuffers.AddLast( in_pBuffer );
+	m_uCachedDataSize += in_pBuffer->uDataSize;
+	m_pDevice->OnCachedSizeChange( in_pBuffer->uDataSize );
+	return true;
+}
+
+// Moves cached buffers that hold data contiguously from in_uPosition to m_listBuffers, without going past
+// the loop end. Nothing must be buffered. Returns true if some data was restored.
+// Sync: Status must be locked.
+bool CAkAutoStmBase::RestoreCachedBuffers(
+	AkUInt64		in_uPosition		// Absolute file position.
+	)
+{
+	AKASSERT( m_listBuffers.Length() == m_uNextToGrant );
+
+	AkAutoLock<CAkIOThread> lock( *m_pDevice );
+
+	bool bRestored = false;
+	AkBufferList::IteratorEx it = m_listCachedBuffers.BeginEx();
+	while ( it != m_listCachedBuffers.End() 
+			&& ( !m_uLoopEnd || in_uPosition < GetFileOffset() + m_uLoopEnd ) )
+	{
+		if ( (*it)->uPosition == in_uPosition )
+		{
+			AkStmBuffer * pCached = *it;
+			m_listCachedBuffers.Erase( it );
+			m_uCachedDataSize -= pCached->uDataSize;
+			m_pDevice->OnCachedSizeChange( -(AkInt32)pCached->uDataSize );
+
+			m_listBuffers.AddLast( pCached );
+			m_uVirtualBufferingSize += pCached->uDataSize;
+			m_uAvailableDataSize += pCached->uDataSize;
+			bRestored = true;
+
+			// Look for the data that follows.
+			in_uPosition += pCached->uDataSize;
+			it = m_listCachedBuffers.BeginEx();
+		}
+		else
+			++it;
+	}
+	return bRestored;
+}
+
+// Removes the oldest cached buffer and returns its memory, NULL if the cache is empty.
+// Sync: Device must be locked.
+void * CAkAutoStmBase::PopCachedBuffer()
+{
+	AkStmBuffer * pCached = m_listCachedBuffers.First();
+	if ( !pCached )
+		return NULL;
+
+	AKVERIFY( m_listCachedBuffers.RemoveFirst() == AK_Success );
+	m_uCachedDataSize -= pCached->uDataSize;
+	m_pDevice->OnCachedSizeChange( -(AkInt32)pCached->uDataSize );
+	void * pBuffer = pCached->pBuffer;
+	m_pDevice->ReleaseCachedBufferHolder( pCached );
+	return pBuffer;
+}
+
+// Frees all cached buffers. Returns false if the cache was empty.
+// Sync: Device lock is acquired.
+bool CAkAutoStmBase::FlushCache()
+{
+	AkAutoLock<CAkIOThread> lock( *m_pDevice );
+	if ( m_listCachedBuffers.IsEmpty() )
+		return false;
+
+	while ( !m_listCachedBuffers.IsEmpty() )
+		m_pDevice->GetIOMemMgr().Free( PopCachedBuffer() );
+	m_pDevice->NotifyMemChange();
+	AKASSERT( m_uCachedDataSize == 0 );
+	return true;
+}
+
+// Speculative prefetch.
+// Learns a seek target: the stream was set to this position while it expected another one.
+// New targets start just below AK_SEEK_TARGET_MIN_SCORE, so that a single seek is never prefetched. 
+// A target gains 2 points when the stream seeks there again, and all other learned targets lose 1, so 
+// that targets that the stream keeps seeking to (even alternately) reach AK_SEEK_TARGET_MIN_SCORE, while
+// one-off seeks are forgotten. Hints are neither aged nor evicted.
+// Sync: Status must be locked.
+void CAkAutoStmBase::RecordSeek(
+	AkUInt64		in_uPosition		// Absolute file position.
+	)
+{
+	bool bFound = false;
+	AkUInt32 uTarget = 0;
+	while ( uTarget < m_uNumSeekTargets )
+	{
+		AkSeekTarget & target = m_arSeekTargets[uTarget];
+		if ( target.uPosition == in_uPosition )
+		{
+			if ( !target.bHint )
+				target.uScore = (AkUInt8)AkMin( target.uScore + 2, AK_SEEK_TARGET_MAX_SCORE );
+			bFound = true;
+			++uTarget;
+		}
+		else if ( !target.bHint 
+				&& --target.uScore == 0 )
+		{
+			// Forget it.
+			m_arSeekTargets[uTarget] = m_arSeekTargets[--m_uNumSeekTargets];
+		}
+		else
+			++uTarget;
+	}
+
+	if ( bFound )
+		return;
+
+	// New target. If the table is full, replace the learned target with the lowest score.
+	AkSeekTarget * pNewTarget = NULL;
+	if ( m_uNumSeekTargets < AK_MAX_SEEK_TARGETS )
+		pNewTarget = &m_arSeekTargets[m_uNumSeekTargets++];
+	else
+	{
+		for ( uTarget = 0; uTarget < m_uNumSeekTargets; ++uTarget )
+		{
+			if ( !m_arSeekTargets[uTarget].bHint
+				&& ( !pNewTarget || m_arSeekTargets[uTarget].uScore < pNewTarget->uScore ) )
+				pNewTarget = &m_arSeekTargets[uTarget];
+		}
+	}
+
+	if ( pNewTarget )
+	{
+		pNewTarget->uPosition = in_uPosition;
+		pNewTarget->uScore = AK_SEEK_TARGET_MIN_SCORE - 1;
+		pNewTarget->bHint = false;
+	}
+}
+
+// Returns true if the next transfer should prefetch a window at a likely seek target into the segment cache.
+// Prefetched data is bounded by the size of the segment cache: it never evicts cached data. Targets whose data 
+// is already buffered or cached, or that are about to be streamed, are skipped.
+// Sync: Status must be locked. Sets m_bSpeculating when it returns true.
+bool CAkAutoStmBase::GetSpeculativeTransfer(
+	AkUInt64 &		out_uPosition,		// Returned absolute file position.
+	AkUInt32 &		out_uSize			// Returned size, truncated at end of file.
+	)
+{
+	// Slots of the ring cannot be held in the cache.
+	if ( m_bSpeculating 
+		|| RequiresScheduling()
+		|| m_uNumSeekTargets == 0
+		|| m_uNumRingSlots > 0
+		|| m_uCachedDataSize + m_uBufferSize > m_uMaxCachedSize )
+		return false;
+
+	AkUInt64 uVirtualPosition = GetVirtualFilePosition();
+	AkUInt64 uEndPosition = GetFileEndPosition();
+
+	AkAutoLock<CAkIOThread> lock( *m_pDevice );
+
+	for ( AkUInt32 uTarget = 0; uTarget < m_uNumSeekTargets; ++uTarget )
+	{
+		const AkSeekTarget & target = m_arSeekTargets[uTarget];
+		if ( target.uScore < AK_SEEK_TARGET_MIN_SCORE
+			|| target.uPosition >= uEndPosition
+			|| target.uPosition == uVirtualPosition )
+			continue;
+
+		bool bIsHeld = false;
+		AkBufferList::Iterator it = m_listCachedBuffers.Begin();
+		while ( !bIsHeld && it != m_listCachedBuffers.End() )
+		{
+			bIsHeld = ( target.uPosition >= (*it)->uPosition && target.uPosition < (*it)->uPosition + (*it)->uDataSize );
+			++it;
+		}
+		it = m_listBuffers.Begin();
+		while ( !bIsHeld && it != m_listBuffers.End() )
+		{
+			bIsHeld = ( target.uPosition >= (*it)->uPosition && target.uPosition < (*it)->uPosition + (*it)->uDataSize );
+			++it;
+		}
+
+		if ( !bIsHeld )
+		{
+			out_uPosition = target.uPosition;
+			out_uSize = (AkUInt32)AkMin( (AkUInt64)m_uBufferSize, uEndPosition - target.uPosition );
+			m_bSpeculating = true;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Keeps data of a completed speculative transfer in the segment cache, or frees its buffer.
+// Sync: Status must be locked. Clears m_bSpeculating.
+void CAkAutoStmBase::OnSpeculativeTransferDone(
+	const AkUInt64 & in_uPosition,		// Absolute file position of transfer.
+	void *			in_pBuffer,			// Address of data.
+	AkUInt32		in_uActualIOSize,	// Size of data.
+	bool			in_bSuccess			// True if the transfer succeeded.
+	)
+{
+	AKASSERT( m_bSpeculating );
+	m_bSpeculating = false;
+
+	AkAutoLock<CAkIOThread> lock( *m_pDevice );
+
+	if ( in_bSuccess 
+		&& in_uActualIOSize > 0
+		&& !m_bIsToBeDestroyed )
+	{
+		AkStmBuffer * pNewBuffer = m_pDevice->GetCachedBufferHolder();
+		pNewBuffer->uPosition = in_uPosition;
+		pNewBuffer->pBuffer = in_pBuffer;
+		pNewBuffer->uDataSize = (AkUInt32)AkMin( (AkUInt64)in_uActualIOSize, GetFileEndPosition() - in_uPosition );
+		if ( KeepInCache( pNewBuffer ) )
+		{
+#ifndef AK_OPTIMIZED
+			m_uBytesTransfered += pNewBuffer->uDataSize;
+#endif
+			return;
+		}
+		m_pDevice->ReleaseCachedBufferHolder( pNewBuffer );
+	}
+
+	FreeIOBuffer( in_pBuffer, in_uActualIOSize );
+	m_pDevice->NotifyMemChange();
+}
+
 void CAkAutoStmBase::OnTransferRemoved( 
 	const AkUInt64 in_uExpectedPosition,	// Expected file position (absolute) after request.
 	const AkUInt64 in_uActualPosition	// Actual file position after request.
@@ -11,6 +11,7 @@
 #define _AK_DEVICE_BASE_H_
 
 #include "AkIOThread.h"
+#include "AkIOMemMgr.h"
 #include <AK/Tools/Common/AkLock.h>
 #include <AK/Tools/Common/AkArray.h>
 #include "AkStreamMgr.h"
@@ -64,6 +65,68 @@ namespace StreamMgr
 	typedef AkListBare<AkStmBuffer,AkListBareNextBuffer>		AkBufferList;
 	typedef AkListBareLight<AkStmBuffer,AkListBareNextBuffer>	AkFreeBufferList;
 
+	// ------------------------------------------------------------------------------
+    // Scheduling key: snapshot of the values used by the scheduler to order tasks.
+	// Each task holds one, which belongs to the device's scheduler index.
+    // ------------------------------------------------------------------------------
+#define AK_SCHED_NOT_INDEXED		((AkUInt32)-1)	// AkStmSchedulingKey::uIndex of a task that is not in the scheduler index.
+#define AK_SCHED_STARVING			((AkUInt32)-2)	// AkStmSchedulingKey::uIndex of a task that is in the starvation bucket of its priority.
+	struct AkStmSchedulingKey
+	{
+		AkInt64		iIOStartTime;	// Time when last transfer started (starving tasks that waited the most go first).
+		AkReal32	fDeadline;		// Effective deadline (0 means starving).
+		AkUInt32	uIndex;			// Position in the scheduler index. AK_SCHED_NOT_INDEXED if not indexed.
+		AkUInt64	uPosition;		// File position of next transfer (absolute). Used by the elevator policy.
+		AkPriority	priority;		// Priority.
+		bool		bSignaled;		// Task requires scheduling.
+	};
+
+	// ------------------------------------------------------------------------------
+    // Transfer chosen by the scheduler: task, I/O buffer and deadline.
+    // ------------------------------------------------------------------------------
+	struct AkStmScheduledTransfer
+	{
+		CAkStmTask *	pTask;
+		void *			pBuffer;
+		AkReal32		fOpDeadline;
+	};
+
+	// ------------------------------------------------------------------------------
+    // Elevator policy: copy of the device's I/O model, taken under its lock, with which the
+	// durations of transfers are predicted during a scheduler pass.
+    // ------------------------------------------------------------------------------
+	struct AkElevatorIOModel
+	{
+		AkReal32		fLatency;		// Fixed cost of a transfer, in ms.
+		AkReal32		fCostPerByte;	// Cost of a byte, in ms.
+	};
+
+	// ------------------------------------------------------------------------------
+    // Likely seek target of an automatic stream: given by the client, or learned from its seeks.
+    // See CAkAutoStmBase::m_arSeekTargets.
+    // ------------------------------------------------------------------------------
+#define AK_MAX_SEEK_TARGETS			(4)				// Maximum number of seek targets tracked by an automatic stream.
+#define AK_SEEK_TARGET_MIN_SCORE	(3)				// Score from which a learned seek target is prefetched. New targets start just below it.
+#define AK_SEEK_TARGET_MAX_SCORE	(8)				// Learned seek target score saturation.
+	struct AkSeekTarget
+	{
+		AkUInt64	uPosition;		// Absolute file position.
+		AkUInt8		uScore;			// Learned targets: incremented when the stream seeks there, decremented when it seeks elsewhere.
+		bool		bHint;			// Target was given by the client (never evicted by learning).
+	};
+
+	// List bare policy for the device's starvation buckets.
+	struct AkListBareNextStarvingTask
+	{
+		static AkForceInline CAkStmTask *& Get( CAkStmTask * in_pItem );
+	};
+
+	// List bare policy for the device's deferred reclamation list.
+	struct AkListBareNextDestroyedTask
+	{
+		static AkForceInline CAkStmTask *& Get( CAkStmTask * in_pItem );
+	};
+
     //-----------------------------------------------------------------------------
     // Name: CAkDeviceBase
     // Desc: Base implementation of the high-level I/O device interface.
@@ -93,6 +156,7 @@ namespace StreamMgr
 
        virtual AKRESULT	Init( 
             const AkDeviceSettings &	in_settings,
+            const AkDeviceSettingsEx &	in_settingsEx,
             AkDeviceID					in_deviceID 
             );
         virtual void	Destroy();
@@ -126,6 +190,10 @@ namespace StreamMgr
 		{
 			return m_pLowLevelHook;
 		}
+		inline IAkIOHookResidentData * GetResidentDataHook()
+		{
+			return m_pResidentDataHook;
+		}
         inline AkUInt32 GetGranularity()
         {
             return m_uGranularity;
@@ -134,10 +202,30 @@ namespace StreamMgr
         {
             return m_fTargetAutoStmBufferLength;
         }
-        inline AkMemPoolId GetIOPoolID()
+        inline AkReal32 GetMeasuredThroughputWeight()
+        {
+            return m_fMeasuredThroughputWeight;
+        }
+        inline CAkIOMemMgr & GetIOMemMgr()
         {
-            return m_streamIOPoolId;
+            return m_ioMemMgr;
         }
+
+		// Buffer reassignment: returns a buffer of in_uBufferSize bytes in place of a buffer that was taken from 
+		// another stream. The latter is exchanged if it is not of the right size, which fails (returns NULL) if 
+		// there is not enough contiguous memory yet.
+		// IMPORTANT: The CAkIOThread must be locked.
+		void * ReassignIOBuffer(
+			void *			in_pBuffer,		// Buffer taken from another stream.
+			AkUInt32		in_uBufferSize	// Required buffer size.
+			);
+
+		// Segment caches of automatic streams: total size of cached data.
+		// IMPORTANT: The CAkIOThread must be locked.
+		inline void OnCachedSizeChange( AkInt32 in_iSizeDelta )
+		{
+			m_uCachedSize += in_iSizeDelta;
+		}
         inline AkInt64 GetTime()
         {
             return m_time;
@@ -158,7 +246,51 @@ namespace StreamMgr
 		{
 			m_listFreeBufferHolders.AddFirst( in_pBufferHolder );
 		}
-        
+
+		// Scheduler index.
+		// Tasks call UpdateSchedulingIndex() every time a value that affects their scheduling changes (ready
+		// for I/O, signaled status, deadline, priority). Tasks that are ready for I/O are kept in the index,
+		// so that the scheduler does not need to inspect all tasks at every pass.
+		// Sync: Index lock. Tasks may hold their status lock, but task locks are never acquired from within
+		// the index lock.
+		void UpdateSchedulingIndex(
+			CAkStmTask *	in_pTask		// Task whose scheduling status changed.
+			);
+		// Also removes the task from the deferred reclamation list. Called when tasks are deleted.
+		void RemoveFromSchedulingIndex(
+			CAkStmTask *	in_pTask		// Task to remove from the index, if applicable.
+			);
+
+		// I/O claims.
+		// Tasks that were handed to another thread for I/O by SchedulerFindNextTasks( .., true ) are "claimed":
+		// they stay out of the index, and cannot be destroyed, until the thread that performed their transfer
+		// releases them. The releasing thread must not access the task afterwards.
+		// Sync: Index lock.
+		void ReleaseTaskClaim(
+			CAkStmTask *	in_pTask		// Task whose transfer was completed (Update() was called).
+			);
+		bool IsTaskClaimed(
+			CAkStmTask *	in_pTask		// Task.
+			);
+
+		// I/O model.
+		// The device measures the time that transfers take between their submission to the Low-Level IO and their
+		// completion, and fits a "latency + size / bandwidth" model to them. The scheduler uses it to predict whether 
+		// the next transfer of a task can complete before its deadline.
+		// Sync: Samples may be added from any thread (Low-Level IO callbacks, I/O workers). 
+		void AddTransferSample(
+			AkUInt32		in_uSize,		// Size transferred.
+			AkReal32		in_fDuration	// Time elapsed between submission and completion, in ms.
+			);
+		// Returns the expected duration of a transfer, in ms. 0 until a transfer has been measured.
+		// Sync: None. 
+		inline AkReal32 PredictTransferTime(
+			AkUInt32		in_uSize		// Transfer size.
+			)
+		{
+			return m_fIOLatency + in_uSize * m_fIOCostPerByte;
+		}
+
         // Device Profile Ex interface.
         // --------------------------------------------------------
 #ifndef AK_OPTIMIZED
@@ -185,6 +317,11 @@ namespace StreamMgr
         virtual AK::IAkStreamProfile * GetStreamProfile( 
             AkUInt32    in_uStreamIndex             // [0,numStreams[
             );
+
+        // I/O model.
+        virtual void     GetIOModel(
+            AkDeviceIOModel & out_ioModel
+            );
 #endif
 
     protected:
@@ -198,10 +335,35 @@ namespace StreamMgr
 		}
 
         // Add a new task to the list.
-        void AddTask( 
+		// The task is pushed to the task inbox without locking the task list. It joins the task list
+		// the next time the inbox is drained.
+		// Returns AK_InsufficientMemory if the scheduler index could not be grown to hold it.
+        AKRESULT AddTask(
             CAkStmTask * in_pStmTask
             );
 
+		// Moves tasks of the inbox to the task list.
+		// Sync: Task list must be locked.
+		void DrainTaskInbox();
+
+		// Returns true if the deferred reclamation list is not empty. 
+		// Sync: None. Tasks may be added to it concurrently.
+		inline bool HasTasksToDestroy()
+		{
+			return !m_listTasksToDestroy.IsEmpty();
+		}
+
+		// Destroys tasks of the deferred reclamation list, that is, tasks that notified that they are 
+		// to be destroyed. Tasks that cannot be destroyed yet remain in the list.
+		// Sync: Task list must be locked.
+		void CleanupDestroyedTasks();
+
+		// Removes a task from the task list and destroys it.
+		// Sync: Task list must be locked.
+		void DestroyTask(
+			CAkStmTask *		in_pTask
+			);
+
         // Destroys all streams.
 		// Returns true if it was able to destroy all streams. Otherwise, the IO thread needs to
 		// wait for pending transfers to complete.
@@ -219,23 +381,178 @@ namespace StreamMgr
 			void *&		out_pBuffer,	// Returned I/O buffer used for this transfer.
 			AkReal32 &	out_fOpDeadline	// Returned deadline for this transfer.
             );
+        // Batched version: finds up to in_uMaxTransfers transfers in one pass. A task is chosen at most once.
+        // Returns the number of transfers found.
+        AkUInt32        SchedulerFindNextTasks(
+			AkStmScheduledTransfer *	out_arTransfers,	// Returned transfers. Must hold at least in_uMaxTransfers items.
+			AkUInt32					in_uMaxTransfers,	// Maximum number of transfers to schedule.
+			bool						in_bClaimTasks = false	// Claim chosen tasks (see ReleaseTaskClaim()) instead of putting them back in the index.
+			);
+        // Chooses next task and gets its I/O buffer. Common to SchedulerFindNextTask(s).
+        CAkStmTask *    SchedulerPickTask(
+			void *&		out_pBuffer,	// Returned I/O buffer used for this transfer.
+			AkReal32 &	out_fOpDeadline	// Returned deadline for this transfer.
+            );
         // Finds next task among standard streams only (typically when there is no more memory for automatic streams).
         CAkStmTask *    ScheduleStdStmOnly(
 			void *&		out_pBuffer,	// Returned I/O buffer used for this transfer.
 			AkReal32 &	out_fOpDeadline	// Returned deadline for this transfer.
             );
+		// Called by the scheduler once it got an I/O buffer for the chosen task.
+		// Sync: Index lock.
+		void OnTaskScheduled(
+			CAkStmTask *	in_pTask,	// Task chosen for I/O.
+			const AkStmSchedulingKey & in_key	// Scheduling key with which it was chosen.
+			);
+
+		// Scheduler index helpers.
+		// Sync: Index lock must be held.
+		// ---------------------------------------------
+
+		// Selection rule of the scheduler: returns true if task A should be chosen before task B.
+		static inline bool IsMoreUrgent(
+			const AkStmSchedulingKey & in_keyA,
+			const AkStmSchedulingKey & in_keyB
+			)
+		{
+			// Signaled tasks (RequiresScheduling) go first.
+			if ( in_keyA.bSignaled != in_keyB.bSignaled )
+				return in_keyA.bSignaled;
+			// Then starving tasks.
+			bool bIsStarvingA = ( in_keyA.fDeadline == 0 );
+			if ( bIsStarvingA != ( in_keyB.fDeadline == 0 ) )
+				return bIsStarvingA;
+			// Starving tasks are chosen by priority, then by the time they have been waiting for I/O.
+			if ( bIsStarvingA )
+			{
+				if ( in_keyA.priority != in_keyB.priority )
+					return in_keyA.priority > in_keyB.priority;
+				return in_keyA.iIOStartTime < in_keyB.iIOStartTime;
+			}
+			// Others are chosen by deadline.
+			return in_keyA.fDeadline < in_keyB.fDeadline;
+		}
+
+		// Returns the most urgent task of the index, and its scheduling key.
+		// Automatic streams are peeked from the heap. Pending standard streams have a time-dependent
+		// deadline and are evaluated now.
+		CAkStmTask * PeekMostUrgentTask(
+			bool				in_bStdStmOnly,	// Consider standard streams only.
+			AkStmSchedulingKey & out_key		// Returned scheduling key of chosen task.
+			);
+
+		// Returns the first task of the highest priority starvation bucket, NULL if there is none.
+		CAkStmTask * PeekStarvingTask();
+
+		// Elevator policy (AK_SCHEDULER_ELEVATOR): returns the task whose next transfer is nearest after the 
+		// end of the previous one, among tasks that may go before the most urgent task without putting its 
+		// deadline at risk. Returns in_pMostUrgentTask if it is at risk, or if no other task qualifies.
+		CAkStmTask * PeekNearestTask(
+			CAkStmTask *		in_pMostUrgentTask,	// Task returned by PeekMostUrgentTask().
+			AkStmSchedulingKey & io_key				// In: Scheduling key of in_pMostUrgentTask. Out: Key of chosen task.
+			);
+
+		// Elevator policy: returns a consistent copy of the I/O model. Until a transfer has been measured, a slow 
+		// device is assumed rather than an instant one (see PredictTransferTime()).
+		// Sync: I/O model lock.
+		void GetElevatorIOModel(
+			AkElevatorIOModel &	out_model			// Returned I/O model.
+			);
+
+		// Elevator policy: expected duration of a transfer, in ms.
+		static inline AkReal32 PredictElevatorTransferTime(
+			const AkElevatorIOModel & in_model,	// I/O model returned by GetElevatorIOModel().
+			AkUInt32			in_uSize			// Transfer size.
+			)
+		{
+			return in_model.fLatency + in_uSize * in_model.fCostPerByte;
+		}
+
+		// Releases the segment cache of an automatic stream, when I/O memory is exhausted. Returns false if no
+		// stream has cached data.
+		// Sync: Task list and CAkIOThread must be locked.
+		bool ReleaseCachedMemory();
+
+		// Returns the indexed automatic stream with the greatest deadline (for buffer reassignment).
+		CAkStmTask * FindMostBufferedTask(
+			AkReal32 &			out_fDeadline	// Returned deadline of this task.
+			);
+
+		// Inserts, repositions or removes a task according to its current scheduling status.
+		void ReindexTask(
+			CAkStmTask *		in_pTask
+			);
+
+		// Removes a task from the index if it is there.
+		void UnindexTask(
+			CAkStmTask *		in_pTask
+			);
+
+		// Called by UpdateSchedulingIndex() after a task was reindexed. Devices whose I/O thread may wait 
+		// for something else than new work override it to wake their I/O thread up.
+		// Sync: Index lock.
+		virtual void OnSchedulingIndexChange() {}
+
+		// Heap maintenance.
+		void HeapSiftUp( AkUInt32 in_uIndex );
+		void HeapSiftDown( AkUInt32 in_uIndex );
+
+		// Elevator policy: maintenance of m_arTasksByPosition. Tasks are inserted and removed with the position 
+		// of their scheduling key, which must not change in-between. Nothing is done without the elevator policy.
+		void AddToPositionIndex( CAkStmTask * in_pTask );
+		void RemoveFromPositionIndex( CAkStmTask * in_pTask );
+		// Returns the index of the first task of m_arTasksByPosition that is not ordered before (in_uPosition, in_pTask).
+		AkUInt32 FindInPositionIndex(
+			AkUInt64			in_uPosition,		// File position (absolute).
+			CAkStmTask *		in_pTask			// Tie-breaker. Pass NULL to find the first task at or after in_uPosition.
+			);
 
 	protected:
 		// Time in milliseconds. Stamped at every scheduler pass.
         AkInt64         m_time;
 
 		// Task list.
-        // Tasks live in m_arTasks from the time they are created until they are completely destroyed (by the I/O thread).
-        // It is more efficient to query the tasks every time scheduling occurs than to add/remove them from the list, 
-        // every time, from other threads.
+        // Tasks live in m_listTasks from the time they are created until they are completely destroyed (by the I/O thread).
+		// New tasks are pushed to a lock-free inbox (multiple producers, linked with pNextLightItem). It is emptied
+		// at once (single consumer) into m_listTasks at the beginning of each scheduler pass, so that threads that
+		// create streams never wait for the scheduler.
         typedef AkListBareLight<CAkStmTask> TaskList;
         TaskList		m_listTasks;            // List of tasks.
-        CAkLock         m_lockTasksList;        // Protects tasks array.
+        CAkLock         m_lockTasksList;        // Protects tasks list.
+		CAkStmTask * volatile m_pTaskInbox;		// Tasks added since the inbox was last drained (LIFO).
+		AkUInt32		m_uNumTasks;			// Number of tasks in m_listTasks and m_pTaskInbox. Protected by index lock.
+
+		// Scheduler index.
+		// Automatic streams that are ready for I/O are kept in a binary heap ordered according to IsMoreUrgent().
+		// Standard streams that are ready for I/O (pending) are kept apart, in no particular order, because their
+		// effective deadline depends on time. All arrays are grown in AddTask() so that indexing never allocates.
+		// Signaled automatic streams that are starving are not kept in the heap, but in one FIFO per priority level
+		// (starvation buckets). They join the back of their bucket when they start starving and leave it when they
+		// get data, so that buckets are drained from the highest priority down, in a round robin fashion.
+		// Lock order: m_lockTasksList, then task status, then m_lockSchedIndex.
+	public:
+		// NOTE: Memory pool policy must be public (see ArrayPoolLocal below).
+		AK_DEFINE_ARRAY_POOL( ArrayPoolSchedIndex, CAkStreamMgr::GetObjPoolID() );
+	protected:
+		typedef AkArray<CAkStmTask*,CAkStmTask*,ArrayPoolSchedIndex,AK_STM_OBJ_POOL_BLOCK_SIZE/sizeof(CAkStmTask*)> TaskArray;
+		TaskArray		m_arReadyAutoTasks;		// Heap of automatic streams ready for I/O.
+		TaskArray		m_arReadyStdTasks;		// Standard streams ready for I/O.
+		TaskArray		m_arTasksByPosition;	// Elevator policy: tasks of m_arReadyAutoTasks and m_arReadyStdTasks, sorted by the position
+												// of their next transfer (schedKey.uPosition), then by address. Empty without the elevator policy.
+		typedef AkListBare<CAkStmTask,AkListBareNextStarvingTask> StarvingTaskList;
+		StarvingTaskList m_arStarvingTasks[AK_MAX_PRIORITY+1];	// Starvation buckets, indexed by priority.
+		AkInt32			m_iHighestStarvingPriority;	// Upper bound of the priority of non-empty starvation buckets. -1 if all are empty.
+		AkUInt64		m_uHeadPosition;		// Elevator policy: end position (absolute) of the last transfer for which the scheduler got a buffer.
+		AkReal32		m_fElevatorBatchTime;	// Elevator policy: predicted duration of the transfers chosen since the beginning of the scheduler pass. 
+												// They are sent before the transfers chosen next. Scheduler only (task list lock).
+		CAkLock			m_lockSchedIndex;		// Protects scheduler index.
+
+		// Deferred reclamation list.
+		// Tasks join it (once) the first time they update the index after being scheduled for destruction, and leave it
+		// when they are destroyed. The scheduler thus never needs to inspect the task list to find tasks to destroy.
+		// Protected by index lock.
+		typedef AkListBare<CAkStmTask,AkListBareNextDestroyedTask> DestroyedTaskList;
+		DestroyedTaskList m_listTasksToDestroy;
 
 		// List of free cached buffer holder structures.
 		AkFreeBufferList	m_listFreeBufferHolders;
@@ -243,10 +560,30 @@ namespace StreamMgr
 
 		// Low-Level I/O hook.
 		IAkLowLevelIOHook *	m_pLowLevelHook;
+		IAkIOHookResidentData * m_pResidentDataHook;	// Optional interface of the hook (AkDeviceSettingsEx::pResidentDataHook). NULL if it was not registered.
+
+		// I/O memory. It is obtained from the I/O pool in one block, and divided in stream buffers by m_ioMemMgr.
+		void *				m_pIOMemory;
+		CAkIOMemMgr			m_ioMemMgr;
+		AkUInt32			m_uCachedSize;		// Size of data in segment caches of automatic streams. Protected by CAkIOThread lock.
 
 		// Settings.
         AkUInt32        m_uGranularity;
         AkReal32        m_fTargetAutoStmBufferLength;
+        AkReal32        m_fMeasuredThroughputWeight;	// Weight of measured throughput vs heuristic, for automatic streams.
+        bool            m_bElevator;					// Elevator dispatch policy (AK_SCHEDULER_ELEVATOR).
+
+		// I/O model: exponentially weighted means of transfer size and duration, variance of size and covariance.
+		// Protected by m_lockIOModel. Fitted values are written under the lock. GetSchedulingKey() reads them without locking,
+		// the elevator policy copies them under the lock (see GetElevatorIOModel()). It is taken last, after m_lockSchedIndex.
+		CAkLock			m_lockIOModel;
+		AkReal32		m_fIOMeanSize;
+		AkReal32		m_fIOMeanDuration;
+		AkReal32		m_fIOSizeVariance;
+		AkReal32		m_fIOCovariance;
+		AkUInt32		m_uNumIOSamples;
+		volatile AkReal32 m_fIOLatency;		// Fitted fixed cost of a transfer, in ms.
+		volatile AkReal32 m_fIOCostPerByte;	// Fitted cost of a byte (inverse of bandwidth), in ms.
         /** Needed at thread level (CAkIOThread)
         AkUInt32		m_uIdleWaitTime;
 		AkUInt32        m_uMaxConcurrentIO;
@@ -349,6 +686,11 @@ namespace StreamMgr
 		// perform any update required after file size was set. Does nothing by default.
 		virtual void OnSetFileSize() {}
 
+		// This is called by the Stream Manager when the file was opened synchronously, before the stream
+		// is handed to its client. Automatic streams use it to serve data that is resident in memory 
+		// directly. Does nothing by default.
+		virtual void OnSyncFileOpen() {}
+
         // Settings access.
         inline AkStmType StmType()      // Task stream type.
         {
@@ -405,8 +747,17 @@ namespace StreamMgr
         // that this task could give away some of its buffers.
         // Automatic stream specific. Not implemented in standard stream objects.
         // Returns NULL if failed, and notifies that memory management should become idle.
-        // Fails if the user got all buffers before the scheduler.
-        virtual void * PopIOBuffer() = 0;
+        // Fails if the user got all buffers before the scheduler, or if the buffer it gave away was not large 
+        // enough (in which case memory is not idle).
+        virtual void * PopIOBuffer(
+			AkUInt32	in_uBufferSize		// Size of the buffer required by the task chosen for I/O.
+			) = 0;
+
+		// Size of I/O buffers (automatic streams), or size remaining to transfer (standard streams).
+		inline AkUInt32 GetBufferSize()
+		{
+			return m_uBufferSize;
+		}
 
 		// Returns True if the task should be considered by the scheduler for an I/O operation.
 		// - Standard streams are ready for I/O when they are Pending.
@@ -425,6 +776,7 @@ namespace StreamMgr
 
         // Scheduling heuristics.
         virtual AkReal32 EffectiveDeadline() = 0;   // Compute task's effective deadline for next operation, in ms.
+        virtual AkUInt64 NextTransferPosition() = 0;// File position (absolute) of next operation.
         AkReal32 TimeSinceLastTransfer(             // Time elapsed since last I/O transfer.
             const AkInt64 & in_liNow                // Time stamp.
             )
@@ -432,6 +784,30 @@ namespace StreamMgr
             return AKPLATFORM::Elapsed( in_liNow, m_iIOStartTime );
         }
 
+		// Computes current scheduling key (index position is left untouched).
+		inline void GetSchedulingKey(
+			AkStmSchedulingKey & out_key
+			)
+		{
+			out_key.iIOStartTime = m_iIOStartTime;
+			out_key.fDeadline	= EffectiveDeadline();
+			out_key.uPosition	= NextTransferPosition();
+			out_key.priority	= m_priority;
+			out_key.bSignaled	= ( m_bRequiresScheduling != 0 );
+
+			// Tasks whose next transfer is not expected to complete before their deadline are considered 
+			// starving already: they are promoted according to their priority.
+			if ( out_key.fDeadline > 0 
+				&& out_key.fDeadline < m_pDevice->PredictTransferTime( GetTransferSize() ) )
+				out_key.fDeadline = 0;
+		}
+
+		// Size of next transfer. Transfers of standard streams are sliced to granularity.
+		inline AkUInt32 GetTransferSize()
+		{
+			return ( m_eStmType == AK_StmTypeAutomatic ) ? m_uBufferSize : AkMin( m_uBufferSize, m_pDevice->GetGranularity() );
+		}
+
         // Profiling.
 #ifndef AK_OPTIMIZED
         
@@ -479,6 +855,24 @@ namespace StreamMgr
 		// List bare light sibling: device's TaskList.
 		CAkStmTask * pNextLightItem;
 
+		// Scheduling key, as of last update of the device's scheduler index.
+		// Owned by the device: only accessed inside its index lock.
+		AkStmSchedulingKey schedKey;
+
+		// List bare sibling: device's starvation buckets.
+		CAkStmTask * pNextStarvingItem;
+
+		// List bare sibling: device's deferred reclamation list.
+		CAkStmTask * pNextDestroyedItem;
+
+		// True while the task is claimed by a thread that performs its transfer (see CAkDeviceBase::ReleaseTaskClaim()).
+		// Owned by the device: only accessed inside its index lock.
+		bool bIOClaimed;
+
+		// True once the task was added to the device's deferred reclamation list.
+		// Owned by the device: only accessed inside its index lock.
+		bool bDestructionQueued;
+
 	protected:
 
 		// Helpers.
@@ -572,6 +966,16 @@ namespace StreamMgr
                                 
     };
 
+	AkForceInline CAkStmTask *& AkListBareNextStarvingTask::Get( CAkStmTask * in_pItem )
+	{
+		return in_pItem->pNextStarvingItem;
+	}
+
+	AkForceInline CAkStmTask *& AkListBareNextDestroyedTask::Get( CAkStmTask * in_pItem )
+	{
+		return in_pItem->pNextDestroyedItem;
+	}
+
     //-----------------------------------------------------------------------------
     // Name: class CAkStmBase
     // Desc: Base implementation for standard streams.
@@ -661,7 +1065,16 @@ namespace StreamMgr
 		virtual void Kill();
 
         // Automatic streams specific: does not apply.
-        virtual void * PopIOBuffer();
+        virtual void * PopIOBuffer(
+			AkUInt32	in_uBufferSize		// Size of the buffer required by the task chosen for I/O.
+			);
+
+		// File position (absolute) of next operation.
+		// Note: Read without locking by the scheduler; the value is only used as a hint.
+		virtual AkUInt64 NextTransferPosition()
+		{
+			return m_bIsPositionDirty ? ( GetFileOffset() + m_uCurPosition ) : m_uFilePosition;
+		}
 
         //-----------------------------------------------------------------------------
         // Profiling.
@@ -843,6 +1256,27 @@ namespace StreamMgr
 		// Returns the target buffering size based on the throughput heuristic.
 		virtual AkUInt32 GetNominalBuffering();
 
+        // Seek hints.
+        // ---------------------------------------
+
+        // Give hints on the positions that the stream is likely to be set to next. Replaces previous hints.
+        virtual AKRESULT SetSeekTargets(
+            const AkUInt64 * in_puPositions,    // Array of positions (offsets from the beginning of the stream).
+            AkUInt32        in_uNumPositions    // Number of positions in array.
+            );
+
+        // Storage settings.
+        // ---------------------------------------
+
+        // Sets the size of the ring buffer. Fails if the stream was started or has data buffered.
+        virtual AKRESULT SetRingBufferSize(
+            AkUInt32        in_uRingBufferSize  // Ring size, in bytes. 0 disables the ring.
+            );
+        // Sets the maximum size of the segment cache. 
+        virtual AKRESULT SetSegmentCacheSize(
+            AkUInt32        in_uSegmentCacheSize // Maximum size of cached data, in bytes. 0 disables the cache.
+            );
+
         //-----------------------------------------------------------------------------
         // CAkStmTask interface.
         //-----------------------------------------------------------------------------
@@ -860,6 +1294,10 @@ namespace StreamMgr
 		// Automatic stream object ensure that the loop end heuristic is consistent.
 		virtual void OnSetFileSize();
 
+		// This is called when the file was opened synchronously. If the Low-Level IO exposes the file's
+		// data in memory, the stream switches to resident mode (see m_pResidentData).
+		virtual void OnSyncFileOpen();
+
         // Data buffer access.
         // Tries to get a buffer for I/O. It might fail if there is no more memory (returns NULL).
         // Returns the address of the user's buffer.
@@ -867,6 +1305,10 @@ namespace StreamMgr
         
         // Scheduling heuristics.
         virtual AkReal32 EffectiveDeadline();   // Compute task's effective deadline for next operation, in ms.
+        virtual AkUInt64 NextTransferPosition() // File position (absolute) of next transfer, as of last scheduling status update.
+        {
+            return m_uNextTransferPosition;
+        }
         
 #ifndef AK_OPTIMIZED
         // IAkStreamProfile interface.
@@ -879,6 +1321,10 @@ namespace StreamMgr
 		virtual void ProfileAllowDestruction();
 #endif
 
+		// Frees all buffers of the segment cache. Returns false if the cache was empty.
+		// Sync: Device lock is acquired.
+		bool FlushCache();
+
 	protected:
         //-----------------------------------------------------------------------------
         // Helpers.
@@ -887,27 +1333,42 @@ namespace StreamMgr
 			AkUInt32 in_uVirtualBufferingSize
 			);
 
+		// Throughput used for scheduling, in bytes/ms: the throughput heuristic, blended with the measured
+		// consumption rate according to the device's measured throughput weight.
+		inline AkReal32 SchedulingThroughput()
+		{
+			AkReal32 fWeight = m_pDevice->GetMeasuredThroughputWeight();
+			if ( fWeight == 0 || m_fMeasuredThroughput == 0 )
+				return m_fThroughput;
+			return m_fThroughput + fWeight * ( m_fMeasuredThroughput - m_fThroughput );
+		}
+
+		// Measures the consumption rate of the client with the data granted to it.
+		// Sync: Status must be locked prior to calling this function.
+		void MeasureThroughput(
+			AkUInt32	in_uGrantedSize			// Size of the buffer that is being granted.
+			);
+
+		// Note: Resident streams are never ready for I/O.
 		inline void SetRunning( bool in_bRunning )
 		{
 			m_bIsRunning = in_bRunning;
-			SetReadyForIO( in_bRunning && !m_bHasReachedEof && !m_bIsToBeDestroyed );
+			SetReadyForIO( in_bRunning && !m_bHasReachedEof && !m_bIsToBeDestroyed && !m_pResidentData );
 		}
 
 		inline void SetReachedEof( bool in_bHasReachedEof )
 		{
 			m_bHasReachedEof = in_bHasReachedEof;
-			SetReadyForIO( m_bIsRunning && !in_bHasReachedEof && !m_bIsToBeDestroyed );
+			SetReadyForIO( m_bIsRunning && !in_bHasReachedEof && !m_bIsToBeDestroyed && !m_pResidentData );
 		}
 
 		// Returns true if the writer thread is done feeding this stream with data.
-		// NOTE: Since stream objects do not keep an explicit count of their actual buffering 
-		// (that is, the amount of data which transfers have completed, which is the sum of 
-		// uDataSize of all their AkStmBuffers), callers must compute it and pass it to this function. 
-		// It is compared to the virtual buffering size, which represents the amount of data for 
+		// The actual buffering size (the amount of data which transfers have completed and that is not
+		// granted) is compared to the virtual buffering size, which represents the amount of data for 
 		// transfers that have been _scheduled_ (including those that have completed).
-		inline bool NeedsNoMoreTransfer( AkUInt32 in_uActualBufferingSize )
+		inline bool NeedsNoMoreTransfer()
 		{
-			return !RequiresScheduling() && ( m_uVirtualBufferingSize <= in_uActualBufferingSize );
+			return !RequiresScheduling() && ( m_uVirtualBufferingSize <= m_uAvailableDataSize );
 		}
 
 		// Automatic streams must implement a method that returns the file position after the last
@@ -938,6 +1399,10 @@ namespace StreamMgr
         void *   GetReadBuffer(     
             AkUInt32 &  out_uSize               // Buffer size.
             );
+        // Resident mode: returns a buffer pointing into resident data at the current position. NULL at end of file.
+        void *   GetResidentBuffer(     
+            AkUInt32 &  out_uSize               // Buffer size.
+            );
         // Releases the latest buffer granted to user. Returns AK_Fail if no buffer was granted.
         AKRESULT ReleaseReadBuffer();
         // Flushes all stream buffers that are not currently granted.
@@ -964,6 +1429,71 @@ namespace StreamMgr
 			bool		in_bStoreData			// Store data in stream object if true, free buffer otherwise.
 			);
 
+		// Frees an I/O buffer of this stream: releases its slots if it lies in the ring, frees it from
+		// the device's I/O memory otherwise.
+		// Sync: Device must be locked.
+		void FreeIOBuffer(
+			void *		in_pBuffer,				// Buffer.
+			AkUInt32	in_uDataSize			// Size of data held in buffer.
+			);
+
+		// Segment cache management. 
+		// Keeps a buffer removed from m_listBuffers in the cache. Returns false if it cannot be cached: caller must free it.
+		// Sync: Device must be locked.
+		bool KeepInCache(
+			AkStmBuffer *	in_pBuffer			// Buffer (with its holder).
+			);
+		// Moves cached buffers that hold data contiguously from in_uPosition to m_listBuffers. Nothing must be buffered.
+		// Returns true if some data was restored.
+		// Sync: Status must be locked.
+		bool RestoreCachedBuffers(
+			AkUInt64		in_uPosition		// Absolute file position.
+			);
+		// Removes the oldest cached buffer and returns its memory, NULL if the cache is empty.
+		// Sync: Device must be locked.
+		void * PopCachedBuffer();
+
+		// Speculative prefetch.
+		// Learns a seek target: the stream was set to this position while it expected another one.
+		// Sync: Status must be locked.
+		void RecordSeek(
+			AkUInt64		in_uPosition		// Absolute file position.
+			);
+		// Returns true if the next transfer should prefetch a window at a likely seek target into the segment cache,
+		// with its absolute position and size. This is only done while the stream does not require buffering 
+		// (that is, with the device's idle bandwidth), one transfer at a time.
+		// Sync: Status must be locked. Sets m_bSpeculating when it returns true.
+		bool GetSpeculativeTransfer(
+			AkUInt64 &		out_uPosition,		// Returned absolute file position.
+			AkUInt32 &		out_uSize			// Returned size, truncated at end of file.
+			);
+		// Keeps data of a completed speculative transfer in the segment cache, or frees its buffer.
+		// Sync: Status must be locked. Clears m_bSpeculating.
+		void OnSpeculativeTransferDone(
+			const AkUInt64 & in_uPosition,		// Absolute file position of transfer.
+			void *			in_pBuffer,			// Address of data.
+			AkUInt32		in_uActualIOSize,	// Size of data.
+			bool			in_bSuccess			// True if the transfer succeeded.
+			);
+
+		// Returns true if data at this absolute position should be cached when it is released by the client: 
+		// beginning of the file or of the loop region.
+		inline bool IsInCachedRange( AkUInt64 in_uPosition )
+		{
+			AkUInt64 uFileOffset = GetFileOffset();
+			return ( in_uPosition < uFileOffset + m_uMaxCachedSize
+					|| ( m_uLoopEnd 
+						&& in_uPosition >= uFileOffset + m_uLoopStart 
+						&& in_uPosition < uFileOffset + m_uLoopStart + m_uMaxCachedSize ) );
+		}
+
+		inline bool IsInRing( const void * in_pBuffer )
+		{
+			return ( m_pRing
+					&& (const AkUInt8*)in_pBuffer >= m_pRing 
+					&& (const AkUInt8*)in_pBuffer < m_pRing + m_uNumRingSlots * m_uBufferSize );
+		}
+
 		// Update task's status after transfer.
 		void UpdateTaskStatus(
 			AKRESULT	in_eIOResult			// AK_Success if IO was successful, AK_Cancelled if IO was cancelled, AK_Fail otherwise.
@@ -979,9 +1509,13 @@ namespace StreamMgr
     protected:
 
 		AkUInt64			m_uNextExpectedUserPosition;	// Expected (absolute) position of next GetBuffer().
+		AkUInt64			m_uNextTransferPosition;		// Position (absolute) of next transfer. Updated in UpdateSchedulingStatus().
         
         // Stream heuristics.
         AkReal32            m_fThroughput;      // Average throughput in bytes/ms. 
+        AkReal32            m_fMeasuredThroughput;	// Measured consumption rate in bytes/ms (moving average). 0 until first sample.
+        AkInt64             m_iThroughputSampleStart;	// Time when current consumption rate sample started.
+        AkUInt32            m_uThroughputSampleSize;	// Data granted to client since current sample started.
         AkUInt32            m_uLoopStart;       // Set to start of loop (byte offset from beginning of stream) for streams that loop, 0 otherwise.
         AkUInt32            m_uLoopEnd;         // Set to end of loop (byte offset from beginning of stream) for streams that loop, 0 otherwise.
         AkUInt32            m_uMinNumBuffers;   // Specify a minimal number of buffers if you plan to own more than one buffer at a time, 0 or 1 otherwise.
@@ -989,10 +1523,43 @@ namespace StreamMgr
         // Streaming buffers.
         AkUInt32            m_uVirtualBufferingSize;	// Virtual buffering size: sum of all buffered data and pending transfers, minus what is granted to client.
 														// Used for fast scheduling (minimizes scheduler computation and locking).
+		// Running counts of the data of m_listBuffers, maintained wherever buffers are added, granted or removed.
+		// They are written inside the status lock, but may be read without it (see QueryBufferingStatus()).
+		volatile AkUInt32	m_uAvailableDataSize;	// Sum of uDataSize of buffers not granted to client (actual buffering size).
+		volatile AkUInt32	m_uGrantedDataSize;		// Sum of uDataSize of buffers granted to client.
 
 		AkBufferList		m_listBuffers;
         AkUInt8             m_uNextToGrant;     // Index of next buffer to grant (this implementation supports a maximum of 255 concurrently granted buffers).
 
+		// Resident mode: address of position 0 of the file handle, as returned by the Low-Level IO's IAkIOHookResidentData::AddRefResidentData().
+		// NULL for streamed files. Buffers of resident streams point directly into this memory: they are created 
+		// when granted (their holders are allocated from the object pool), and the stream is never scheduled.
+		const AkUInt8 *		m_pResidentData;
+
+		// Ring-buffer storage mode: contiguous block of I/O memory reserved by the stream when it first needs a buffer,
+		// divided in slots of m_uBufferSize that are used in turn. Completed transfers that follow the last buffer in
+		// the ring and in the file are appended to it, so that the client is granted larger spans of data. 
+		// When the next slot is still in use, the stream falls back to the device's I/O memory.
+		// Sync: Slots are allocated and freed with the device locked.
+#define AK_MAX_RING_SLOTS	(32)	// Maximum number of slots in a ring (m_uRingSlotsUsed is a 32-bit field).
+		AkUInt8 *			m_pRing;			// NULL when not in ring mode or not allocated yet.
+		AkUInt32			m_uRingSlotsUsed;	// Bit field of slots in use.
+		AkUInt8				m_uNumRingSlots;	// Number of slots requested (until m_pRing is allocated), then allocated. 0 when not in ring mode.
+		AkUInt8				m_uNextRingSlot;	// Next slot to use.
+
+		// Segment cache: buffers that were flushed, or that were released by the client at the beginning of the file or 
+		// of the loop region (see IsInCachedRange()), are kept up to m_uMaxCachedSize bytes, the oldest being evicted first. 
+		// SetPosition() restores them if they hold the data at the new position. Cached data does not count as buffering.
+		// Sync: Device lock.
+		AkBufferList		m_listCachedBuffers;
+		AkUInt32			m_uCachedDataSize;	// Sum of uDataSize of cached buffers.
+		AkUInt32			m_uMaxCachedSize;	// 0 when the stream has no cache.
+
+		// Likely seek targets, prefetched into the segment cache with idle bandwidth (see GetSpeculativeTransfer()).
+		// Sync: Status lock.
+		AkSeekTarget		m_arSeekTargets[AK_MAX_SEEK_TARGETS];
+		AkUInt8				m_uNumSeekTargets;
+
 		// Helper: get next buffer to grant to client.
 		inline AkStmBuffer * GetNextBufferToGrant()
 		{
@@ -1010,6 +1577,8 @@ namespace StreamMgr
         // Stream status.
         AkUInt8            	m_bIsRunning    :1; // Running or paused.
         AkUInt8           	m_bIOError      :1; // Stream encountered I/O error.
+        AkUInt8           	m_bIsSamplingThroughput :1; // A consumption rate sample is in progress.
+        AkUInt8           	m_bSpeculating  :1; // A speculative transfer is pending.
     };
 }
 }
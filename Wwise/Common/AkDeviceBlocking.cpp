@@ -21,13 +21,52 @@ CAkDeviceBlocking::CAkDeviceBlocking(
 	IAkLowLevelIOHook *	in_pLowLevelHook
 	)
 : CAkDeviceBase( in_pLowLevelHook )
+, m_uNumWorkers( 0 )
+, m_iNumTransfersInFlight( 0 )
+, m_bIndexChanged( false )
+, m_bWaitingForTransfers( false )
 {
+	AKPLATFORM::AkClearEvent( m_eventIOThreadWake );
 }
 
 CAkDeviceBlocking::~CAkDeviceBlocking( )
 {
 }
 
+// Init.
+AKRESULT CAkDeviceBlocking::Init( 
+	const AkDeviceSettings &	in_settings,
+	const AkDeviceSettingsEx &	in_settingsEx,
+	AkDeviceID					in_deviceID 
+	)
+{
+	if ( in_settingsEx.uNumIOWorkers > AK_MAX_IO_WORKERS )
+	{
+		AKASSERT( !"Invalid number of I/O workers" );
+		return AK_InvalidParameter;
+	}
+
+	// Workers must exist before the I/O thread starts scheduling.
+	// With 0 or 1 worker, the I/O thread performs transfers itself.
+	if ( in_settingsEx.uNumIOWorkers > 1 )
+	{
+		AKRESULT eResult = CreateWorkers( in_settingsEx.uNumIOWorkers, in_settings.threadProperties );
+		if ( eResult != AK_Success )
+			return eResult;
+	}
+
+	return CAkDeviceBase::Init( in_settings, in_settingsEx, in_deviceID );
+}
+
+// Destroy.
+void CAkDeviceBlocking::Destroy()
+{
+	// Stop the I/O thread first: it destroys all streams, after workers have completed their transfers.
+	CAkIOThread::Term();
+	StopWorkers();
+	CAkDeviceBase::Destroy();
+}
+
 
 // Stream creation interface.
 // --------------------------------------------------------
@@ -65,9 +104,11 @@ CAkStmTask * CAkDeviceBlocking::CreateStd(
         eResult = AK_InsufficientMemory;
 	}
 
+    if ( AK_Success == eResult )
+    	eResult = AddTask( pNewStm );
+
     if ( AK_Success == eResult )
 	{
-		AddTask( pNewStm );
 		out_pStream = pNewStm;
 		return pNewStm;
 	}
@@ -131,9 +172,11 @@ CAkStmTask * CAkDeviceBlocking::CreateAuto(
 		eResult = AK_InsufficientMemory;
 	}
 	
+    if ( AK_Success == eResult )
+    	eResult = AddTask( pNewStm );
+
     if ( AK_Success == eResult )
     {
-		AddTask( pNewStm );
 		out_pStream = pNewStm;
 		return pNewStm;
 	}
@@ -155,8 +198,15 @@ CAkStmTask * CAkDeviceBlocking::CreateAuto(
 // Finds the next task to be executed,
 // posts the request to Low-Level IO and blocks until it is completed,
 // updates the task.
+// With I/O workers, transfers are executed by the workers instead.
 void CAkDeviceBlocking::PerformIO()
 {
+	if ( m_uNumWorkers > 0 )
+	{
+		DispatchTransfers();
+		return;
+	}
+
     void * pBuffer;
 	AkReal32 fOpDeadline;
 
@@ -217,16 +267,16 @@ void CAkDeviceBlocking::ExecuteTask(
 		return;
 	}
     AKASSERT( info.uRequestedSize > 0 &&
-    		  info.uRequestedSize <= m_uGranularity );
+    		  info.uRequestedSize <= info.uBufferSize );
 	info.uSizeTransferred = 0;
 
-	// Store current transfer position for conditional cancels.
-	m_uCurTransferPosition = info.uFilePosition;
-
 	AkIoHeuristics heuristics;
 	heuristics.priority = in_pTask->Priority();
 	heuristics.fDeadline = in_fOpDeadline;
 
+	AkInt64 iSubmitTime;
+	AKPLATFORM::PerformanceCounter( &iSubmitTime );
+
     // Read or write?
     if ( in_pTask->IsWriteOp( ) )
     {
@@ -247,6 +297,14 @@ void CAkDeviceBlocking::ExecuteTask(
             info );
     }
 
+	// Feed the I/O model.
+	if ( eResult == AK_Success )
+	{
+		AkInt64 iNow;
+		AKPLATFORM::PerformanceCounter( &iNow );
+		AddTransferSample( info.uSizeTransferred, AKPLATFORM::Elapsed( iNow, iSubmitTime ) );
+	}
+
     // Monitor errors.
 #ifndef AK_OPTIMIZED
     if ( eResult != AK_Success )
@@ -266,6 +324,245 @@ void CAkDeviceBlocking::ExecuteTask(
 
 }
 
+// I/O workers.
+// -------------------------------------------------------------------
+
+CAkDeviceBlocking::AkIOWorker::AkIOWorker()
+: pDevice( NULL )
+, uFirst( 0 )
+, uNumQueued( 0 )
+, uLoad( 0 )
+, bStop( false )
+{
+	AKPLATFORM::AkClearThread( &hThread );
+	AKPLATFORM::AkClearEvent( eventWork );
+}
+
+// Creates worker threads. 
+// Workers that were created are destroyed by StopWorkers(), even if this fails.
+AKRESULT CAkDeviceBlocking::CreateWorkers(
+	AkUInt32					in_uNumWorkers,		// Number of worker threads.
+	const AkThreadProperties &	in_threadProperties	// Thread properties.
+	)
+{
+	AKASSERT( m_uNumWorkers == 0 && in_uNumWorkers <= AK_MAX_IO_WORKERS );
+
+	if ( AKPLATFORM::AkCreateEvent( m_eventIOThreadWake ) != AK_Success )
+		return AK_Fail;
+
+	while ( m_uNumWorkers < in_uNumWorkers )
+	{
+		AkIOWorker * pWorker;
+		AkNew2( pWorker, CAkStreamMgr::GetObjPoolID(), AkIOWorker, AkIOWorker() );
+		if ( !pWorker )
+		{
+			// StopWorkers() destroys the wake event only if there are workers.
+			if ( m_uNumWorkers == 0 )
+				AKPLATFORM::AkDestroyEvent( m_eventIOThreadWake );
+			return AK_InsufficientMemory;
+		}
+		pWorker->pDevice = this;
+		m_arWorkers[m_uNumWorkers++] = pWorker;
+
+		if ( AKPLATFORM::AkCreateEvent( pWorker->eventWork ) != AK_Success )
+			return AK_Fail;
+
+		AKPLATFORM::AkCreateThread( 
+			WorkerThreadFunc,
+			pWorker,
+			in_threadProperties,
+			&pWorker->hThread,
+			"AK::IOWorker" );
+		if ( !AKPLATFORM::AkIsValidThread( &pWorker->hThread ) )
+		{
+			AKASSERT( !"Could not create I/O worker thread" );
+			return AK_Fail;
+		}
+	}
+	return AK_Success;
+}
+
+// Stops worker threads once they have executed all their transfers, and destroys them.
+void CAkDeviceBlocking::StopWorkers()
+{
+	// Nothing was created with 0 or 1 worker.
+	if ( m_uNumWorkers == 0 )
+		return;
+
+	for ( AkUInt32 uWorker = 0; uWorker < m_uNumWorkers; ++uWorker )
+	{
+		AkIOWorker * pWorker = m_arWorkers[uWorker];
+		if ( AKPLATFORM::AkIsValidThread( &pWorker->hThread ) )
+		{
+			{
+				AkAutoLock<CAkLock> queue( pWorker->lockQueue );
+				pWorker->bStop = true;
+			}
+			AKPLATFORM::AkSignalEvent( pWorker->eventWork );
+			AKPLATFORM::AkWaitForSingleThread( &pWorker->hThread );
+			AKPLATFORM::AkCloseThread( &pWorker->hThread );
+		}
+		AKASSERT( pWorker->uNumQueued == 0 );
+		AKPLATFORM::AkDestroyEvent( pWorker->eventWork );
+		AkDelete2( CAkStreamMgr::GetObjPoolID(), AkIOWorker, pWorker );
+	}
+	m_uNumWorkers = 0;
+	AKPLATFORM::AkDestroyEvent( m_eventIOThreadWake );
+}
+
+// Schedules as many transfers as workers can take, and pushes each of them to the least loaded worker.
+// If nothing can be scheduled while transfers are in flight, waits until one completes or until the 
+// scheduling status of a task changes: claimed tasks cannot be chosen nor destroyed until a transfer 
+// completes, but new work must not wait for it.
+void CAkDeviceBlocking::DispatchTransfers()
+{
+	{
+		AkAutoLock<CAkLock> index( m_lockSchedIndex );
+		m_bIndexChanged = false;
+	}
+
+	AkUInt32 uNumTransfers = 0;
+	AkInt32 iNumFree = (AkInt32)( m_uNumWorkers * AK_IO_WORKER_QUEUE_SIZE ) - m_iNumTransfersInFlight;
+	if ( iNumFree > 0 )
+	{
+		uNumTransfers = SchedulerFindNextTasks( m_arScheduledTransfers, (AkUInt32)iNumFree, true );
+
+		for ( AkUInt32 uTransfer = 0; uTransfer < uNumTransfers; ++uTransfer )
+		{
+			AKASSERT( m_arScheduledTransfers[uTransfer].pBuffer );	// If scheduler chose a task, it must have provided a valid buffer.
+
+			// Find least loaded worker. Loads only decrease behind our back.
+			AkIOWorker * pWorker = m_arWorkers[0];
+			for ( AkUInt32 uWorker = 1; uWorker < m_uNumWorkers; ++uWorker )
+			{
+				if ( m_arWorkers[uWorker]->uLoad < pWorker->uLoad )
+					pWorker = m_arWorkers[uWorker];
+			}
+
+			AKPLATFORM::AkInterlockedIncrement( &m_iNumTransfersInFlight );
+			{
+				AkAutoLock<CAkLock> queue( pWorker->lockQueue );
+				AKASSERT( pWorker->uNumQueued < AK_IO_WORKER_QUEUE_SIZE );
+				pWorker->arQueue[ ( pWorker->uFirst + pWorker->uNumQueued ) % AK_IO_WORKER_QUEUE_SIZE ] = m_arScheduledTransfers[uTransfer];
+				++pWorker->uNumQueued;
+				++pWorker->uLoad;
+			}
+			AKPLATFORM::AkSignalEvent( pWorker->eventWork );
+		}
+	}
+
+	if ( uNumTransfers == 0 
+		&& m_iNumTransfersInFlight > 0 )
+	{
+		{
+			// Tasks that were reindexed during this pass may be ready now: schedule again without waiting.
+			AkAutoLock<CAkLock> index( m_lockSchedIndex );
+			if ( m_bIndexChanged )
+				return;
+			m_bWaitingForTransfers = true;
+		}
+
+		AKPLATFORM::AkWaitForEvent( m_eventIOThreadWake );
+
+		AkAutoLock<CAkLock> index( m_lockSchedIndex );
+		m_bWaitingForTransfers = false;
+	}
+}
+
+// Wakes the I/O thread if it waits for in-flight transfers: the task that changed may need to be scheduled.
+// Sync: Index lock.
+void CAkDeviceBlocking::OnSchedulingIndexChange()
+{
+	m_bIndexChanged = true;
+	if ( m_bWaitingForTransfers )
+		AKPLATFORM::AkSignalEvent( m_eventIOThreadWake );
+}
+
+// Gets the next transfer of a worker: the oldest of its own queue or, if it is empty, the oldest of the 
+// most loaded worker (work stealing). The load of the worker that executes it is incremented.
+// Returns false if there is none.
+bool CAkDeviceBlocking::PopTransfer(
+	AkIOWorker *				in_pWorker,			// Worker.
+	AkStmScheduledTransfer &	out_transfer		// Returned transfer.
+	)
+{
+	{
+		AkAutoLock<CAkLock> queue( in_pWorker->lockQueue );
+		if ( in_pWorker->uNumQueued > 0 )
+		{
+			out_transfer = in_pWorker->arQueue[in_pWorker->uFirst];
+			in_pWorker->uFirst = ( in_pWorker->uFirst + 1 ) % AK_IO_WORKER_QUEUE_SIZE;
+			--in_pWorker->uNumQueued;
+			return true;
+		}
+	}
+
+	// Own queue is empty: steal.
+	AkIOWorker * pVictim = NULL;
+	for ( AkUInt32 uWorker = 0; uWorker < m_uNumWorkers; ++uWorker )
+	{
+		AkIOWorker * pWorker = m_arWorkers[uWorker];
+		if ( pWorker != in_pWorker 
+			&& pWorker->uNumQueued > 0
+			&& ( !pVictim || pWorker->uNumQueued > pVictim->uNumQueued ) )
+		{
+			pVictim = pWorker;
+		}
+	}
+	if ( !pVictim )
+		return false;
+
+	{
+		AkAutoLock<CAkLock> queue( pVictim->lockQueue );
+		if ( pVictim->uNumQueued == 0 )
+			return false;	// Executed by its owner in the meantime.
+		out_transfer = pVictim->arQueue[pVictim->uFirst];
+		pVictim->uFirst = ( pVictim->uFirst + 1 ) % AK_IO_WORKER_QUEUE_SIZE;
+		--pVictim->uNumQueued;
+		--pVictim->uLoad;
+	}
+	{
+		AkAutoLock<CAkLock> queue( in_pWorker->lockQueue );
+		++in_pWorker->uLoad;
+	}
+	return true;
+}
+
+// Worker thread: executes transfers until it is stopped.
+AK_DECLARE_THREAD_ROUTINE( CAkDeviceBlocking::WorkerThreadFunc )
+{
+	AkIOWorker * pWorker = AK_GET_THREAD_ROUTINE_PARAMETER_PTR( AkIOWorker );
+	CAkDeviceBlocking * pDevice = pWorker->pDevice;
+
+	for (;;)
+	{
+		AkStmScheduledTransfer transfer;
+		if ( pDevice->PopTransfer( pWorker, transfer ) )
+		{
+			pDevice->ExecuteTask( transfer.pTask, transfer.pBuffer, transfer.fOpDeadline );
+
+			// The task may be destroyed as soon as its claim is released.
+			pDevice->ReleaseTaskClaim( transfer.pTask );
+			{
+				AkAutoLock<CAkLock> queue( pWorker->lockQueue );
+				--pWorker->uLoad;
+			}
+			AKPLATFORM::AkInterlockedDecrement( &pDevice->m_iNumTransfersInFlight );
+			AKPLATFORM::AkSignalEvent( pDevice->m_eventIOThreadWake );
+			continue;
+		}
+
+		{
+			AkAutoLock<CAkLock> queue( pWorker->lockQueue );
+			if ( pWorker->bStop && pWorker->uNumQueued == 0 )
+				break;
+		}
+		AKPLATFORM::AkWaitForEvent( pWorker->eventWork );
+	}
+
+	AkExitThread( AK_RETURN_THREAD_OK );
+}
+
 //-----------------------------------------------------------------------------
 // Name: class CAkStdStmBlocking
 // Desc: Standard stream implementation.
@@ -470,12 +767,16 @@ bool CAkAutoStmBlocking::TransferInfo(
 		return false;
 
 	// Required transfer size is the buffer size for this stream.
-    // Slice request to granularity.
-	if ( m_uBufferSize > m_pDevice->GetGranularity( ) )
-        out_uBufferSize = m_pDevice->GetGranularity( );
-    else
-        out_uBufferSize = m_uBufferSize;
+	// Note: Buffers are allocated to the size of each stream, so requests are not sliced to granularity.
+	out_uBufferSize = m_uBufferSize;
 
+	// Speculative transfer: prefetch data at a likely seek target into the segment cache. It is neither 
+	// a pending transfer nor counted as buffering.
+	if ( GetSpeculativeTransfer( out_uPosition, out_uRequestSize ) )
+	{
+		m_bTransferInProgress = true;
+		return true;
+	}
 	
 	// Compute (absolute) file position for transfer.
 	
@@ -494,18 +795,19 @@ bool CAkAutoStmBlocking::TransferInfo(
 
 	// "Enqueue" new transfer request.
 	out_uRequestSize = PushTransferRequest( out_uPosition, out_uBufferSize );
+	m_uCurTransferPosition = out_uPosition;
 	AKASSERT( out_uRequestSize > 0 );
 #ifdef _DEBUG
 	m_uExpectedTransferSize = out_uRequestSize;
 #endif
 
+	// Reset timer. Time count since last transfer starts now.
+    m_iIOStartTime = m_pDevice->GetTime();
+
 	// Update status.
 	m_uVirtualBufferingSize += out_uRequestSize;
 	UpdateSchedulingStatus();
 
-	// Reset timer. Time count since last transfer starts now.
-    m_iIOStartTime = m_pDevice->GetTime();
-
 	m_bTransferInProgress = true;
 
 	return true;
@@ -523,6 +825,15 @@ void CAkAutoStmBlocking::Update(
 	// Lock status.
     AkAutoLock<CAkLock> update( m_lockStatus );
 
+	// Speculative transfer: its data goes to the segment cache. I/O errors do not affect the stream.
+	if ( in_pCookie && m_bSpeculating )
+	{
+		OnSpeculativeTransferDone( in_uPosition, in_pBuffer, in_uActualIOSize, AK_Success == in_eIOResult );
+		m_bTransferInProgress = false;
+		UpdateSchedulingStatus();
+		return;
+	}
+
 	bool bStoreData = ( AK_Success == in_eIOResult 
 						&& m_bHasTransferPending
 						&& ( in_uPosition + in_uActualIOSize ) >= m_uExpectedFilePosition );
@@ -548,7 +859,9 @@ void CAkAutoStmBlocking::Update(
 
 // Try to remove a buffer from this stream's list of buffers. Fails if user owns them all.
 // Sync: Status.
-void * CAkAutoStmBlocking::PopIOBuffer( )
+void * CAkAutoStmBlocking::PopIOBuffer(
+	AkUInt32	in_uBufferSize		// Size of the buffer required by the task chosen for I/O.
+	)
 {
     // Lock status.
     AkAutoLock<CAkLock> stmBufferGate( m_lockStatus );
@@ -559,7 +872,7 @@ void * CAkAutoStmBlocking::PopIOBuffer( )
     m_pDevice->Lock();
 
     // Now that memory is locked, try to get a buffer again.
-    void * pBuffer = AK::MemoryMgr::GetBlock( m_pDevice->GetIOPoolID() );
+    void * pBuffer = m_pDevice->GetIOMemMgr().Alloc( in_uBufferSize );
 
     if ( pBuffer )
     {
@@ -568,6 +881,15 @@ void * CAkAutoStmBlocking::PopIOBuffer( )
         return pBuffer;
     }
 
+	// Give away data of the segment cache first: it does not count as buffering.
+	pBuffer = PopCachedBuffer();
+	if ( pBuffer )
+	{
+		pBuffer = m_pDevice->ReassignIOBuffer( pBuffer, in_uBufferSize );
+		m_pDevice->Unlock();
+		return pBuffer;
+	}
+
 	// In a blocking device, there cannot be a transfer pending for this task while the 
 	// scheduler is trying to pop a buffer.
 	AKASSERT( !m_bTransferInProgress );
@@ -577,9 +899,11 @@ void * CAkAutoStmBlocking::PopIOBuffer( )
 	// 1) All buffers are already granted to client.
 	// 2) Removing a buffer would take this stream under target buffering.
 
-	if ( m_listBuffers.IsEmpty() )
+	if ( m_listBuffers.IsEmpty() 
+		|| IsInRing( m_listBuffers.Last()->pBuffer ) )
 	{
-		// This task cannot let a buffer go. Notify scheduler that memory is blocked for a while.
+		// This task cannot let a buffer go (buffers of its ring are reserved to it). 
+		// Notify scheduler that memory is blocked for a while.
 		m_pDevice->NotifyMemIdle();
 		m_pDevice->Unlock();
 		return NULL;
@@ -595,6 +919,8 @@ void * CAkAutoStmBlocking::PopIOBuffer( )
 		
 		// Remove a buffer from the buffers list.
 		m_uVirtualBufferingSize -= uSizeToRemove;
+		AKASSERT( m_uAvailableDataSize >= uSizeToRemove );
+		m_uAvailableDataSize -= uSizeToRemove;
 
 		AkStmBuffer * pLastStmBuffer = m_listBuffers.Last();
         pBuffer = pLastStmBuffer->pBuffer;
@@ -605,6 +931,9 @@ void * CAkAutoStmBlocking::PopIOBuffer( )
 
 		// Update status: Correct position. Reset EOF flag and restart if necessary.
 		UpdateSchedulingStatus();
+
+		// Exchange buffer if it is not of the required size.
+		pBuffer = m_pDevice->ReassignIOBuffer( pBuffer, in_uBufferSize );
     }
     else
     {
@@ -665,7 +994,7 @@ void CAkAutoStmBlocking::CancelPendingTransfers(
 {
 	if ( m_bHasTransferPending )
 	{
-		if ( ((CAkDeviceBlocking*)(m_pDevice))->CurTransferPosition() >= in_uMaxKeepPosition 
+		if ( m_uCurTransferPosition >= in_uMaxKeepPosition 
 			|| m_uExpectedFilePosition < in_uMaxKeepPosition )
 		{
 			m_bHasTransferPending = false;
@@ -692,6 +1021,7 @@ void CAkAutoStmBlocking::CheckVirtualBufferingConsistency()
 {
 	AkUInt32 uVirtualBuffering = 0;
 	AkUInt32 uNumGranted = m_uNextToGrant;
+	AkUInt32 uGrantedSize = 0;
 	
 	AkBufferList::Iterator it = m_listBuffers.Begin();
 	while ( it != m_listBuffers.End() )
@@ -699,10 +1029,15 @@ void CAkAutoStmBlocking::CheckVirtualBufferingConsistency()
 		if ( uNumGranted == 0 ) // Skip buffers granted.
 			uVirtualBuffering += (*it)->uDataSize;
 		else 
+		{
+			uGrantedSize += (*it)->uDataSize;
 			uNumGranted--;
+		}
 		
 		++it;
 	}
+	AKASSERT( uVirtualBuffering == m_uAvailableDataSize 
+			&& uGrantedSize == m_uGrantedDataSize );
 	uVirtualBuffering += m_uExpectedTransferSize;
 	AKASSERT( uVirtualBuffering == m_uVirtualBufferingSize );
 }
@@ -12,6 +12,11 @@
 
 #include "AkDeviceBase.h"
 
+// Maximum number of I/O worker threads of a blocking device (AkDeviceSettingsEx::uNumIOWorkers).
+#define AK_MAX_IO_WORKERS			(16)
+// Number of transfers that may be queued or executing on each worker.
+#define AK_IO_WORKER_QUEUE_SIZE		(2)
+
 namespace AK
 {
 namespace StreamMgr
@@ -20,6 +25,10 @@ namespace StreamMgr
     //-----------------------------------------------------------------------------
     // Name: CAkDeviceBlocking
     // Desc: Implementation of the Blocking Scheduler device.
+    //       With more than one I/O worker (AkDeviceSettingsEx::uNumIOWorkers), the I/O
+    //       thread only schedules transfers: chosen tasks are claimed and pushed to
+    //       the local queue of the least loaded worker. Workers execute transfers of 
+    //       their own queue, and steal from the most loaded worker when it is empty.
     //-----------------------------------------------------------------------------
     class CAkDeviceBlocking : public CAkDeviceBase
     {
@@ -30,6 +39,13 @@ namespace StreamMgr
 			);
         virtual ~CAkDeviceBlocking();
 
+		virtual AKRESULT	Init( 
+			const AkDeviceSettings &	in_settings,
+			const AkDeviceSettingsEx &	in_settingsEx,
+			AkDeviceID					in_deviceID 
+			);
+		virtual void		Destroy();
+
 		// Stream creation interface.
         // --------------------------------------------------------
 
@@ -49,11 +65,6 @@ namespace StreamMgr
 			IAkAutoStream *&            out_pStream         // Returned interface to an automatic stream.
             );
 
-		inline AkUInt64 CurTransferPosition()
-		{
-			return m_uCurTransferPosition;
-		}
-
     protected:
 
         // This device's implementation of PerformIO().
@@ -66,8 +77,56 @@ namespace StreamMgr
 			AkReal32		in_fOpDeadline
             );
 
+		// I/O workers.
+		// ---------------------------------
+
+		// Worker thread and its local queue of transfers.
+		struct AkIOWorker
+		{
+			AkIOWorker();
+
+			CAkDeviceBlocking *		pDevice;		// Owner device.
+			AkThread				hThread;		// Worker thread.
+			AkEvent					eventWork;		// Signaled when a transfer is queued, or when the worker must stop.
+			CAkLock					lockQueue;		// Protects the queue, uLoad and bStop.
+			AkStmScheduledTransfer	arQueue[AK_IO_WORKER_QUEUE_SIZE];	// Ring buffer of transfers waiting to be executed.
+			AkUInt32				uFirst;			// Position of the oldest queued transfer.
+			AkUInt32				uNumQueued;		// Number of queued transfers.
+			AkUInt32				uLoad;			// Number of queued transfers, plus the one being executed.
+			bool					bStop;			// Worker thread exits once its queue is empty.
+		};
+
+		// Creates/stops worker threads.
+		AKRESULT CreateWorkers(
+			AkUInt32					in_uNumWorkers,		// Number of worker threads.
+			const AkThreadProperties &	in_threadProperties	// Thread properties.
+			);
+		void StopWorkers();
+
+		// Schedules transfers and sends them to the workers.
+		void DispatchTransfers();
+
+		// Wakes the I/O thread if it waits for in-flight transfers.
+		// Sync: Index lock.
+		virtual void OnSchedulingIndexChange();
+
+		// Gets the next transfer of a worker, from its own queue or from the most loaded worker.
+		// Returns false if there is none.
+		bool PopTransfer(
+			AkIOWorker *				in_pWorker,			// Worker.
+			AkStmScheduledTransfer &	out_transfer		// Returned transfer.
+			);
+
+		static AK_DECLARE_THREAD_ROUTINE( WorkerThreadFunc );
+
 	protected:
-		AkUInt64 m_uCurTransferPosition;
+		AkIOWorker *			m_arWorkers[AK_MAX_IO_WORKERS];
+		AkUInt32				m_uNumWorkers;			// Number of worker threads. 0 when the I/O thread performs transfers itself.
+		AkEvent					m_eventIOThreadWake;	// Signaled by workers every time they complete a transfer, and by tasks whose scheduling status changes while the I/O thread waits for transfers.
+		bool					m_bIndexChanged;		// A task was reindexed since the beginning of the last scheduler pass. Protected by index lock.
+		bool					m_bWaitingForTransfers;	// The I/O thread waits on m_eventIOThreadWake. Protected by index lock.
+		AkInt32					m_iNumTransfersInFlight;// Transfers that were sent to workers and were not completed yet.
+		AkStmScheduledTransfer	m_arScheduledTransfers[AK_MAX_IO_WORKERS * AK_IO_WORKER_QUEUE_SIZE];	// Transfers chosen by the scheduler in one pass.
     };
 
 	//-----------------------------------------------------------------------------
@@ -170,7 +229,9 @@ namespace StreamMgr
 		// Automatic stream specific. 
         // For buffer reassignment. The scheduler calls this if there is no memory available and it considers
         // that this task could give away some of its buffers.
-        virtual void * PopIOBuffer();
+        virtual void * PopIOBuffer(
+			AkUInt32	in_uBufferSize		// Size of the buffer required by the task chosen for I/O.
+			);
 
 		// Returns the file position after the one and only valid (non cancelled) pending transfer. 
 		// If there is no transfer pending, then it is the position at the end of buffering.
@@ -200,6 +261,7 @@ namespace StreamMgr
 
 	protected:
 		AkUInt64			m_uExpectedFilePosition;
+		AkUInt64			m_uCurTransferPosition;	// Position of the transfer in progress (for conditional cancels).
 		// Note: there is a slight difference between these 2 flags. Both are set to true as soon as 
 		// a transfer was prepared. m_bTransferInProgress is always reset in Update() only, whereas 
 		// m_bHasTransferPending may be reset if the transfer is cancelled, and is used to determine
@@ -27,6 +27,14 @@ CAkDeviceDeferredLinedUp::CAkDeviceDeferredLinedUp(
 	)
 : CAkDeviceDeferredLinedUpBase( in_pLowLevelHook )
 , m_pXferObjMem( NULL )
+, m_arScheduledTransfers( NULL )
+, m_arBatchTransfers( NULL )
+, m_arCoalescing( NULL )
+, m_uMaxCoalescedSize( 0 )
+, m_uMaxCoalescingMemSize( 0 )
+, m_uCoalescingMemSize( 0 )
+, m_uCoalescingGap( 0 )
+, m_pBatchHook( NULL )
 {
 }
 
@@ -36,6 +44,7 @@ CAkDeviceDeferredLinedUp::~CAkDeviceDeferredLinedUp( )
 
 AKRESULT CAkDeviceDeferredLinedUp::Init( 
 	const AkDeviceSettings &	in_settings,
+	const AkDeviceSettingsEx &	in_settingsEx,
 	AkDeviceID					in_deviceID 
 	)
 {
@@ -46,7 +55,7 @@ AKRESULT CAkDeviceDeferredLinedUp::Init(
 		return AK_InvalidParameter;
 	}
 
-	AKRESULT eResult = CAkDeviceBase::Init( in_settings, in_deviceID );
+	AKRESULT eResult = CAkDeviceBase::Init( in_settings, in_settingsEx, in_deviceID );
 	if ( AK_Success == eResult )
 	{
 		// Cache all transfer objects needed.
@@ -62,6 +71,35 @@ AKRESULT CAkDeviceDeferredLinedUp::Init(
 			m_listFreeTransferObjs.AddFirst( pXferObj++ );
 		}
 		while ( pXferObj < pXferObjEnd );
+		m_uNumFreeTransferObjs = in_settings.uMaxConcurrentIO;
+
+		m_arScheduledTransfers = (AkStmScheduledTransfer*)AkAlloc( CAkStreamMgr::GetObjPoolID(), in_settings.uMaxConcurrentIO * sizeof( AkStmScheduledTransfer ) );
+		if ( !m_arScheduledTransfers )
+			return AK_Fail;
+
+		// Use the Low-Level IO's batch interface if it was registered.
+		m_pBatchHook = in_settingsEx.pBatchHook;
+
+		// Coalescing requires I/O memory for its reads.
+		if ( in_settingsEx.uMaxCoalescedSize > 0 
+			&& m_streamIOPoolId != AK_INVALID_POOL_ID )
+		{
+			m_arCoalescing = (AkUInt32*)AkAlloc( CAkStreamMgr::GetObjPoolID(), in_settings.uMaxConcurrentIO * sizeof( AkUInt32 ) );
+			if ( !m_arCoalescing )
+				return AK_Fail;
+			m_uMaxCoalescedSize = AkMin( in_settingsEx.uMaxCoalescedSize, m_ioMemMgr.GetMaxAllocSize() );
+			// Buffers of coalesced transfers are bounded to one block that can hold the largest of them.
+			m_uMaxCoalescingMemSize = m_ioMemMgr.GetAllocSize( m_uMaxCoalescedSize );
+			m_uCoalescingGap = in_settingsEx.uCoalescingGap;
+		}
+
+		// Transfers of a pass are prepared together if they are sent in a batch, or coalesced.
+		if ( m_pBatchHook || m_arCoalescing )
+		{
+			m_arBatchTransfers = (AkAsyncIOBatchTransfer*)AkAlloc( CAkStreamMgr::GetObjPoolID(), in_settings.uMaxConcurrentIO * sizeof( AkAsyncIOBatchTransfer ) );
+			if ( !m_arBatchTransfers )
+				return AK_Fail;
+		}
 	}
 	return AK_Success;
 }
@@ -73,9 +111,16 @@ void CAkDeviceDeferredLinedUp::Destroy()
 	if ( m_pXferObjMem )
 	{
 		m_listFreeTransferObjs.RemoveAll();
+		m_uNumFreeTransferObjs = 0;
 		AkFree( CAkStreamMgr::GetObjPoolID(), m_pXferObjMem );
 	}
 	m_listFreeTransferObjs.Term();
+	if ( m_arScheduledTransfers )
+		AkFree( CAkStreamMgr::GetObjPoolID(), m_arScheduledTransfers );
+	if ( m_arBatchTransfers )
+		AkFree( CAkStreamMgr::GetObjPoolID(), m_arBatchTransfers );
+	if ( m_arCoalescing )
+		AkFree( CAkStreamMgr::GetObjPoolID(), m_arCoalescing );
 	CAkDeviceBase::Destroy();
 }
 
@@ -115,9 +160,11 @@ CAkStmTask * CAkDeviceDeferredLinedUp::CreateStd(
         eResult = AK_InsufficientMemory;
 	}
 
+    if ( AK_Success == eResult )
+    	eResult = AddTask( pNewStm );
+
     if ( AK_Success == eResult )
 	{
-        AddTask( pNewStm );
 		out_pStream = pNewStm;
 		return pNewStm;
 	}
@@ -181,9 +228,11 @@ CAkStmTask * CAkDeviceDeferredLinedUp::CreateAuto(
 		eResult = AK_InsufficientMemory;
 	}
 
+	if ( AK_Success == eResult )
+		eResult = AddTask( pNewStm );
+
 	if ( AK_Success == eResult )
 	{
-		AddTask( pNewStm );
         out_pStream = pNewStm;
 		return pNewStm;
 	}
@@ -201,21 +250,37 @@ CAkStmTask * CAkDeviceDeferredLinedUp::CreateAuto(
 }
 
 // This device's implementation of PerformIO(), called by the I/O thread.
+// As many transfers as there are free transfer objects are scheduled in one pass, then posted to the
+// Low-Level IO back-to-back.
 void CAkDeviceDeferredLinedUp::PerformIO( )
 {
-    void * pBuffer;
-	AkReal32 fOpDeadline;
-    CAkStmTask * pTask = SchedulerFindNextTask( pBuffer, fOpDeadline );
+	AkUInt32 uMaxTransfers;
+	{
+		AkAutoLock<CAkIOThread> transferCache( *this );
+		uMaxTransfers = m_uNumFreeTransferObjs;
+	}
+	if ( !uMaxTransfers )
+		return;
 
-    if ( pTask )
-    {
-        AKASSERT( pBuffer );    // If scheduler chose a task, it must have provided a valid buffer.
-        
-        // Post task to Low-Level IO.
-        ExecuteTask( pTask, 
-                     pBuffer,
-					 fOpDeadline );
-    }
+	AkUInt32 uNumTransfers = SchedulerFindNextTasks( m_arScheduledTransfers, uMaxTransfers );
+
+	if ( m_arBatchTransfers )
+	{
+		ExecuteTasksBatched( uNumTransfers );
+		return;
+	}
+
+	// The Low-Level IO does not support batches: send transfers one by one.
+	for ( AkUInt32 uTransfer = 0; uTransfer < uNumTransfers; ++uTransfer )
+	{
+		AkStmScheduledTransfer & transfer = m_arScheduledTransfers[uTransfer];
+		AKASSERT( transfer.pBuffer );    // If scheduler chose a task, it must have provided a valid buffer.
+
+		// Post task to Low-Level IO.
+		ExecuteTask( transfer.pTask, 
+					 transfer.pBuffer,
+					 transfer.fOpDeadline );
+	}
 }
 
 // Execute task chosen by scheduler.
@@ -224,6 +289,307 @@ void CAkDeviceDeferredLinedUp::ExecuteTask(
     void *			in_pBuffer,
 	AkReal32		in_fOpDeadline
     )
+{
+	AkAsyncIOBatchTransfer transfer;
+	if ( !PrepareTransfer( in_pTask, in_pBuffer, in_fOpDeadline, transfer ) )
+		return;
+    
+    // Read or write?
+    if ( in_pTask->IsWriteOp( ) )
+    {
+        // Write.
+        transfer.eResult = static_cast<IAkIOHookDeferred*>( m_pLowLevelHook )->Write( 
+            *transfer.pFileDesc, 
+			transfer.heuristics, 
+			*transfer.pTransferInfo );
+    }
+    else
+    {
+        // Read.
+        transfer.eResult = static_cast<IAkIOHookDeferred*>( m_pLowLevelHook )->Read( 
+			*transfer.pFileDesc, 
+			transfer.heuristics, 
+			*transfer.pTransferInfo );
+    }
+
+	OnTransferSubmitted( in_pTask, in_pBuffer, transfer );
+}
+
+// Execute tasks chosen by scheduler in one pass: transfers are all prepared, coalesced if applicable, then
+// sent to the Low-Level IO using its batch interface if it supports it.
+// Consecutive transfers of the same direction are sent together, in the order chosen by the scheduler.
+void CAkDeviceDeferredLinedUp::ExecuteTasksBatched(
+	AkUInt32		in_uNumTransfers	// Number of transfers in m_arScheduledTransfers.
+	)
+{
+	// Prepare all transfers. Those that cannot be sent are dropped, and the others are packed so that
+	// m_arBatchTransfers[i] corresponds to m_arScheduledTransfers[i].
+	AkUInt32 uNumPrepared = 0;
+	for ( AkUInt32 uTransfer = 0; uTransfer < in_uNumTransfers; ++uTransfer )
+	{
+		AkStmScheduledTransfer & scheduled = m_arScheduledTransfers[uTransfer];
+		AKASSERT( scheduled.pBuffer );    // If scheduler chose a task, it must have provided a valid buffer.
+		if ( PrepareTransfer( scheduled.pTask, scheduled.pBuffer, scheduled.fOpDeadline, m_arBatchTransfers[uNumPrepared] ) )
+			m_arScheduledTransfers[uNumPrepared++] = scheduled;
+	}
+
+	if ( m_arCoalescing 
+		&& uNumPrepared > 1 )
+		uNumPrepared = CoalesceTransfers( uNumPrepared );
+
+	AkUInt32 uFirst = 0;
+	while ( uFirst < uNumPrepared )
+	{
+		bool bIsWrite = m_arScheduledTransfers[uFirst].pTask->IsWriteOp();
+		AkUInt32 uEnd = uFirst + 1;
+		while ( uEnd < uNumPrepared 
+				&& m_arScheduledTransfers[uEnd].pTask->IsWriteOp() == bIsWrite )
+			++uEnd;
+
+		if ( m_pBatchHook )
+		{
+			if ( bIsWrite )
+				m_pBatchHook->BatchWrite( uEnd - uFirst, m_arBatchTransfers + uFirst );
+			else
+				m_pBatchHook->BatchRead( uEnd - uFirst, m_arBatchTransfers + uFirst );
+		}
+		else
+		{
+			IAkIOHookDeferred * pHook = static_cast<IAkIOHookDeferred*>( m_pLowLevelHook );
+			for ( AkUInt32 uTransfer = uFirst; uTransfer < uEnd; ++uTransfer )
+			{
+				AkAsyncIOBatchTransfer & transfer = m_arBatchTransfers[uTransfer];
+				if ( bIsWrite )
+					transfer.eResult = pHook->Write( *transfer.pFileDesc, transfer.heuristics, *transfer.pTransferInfo );
+				else
+					transfer.eResult = pHook->Read( *transfer.pFileDesc, transfer.heuristics, *transfer.pTransferInfo );
+			}
+		}
+
+		for ( AkUInt32 uTransfer = uFirst; uTransfer < uEnd; ++uTransfer )
+			OnTransferSubmitted( m_arScheduledTransfers[uTransfer].pTask, m_arScheduledTransfers[uTransfer].pBuffer, m_arBatchTransfers[uTransfer] );
+
+		uFirst = uEnd;
+	}
+}
+
+// Merges prepared reads on the same file whose ranges are adjacent, or apart by at most m_uCoalescingGap bytes,
+// into coalesced transfers. Reads may overlap (e.g. streams of the same sound). Writes are never merged.
+// m_arScheduledTransfers and m_arBatchTransfers are compacted. Returns the number of transfers left.
+AkUInt32 CAkDeviceDeferredLinedUp::CoalesceTransfers(
+	AkUInt32		in_uNumTransfers	// Number of prepared transfers in m_arBatchTransfers.
+	)
+{
+	for ( AkUInt32 uFirst = 0; uFirst < in_uNumTransfers; ++uFirst )
+	{
+		AkAsyncIOBatchTransfer & first = m_arBatchTransfers[uFirst];
+		if ( !first.pTransferInfo 
+			|| first.pTransferInfo->pCallback == CoalescedIOCallback
+			|| m_arScheduledTransfers[uFirst].pTask->IsWriteOp() )
+			continue;
+
+		// Gather reads on the same file that are left, sorted by position.
+		AkUInt32 uNumIndices = 0;
+		for ( AkUInt32 uTransfer = uFirst; uTransfer < in_uNumTransfers; ++uTransfer )
+		{
+			AkAsyncIOBatchTransfer & transfer = m_arBatchTransfers[uTransfer];
+			if ( !transfer.pTransferInfo 
+				|| transfer.pTransferInfo->pCallback == CoalescedIOCallback
+				|| transfer.pFileDesc->hFile != first.pFileDesc->hFile
+				|| m_arScheduledTransfers[uTransfer].pTask->IsWriteOp() )
+				continue;
+
+			AkUInt32 uInsert = uNumIndices++;
+			while ( uInsert > 0 
+					&& m_arBatchTransfers[m_arCoalescing[uInsert-1]].pTransferInfo->uFilePosition > transfer.pTransferInfo->uFilePosition )
+			{
+				m_arCoalescing[uInsert] = m_arCoalescing[uInsert-1];
+				--uInsert;
+			}
+			m_arCoalescing[uInsert] = uTransfer;
+		}
+
+		// Split them in runs of reads that are close enough, and merge runs.
+		AkUInt32 uRunStart = 0;
+		while ( uRunStart < uNumIndices )
+		{
+			const AkAsyncIOTransferInfo * pStart = m_arBatchTransfers[m_arCoalescing[uRunStart]].pTransferInfo;
+			AkUInt64 uRequestedEnd = pStart->uFilePosition + pStart->uRequestedSize;
+			AkUInt64 uBufferEnd = pStart->uFilePosition + pStart->uBufferSize;
+			AkUInt32 uRunEnd = uRunStart + 1;
+			while ( uRunEnd < uNumIndices )
+			{
+				const AkAsyncIOTransferInfo * pNext = m_arBatchTransfers[m_arCoalescing[uRunEnd]].pTransferInfo;
+				AkUInt64 uNextBufferEnd = AkMax( uBufferEnd, pNext->uFilePosition + pNext->uBufferSize );
+				if ( pNext->uFilePosition > uRequestedEnd + m_uCoalescingGap
+					|| uNextBufferEnd - pStart->uFilePosition > m_uMaxCoalescedSize )
+					break;
+				uRequestedEnd = AkMax( uRequestedEnd, pNext->uFilePosition + pNext->uRequestedSize );
+				uBufferEnd = uNextBufferEnd;
+				++uRunEnd;
+			}
+
+			if ( uRunEnd - uRunStart > 1 )
+				MergeTransfers( m_arCoalescing + uRunStart, uRunEnd - uRunStart );
+			uRunStart = uRunEnd;
+		}
+	}
+
+	// Compact.
+	AkUInt32 uNumLeft = 0;
+	for ( AkUInt32 uTransfer = 0; uTransfer < in_uNumTransfers; ++uTransfer )
+	{
+		if ( m_arBatchTransfers[uTransfer].pTransferInfo )
+		{
+			m_arScheduledTransfers[uNumLeft] = m_arScheduledTransfers[uTransfer];
+			m_arBatchTransfers[uNumLeft++] = m_arBatchTransfers[uTransfer];
+		}
+	}
+	return uNumLeft;
+}
+
+// Replaces prepared reads by a coalesced transfer, in the slot of the first one that was scheduled.
+// The others are removed (their transfer info is set to NULL). Returns false if it could not be created.
+// Data is read directly into the buffers of the merged transfers if they are contiguous. Otherwise the 
+// coalesced transfer gets its own buffer, within m_uMaxCoalescingMemSize.
+bool CAkDeviceDeferredLinedUp::MergeTransfers(
+	const AkUInt32 *	in_arIndices,	// Indices of transfers in m_arBatchTransfers, in file order.
+	AkUInt32		in_uNumIndices		// Number of transfers to merge.
+	)
+{
+	AKASSERT( in_uNumIndices > 1 );
+
+	AkUInt64 uStart = m_arBatchTransfers[in_arIndices[0]].pTransferInfo->uFilePosition;
+	AkUInt64 uRequestedEnd = 0;
+	AkUInt64 uBufferEnd = 0;
+	AkUInt32 uSlot = in_arIndices[0];
+	const AkUInt8 * pFirstBuffer = (const AkUInt8*)m_arBatchTransfers[in_arIndices[0]].pTransferInfo->pBuffer;
+	bool bIsDirect = true;
+	for ( AkUInt32 uIdx = 0; uIdx < in_uNumIndices; ++uIdx )
+	{
+		const AkAsyncIOTransferInfo * pInfo = m_arBatchTransfers[in_arIndices[uIdx]].pTransferInfo;
+
+		// Direct: each buffer starts where the previous one ends, in memory and in the file.
+		if ( uIdx > 0 
+			&& ( pInfo->uFilePosition != uBufferEnd 
+				|| (const AkUInt8*)pInfo->pBuffer != pFirstBuffer + ( pInfo->uFilePosition - uStart ) ) )
+			bIsDirect = false;
+
+		uRequestedEnd = AkMax( uRequestedEnd, pInfo->uFilePosition + pInfo->uRequestedSize );
+		uBufferEnd = AkMax( uBufferEnd, pInfo->uFilePosition + pInfo->uBufferSize );
+		uSlot = AkMin( uSlot, in_arIndices[uIdx] );
+	}
+
+	AkCoalescedTransfer * pCoalesced = (AkCoalescedTransfer*)AkAlloc( CAkStreamMgr::GetObjPoolID(), sizeof( AkCoalescedTransfer ) + ( in_uNumIndices - 1 ) * sizeof( AkAsyncIOTransferInfo* ) );
+	if ( !pCoalesced )
+		return false;
+
+	void * pBuffer = (void*)pFirstBuffer;
+	if ( !bIsDirect )
+	{
+		AkAutoLock<CAkIOThread> lock( *this );
+		AkUInt32 uAllocSize = m_ioMemMgr.GetAllocSize( (AkUInt32)( uBufferEnd - uStart ) );
+		pBuffer = NULL;
+		if ( uAllocSize > 0 
+			&& m_uCoalescingMemSize + uAllocSize <= m_uMaxCoalescingMemSize )
+		{
+			pBuffer = m_ioMemMgr.Alloc( uAllocSize );
+			if ( pBuffer )
+				m_uCoalescingMemSize += m_ioMemMgr.GetBlockSize( pBuffer );
+		}
+	}
+	if ( !pBuffer )
+	{
+		AkFree( CAkStreamMgr::GetObjPoolID(), pCoalesced );
+		return false;
+	}
+
+	pCoalesced->info.pBuffer = pBuffer;
+	pCoalesced->info.uFilePosition = uStart;
+	pCoalesced->info.uBufferSize = (AkUInt32)( uBufferEnd - uStart );
+	pCoalesced->info.uRequestedSize = (AkUInt32)( uRequestedEnd - uStart );
+	pCoalesced->info.uSizeTransferred = 0;
+	pCoalesced->info.pCallback = CoalescedIOCallback;
+	pCoalesced->info.pCookie = pCoalesced;
+	pCoalesced->info.pUserData = NULL;
+	pCoalesced->pDevice = this;
+	AKPLATFORM::PerformanceCounter( &pCoalesced->iSubmitTime );
+	pCoalesced->bIsDirect = bIsDirect;
+	pCoalesced->uNumTransfers = in_uNumIndices;
+
+	// The coalesced transfer is as urgent as the most urgent of its transfers.
+	AkAsyncIOBatchTransfer & merged = m_arBatchTransfers[uSlot];
+	for ( AkUInt32 uIdx = 0; uIdx < in_uNumIndices; ++uIdx )
+	{
+		AkAsyncIOBatchTransfer & transfer = m_arBatchTransfers[in_arIndices[uIdx]];
+		pCoalesced->arTransfers[uIdx] = transfer.pTransferInfo;
+		((CAkPendingTransfer*)transfer.pTransferInfo->pCookie)->TagAsCoalesced();
+
+		merged.heuristics.priority = AkMax( merged.heuristics.priority, transfer.heuristics.priority );
+		merged.heuristics.fDeadline = AkMin( merged.heuristics.fDeadline, transfer.heuristics.fDeadline );
+		if ( in_arIndices[uIdx] != uSlot )
+			transfer.pTransferInfo = NULL;
+	}
+	merged.pTransferInfo = &pCoalesced->info;
+	return true;
+}
+
+// Callback from Low-Level IO for coalesced transfers: feeds the I/O model with the whole read, copies data to
+// the buffer of each merged transfer if it was not read there directly, completes them through their own 
+// callback, and frees the coalesced transfer.
+void CAkDeviceDeferredLinedUp::CoalescedIOCallback(
+	AkAsyncIOTransferInfo * in_pTransferInfo,	// Transfer info of the coalesced transfer.
+	AKRESULT		in_eResult			// Result of transfer.
+	)
+{
+	AkCoalescedTransfer * pCoalesced = (AkCoalescedTransfer*)in_pTransferInfo->pCookie;
+	AKASSERT( pCoalesced || !"Invalid coalesced transfer: corrupted cookie" );
+	CAkDeviceDeferredLinedUp * pDevice = pCoalesced->pDevice;
+
+	// One sample for the whole read: merged transfers do not feed the I/O model themselves.
+	if ( AK_Success == in_eResult )
+	{
+		AkInt64 iNow;
+		AKPLATFORM::PerformanceCounter( &iNow );
+		pDevice->AddTransferSample( in_pTransferInfo->uSizeTransferred, AKPLATFORM::Elapsed( iNow, pCoalesced->iSubmitTime ) );
+	}
+
+	for ( AkUInt32 uTransfer = 0; uTransfer < pCoalesced->uNumTransfers; ++uTransfer )
+	{
+		AkAsyncIOTransferInfo * pInfo = pCoalesced->arTransfers[uTransfer];
+		AkUInt32 uOffset = (AkUInt32)( pInfo->uFilePosition - in_pTransferInfo->uFilePosition );
+		if ( AK_Success == in_eResult 
+			&& in_pTransferInfo->uSizeTransferred > uOffset )
+		{
+			pInfo->uSizeTransferred = AkMin( pInfo->uRequestedSize, in_pTransferInfo->uSizeTransferred - uOffset );
+			if ( !pCoalesced->bIsDirect )
+				AKPLATFORM::AkMemCpy( pInfo->pBuffer, (AkUInt8*)in_pTransferInfo->pBuffer + uOffset, pInfo->uSizeTransferred );
+		}
+		else
+			pInfo->uSizeTransferred = 0;
+
+		pInfo->pCallback( pInfo, in_eResult );
+	}
+
+	if ( !pCoalesced->bIsDirect )
+	{
+		AkAutoLock<CAkIOThread> lock( *pDevice );
+		AKASSERT( pDevice->m_uCoalescingMemSize >= pDevice->m_ioMemMgr.GetBlockSize( in_pTransferInfo->pBuffer ) );
+		pDevice->m_uCoalescingMemSize -= pDevice->m_ioMemMgr.GetBlockSize( in_pTransferInfo->pBuffer );
+		pDevice->m_ioMemMgr.Free( in_pTransferInfo->pBuffer );
+		pDevice->NotifyMemChange();
+	}
+	AkFree( CAkStreamMgr::GetObjPoolID(), pCoalesced );
+}
+
+// Prepare transfer of a task chosen by scheduler.
+// Returns false if the transfer cannot be sent to the Low-Level IO (the task is updated accordingly).
+bool CAkDeviceDeferredLinedUp::PrepareTransfer(
+	CAkStmTask *				in_pTask,
+	void *						in_pBuffer,
+	AkReal32					in_fOpDeadline,
+	AkAsyncIOBatchTransfer &	out_transfer	// Returned transfer, ready to be sent to the Low-Level IO.
+	)
 {
 	AKASSERT( in_pTask != NULL );
 
@@ -240,13 +606,12 @@ void CAkDeviceDeferredLinedUp::ExecuteTask(
 			in_pBuffer,  
 			0,
 			AK_Fail );
-		return;
+		return false;
 	}
     
     // Get info for IO.
-    AkFileDesc * pFileDesc;
-	AkAsyncIOTransferInfo * pInfo = in_pTask->TransferInfo( in_pBuffer, pFileDesc );
-	if ( !pInfo )
+	out_transfer.pTransferInfo = in_pTask->TransferInfo( in_pBuffer, out_transfer.pFileDesc );
+	if ( !out_transfer.pTransferInfo )
 	{
 		// Not enough small object memory to enqueue a transfer in the LowLevelIO! Update and bail out.
 		// Cancel this request.
@@ -262,43 +627,41 @@ void CAkDeviceDeferredLinedUp::ExecuteTask(
 		// On the other hand, we do not want to kill the task that has the lowest priority, because
 		// before memory is actually freed, this thread will likely have killed all its tasks...
 		CAkStreamMgr::ForceCleanup( NULL, AK_MAX_PRIORITY );
-		return;
+		return false;
 	}
 
-	AkIoHeuristics heuristics;
-	heuristics.priority = in_pTask->Priority();
-	heuristics.fDeadline = in_fOpDeadline;
-    
-    // Read or write?
-    if ( in_pTask->IsWriteOp( ) )
-    {
-        // Write.
-        eResult = static_cast<IAkIOHookDeferred*>( m_pLowLevelHook )->Write( 
-            *pFileDesc, 
-			heuristics, 
-			*pInfo );
-    }
-    else
-    {
-        // Read.
-        eResult = static_cast<IAkIOHookDeferred*>( m_pLowLevelHook )->Read( 
-			*pFileDesc, 
-			heuristics, 
-			*pInfo );
-    }
+	out_transfer.heuristics.priority = in_pTask->Priority();
+	out_transfer.heuristics.fDeadline = in_fOpDeadline;
+	out_transfer.eResult = AK_Success;
+	return true;
+}
 
-	if ( eResult != AK_Success )
+// Handle the result of sending a transfer to the Low-Level IO.
+void CAkDeviceDeferredLinedUp::OnTransferSubmitted(
+	CAkStmTask *					in_pTask,
+	void *							in_pBuffer,		// Buffer provided by the scheduler.
+	const AkAsyncIOBatchTransfer &	in_transfer
+	)
+{
+	if ( in_transfer.eResult != AK_Success )
 	{
+		// Coalesced transfer: complete all the transfers that were merged with the error.
+		if ( in_transfer.pTransferInfo->pCallback == CoalescedIOCallback )
+		{
+			CoalescedIOCallback( in_transfer.pTransferInfo, in_transfer.eResult );
+			return;
+		}
+
         // Error in Read() (cannot be a cancellation). Update task now.
 		AK_MONITOR_ERROR( AK::Monitor::ErrorCode_IODevice );
 
-		CAkPendingTransfer * pTransfer = (CAkPendingTransfer*)(pInfo->pCookie);
+		CAkPendingTransfer * pTransfer = (CAkPendingTransfer*)(in_transfer.pTransferInfo->pCookie);
 	    in_pTask->Update( 
 			pTransfer,
 			pTransfer->StartPosition(), 
 	        in_pBuffer,
 			0,
-			eResult );
+			in_transfer.eResult );
     }
 }
 
@@ -524,6 +887,7 @@ AkReal32 CAkStdStmDeferredLinedUp::EffectiveDeadline()
 // Desc: Base automatic stream implementation.
 //-----------------------------------------------------------------------------
 CAkAutoStmDeferredLinedUp::CAkAutoStmDeferredLinedUp()
+: m_pSpeculativeXfer( NULL )
 {
 }
 
@@ -569,13 +933,37 @@ AkAsyncIOTransferInfo * CAkAutoStmDeferredLinedUp::TransferInfo(
 
 	AkUInt64 uPosition;
 	AkUInt32 uSize;
+	AkUInt32 uExpectedTransferSize;
+	bool bUnused;
+
+	// Speculative transfer: prefetch data at a likely seek target into the segment cache.
+	// It is moved to the cancelled list right away, so that it is never stored as stream data and the stream
+	// cannot be destroyed before it completes (see Update()). Unlike other cancelled transfers, it does not 
+	// count as virtual buffering: its data only becomes buffering if the stream seeks to it.
+	if ( GetSpeculativeTransfer( uPosition, uSize ) )
+	{
+		AkAsyncIOTransferInfo * pXferInfo = PushTransferRequest( 
+			in_pBuffer, 
+			uPosition, 
+			uSize, 
+			false, 
+			uExpectedTransferSize, 
+			bUnused );
+		if ( !pXferInfo )
+		{
+			m_bSpeculating = false;
+			return NULL;
+		}
+
+		m_pSpeculativeXfer = (CAkPendingTransfer*)pXferInfo->pCookie;
+		AKVERIFY( m_listPendingXfers.Remove( m_pSpeculativeXfer ) == AK_Success );
+		AddToCancelledList( m_pSpeculativeXfer );
+		return pXferInfo;
+	}
 
 	// Required transfer size is the buffer size for this stream.
-    // Slice request to granularity.
-	if ( m_uBufferSize > m_pDevice->GetGranularity() )
-        uSize = m_pDevice->GetGranularity();
-    else
-        uSize = m_uBufferSize;
+	// Note: Buffers are allocated to the size of each stream, so requests are not sliced to granularity.
+	uSize = m_uBufferSize;
 
 	
 	// Compute (absolute) file position for transfer.
@@ -593,8 +981,6 @@ AkAsyncIOTransferInfo * CAkAutoStmDeferredLinedUp::TransferInfo(
 
 	// Enqueue new transfer request.
 	
-	AkUInt32 uExpectedTransferSize;
-	bool bUnused;
 	AkAsyncIOTransferInfo * pXferInfo = PushTransferRequest( 
 		in_pBuffer, 
 		uPosition, 
@@ -606,15 +992,53 @@ AkAsyncIOTransferInfo * CAkAutoStmDeferredLinedUp::TransferInfo(
     {
 		AKASSERT( uExpectedTransferSize > 0 );
 
-		m_uVirtualBufferingSize += uExpectedTransferSize;
-		UpdateSchedulingStatus();
-
 		// Reset timer. Time count since last transfer starts now.
 		m_iIOStartTime = m_pDevice->GetTime();
+
+		m_uVirtualBufferingSize += uExpectedTransferSize;
+		UpdateSchedulingStatus();
     }
 	return pXferInfo;
 }
 
+// Override Update() to keep data of speculative transfers in the segment cache. 
+// I/O errors of speculative transfers do not affect the stream.
+void CAkAutoStmDeferredLinedUp::Update(
+	void *		in_pCookie,				// Cookie: transfer object. NULL if transfer object was not created.
+	const AkUInt64 in_uPosition,		// Absolute file position of transfer.
+    void *      in_pBuffer,             // Address of data.
+	AkUInt32    in_uActualIOSize,       // Size available for writing/reading.
+	AKRESULT	in_eIOResult			// AK_Success if IO was successful, AK_Cancelled if IO was cancelled, AK_Fail otherwise.
+    )
+{
+	// Lock status.
+	AkAutoLock<CAkLock> update( m_lockStatus );
+
+	if ( !in_pCookie 
+		|| in_pCookie != m_pSpeculativeXfer )
+	{
+		CAkStmDeferredLinedUpBase<CAkAutoStmBase>::Update( in_pCookie, in_uPosition, in_pBuffer, in_uActualIOSize, in_eIOResult );
+		return;
+	}
+
+	CAkPendingTransfer * pTransfer = m_pSpeculativeXfer;
+	m_pSpeculativeXfer = NULL;
+
+	// Feed the device's I/O model. Coalesced transfers are sampled as a whole.
+	if ( AK_Success == in_eIOResult 
+		&& !pTransfer->IsCoalesced() )
+		m_pDevice->AddTransferSample( in_uActualIOSize, pTransfer->ElapsedSinceSubmit() );
+
+	OnSpeculativeTransferDone( in_uPosition, in_pBuffer, in_uActualIOSize, AK_Success == in_eIOResult );
+
+	// Dequeue it from the cancelled list. It was never part of virtual buffering.
+	AKVERIFY( m_listCancelledXfers.Remove( pTransfer ) == AK_Success );
+	((CAkDeviceDeferredLinedUpBase*)m_pDevice)->ReleaseTransferObject( pTransfer );
+	UpdateSchedulingStatus();
+
+	m_pDevice->DecrementIOCount();
+}
+
 AkUInt64 CAkAutoStmDeferredLinedUp::GetVirtualFilePosition()
 {
 	// Must be locked.
@@ -670,7 +1094,9 @@ bool CAkAutoStmDeferredLinedUp::CancelLastTransfer()
 // NOTE: This implementation differs from the blocking device's because we must also check 
 // pending transfers.
 // Sync: Status.
-void * CAkAutoStmDeferredLinedUp::PopIOBuffer( )
+void * CAkAutoStmDeferredLinedUp::PopIOBuffer(
+	AkUInt32	in_uBufferSize		// Size of the buffer required by the task chosen for I/O.
+	)
 {
     // Lock status.
     AkAutoLock<CAkLock> stmBufferGate( m_lockStatus );
@@ -681,7 +1107,7 @@ void * CAkAutoStmDeferredLinedUp::PopIOBuffer( )
     m_pDevice->Lock();
 
     // Now that memory is locked, try to get a buffer again.
-    void * pBuffer = AK::MemoryMgr::GetBlock( m_pDevice->GetIOPoolID() );
+    void * pBuffer = m_pDevice->GetIOMemMgr().Alloc( in_uBufferSize );
 
     if ( pBuffer )
     {
@@ -690,9 +1116,20 @@ void * CAkAutoStmDeferredLinedUp::PopIOBuffer( )
         return pBuffer;
     }
 
-	if ( m_listPendingXfers.IsEmpty() && m_listBuffers.IsEmpty() )
+	// Give away data of the segment cache first: it does not count as buffering.
+	pBuffer = PopCachedBuffer();
+	if ( pBuffer )
+	{
+		pBuffer = m_pDevice->ReassignIOBuffer( pBuffer, in_uBufferSize );
+		m_pDevice->Unlock();
+		return pBuffer;
+	}
+
+	if ( ( m_listPendingXfers.IsEmpty() && m_listBuffers.IsEmpty() )
+		|| IsInRing( m_listPendingXfers.Last() ? m_listPendingXfers.Last()->info.pBuffer : m_listBuffers.Last()->pBuffer ) )
 	{
-		// This task cannot let a buffer go. Notify scheduler that memory is blocked for a while.
+		// This task cannot let a buffer go (buffers of its ring are reserved to it). 
+		// Notify scheduler that memory is blocked for a while.
 		m_pDevice->NotifyMemIdle();
 		m_pDevice->Unlock();
 		return NULL;
@@ -713,11 +1150,16 @@ void * CAkAutoStmDeferredLinedUp::PopIOBuffer( )
 
 	// Because the virtual buffering size is only updated when transfers complete (cancelled or not),
 	// we need to compute virtual buffering size value which takes currently cancelled transfers 
-	// into account.
+	// into account. The speculative transfer is not part of it.
 	AkUInt32 uVirtualBufferingSize = m_uVirtualBufferingSize;
 	CancelledTransfersList::Iterator it = m_listCancelledXfers.Begin();
 	while ( it != m_listCancelledXfers.End() )
 	{
+		if ( (*it) == m_pSpeculativeXfer )
+		{
+			++it;
+			continue;
+		}
 		AKASSERT( uVirtualBufferingSize >= (*it)->info.uRequestedSize );
 		uVirtualBufferingSize -= (*it)->info.uRequestedSize;
 		++it;
@@ -733,6 +1175,8 @@ void * CAkAutoStmDeferredLinedUp::PopIOBuffer( )
 		{
 			// No transfer to cancel: remove a buffer.
 			m_uVirtualBufferingSize -= uSizeToRemove;
+			AKASSERT( m_uAvailableDataSize >= uSizeToRemove );
+			m_uAvailableDataSize -= uSizeToRemove;
 
 			AkStmBuffer * pLastStmBuffer = m_listBuffers.Last();
 	        pBuffer = pLastStmBuffer->pBuffer;
@@ -743,12 +1187,15 @@ void * CAkAutoStmDeferredLinedUp::PopIOBuffer( )
 
 			// Update status: Correct position. Reset EOF flag and restart if necessary.
 			UpdateSchedulingStatus();
+
+			// Exchange buffer if it is not of the required size.
+			pBuffer = m_pDevice->ReassignIOBuffer( pBuffer, in_uBufferSize );
 		}
 		else
       	{
 			// Transfer was cancelled. A buffer will be freed eventually. 
 			// Perhaps it was freed during call to CancelTransfer(). Try again.
-			pBuffer = AK::MemoryMgr::GetBlock( m_pDevice->GetIOPoolID() );
+			pBuffer = m_pDevice->GetIOMemMgr().Alloc( in_uBufferSize );
 			if ( !pBuffer )
 			{
 				// No buffer was freed while cancelling. It will occur later, from another thread.
@@ -773,6 +1220,7 @@ void CAkAutoStmDeferredLinedUp::CheckVirtualBufferingConsistency()
 {
 	AkUInt32 uVirtualBuffering = 0;
 	AkUInt32 uNumGranted = m_uNextToGrant;
+	AkUInt32 uGrantedSize = 0;
 	{
 		AkBufferList::Iterator it = m_listBuffers.Begin();
 		while ( it != m_listBuffers.End() )
@@ -780,10 +1228,15 @@ void CAkAutoStmDeferredLinedUp::CheckVirtualBufferingConsistency()
 			if ( uNumGranted == 0 ) // Skip buffers granted.
 				uVirtualBuffering += (*it)->uDataSize;
 			else 
+			{
+				uGrantedSize += (*it)->uDataSize;
 				uNumGranted--;
+			}
 			++it;
 		}
 	}
+	AKASSERT( uVirtualBuffering == m_uAvailableDataSize 
+			&& uGrantedSize == m_uGrantedDataSize );
 	{
 		PendingTransfersList::Iterator it = m_listPendingXfers.Begin();
 		while ( it != m_listPendingXfers.End() )
@@ -793,11 +1246,12 @@ void CAkAutoStmDeferredLinedUp::CheckVirtualBufferingConsistency()
 		}
 	}
 	{
-		// Also add all transfers marked as cancelled but not removed from task yet.
+		// Also add all transfers marked as cancelled but not removed from task yet, except the speculative transfer.
 		CancelledTransfersList::Iterator it = m_listCancelledXfers.Begin();
 		while ( it != m_listCancelledXfers.End() )
 		{
-			uVirtualBuffering += (AkUInt32)( (*it)->EndPosition() - (*it)->StartPosition() );
+			if ( (*it) != m_pSpeculativeXfer )
+				uVirtualBuffering += (AkUInt32)( (*it)->EndPosition() - (*it)->StartPosition() );
 			++it;
 		}
 	}
@@ -18,6 +18,25 @@ namespace AK
 {
 namespace StreamMgr
 {
+	class CAkDeviceDeferredLinedUp;
+
+    //-----------------------------------------------------------------------------
+    // Name: struct AkCoalescedTransfer
+    // Desc: Read that merges transfers of different tasks on the same file, sent to the 
+    //       Low-Level IO in their place. If the buffers of the merged transfers follow each 
+    //       other in I/O memory like their data in the file, data is read directly into them. 
+    //       Otherwise it is read into a buffer of the device's I/O memory, then copied to the 
+    //       buffer of each merged transfer. Each is completed through its own callback.
+    //-----------------------------------------------------------------------------
+	struct AkCoalescedTransfer
+	{
+		AkAsyncIOTransferInfo		info;			// Transfer info sent to the Low-Level IO. Its cookie points to this object.
+		CAkDeviceDeferredLinedUp *	pDevice;		// Device that owns the buffer.
+		AkInt64						iSubmitTime;	// Time when the transfer was prepared (for the device's I/O model).
+		bool						bIsDirect;		// Data is read directly into the buffers of merged transfers.
+		AkUInt32					uNumTransfers;	// Number of merged transfers.
+		AkAsyncIOTransferInfo *		arTransfers[1];	// Transfer info of merged transfers, in file order (uNumTransfers items).
+	};
 
     //-----------------------------------------------------------------------------
     // Name: CAkDeviceDeferredLinedUp
@@ -34,6 +53,7 @@ namespace StreamMgr
 
 		virtual AKRESULT	Init( 
             const AkDeviceSettings &	in_settings,
+            const AkDeviceSettingsEx &	in_settingsEx,
             AkDeviceID					in_deviceID 
             );
 		virtual void		Destroy();
@@ -67,7 +87,58 @@ namespace StreamMgr
 			AkReal32		in_fOpDeadline
             );
 
+		// Execute tasks chosen by scheduler in one pass: transfers are all prepared, coalesced if applicable, then
+		// sent to the Low-Level IO using its batch interface if it supports it.
+		void ExecuteTasksBatched(
+			AkUInt32		in_uNumTransfers	// Number of transfers in m_arScheduledTransfers.
+			);
+
+		// Merges prepared reads on the same file whose ranges are adjacent, or apart by at most m_uCoalescingGap bytes,
+		// into coalesced transfers (see AkCoalescedTransfer). m_arScheduledTransfers and m_arBatchTransfers are compacted.
+		// Returns the number of transfers left.
+		AkUInt32 CoalesceTransfers(
+			AkUInt32		in_uNumTransfers	// Number of prepared transfers in m_arBatchTransfers.
+			);
+
+		// Replaces prepared reads by a coalesced transfer, in the slot of the first one that was scheduled.
+		// The others are removed (their transfer info is set to NULL). Returns false if it could not be created.
+		bool MergeTransfers(
+			const AkUInt32 *	in_arIndices,	// Indices of transfers in m_arBatchTransfers, in file order.
+			AkUInt32		in_uNumIndices		// Number of transfers to merge.
+			);
+
+		// Callback from Low-Level IO for coalesced transfers.
+		static void CoalescedIOCallback(
+			AkAsyncIOTransferInfo * in_pTransferInfo,	// Transfer info of the coalesced transfer.
+			AKRESULT		in_eResult			// Result of transfer.
+			);
+
+		// Prepare transfer of a task chosen by scheduler: handles deferred opening and gets the transfer info.
+		// Returns false if the transfer cannot be sent to the Low-Level IO (the task is updated accordingly).
+		bool PrepareTransfer(
+			CAkStmTask *				in_pTask,
+			void *						in_pBuffer,
+			AkReal32					in_fOpDeadline,
+			AkAsyncIOBatchTransfer &	out_transfer	// Returned transfer, ready to be sent to the Low-Level IO.
+			);
+
+		// Handle the result of sending a transfer to the Low-Level IO.
+		void OnTransferSubmitted(
+			CAkStmTask *					in_pTask,
+			void *							in_pBuffer,		// Buffer provided by the scheduler.
+			const AkAsyncIOBatchTransfer &	in_transfer
+			);
+
 		CAkPendingTransfer * m_pXferObjMem;
+		AkStmScheduledTransfer * m_arScheduledTransfers;	// Transfers chosen by the scheduler in one pass (uMaxConcurrentIO items).
+		AkAsyncIOBatchTransfer * m_arBatchTransfers;		// Transfers prepared in one pass (uMaxConcurrentIO items). NULL if the hook does not support 
+															// batches and transfers are not coalesced: transfers are then prepared and sent one by one.
+		AkUInt32 *			m_arCoalescing;				// Indices of transfers considered for coalescing (uMaxConcurrentIO items). NULL if transfers are not coalesced.
+		AkUInt32			m_uMaxCoalescedSize;		// Maximum size of a coalesced transfer. 0 if transfers are not coalesced.
+		AkUInt32			m_uMaxCoalescingMemSize;	// I/O memory that coalesced transfers may use at once for their own buffers.
+		AkUInt32			m_uCoalescingMemSize;		// I/O memory used by buffers of coalesced transfers. Sync: Device lock.
+		AkUInt32			m_uCoalescingGap;			// Maximum gap between coalesced transfers.
+		IAkIOHookDeferredBatch * m_pBatchHook;			// Batch interface of the Low-Level IO (AkDeviceSettingsEx::pBatchHook). NULL if it was not registered.
     };
 
     //-----------------------------------------------------------------------------
@@ -159,6 +230,15 @@ namespace StreamMgr
 			AkFileDesc *&		out_pFileDesc		// Stream's associated file descriptor.
 			);
 
+		// Override Update() to keep data of speculative transfers in the segment cache.
+		virtual void Update(
+			void *		in_pCookie,				// Cookie: transfer object. NULL if transfer object was not created.
+			const AkUInt64 in_uPosition,		// Absolute file position of transfer.
+            void *      in_pBuffer,             // Address of data.
+			AkUInt32    in_uActualIOSize,       // Size available for writing/reading.
+			AKRESULT	in_eIOResult			// AK_Success if IO was successful, AK_Cancelled if IO was cancelled, AK_Fail otherwise.
+            );
+
 	protected:
 
 		// CAkAutoStm-specific implementation.
@@ -167,7 +247,9 @@ namespace StreamMgr
 		// Automatic stream specific. 
         // For buffer reassignment. The scheduler calls this if there is no memory available and it considers
         // that this task could give away some of its buffers.
-        virtual void * PopIOBuffer();
+        virtual void * PopIOBuffer(
+			AkUInt32	in_uBufferSize		// Size of the buffer required by the task chosen for I/O.
+			);
 
 		// Automatic streams must implement a method that returns the file position after the last
 		// valid (non cancelled) pending transfer. If there is no transfer pending, then it is the position
@@ -188,6 +270,12 @@ namespace StreamMgr
 #ifdef _DEBUG
 		virtual void CheckVirtualBufferingConsistency();
 #endif
+
+	protected:
+		// Speculative transfer in progress (see CAkAutoStmBase::GetSpeculativeTransfer()), NULL if none. 
+		// It is kept in the list of cancelled transfers from the start, so that it is never resolved as buffering,
+		// but it is left out of virtual buffering.
+		CAkPendingTransfer *	m_pSpeculativeXfer;
     };
 }
 }
@@ -21,6 +21,8 @@
 #include <AK/Plugin/AkMP3SourceFactory.h> // For MP3 Codec ID.
 #endif
 #include <AK/Tools/Common/AkPlatformFuncs.h>
+#include <AK/Tools/Common/AkAutoLock.h>
+#include <AK/Tools/Common/AkFNVHash.h>
 #include <wchar.h>
 #include <stdio.h>
 #include <assert.h>
@@ -35,6 +37,13 @@
 #define MAX_FILETITLE_SIZE          (MAX_NUMBER_STRING_SIZE+MAX_EXTENSION_SIZE+1)   // null-terminated
 
 
+// Flags of resolved path cache entries.
+#define AK_PATH_CACHE_VALID			(0x01)	// Entry is used.
+#define AK_PATH_CACHE_BY_NAME		(0x02)	// Resolved with the string overload.
+#define AK_PATH_CACHE_HAS_FLAGS		(0x04)	// File system flags were specified.
+#define AK_PATH_CACHE_READ			(0x08)	// Opened with AK_OpenModeRead.
+#define AK_PATH_CACHE_LANG_SPECIFIC	(0x10)	// File is language specific.
+
 #ifdef AK_WIN
 #define OS_PRINTF	swprintf
 #else
@@ -54,6 +63,9 @@ CAkFileLocationBase::CAkFileLocationBase()
     m_szBankPath[0] = NULL;
     m_szAudioSrcPath[0] = NULL;
     m_szLangSpecificDirName[0] = NULL;
+#if AK_FILE_LOCATION_PATH_CACHE_SIZE > 0
+	FlushPathCache();
+#endif
 }
 
 CAkFileLocationBase::~CAkFileLocationBase()
@@ -76,6 +88,31 @@ AKRESULT CAkFileLocationBase::GetFullFilePath(
         return AK_InvalidParameter;
     }
 
+#if AK_FILE_LOCATION_PATH_CACHE_SIZE > 0
+	size_t uNameLength = AKPLATFORM::OsStrLen( in_pszFileName );
+	AK::FNVHash<AK::Hash32> hash;
+	AkUInt32 uKey = hash.Compute( in_pszFileName, (unsigned int)( uNameLength * sizeof( AkOSChar ) ) );
+	AkUInt32 uCacheFlags = GetCacheFlags( in_pFlags, in_eOpenMode, true );
+	if ( FindCachedPath( uKey, in_pFlags, uCacheFlags, in_pszFileName, uNameLength, out_pszFullFilePath ) )
+		return AK_Success;
+
+	AKRESULT eResult = BuildFullFilePath( in_pszFileName, in_pFlags, in_eOpenMode, out_pszFullFilePath );
+	if ( eResult == AK_Success )
+		CachePath( uKey, in_pFlags, uCacheFlags, out_pszFullFilePath );
+	return eResult;
+#else
+	return BuildFullFilePath( in_pszFileName, in_pFlags, in_eOpenMode, out_pszFullFilePath );
+#endif
+}
+
+// String overload, without the cache.
+AKRESULT CAkFileLocationBase::BuildFullFilePath(
+	const AkOSChar*		in_pszFileName,		// File name.
+	AkFileSystemFlags * in_pFlags,			// Special flags. Can be NULL.
+	AkOpenMode			in_eOpenMode,		// File open mode (read, write, ...).
+	AkOSChar*			out_pszFullFilePath // Full file path.
+	)
+{
 	// Prepend string path (basic file system logic).
 
     // Compute file name with file system paths.
@@ -166,7 +203,29 @@ AKRESULT CAkFileLocationBase::GetFullFilePath(
 AKRESULT CAkFileLocationBase::GetFullFilePath(
 	AkFileID			in_fileID,			// File ID.
 	AkFileSystemFlags *	in_pFlags,			// Special flags. 
-	AkOpenMode			/* in_eOpenMode*/,	// File open mode (read, write, ...).
+	AkOpenMode			in_eOpenMode,		// File open mode (read, write, ...).
+	AkOSChar *			out_pszFullFilePath	// Full file path.
+	)
+{
+#if AK_FILE_LOCATION_PATH_CACHE_SIZE > 0
+	AkUInt32 uCacheFlags = GetCacheFlags( in_pFlags, in_eOpenMode, false );
+	if ( FindCachedPath( in_fileID, in_pFlags, uCacheFlags, NULL, 0, out_pszFullFilePath ) )
+		return AK_Success;
+
+	AKRESULT eResult = BuildFullFilePath( in_fileID, in_pFlags, out_pszFullFilePath );
+	if ( eResult == AK_Success )
+		CachePath( in_fileID, in_pFlags, uCacheFlags, out_pszFullFilePath );
+	return eResult;
+#else
+	(void)in_eOpenMode;
+	return BuildFullFilePath( in_fileID, in_pFlags, out_pszFullFilePath );
+#endif
+}
+
+// ID overload, without the cache.
+AKRESULT CAkFileLocationBase::BuildFullFilePath(
+	AkFileID			in_fileID,			// File ID.
+	AkFileSystemFlags *	in_pFlags,			// Special flags. 
 	AkOSChar *			out_pszFullFilePath	// Full file path.
 	)
 {
@@ -260,6 +319,9 @@ AKRESULT CAkFileLocationBase::SetBasePath(
 		return AK_InvalidParameter;
 	}
 	AKPLATFORM::SafeStrCpy( m_szBasePath, in_pszBasePath, AK_MAX_PATH );
+#if AK_FILE_LOCATION_PATH_CACHE_SIZE > 0
+	FlushPathCache();
+#endif
 	return AK_Success;
 }
 
@@ -272,6 +334,9 @@ AKRESULT CAkFileLocationBase::SetBankPath(
 		return AK_InvalidParameter;
 	}
 	AKPLATFORM::SafeStrCpy( m_szBankPath, in_pszBankPath, AK_MAX_PATH );
+#if AK_FILE_LOCATION_PATH_CACHE_SIZE > 0
+	FlushPathCache();
+#endif
 	return AK_Success;
 }
 
@@ -284,6 +349,9 @@ AKRESULT CAkFileLocationBase::SetAudioSrcPath(
 		return AK_InvalidParameter;
 	}
 	AKPLATFORM::SafeStrCpy( m_szAudioSrcPath, in_pszAudioSrcPath, AK_MAX_PATH );
+#if AK_FILE_LOCATION_PATH_CACHE_SIZE > 0
+	FlushPathCache();
+#endif
 	return AK_Success;
 }
 
@@ -296,6 +364,107 @@ AKRESULT CAkFileLocationBase::SetLangSpecificDirName(
 		return AK_InvalidParameter;
 	}
 	AKPLATFORM::SafeStrCpy( m_szLangSpecificDirName, in_pszDirName, AK_MAX_PATH );
+#if AK_FILE_LOCATION_PATH_CACHE_SIZE > 0
+	FlushPathCache();
+#endif
 	return AK_Success;
 }
 
+#if AK_FILE_LOCATION_PATH_CACHE_SIZE > 0
+
+// Returns the AK_PATH_CACHE_xxx flags that identify a path, along with its key.
+AkUInt32 CAkFileLocationBase::GetCacheFlags(
+	AkFileSystemFlags *	in_pFlags,			// Special flags. Can be NULL.
+	AkOpenMode			in_eOpenMode,		// File open mode.
+	bool				in_bByName			// True for the string overload.
+	)
+{
+	AkUInt32 uCacheFlags = AK_PATH_CACHE_VALID;
+	if ( in_bByName )
+	{
+		uCacheFlags |= AK_PATH_CACHE_BY_NAME;
+		// Open mode only matters to the string overload.
+		if ( in_eOpenMode == AK_OpenModeRead )
+			uCacheFlags |= AK_PATH_CACHE_READ;
+	}
+	if ( in_pFlags )
+	{
+		uCacheFlags |= AK_PATH_CACHE_HAS_FLAGS;
+		if ( in_pFlags->bIsLanguageSpecific )
+			uCacheFlags |= AK_PATH_CACHE_LANG_SPECIFIC;
+	}
+	return uCacheFlags;
+}
+
+static inline AkUInt32 GetPathCacheSlot( AkUInt32 in_uKey, AkUInt32 in_uCodecID, AkUInt32 in_uCacheFlags )
+{
+	AkUInt32 uHash = in_uKey ^ ( in_uCodecID * 0x9E3779B1 ) ^ ( in_uCacheFlags << 24 );
+	uHash ^= uHash >> 16;
+	return uHash & ( AK_FILE_LOCATION_PATH_CACHE_SIZE - 1 );
+}
+
+// Copies a cached path to out_pszFullFilePath. Returns false if it is not cached.
+// With in_pszFileName, the cached path is verified to end with the file name.
+bool CAkFileLocationBase::FindCachedPath(
+	AkUInt32			in_uKey,			// File ID, or hash of the file name.
+	AkFileSystemFlags *	in_pFlags,			// Special flags. Can be NULL.
+	AkUInt32			in_uCacheFlags,		// Flags returned by GetCacheFlags().
+	const AkOSChar *	in_pszFileName,		// File name (string overload). NULL otherwise.
+	size_t				in_uNameLength,		// Length of in_pszFileName.
+	AkOSChar *			out_pszFullFilePath	// Full file path.
+	)
+{
+	AkUInt32 uCompanyID = in_pFlags ? in_pFlags->uCompanyID : 0;
+	AkUInt32 uCodecID = in_pFlags ? in_pFlags->uCodecID : 0;
+
+	AkAutoLock<CAkLock> lock( m_lockPathCache );
+
+	AkCachedPath & entry = m_arCachedPaths[ GetPathCacheSlot( in_uKey, uCodecID, in_uCacheFlags ) ];
+	if ( entry.uFlags != in_uCacheFlags
+		|| entry.uKey != in_uKey
+		|| entry.uCodecID != uCodecID
+		|| entry.uCompanyID != uCompanyID )
+		return false;
+
+	// Names are hashed: compare the file title. The rest of the path only depends on the flags.
+	if ( in_pszFileName
+		&& ( entry.uLength < in_uNameLength
+			|| memcmp( entry.szPath + entry.uLength - in_uNameLength, in_pszFileName, in_uNameLength * sizeof( AkOSChar ) ) != 0 ) )
+		return false;
+
+	memcpy( out_pszFullFilePath, entry.szPath, ( entry.uLength + 1 ) * sizeof( AkOSChar ) );
+	return true;
+}
+
+// Stores a resolved path in the cache, replacing the entry that occupied its slot.
+void CAkFileLocationBase::CachePath(
+	AkUInt32			in_uKey,			// File ID, or hash of the file name.
+	AkFileSystemFlags *	in_pFlags,			// Special flags. Can be NULL.
+	AkUInt32			in_uCacheFlags,		// Flags returned by GetCacheFlags().
+	const AkOSChar *	in_pszFullFilePath	// Full file path.
+	)
+{
+	size_t uLength = AKPLATFORM::OsStrLen( in_pszFullFilePath );
+	assert( uLength < AK_MAX_PATH );
+	AkUInt32 uCodecID = in_pFlags ? in_pFlags->uCodecID : 0;
+
+	AkAutoLock<CAkLock> lock( m_lockPathCache );
+
+	AkCachedPath & entry = m_arCachedPaths[ GetPathCacheSlot( in_uKey, uCodecID, in_uCacheFlags ) ];
+	entry.uKey			= in_uKey;
+	entry.uCompanyID	= in_pFlags ? in_pFlags->uCompanyID : 0;
+	entry.uCodecID		= uCodecID;
+	entry.uFlags		= in_uCacheFlags;
+	entry.uLength		= (AkUInt32)uLength;
+	memcpy( entry.szPath, in_pszFullFilePath, ( uLength + 1 ) * sizeof( AkOSChar ) );
+}
+
+// Frees all entries. Called whenever a path is set.
+void CAkFileLocationBase::FlushPathCache()
+{
+	AkAutoLock<CAkLock> lock( m_lockPathCache );
+	for ( AkUInt32 uEntry = 0; uEntry < AK_FILE_LOCATION_PATH_CACHE_SIZE; uEntry++ )
+		m_arCachedPaths[uEntry].uFlags = 0;
+}
+
+#endif
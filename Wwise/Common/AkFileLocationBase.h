@@ -18,6 +18,15 @@
 struct AkFileSystemFlags;
 
 #include <AK/SoundEngine/Common/IAkStreamMgr.h>
+#include <AK/Tools/Common/AkLock.h>
+
+// Number of entries of the resolved path cache. Must be a power of 2. Set to 0 to disable the cache.
+// Full paths returned by GetFullFilePath() are kept in a small direct-mapped cache, keyed by
+// file ID (or file name hash) and file system flags, so that files that are opened repeatedly
+// do not require string concatenation and formatting. The cache is flushed whenever a path is set.
+#ifndef AK_FILE_LOCATION_PATH_CACHE_SIZE
+#define AK_FILE_LOCATION_PATH_CACHE_SIZE	(32)
+#endif
 
 class CAkFileLocationBase
 {
@@ -77,6 +86,63 @@ public:
 
 protected:
 
+	// Path resolving without the cache.
+	AKRESULT BuildFullFilePath(
+		const AkOSChar *	in_pszFileName,		// File name.
+		AkFileSystemFlags * in_pFlags,			// Special flags. Can be NULL.
+		AkOpenMode			in_eOpenMode,		// File open mode (read, write, ...).
+		AkOSChar *			out_pszFullFilePath // Full file path.
+		);
+	AKRESULT BuildFullFilePath(
+		AkFileID			in_fileID,			// File ID.
+		AkFileSystemFlags *	in_pFlags,			// Special flags. 
+		AkOSChar *			out_pszFullFilePath	// Full file path.
+		);
+
+#if AK_FILE_LOCATION_PATH_CACHE_SIZE > 0
+	struct AkCachedPath
+	{
+		AkUInt32			uKey;				// File ID, or hash of the file name.
+		AkUInt32			uCompanyID;			// Company ID of file system flags.
+		AkUInt32			uCodecID;			// Codec ID of file system flags.
+		AkUInt32			uFlags;				// AK_PATH_CACHE_xxx flags. 0 when the entry is free.
+		AkUInt32			uLength;			// Length of szPath (excluding NULL character).
+		AkOSChar			szPath[AK_MAX_PATH];// Full file path.
+	};
+
+	// Returns the AK_PATH_CACHE_xxx flags that identify a path, along with its key.
+	static AkUInt32 GetCacheFlags(
+		AkFileSystemFlags *	in_pFlags,			// Special flags. Can be NULL.
+		AkOpenMode			in_eOpenMode,		// File open mode.
+		bool				in_bByName			// True for the string overload.
+		);
+
+	// Copies a cached path to out_pszFullFilePath. Returns false if it is not cached.
+	// With in_pszFileName, the cached path is verified to end with the file name.
+	bool FindCachedPath(
+		AkUInt32			in_uKey,			// File ID, or hash of the file name.
+		AkFileSystemFlags *	in_pFlags,			// Special flags. Can be NULL.
+		AkUInt32			in_uCacheFlags,		// Flags returned by GetCacheFlags().
+		const AkOSChar *	in_pszFileName,		// File name (string overload). NULL otherwise.
+		size_t				in_uNameLength,		// Length of in_pszFileName.
+		AkOSChar *			out_pszFullFilePath	// Full file path.
+		);
+
+	// Stores a resolved path in the cache, replacing the entry that occupied its slot.
+	void CachePath(
+		AkUInt32			in_uKey,			// File ID, or hash of the file name.
+		AkFileSystemFlags *	in_pFlags,			// Special flags. Can be NULL.
+		AkUInt32			in_uCacheFlags,		// Flags returned by GetCacheFlags().
+		const AkOSChar *	in_pszFullFilePath	// Full file path.
+		);
+
+	// Frees all entries. Called whenever a path is set.
+	void FlushPathCache();
+
+	CAkLock				m_lockPathCache;
+	AkCachedPath		m_arCachedPaths[AK_FILE_LOCATION_PATH_CACHE_SIZE];
+#endif
+
 	// Internal user paths.
 	AkOSChar			m_szBasePath[AK_MAX_PATH];
 	AkOSChar			m_szBankPath[AK_MAX_PATH];
@@ -0,0 +1,337 @@
+//////////////////////////////////////////////////////////////////////
+//
+// AkFilePackageIndex.cpp
+//
+// This class merges the look-up tables of all loaded file packages
+// (CAkFilePackage) into a single open-addressing hash table, so that
+// a file can be found with a single probe, regardless of the number
+// of packages loaded.
+//
+// Copyright (c) 2007-2009 Audiokinetic Inc. / All Rights Reserved
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "AkFilePackageIndex.h"
+#include <AK/SoundEngine/Common/AkMemoryMgr.h>
+#include <AK/Tools/Common/AkPlatformFuncs.h>
+
+// Minimum number of slots of the table.
+#define AK_PACKAGE_INDEX_MIN_SLOTS	(64)
+
+CAkFilePackageIndex::CAkFilePackageIndex()
+: m_pTable( NULL )
+, m_poolID( AK_INVALID_POOL_ID )
+, m_uNumSlots( 0 )
+, m_uNumEntries( 0 )
+, m_bValid( true )
+{
+}
+
+CAkFilePackageIndex::~CAkFilePackageIndex()
+{
+	AKASSERT( !m_pTable || !"Term() was not called" );
+}
+
+// Releases the table. The index is valid (and empty) afterwards.
+void CAkFilePackageIndex::Term()
+{
+	FreeTable( m_poolID, m_pTable );
+	m_pTable = NULL;
+	m_poolID = AK_INVALID_POOL_ID;
+	m_uNumSlots = 0;
+	m_uNumEntries = 0;
+	m_bValid = true;
+}
+
+// Adds the entries of a package that was just loaded. They override
+// the entries of the packages already indexed.
+// Returns AK_Success, or AK_InsufficientMemory, in which case the index is invalidated.
+AKRESULT CAkFilePackageIndex::AddPackage(
+	CAkFilePackage *	in_pPackage		// Package that was just loaded.
+	)
+{
+	if ( !m_bValid )
+		return AK_Fail;	// Will be built again in Rebuild().
+
+	if ( Reserve( m_uNumEntries + NumEntries( in_pPackage ) ) != AK_Success )
+	{
+		Term();
+		m_bValid = false;
+		return AK_InsufficientMemory;
+	}
+
+	AddEntries( in_pPackage, true, true );
+	AddEntries( in_pPackage, false, true );
+	return AK_Success;
+}
+
+// Removes the entries of a package that is about to be unloaded, and restores
+// the entries that it was overriding.
+void CAkFilePackageIndex::RemovePackage(
+	CAkFilePackage *	in_pPackage,	// Package to remove. Must not be part of in_packages anymore.
+	ListFilePackages &	in_packages		// Remaining packages, most recently loaded first.
+	)
+{
+	if ( !m_bValid || !m_pTable )
+		return;
+
+	RemoveEntries( in_pPackage, true, in_packages );
+	RemoveEntries( in_pPackage, false, in_packages );
+}
+
+// Rebuilds the index from scratch, typically after the language changed.
+// Returns AK_Success, or AK_InsufficientMemory, in which case the index is invalidated.
+AKRESULT CAkFilePackageIndex::Rebuild(
+	ListFilePackages &	in_packages		// Loaded packages, most recently loaded first.
+	)
+{
+	AkUInt32 uNumEntries = 0;
+	ListFilePackages::Iterator it = in_packages.Begin();
+	while ( it != in_packages.End() )
+	{
+		uNumEntries += NumEntries( *it );
+		++it;
+	}
+
+	m_bValid = true;
+	if ( m_pTable )
+	{
+		memset( m_pTable, 0, m_uNumSlots * sizeof( AkIndexEntry ) );
+		m_uNumEntries = 0;
+	}
+
+	if ( uNumEntries == 0 )
+		return AK_Success;
+
+	if ( Reserve( uNumEntries ) != AK_Success )
+	{
+		Term();
+		m_bValid = false;
+		return AK_InsufficientMemory;
+	}
+
+	// Packages are listed from the most recently loaded: do not override keys.
+	it = in_packages.Begin();
+	while ( it != in_packages.End() )
+	{
+		AddEntries( *it, true, false );
+		AddEntries( *it, false, false );
+		++it;
+	}
+	return AK_Success;
+}
+
+// Find a file entry by ID. Returns the package containing the file, or NULL if it is not indexed.
+CAkFilePackage * CAkFilePackageIndex::LookupFile(
+	AkFileID			in_fileID,		// File ID.
+	AkFileSystemFlags *	in_pFlags,		// Special flags. Do not pass NULL.
+	const CAkFilePackageLUT::AkFileEntry *& out_pEntry	// Returned file entry.
+	)
+{
+	AKASSERT( m_bValid && in_pFlags && in_pFlags->uCompanyID == AKCOMPANYID_AUDIOKINETIC );
+
+	if ( !m_pTable )
+		return NULL;
+
+	AkIndexEntry * pSlot = FindSlot( in_fileID, GetKey( in_pFlags->uCodecID == AKCODECID_BANK, in_pFlags->bIsLanguageSpecific ) );
+	if ( pSlot->uKey )
+	{
+		out_pEntry = pSlot->pEntry;
+		return pSlot->pPackage;
+	}
+	return NULL;
+}
+
+// Adds the entries of one of the LUTs of a package.
+// If in_bOverride is false, keys that are already indexed are left untouched.
+void CAkFilePackageIndex::AddEntries(
+	CAkFilePackage *	in_pPackage,	// Package.
+	bool				in_bSoundBanks,	// True: soundbanks LUT. False: streamed files LUT.
+	bool				in_bOverride	// True: replace existing keys.
+	)
+{
+	AkUInt32 uNumFiles;
+	const CAkFilePackageLUT::AkFileEntry * pEntries = GetIndexedEntries( in_pPackage, in_bSoundBanks, uNumFiles );
+	AkUInt16 uCurLangID = in_pPackage->lut.CurLanguageID();
+
+	for ( AkUInt32 uEntry = 0; uEntry < uNumFiles; uEntry++ )
+	{
+		const CAkFilePackageLUT::AkFileEntry & entry = pEntries[uEntry];
+		if ( !IsIndexed( entry, uCurLangID ) )
+			continue;
+
+		AkUInt32 uKey = GetKey( in_bSoundBanks, entry.uLanguageID != CAkFilePackageLUT::AK_INVALID_LANGUAGE_ID );
+		AkIndexEntry * pSlot = FindSlot( entry.fileID, uKey );
+		if ( !pSlot->uKey )
+		{
+			AKASSERT( m_uNumEntries < m_uNumSlots / 2 + 1 );
+			pSlot->fileID	= entry.fileID;
+			pSlot->uKey		= uKey;
+			++m_uNumEntries;
+		}
+		else if ( !in_bOverride )
+			continue;
+
+		pSlot->pPackage	= in_pPackage;
+		pSlot->pEntry	= &entry;
+	}
+}
+
+// Removes the entries of one of the LUTs of a package, and restores the entries it was overriding.
+void CAkFilePackageIndex::RemoveEntries(
+	CAkFilePackage *	in_pPackage,	// Package.
+	bool				in_bSoundBanks,	// True: soundbanks LUT. False: streamed files LUT.
+	ListFilePackages &	in_packages		// Remaining packages, most recently loaded first.
+	)
+{
+	AkUInt32 uNumFiles;
+	const CAkFilePackageLUT::AkFileEntry * pEntries = GetIndexedEntries( in_pPackage, in_bSoundBanks, uNumFiles );
+	AkUInt16 uCurLangID = in_pPackage->lut.CurLanguageID();
+
+	for ( AkUInt32 uEntry = 0; uEntry < uNumFiles; uEntry++ )
+	{
+		const CAkFilePackageLUT::AkFileEntry & entry = pEntries[uEntry];
+		if ( !IsIndexed( entry, uCurLangID ) )
+			continue;
+
+		bool bLangSpecific = ( entry.uLanguageID != CAkFilePackageLUT::AK_INVALID_LANGUAGE_ID );
+		AkIndexEntry * pSlot = FindSlot( entry.fileID, GetKey( in_bSoundBanks, bLangSpecific ) );
+		AKASSERT( pSlot->uKey || !"Entry of a loaded package is not indexed" );
+		if ( pSlot->pPackage != in_pPackage )
+			continue;	// Overridden by a more recent package.
+
+		// Find the most recent package that also contains this file.
+		bool bFound = false;
+		ListFilePackages::Iterator it = in_packages.Begin();
+		while ( it != in_packages.End() && !bFound )
+		{
+			// Language-specific entries of packages without a valid language are not indexed.
+			if ( !bLangSpecific || (*it)->lut.CurLanguageID() != CAkFilePackageLUT::AK_INVALID_LANGUAGE_ID )
+			{
+				// Soundbanks are searched in the streamed files LUT of packages that have no soundbanks LUT.
+				AkUInt32 uNumSoundBanks;
+				bool bSearchSoundBanks = in_bSoundBanks && (*it)->lut.GetFileEntries( true, uNumSoundBanks );
+				const CAkFilePackageLUT::AkFileEntry * pOtherEntry = (*it)->lut.LookupFile( entry.fileID, bSearchSoundBanks, bLangSpecific );
+				if ( pOtherEntry )
+				{
+					pSlot->pPackage = *it;
+					pSlot->pEntry	= pOtherEntry;
+					bFound = true;
+				}
+			}
+			++it;
+		}
+
+		if ( !bFound )
+			EraseSlot( pSlot );
+	}
+}
+
+// Makes sure that the table can hold in_uNumEntries with a load factor of 1/2 at most.
+AKRESULT CAkFilePackageIndex::Reserve(
+	AkUInt32			in_uNumEntries	// Number of entries.
+	)
+{
+	AkUInt32 uNumSlots = AK_PACKAGE_INDEX_MIN_SLOTS;
+	while ( uNumSlots < 2 * in_uNumEntries )
+		uNumSlots *= 2;
+
+	if ( m_pTable && m_uNumSlots >= uNumSlots )
+		return AK_Success;
+
+	// Create a new table in its own pool, and rehash current entries into it.
+	AkUInt32 uMemSize = uNumSlots * sizeof( AkIndexEntry );
+	AkMemPoolId poolID = AK::MemoryMgr::CreatePool( NULL, uMemSize, uMemSize, AkMalloc | AkFixedSizeBlocksMode );
+	if ( poolID == AK_INVALID_POOL_ID )
+		return AK_InsufficientMemory;
+	AK_SETPOOLNAME( poolID, AKTEXT("File Package Index") );
+
+	AkIndexEntry * pNewTable = (AkIndexEntry*)AK::MemoryMgr::GetBlock( poolID );
+	if ( !pNewTable )
+	{
+		AKVERIFY( AK::MemoryMgr::DestroyPool( poolID ) == AK_Success );
+		return AK_InsufficientMemory;
+	}
+	memset( pNewTable, 0, uMemSize );
+
+	AkIndexEntry * pOldTable = m_pTable;
+	AkMemPoolId oldPoolID = m_poolID;
+	AkUInt32 uOldNumSlots = m_uNumSlots;
+
+	m_pTable = pNewTable;
+	m_poolID = poolID;
+	m_uNumSlots = uNumSlots;
+
+	for ( AkUInt32 uSlot = 0; uSlot < uOldNumSlots; uSlot++ )
+	{
+		if ( pOldTable[uSlot].uKey )
+		{
+			AkIndexEntry * pSlot = FindSlot( pOldTable[uSlot].fileID, pOldTable[uSlot].uKey );
+			AKASSERT( !pSlot->uKey );
+			*pSlot = pOldTable[uSlot];
+		}
+	}
+
+	FreeTable( oldPoolID, pOldTable );
+	return AK_Success;
+}
+
+// Returns the number of indexable entries of a package (upper bound, for Reserve()).
+AkUInt32 CAkFilePackageIndex::NumEntries(
+	CAkFilePackage *	in_pPackage		// Package.
+	)
+{
+	AkUInt32 uNumSoundBanks, uNumStmFiles;
+	GetIndexedEntries( in_pPackage, true, uNumSoundBanks );
+	GetIndexedEntries( in_pPackage, false, uNumStmFiles );
+	return uNumSoundBanks + uNumStmFiles;
+}
+
+// Returns the entries of a package that are indexed under the soundbanks or the streamed files key.
+// Soundbanks are taken from the streamed files LUT if the package has no soundbanks LUT (see CAkFilePackageLUT::LookupFile()).
+const CAkFilePackageLUT::AkFileEntry * CAkFilePackageIndex::GetIndexedEntries(
+	CAkFilePackage *	in_pPackage,	// Package.
+	bool				in_bSoundBanks,	// True: soundbanks key. False: streamed files key.
+	AkUInt32 &			out_uNumFiles	// Returned number of entries.
+	)
+{
+	const CAkFilePackageLUT::AkFileEntry * pEntries = in_pPackage->lut.GetFileEntries( in_bSoundBanks, out_uNumFiles );
+	if ( !pEntries && in_bSoundBanks )
+		pEntries = in_pPackage->lut.GetFileEntries( false, out_uNumFiles );
+	return pEntries;
+}
+
+// Returns the slot of a key, or the free slot where it should be inserted.
+CAkFilePackageIndex::AkIndexEntry * CAkFilePackageIndex::FindSlot(
+	AkFileID			in_fileID,		// File ID.
+	AkUInt32			in_uKey			// Key flags.
+	)
+{
+	AKASSERT( m_pTable && m_uNumEntries < m_uNumSlots );
+	return IndexTable::FindSlot( m_pTable, m_uNumSlots, in_fileID, in_uKey );
+}
+
+// Frees a slot, and shifts back the entries that follow it in their probing sequence,
+// so that no tombstone is needed.
+void CAkFilePackageIndex::EraseSlot(
+	AkIndexEntry *		in_pSlot		// Slot to free.
+	)
+{
+	IndexTable::EraseSlot( m_pTable, m_uNumSlots, in_pSlot );
+	--m_uNumEntries;
+}
+
+// Frees the table and its memory pool.
+void CAkFilePackageIndex::FreeTable(
+	AkMemPoolId			in_poolID,		// Pool of the table.
+	AkIndexEntry *		in_pTable		// Table.
+	)
+{
+	if ( in_poolID != AK_INVALID_POOL_ID )
+	{
+		if ( in_pTable )
+			AK::MemoryMgr::ReleaseBlock( in_poolID, in_pTable );
+		AKVERIFY( AK::MemoryMgr::DestroyPool( in_poolID ) == AK_Success );
+	}
+}
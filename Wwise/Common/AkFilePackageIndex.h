@@ -0,0 +1,188 @@
+//////////////////////////////////////////////////////////////////////
+//
+// AkFilePackageIndex.h
+//
+// This class merges the look-up tables of all loaded file packages
+// (CAkFilePackage) into a single open-addressing hash table, so that
+// a file can be found with a single probe, regardless of the number
+// of packages loaded.
+//
+// Entries are keyed on the file ID, the LUT in which they are stored
+// (soundbanks or streamed files), and whether they are language-specific.
+// Like CAkFilePackageLUT::LookupFile(), soundbanks of a package that has no
+// soundbanks LUT are searched in its streamed files LUT: the entries of the
+// latter are then also indexed as soundbanks.
+// Language-specific entries are indexed only if they match the current
+// language of their package: the index must thus be rebuilt when the
+// language changes.
+//
+// The most recently loaded package overrides the others: when a file is
+// present in more than one package, the index refers to the entry of the
+// last one that was loaded (consistent with the order in which packages are
+// searched). When a package is unloaded, the entries that it was overriding
+// are restored from the remaining packages.
+//
+// Copyright (c) 2007-2009 Audiokinetic Inc. / All Rights Reserved
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef _AK_FILE_PACKAGE_INDEX_H_
+#define _AK_FILE_PACKAGE_INDEX_H_
+
+#include "AkFilePackage.h"
+#include "AkOpenAddressingTable.h"
+
+//-----------------------------------------------------------------------------
+// Name: class CAkFilePackageIndex.
+// Desc: Open-addressing (linear probing) hash table of the file entries of
+//		 all loaded packages. The table is stored in its own memory pool,
+//		 which is recreated when the table needs to grow.
+//		 If memory cannot be allocated, the index becomes invalid (see IsValid())
+//		 and users should search each package instead, until it is rebuilt.
+//-----------------------------------------------------------------------------
+class CAkFilePackageIndex
+{
+public:
+
+	CAkFilePackageIndex();
+	~CAkFilePackageIndex();
+
+	// Releases the table. The index is valid (and empty) afterwards.
+	void Term();
+
+	// Adds the entries of a package that was just loaded. They override
+	// the entries of the packages already indexed.
+	// Returns AK_Success, or AK_InsufficientMemory, in which case the index is invalidated.
+	AKRESULT AddPackage(
+		CAkFilePackage *	in_pPackage		// Package that was just loaded.
+		);
+
+	// Removes the entries of a package that is about to be unloaded, and restores
+	// the entries that it was overriding.
+	void RemovePackage(
+		CAkFilePackage *	in_pPackage,	// Package to remove. Must not be part of in_packages anymore.
+		ListFilePackages &	in_packages		// Remaining packages, most recently loaded first.
+		);
+
+	// Rebuilds the index from scratch, typically after the language changed.
+	// Returns AK_Success, or AK_InsufficientMemory, in which case the index is invalidated.
+	AKRESULT Rebuild(
+		ListFilePackages &	in_packages		// Loaded packages, most recently loaded first.
+		);
+
+	// Find a file entry by ID. Returns the package containing the file, or NULL if it is not indexed.
+	CAkFilePackage * LookupFile(
+		AkFileID			in_fileID,		// File ID.
+		AkFileSystemFlags *	in_pFlags,		// Special flags. Do not pass NULL.
+		const CAkFilePackageLUT::AkFileEntry *& out_pEntry	// Returned file entry.
+		);
+
+	// Returns false if the index could not be built. Packages must be searched one by one until it is rebuilt successfully.
+	inline bool IsValid() { return m_bValid; }
+
+protected:
+
+	// Key flags.
+	enum AkIndexKeyFlags
+	{
+		AK_INDEX_KEY_VALID			= 0x1,	// Slot is used.
+		AK_INDEX_KEY_SOUNDBANK		= 0x2,	// Entry of the soundbanks LUT (streamed files LUT otherwise).
+		AK_INDEX_KEY_LANG_SPECIFIC	= 0x4	// Entry is language-specific.
+	};
+
+	struct AkIndexEntry
+	{
+		AkFileID			fileID;		// File ID.
+		AkUInt32			uKey;		// Combination of AkIndexKeyFlags. 0 if the slot is free.
+		CAkFilePackage *	pPackage;	// Package that contains the file.
+		const CAkFilePackageLUT::AkFileEntry * pEntry;	// Entry in the package's LUT.
+	};
+
+	// Adds the entries of one of the LUTs of a package.
+	// If in_bOverride is false, keys that are already indexed are left untouched.
+	void AddEntries(
+		CAkFilePackage *	in_pPackage,	// Package.
+		bool				in_bSoundBanks,	// True: soundbanks LUT. False: streamed files LUT.
+		bool				in_bOverride	// True: replace existing keys.
+		);
+
+	// Removes the entries of one of the LUTs of a package, and restores the entries it was overriding.
+	void RemoveEntries(
+		CAkFilePackage *	in_pPackage,	// Package.
+		bool				in_bSoundBanks,	// True: soundbanks LUT. False: streamed files LUT.
+		ListFilePackages &	in_packages		// Remaining packages, most recently loaded first.
+		);
+
+	// Makes sure that the table can hold in_uNumEntries with a load factor of 1/2 at most.
+	AKRESULT Reserve(
+		AkUInt32			in_uNumEntries	// Number of entries.
+		);
+
+	// Returns the number of indexable entries of a package (upper bound, for Reserve()).
+	static AkUInt32 NumEntries(
+		CAkFilePackage *	in_pPackage		// Package.
+		);
+
+	// Returns the entries of a package that are indexed under the soundbanks or the streamed files key.
+	// Soundbanks are taken from the streamed files LUT if the package has no soundbanks LUT.
+	static const CAkFilePackageLUT::AkFileEntry * GetIndexedEntries(
+		CAkFilePackage *	in_pPackage,	// Package.
+		bool				in_bSoundBanks,	// True: soundbanks key. False: streamed files key.
+		AkUInt32 &			out_uNumFiles	// Returned number of entries.
+		);
+
+	// Returns true if a LUT entry should be indexed, given the current language of its package.
+	static inline bool IsIndexed(
+		const CAkFilePackageLUT::AkFileEntry & in_entry,	// LUT entry.
+		AkUInt16			in_uCurLangID	// Current language of the package.
+		)
+	{
+		return ( in_entry.uLanguageID == CAkFilePackageLUT::AK_INVALID_LANGUAGE_ID
+			|| in_entry.uLanguageID == in_uCurLangID );
+	}
+
+	// Returns the key of a LUT entry.
+	static inline AkUInt32 GetKey(
+		bool				in_bSoundBank,		// True: soundbanks LUT.
+		bool				in_bLangSpecific	// True: language-specific entry.
+		)
+	{
+		return AK_INDEX_KEY_VALID
+			| ( in_bSoundBank ? AK_INDEX_KEY_SOUNDBANK : 0 )
+			| ( in_bLangSpecific ? AK_INDEX_KEY_LANG_SPECIFIC : 0 );
+	}
+
+	// Access to the keys of a slot (see AkOpenAddressingTable).
+	struct AkIndexKeys
+	{
+		static inline AkUInt32 GetID( const AkIndexEntry & in_slot ) { return in_slot.fileID; }
+		static inline AkUInt32 & Flags( AkIndexEntry & in_slot ) { return in_slot.uKey; }
+	};
+	typedef AkOpenAddressingTable<AkIndexEntry,AkIndexKeys> IndexTable;
+
+	// Returns the slot of a key, or the free slot where it should be inserted.
+	AkIndexEntry * FindSlot(
+		AkFileID			in_fileID,		// File ID.
+		AkUInt32			in_uKey			// Key flags.
+		);
+
+	// Frees a slot, and shifts back the entries that follow it in their probing sequence.
+	void EraseSlot(
+		AkIndexEntry *		in_pSlot		// Slot to free.
+		);
+
+	// Frees the table and its memory pool.
+	void FreeTable(
+		AkMemPoolId			in_poolID,		// Pool of the table.
+		AkIndexEntry *		in_pTable		// Table.
+		);
+
+protected:
+	AkIndexEntry *		m_pTable;		// Slots. NULL until the first package is added.
+	AkMemPoolId			m_poolID;		// Memory pool of the table.
+	AkUInt32			m_uNumSlots;	// Number of slots (power of 2).
+	AkUInt32			m_uNumEntries;	// Number of used slots.
+	bool				m_bValid;		// False if the index could not be built.
+};
+
+#endif //_AK_FILE_PACKAGE_INDEX_H_
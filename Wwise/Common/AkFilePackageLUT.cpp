@@ -38,14 +38,29 @@
 CAkFilePackageLUT::CAkFilePackageLUT()
 :m_curLangID( AK_INVALID_LANGUAGE_ID )
 ,m_pLangMap( NULL )
+,m_pHashedLangMap( NULL )
+,m_pSoundBankNames( NULL )
 ,m_pSoundBanks( NULL )
 ,m_pStmFiles( NULL )
+,m_indexPoolID( AK_INVALID_POOL_ID )
 {
 	AK_STATIC_ASSERT(sizeof(AkFileEntry) == 24);
+	m_soundBanksIndex.pKeys = NULL;
+	m_soundBanksIndex.pEntries = NULL;
+	m_soundBanksIndex.uNumKeys = 0;
+	m_stmFilesIndex.pKeys = NULL;
+	m_stmFilesIndex.pEntries = NULL;
+	m_stmFilesIndex.uNumKeys = 0;
 }
 
 CAkFilePackageLUT::~CAkFilePackageLUT()
 {
+	if ( m_indexPoolID != AK_INVALID_POOL_ID )
+	{
+		// Search indexes are stored in a single block, starting with the soundbanks keys.
+		AK::MemoryMgr::ReleaseBlock( m_indexPoolID, m_soundBanksIndex.pKeys );
+		AKVERIFY( AK::MemoryMgr::DestroyPool( m_indexPoolID ) == AK_Success );
+	}
 }
 
 // Create a new LUT from a packaged file header.
@@ -63,32 +78,106 @@ AKRESULT CAkFilePackageLUT::Setup(
 		AkUInt32			uSoundBanksLUTSize;
 		AkUInt32			uStmFilesLUTSize;
 	};
+	// Version 2 and up.
+	struct FileHeaderFormatV2 : public FileHeaderFormat
+	{
+		AkUInt32			uSoundBankNamesMapSize;
+	};
 	FileHeaderFormat * pHeader = (FileHeaderFormat*)in_pData;
 
-	// Check header size,
+	// Check version.
 	if ( in_uHeaderSize < sizeof(FileHeaderFormat)
+		|| pHeader->uVersion < AKPK_MIN_VERSION )
+		return AK_Fail;
+	bool bHashedMaps = ( pHeader->uVersion >= AKPK_HASHED_MAPS_VERSION );
+
+	// Check header size,
+	AkUInt32 uHeaderFormatSize = bHashedMaps ? sizeof(FileHeaderFormatV2) : sizeof(FileHeaderFormat);
+	AkUInt32 uSoundBankNamesMapSize = bHashedMaps ? ((FileHeaderFormatV2*)pHeader)->uSoundBankNamesMapSize : 0;
+	if ( in_uHeaderSize < uHeaderFormatSize
 			+ pHeader->uLanguageMapSize
 			+ pHeader->uSoundBanksLUTSize
-			+ pHeader->uStmFilesLUTSize )
+			+ pHeader->uStmFilesLUTSize
+			+ uSoundBankNamesMapSize )
 	{
 		return AK_Fail;
 	}
 
-	// Check version.
-	if ( pHeader->uVersion < AKPK_CURRENT_VERSION )
-		return AK_Fail;
-
 	// Get address of maps and LUTs.
-	in_pData += sizeof(FileHeaderFormat);
-	m_pLangMap		= (StringMap*)in_pData;
+	in_pData += uHeaderFormatSize;
+	if ( bHashedMaps )
+		m_pHashedLangMap = (HashedStringMap*)in_pData;
+	else
+		m_pLangMap	= (StringMap*)in_pData;
 	in_pData += pHeader->uLanguageMapSize;
 	m_pSoundBanks	= (FileLUT*)in_pData;
 	in_pData += pHeader->uSoundBanksLUTSize;
 	m_pStmFiles		= (FileLUT*)in_pData;
+	in_pData += pHeader->uStmFilesLUTSize;
+	if ( uSoundBankNamesMapSize > 0 )
+		m_pSoundBankNames = (HashedStringMap*)in_pData;
+
+	// Build search indexes. If it fails, LUTs are searched directly.
+	BuildIndexes();
 	
 	return AK_Success;
 }
 
+// Helper: Builds the search indexes of both file LUTs, in their own memory pool.
+// If memory cannot be allocated, files are searched directly in the LUTs.
+void CAkFilePackageLUT::BuildIndexes()
+{
+	AkUInt32 uNumSoundBanks = m_pSoundBanks->NumFiles();
+	AkUInt32 uNumStmFiles = m_pStmFiles->NumFiles();
+	if ( uNumSoundBanks + uNumStmFiles == 0 )
+		return;
+
+	// Indexes are 1-based: reserve one more key for each.
+	AkUInt32 uMemSize = ( uNumSoundBanks + uNumStmFiles + 2 ) * ( sizeof( AkUInt64 ) + sizeof( AkUInt32 ) );
+	m_indexPoolID = AK::MemoryMgr::CreatePool( NULL, uMemSize, uMemSize, AkMalloc | AkFixedSizeBlocksMode );
+	if ( m_indexPoolID == AK_INVALID_POOL_ID )
+		return;
+	AK_SETPOOLNAME( m_indexPoolID, AKTEXT("File Package LUT Index") );
+
+	AkUInt8 * pMem = (AkUInt8*)AK::MemoryMgr::GetBlock( m_indexPoolID );
+	if ( !pMem )
+	{
+		AKVERIFY( AK::MemoryMgr::DestroyPool( m_indexPoolID ) == AK_Success );
+		m_indexPoolID = AK_INVALID_POOL_ID;
+		return;
+	}
+
+	// Keys of both indexes first (alignment), then entry positions.
+	m_soundBanksIndex.pKeys		= (AkUInt64*)pMem;
+	m_stmFilesIndex.pKeys		= m_soundBanksIndex.pKeys + uNumSoundBanks + 1;
+	m_soundBanksIndex.pEntries	= (AkUInt32*)( m_stmFilesIndex.pKeys + uNumStmFiles + 1 );
+	m_stmFilesIndex.pEntries	= m_soundBanksIndex.pEntries + uNumSoundBanks + 1;
+	m_soundBanksIndex.uNumKeys	= uNumSoundBanks;
+	m_stmFilesIndex.uNumKeys	= uNumStmFiles;
+
+	AKVERIFY( FillIndex( m_pSoundBanks->FileEntries(), m_soundBanksIndex, 0, 1 ) == uNumSoundBanks );
+	AKVERIFY( FillIndex( m_pStmFiles->FileEntries(), m_stmFilesIndex, 0, 1 ) == uNumStmFiles );
+}
+
+// Helper: Fills the search index of a LUT recursively (in-order traversal of the implicit tree).
+// Returns the position in the LUT of the next entry to place.
+AkUInt32 CAkFilePackageLUT::FillIndex(
+	const AkFileEntry *	in_pEntries,	// LUT entries, sorted.
+	FileLUTIndex &		io_index,		// Index to fill.
+	AkUInt32			in_uEntry,		// Position in the LUT of the next entry to place.
+	AkUInt32			in_uNode		// Node of the index to fill (1-based).
+	)
+{
+	if ( in_uNode <= io_index.uNumKeys )
+	{
+		in_uEntry = FillIndex( in_pEntries, io_index, in_uEntry, 2 * in_uNode );
+		io_index.pKeys[in_uNode] = MakeKey( in_pEntries[in_uEntry].fileID, in_pEntries[in_uEntry].uLanguageID );
+		io_index.pEntries[in_uNode] = in_uEntry;
+		in_uEntry = FillIndex( in_pEntries, io_index, in_uEntry + 1, 2 * in_uNode + 1 );
+	}
+	return in_uEntry;
+}
+
 // Find a file entry by ID.
 const CAkFilePackageLUT::AkFileEntry * CAkFilePackageLUT::LookupFile(
 	AkFileID			in_uID,			// File ID.
@@ -101,21 +190,52 @@ const CAkFilePackageLUT::AkFileEntry * CAkFilePackageLUT::LookupFile(
 		&& m_pSoundBanks
 		&& m_pSoundBanks->HasFiles() )
 	{
-		return LookupFile( in_uID, m_pSoundBanks, in_pFlags->bIsLanguageSpecific );
+		return LookupFile( in_uID, m_pSoundBanks, m_soundBanksIndex, in_pFlags->bIsLanguageSpecific );
 	}
 	else if ( m_pStmFiles && m_pStmFiles->HasFiles() )
 	{
 		// We assume that the file is a streamed audio file.
-		return LookupFile( in_uID, m_pStmFiles, in_pFlags->bIsLanguageSpecific );
+		return LookupFile( in_uID, m_pStmFiles, m_stmFilesIndex, in_pFlags->bIsLanguageSpecific );
 	}
 	// No table loaded.
 	return NULL;
 }
 
+// Find a file entry by ID in the soundbanks or the streamed files LUT.
+const CAkFilePackageLUT::AkFileEntry * CAkFilePackageLUT::LookupFile(
+	AkFileID			in_uID,					// File ID.
+	bool				in_bSoundBank,			// True: search the soundbanks LUT. False: search the streamed files LUT.
+	bool				in_bIsLanguageSpecific	// True: match current language ID.
+	)
+{
+	const FileLUT * pLut = in_bSoundBank ? m_pSoundBanks : m_pStmFiles;
+	if ( pLut && pLut->HasFiles() )
+		return LookupFile( in_uID, pLut, in_bSoundBank ? m_soundBanksIndex : m_stmFilesIndex, in_bIsLanguageSpecific );
+	return NULL;
+}
+
+// Get the entries of the soundbanks or the streamed files LUT (sorted by file ID, then by language ID).
+// Returns NULL if the LUT is empty.
+const CAkFilePackageLUT::AkFileEntry * CAkFilePackageLUT::GetFileEntries(
+	bool				in_bSoundBanks,			// True: soundbanks LUT. False: streamed files LUT.
+	AkUInt32 &			out_uNumFiles			// Returned number of entries.
+	) const
+{
+	const FileLUT * pLut = in_bSoundBanks ? m_pSoundBanks : m_pStmFiles;
+	if ( pLut && pLut->HasFiles() )
+	{
+		out_uNumFiles = pLut->NumFiles();
+		return pLut->FileEntries();
+	}
+	out_uNumFiles = 0;
+	return NULL;
+}
+
 // Helper: Find a file entry by ID.
 const CAkFilePackageLUT::AkFileEntry * CAkFilePackageLUT::LookupFile(
 	AkFileID			in_uID,					// File ID.
 	const FileLUT *		in_pLut,				// LUT to search.
+	const FileLUTIndex &in_index,				// Search index of this LUT.
 	bool				in_bIsLanguageSpecific	// True: match language ID.
 	)
 {
@@ -124,6 +244,27 @@ const CAkFilePackageLUT::AkFileEntry * CAkFilePackageLUT::LookupFile(
 	AKASSERT( pTable && in_pLut->HasFiles() );
 	AkUInt16 uLangID = in_bIsLanguageSpecific ? m_curLangID : AK_INVALID_LANGUAGE_ID;
 
+	if ( in_index.pKeys )
+	{
+		// Branchless descent of the implicit tree: go right when the key of the node is smaller.
+		const AkUInt64 * pKeys = in_index.pKeys;
+		AkUInt64 key = MakeKey( in_uID, uLangID );
+		AkUInt32 uNumKeys = in_index.uNumKeys;
+		AkUInt32 uNode = 1;
+		while ( uNode <= uNumKeys )
+			uNode = 2 * uNode + ( pKeys[uNode] < key );
+
+		// The lower bound is the node where we last went left: undo the right turns that followed, then the left one.
+		while ( uNode & 1 )
+			uNode >>= 1;
+		uNode >>= 1;
+
+		// Fetch the entry only if its key matches.
+		if ( uNode && pKeys[uNode] == key )
+			return pTable + in_index.pEntries[uNode];
+		return NULL;
+	}
+
 	// Binary search. LUT items should be sorted by fileID, then by language ID.
 	AkInt32 uTop = 0, uBottom = in_pLut->NumFiles()-1;
 	do
@@ -157,7 +298,14 @@ AKRESULT CAkFilePackageLUT::SetCurLanguage(
 	)
 {
 	m_curLangID = AK_INVALID_LANGUAGE_ID;
-	if ( m_pLangMap && in_pszLanguage )
+	if ( m_pHashedLangMap && in_pszLanguage )
+	{
+		AkUInt16 uLangID = (AkUInt16)m_pHashedLangMap->GetID( in_pszLanguage, false );
+		if ( uLangID == AK_INVALID_UNIQUE_ID )
+			return AK_InvalidLanguage;
+		m_curLangID = uLangID;
+	}
+	else if ( m_pLangMap && in_pszLanguage )
 	{
 		AkUInt16 uLangID = (AkUInt16)m_pLangMap->GetID( in_pszLanguage );
 		if ( uLangID == AK_INVALID_UNIQUE_ID )
@@ -189,6 +337,14 @@ AkFileID CAkFilePackageLUT::GetSoundBankID(
 {
 	if ( m_pSoundBanks )
 	{
+		// Use the soundbank names map if the package has one. Its IDs are those of GetIDFromString().
+		if ( m_pSoundBankNames )
+		{
+			AkFileID fileID = m_pSoundBankNames->GetID( in_pszBankName, true );
+			if ( fileID != AK_INVALID_UNIQUE_ID )
+				return fileID;
+		}
+
 		// Remove the file extension if it was used.
 		AkUInt32 stringSize = (AkUInt32)AKPLATFORM::OsStrLen( in_pszBankName ) + 1;
 		AkOSChar* pStringWithoutExtension = (AkOSChar *)AkAlloca( (stringSize) * sizeof( AkOSChar ) );
@@ -245,3 +401,35 @@ AkUInt32 CAkFilePackageLUT::StringMap::GetID( const AkOSChar* in_pszString )
 	// ID not found.
 	return AK_INVALID_UNIQUE_ID;
 }
+
+AkUInt32 CAkFilePackageLUT::HashedStringMap::GetID( 
+	const AkOSChar*	in_pszString,		// String. Case insensitive.
+	bool			in_bStopAtExtension	// True: ignore the extension of in_pszString.
+	)
+{
+	if ( m_uNumStrings == 0 )
+		return AK_INVALID_UNIQUE_ID;
+
+	// 'this' is m_uNumStrings. +1 points to the beginning of the StringEntry array,
+	// which is followed by the number of buckets and their displacement.
+	const StringEntry * pTable = (StringEntry*)((AkUInt32*)this + 1);
+	const AkUInt32 * pBuckets = (AkUInt32*)( pTable + m_uNumStrings );
+	AKASSERT( pBuckets[0] > 0 );
+
+	AkUInt32 uHash1, uHash2;
+	HashString( in_pszString, in_bStopAtExtension, uHash1, uHash2 );
+	AkUInt32 uSlot = GetHashedSlot( uHash1, uHash2, pBuckets[ 1 + uHash1 % pBuckets[0] ], m_uNumStrings );
+
+	// The slot holds the only candidate: verify it (packaged strings are lower case).
+	const AkOSChar * pString = (AkOSChar*)((AkUInt8*)this + pTable[ uSlot ].uOffset);
+	while ( *pString == ToLower( *in_pszString ) && *pString != 0 )
+	{
+		++pString;
+		++in_pszString;
+	}
+	if ( *pString == 0 && IsEndOfString( *in_pszString, in_bStopAtExtension ) )
+		return pTable[ uSlot ].uID;
+
+	// ID not found.
+	return AK_INVALID_UNIQUE_ID;
+}
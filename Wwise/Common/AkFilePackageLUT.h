@@ -16,6 +16,13 @@
 // matches the name of the directory that is created by the Wwise Bank Manager,
 // except for the trailing slash.
 //
+// Starting with version 2, string maps (languages and soundbank names) are
+// stored in hash order along with the displacements of a minimal perfect hash
+// function (see CAkFilePackageStringMapWriter), so that a string is resolved
+// with a single hash of its characters and one string comparison, without
+// being copied. Version 1 packages are still searched with the original
+// binary search.
+//
 // Copyright (c) 2007-2009 Audiokinetic Inc. / All Rights Reserved
 //
 //////////////////////////////////////////////////////////////////////
@@ -27,7 +34,9 @@
 #include <AK/Tools/Common/AkAssert.h>
 
 // AK file packager definitions.
-#define AKPK_CURRENT_VERSION		(1)
+#define AKPK_CURRENT_VERSION		(2)
+#define AKPK_MIN_VERSION			(1)	// Oldest version that can be parsed.
+#define AKPK_HASHED_MAPS_VERSION	(2)	// First version with hashed string maps and a soundbank names map.
 
 #define AKPK_HEADER_CHUNK_DEF_SIZE	(8)	// The header chunk definition is 8 bytes wide.
 
@@ -53,6 +62,14 @@ public:
         AkUInt32	uLanguageID;// Language ID. AK_INVALID_LANGUAGE_ID if not language-specific. 
     };
 
+	// Entry of a string map.
+	struct StringEntry
+	{
+		AkUInt32	uOffset;	// Byte offset of the string in the packaged strings section, 
+								// from beginning of the string map.
+		AkUInt32	uID;		// ID.
+	};
+
     CAkFilePackageLUT();
     virtual ~CAkFilePackageLUT();
 
@@ -69,6 +86,23 @@ public:
 		AkFileSystemFlags * in_pFlags			// Special flags. Do not pass NULL.
 		);
 
+	// Find a file entry by ID in the soundbanks or the streamed files LUT.
+	const AkFileEntry * LookupFile(
+		AkFileID			in_uID,					// File ID.
+		bool				in_bSoundBank,			// True: search the soundbanks LUT. False: search the streamed files LUT.
+		bool				in_bIsLanguageSpecific	// True: match current language ID.
+		);
+
+	// Get the entries of the soundbanks or the streamed files LUT (sorted by file ID, then by language ID).
+	// Returns NULL if the LUT is empty.
+	const AkFileEntry * GetFileEntries(
+		bool				in_bSoundBanks,			// True: soundbanks LUT. False: streamed files LUT.
+		AkUInt32 &			out_uNumFiles			// Returned number of entries.
+		) const;
+
+	// Get current language ID.
+	inline AkUInt16 CurLanguageID() const { return m_curLangID; }
+
 	// Set current language.
 	// Returns AK_InvalidLanguage if a package is loaded but the language string cannot be found.
 	// Returns AK_Success otherwise.
@@ -82,6 +116,62 @@ public:
 		const AkOSChar*			in_pszBankName		// Soundbank name.
 		);
 
+	//
+	// Hashed string maps (version 2 and up).
+	// Shared by the run-time look-up and the packager-side writer (CAkFilePackageStringMapWriter).
+	//
+
+	// Returns the lower case version of an ASCII character.
+	static inline AkOSChar ToLower( AkOSChar in_char )
+	{
+		return ( in_char >= AKTEXT('A') && in_char <= AKTEXT('Z') ) ? (AkOSChar)( in_char + ( AKTEXT('a') - AKTEXT('A') ) ) : in_char;
+	}
+
+	// Returns true if in_char ends a string (or its name part, if in_bStopAtExtension).
+	static inline bool IsEndOfString( AkOSChar in_char, bool in_bStopAtExtension )
+	{
+		return ( in_char == 0 || ( in_bStopAtExtension && in_char == AKTEXT('.') ) );
+	}
+
+	// Computes two independent hashes of the lower case version of a string, in a single pass:
+	// FNV-1a and a multiplicative (x31) hash of its characters.
+	static inline void HashString(
+		const AkOSChar *	in_pszString,		// String.
+		bool				in_bStopAtExtension,// True: ignore the extension (from the first '.').
+		AkUInt32 &			out_uHash1,			// Returned first hash: selects a displacement.
+		AkUInt32 &			out_uHash2			// Returned second hash: displaced to get the slot.
+		)
+	{
+		AkUInt32 uHash1 = 2166136261U;
+		AkUInt32 uHash2 = 0;
+		while ( !IsEndOfString( *in_pszString, in_bStopAtExtension ) )
+		{
+			AkUInt32 uChar = (AkUInt32)ToLower( *in_pszString++ );
+			uHash1 = ( uHash1 ^ uChar ) * 16777619U;
+			uHash2 = uHash2 * 31 + uChar;
+		}
+		out_uHash1 = uHash1;
+		out_uHash2 = uHash2;
+	}
+
+	// Returns the slot of a string in a hashed map of in_uNumStrings strings, given its hashes and displacement.
+	static inline AkUInt32 GetHashedSlot(
+		AkUInt32			in_uHash1,			// First hash of the string.
+		AkUInt32			in_uHash2,			// Second hash of the string.
+		AkUInt32			in_uDisplacement,	// Displacement of the bucket of the string (selected with in_uHash1).
+		AkUInt32			in_uNumStrings		// Number of strings in the map.
+		)
+	{
+		AkUInt32 uHash = in_uHash2 + in_uDisplacement * ( in_uHash1 | 1 );
+		// Murmur3 finalizer.
+		uHash ^= uHash >> 16;
+		uHash *= 0x85ebca6b;
+		uHash ^= uHash >> 13;
+		uHash *= 0xc2b2ae35;
+		uHash ^= uHash >> 16;
+		return uHash % in_uNumStrings;
+	}
+
 protected:
 	static void RemoveFileExtension( AkOSChar* in_pstring );
 	static void _MakeLower( AkOSChar* in_pString );
@@ -100,13 +190,48 @@ protected:
 		AkUInt32		m_uNumFiles;
 	};
 
+	//
+	// Search index of a file LUT.
+	// The keys of the LUT (file ID and language ID) are packed in a separate array,
+	// in Eytzinger (breadth-first) order, so that the first levels of the search
+	// share the same cache lines, and a lookup never touches the 24-byte entries
+	// except the one that is found.
+	//
+	struct FileLUTIndex
+	{
+		AkUInt64 *	pKeys;		// Keys, in Eytzinger order. 1-based: pKeys[0] is unused.
+		AkUInt32 *	pEntries;	// Position in the LUT of the entry of each key.
+		AkUInt32	uNumKeys;	// Number of keys (number of entries of the LUT).
+	};
+
 	// Helper: Find a file entry by ID.
 	const AkFileEntry * LookupFile(
 		AkFileID			in_uID,					// File ID.
 		const FileLUT *		in_pLut,				// LUT to search.
+		const FileLUTIndex &in_index,				// Search index of this LUT.
 		bool				in_bIsLanguageSpecific	// True: match language ID.
 		);
 
+	// Helper: Builds the search indexes of both file LUTs, in their own memory pool.
+	// If memory cannot be allocated, files are searched directly in the LUTs.
+	void BuildIndexes();
+
+	// Helper: Fills the search index of a LUT recursively (in-order traversal of the implicit tree).
+	// Returns the position in the LUT of the next entry to place.
+	static AkUInt32 FillIndex(
+		const AkFileEntry *	in_pEntries,	// LUT entries, sorted.
+		FileLUTIndex &		io_index,		// Index to fill.
+		AkUInt32			in_uEntry,		// Position in the LUT of the next entry to place.
+		AkUInt32			in_uNode		// Node of the index to fill (1-based).
+		);
+
+	// Helper: Returns the search key of a file.
+	static inline AkUInt64 MakeKey( AkFileID in_fileID, AkUInt32 in_uLanguageID )
+	{
+		// The LUT is sorted by file ID, then by language ID: so are the keys.
+		return ( (AkUInt64)in_fileID << 32 ) | in_uLanguageID;
+	}
+
 private:
 
 	AkUInt16			m_curLangID;	// Current language.
@@ -115,30 +240,50 @@ private:
 	//
 	// Maps format.
 	//
+	// Version 1: strings are sorted, and searched with a binary search.
 	class StringMap
 	{
 	public:
 		// Returns AK_INVALID_UNIQUE_ID if ID is not found.
 		AkUInt32 GetID( const AkOSChar* in_pszString );
 	private:
-		struct StringEntry
-		{
-			AkUInt32	uOffset;	// Byte offset of the string in the packaged strings section, 
-									// from beginning of the string map.
-			AkUInt32	uID;		// ID.
-		};
 		StringMap();	// Do not create this object, just cast raw data to use GetID().
 		AkUInt32	m_uNumStrings;
 	};
 
+	// Version 2: string entries are stored in hash order, and are followed by 
+	// the number of buckets and the displacement of each bucket:
+	// [m_uNumStrings][StringEntry x m_uNumStrings][uNumBuckets][AkUInt32 x uNumBuckets][strings]
+	class HashedStringMap
+	{
+	public:
+		// Returns AK_INVALID_UNIQUE_ID if ID is not found.
+		AkUInt32 GetID( 
+			const AkOSChar*	in_pszString,		// String. Case insensitive.
+			bool			in_bStopAtExtension	// True: ignore the extension of in_pszString.
+			);
+	private:
+		HashedStringMap();	// Do not create this object, just cast raw data to use GetID().
+		AkUInt32	m_uNumStrings;
+	};
+
 	// Languages map.
-	StringMap *			m_pLangMap;
+	StringMap *			m_pLangMap;			// Version 1.
+	HashedStringMap *	m_pHashedLangMap;	// Version 2 and up.
+
+	// SoundBank names map (version 2 and up, optional).
+	HashedStringMap *	m_pSoundBankNames;
 
 	// SoundBanks LUT.
     FileLUT *			m_pSoundBanks;
 	
 	// StreamedFiles LUT.
     FileLUT	*			m_pStmFiles;
+
+	// Search indexes of the LUTs.
+	FileLUTIndex		m_soundBanksIndex;
+	FileLUTIndex		m_stmFilesIndex;
+	AkMemPoolId			m_indexPoolID;	// Memory pool of the search indexes.
 };
 
 #endif //_AK_FILE_PACKAGE_LUT_H_
@@ -21,7 +21,9 @@
 //
 // LoadFilePackage() returns a package ID that can be used to unload it. Any number
 // of packages can be loaded simultaneously. When Open() is called, the last package 
-// loaded is searched first, then the previous one, and so on.
+// loaded is searched first, then the previous one, and so on. The look-up tables of
+// all packages are merged in a hash table (CAkFilePackageIndex), so that this search
+// is performed with a single probe.
 //
 // The language ID was created dynamically when the package was created. The header 
 // also contains a map of language names (strings) to their ID, so that the proper 
@@ -41,6 +43,7 @@
 
 #include <AK/SoundEngine/Common/AkStreamMgrModule.h>
 #include "AkFilePackage.h"
+#include "AkFilePackageIndex.h"
 
 
 //-----------------------------------------------------------------------------
@@ -147,12 +150,18 @@ protected:
 	// File package handling methods.
     // ------------------------------------------
 
-    // Searches the LUT to find the file data associated with the FileID.
+    // Searches the index of all loaded packages to find the file data associated with the FileID.
     // Returns AK_Success if the file is found.
     AKRESULT FindPackagedFile( 
-		CAkFilePackage *	in_pPackage,	// Package to search into.
 		AkFileID			in_fileID,		// File ID.
-		AkFileSystemFlags * in_pFlags,		// Special flags. Can pass NULL.
+		AkFileSystemFlags * in_pFlags,		// Special flags. Do not pass NULL.
+		AkFileDesc &		out_fileDesc	// Returned file descriptor.
+		);
+
+	// Fills the file descriptor of a file found in a package.
+	void GetPackagedFileDesc(
+		CAkFilePackage *	in_pPackage,	// Package that contains the file.
+		const CAkFilePackageLUT::AkFileEntry * in_pEntry,	// Entry of the file in the package's LUT.
 		AkFileDesc &		out_fileDesc	// Returned file descriptor.
 		);
 
@@ -166,6 +175,11 @@ protected:
 		CAkFilePackage *	in_pPackage		// File package item.
 		);
 
+	// Closes the file handle of a package (opened with the base class' Open()).
+	void ClosePackageFile(
+		CAkFilePackage *	in_pPackage		// File package item.
+		);
+
 	// Returns true if file described by in_fileDesc is in a package.
 	inline bool IsInPackage( 
 		const AkFileDesc & in_fileDesc		// File descriptor.
@@ -177,6 +191,9 @@ protected:
 protected:
 	// List of loaded packages.
 	ListFilePackages	m_packages;
+
+	// Index of the files of all loaded packages.
+	CAkFilePackageIndex	m_index;
 };
 
 #include "AkFilePackageLowLevelIO.inl"
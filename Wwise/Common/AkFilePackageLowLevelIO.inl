@@ -21,7 +21,9 @@
 //
 // LoadFilePackage() returns a package ID that can be used to unload it. Any number
 // of packages can be loaded simultaneously. When Open() is called, the last package 
-// loaded is searched first, then the previous one, and so on.
+// loaded is searched first, then the previous one, and so on. The look-up tables of
+// all packages are merged in a hash table (CAkFilePackageIndex), so that this search
+// is performed with a single probe.
 //
 // The language ID was created dynamically when the package was created. The header 
 // also contains a map of language names (strings) to their ID, so that the proper 
@@ -55,9 +57,14 @@ CAkFilePackageLowLevelIO<T_LLIOHOOK_FILELOC>::~CAkFilePackageLowLevelIO()
 template <class T_LLIOHOOK_FILELOC>
 void CAkFilePackageLowLevelIO<T_LLIOHOOK_FILELOC>::Term()
 {
-    T_LLIOHOOK_FILELOC::Term();
+	// Destroy the streaming device first: its streams may still be doing I/O on package handles.
+	// Then unload packages before terminating the base class, since their handles are closed through it.
+	// Note: The base class' Term() destroys the device again, which is ignored.
+	AK::StreamMgr::DestroyDevice( T_LLIOHOOK_FILELOC::m_deviceID );
 	UnloadAllFilePackages();
 	m_packages.Term();
+	m_index.Term();
+    T_LLIOHOOK_FILELOC::Term();
 }
 
 // Override Open (string): Search file in each LUTx first. If it cannot be found, use base class services.
@@ -77,21 +84,14 @@ AKRESULT CAkFilePackageLowLevelIO<T_LLIOHOOK_FILELOC>::Open(
 		&& in_pFlags->uCompanyID == AKCOMPANYID_AUDIOKINETIC 
 		&& in_pFlags->uCodecID == AKCODECID_BANK )
 	{
-		// Search file in each package.
+		// The soundbank ID is the hash of its name: it does not depend on the package.
 		ListFilePackages::Iterator it = m_packages.Begin();
-		while ( it != m_packages.End() )
+		AkFileID fileID = ( it != m_packages.End() ) ? (*it)->lut.GetSoundBankID( in_pszFileName ) : AK_INVALID_FILE_ID;
+		if ( fileID != AK_INVALID_FILE_ID 
+			&& FindPackagedFile( fileID, in_pFlags, out_fileDesc ) == AK_Success )
 		{
-			AkFileID fileID = (*it)->lut.GetSoundBankID( in_pszFileName );
-			if ( fileID != AK_INVALID_FILE_ID )
-			{
-				// Found the ID in the lut. 
-				if ( FindPackagedFile( *it, fileID, in_pFlags, out_fileDesc ) == AK_Success )
-				{
-					io_bSyncOpen = true;	// File is opened, now.
-					return AK_Success;
-				}
-			}
-			++it;
+			io_bSyncOpen = true;	// File is opened, now.
+			return AK_Success;
 		}
     }
 
@@ -120,17 +120,11 @@ AKRESULT CAkFilePackageLowLevelIO<T_LLIOHOOK_FILELOC>::Open(
 		&& in_pFlags 
 		&& in_pFlags->uCompanyID == AKCOMPANYID_AUDIOKINETIC )
 	{
-		// Search file in each package.
-		ListFilePackages::Iterator it = m_packages.Begin();
-		while ( it != m_packages.End() )
+		if ( FindPackagedFile( in_fileID, in_pFlags, out_fileDesc ) == AK_Success )
 		{
-			if ( FindPackagedFile( *it, in_fileID, in_pFlags, out_fileDesc ) == AK_Success )
-			{
-				// File found. Return now.
-				io_bSyncOpen = true;	// File is opened, now.
-				return AK_Success;
-			}
-			++it;
+			// File found. Return now.
+			io_bSyncOpen = true;	// File is opened, now.
+			return AK_Success;
 		}
 	}
 
@@ -194,40 +188,71 @@ AKRESULT CAkFilePackageLowLevelIO<T_LLIOHOOK_FILELOC>::SetLangSpecificDirName(
 			++it;
 		}
 
+		// Language-specific entries of the index depend on the current language of each package.
+		m_index.Rebuild( m_packages );
     }
     return eResult;
 }
 
-// Searches the LUT to find the file data associated with the FileID.
+// Searches the index of all loaded packages to find the file data associated with the FileID.
+// If the index could not be built, searches the LUT of each package, from the most recently loaded.
 // Returns AK_Success if the file is found.
 template <class T_LLIOHOOK_FILELOC>
 AKRESULT CAkFilePackageLowLevelIO<T_LLIOHOOK_FILELOC>::FindPackagedFile( 
-	CAkFilePackage *	in_pPackage,	// Package to search into.
     AkFileID			in_fileID,		// File ID.
-    AkFileSystemFlags * in_pFlags,		// Special flags. Can pass NULL.
+    AkFileSystemFlags * in_pFlags,		// Special flags. Do not pass NULL.
     AkFileDesc &		out_fileDesc	// Returned file descriptor.
     )
 {
-	AKASSERT( in_pPackage && in_pFlags );
-	const CAkFilePackageLUT::AkFileEntry * pEntry = in_pPackage->lut.LookupFile( in_fileID, in_pFlags );
+	AKASSERT( in_pFlags );
 
-	if ( pEntry )
+	if ( m_index.IsValid() )
 	{
-		// Fill file descriptor.
-        out_fileDesc.deviceID   = T_LLIOHOOK_FILELOC::m_deviceID;
-        out_fileDesc.hFile      = in_pPackage->GetHandle();
-        out_fileDesc.iFileSize	= pEntry->iFileSize;
-        out_fileDesc.uSector	= pEntry->uStartBlock;
-		out_fileDesc.pCustomParam = NULL;
-		// NOTE: We use the uCustomParamSize to store the block size.
-		// We will determine whether this file was opened from a package by comparing 
-		// uCustomParamSize with 0 (see IsInPackage()).
-        out_fileDesc.uCustomParamSize = pEntry->uBlockSize;
-        return AK_Success;
-    }
+		const CAkFilePackageLUT::AkFileEntry * pEntry;
+		CAkFilePackage * pPackage = m_index.LookupFile( in_fileID, in_pFlags, pEntry );
+		if ( pPackage )
+		{
+			GetPackagedFileDesc( pPackage, pEntry, out_fileDesc );
+			return AK_Success;
+		}
+		return AK_FileNotFound;
+	}
+
+	// Search file in each package.
+	ListFilePackages::Iterator it = m_packages.Begin();
+	while ( it != m_packages.End() )
+	{
+		const CAkFilePackageLUT::AkFileEntry * pEntry = (*it)->lut.LookupFile( in_fileID, in_pFlags );
+		if ( pEntry )
+		{
+			GetPackagedFileDesc( *it, pEntry, out_fileDesc );
+			return AK_Success;
+		}
+		++it;
+	}
     return AK_FileNotFound;
 }
 
+// Fills the file descriptor of a file found in a package.
+template <class T_LLIOHOOK_FILELOC>
+void CAkFilePackageLowLevelIO<T_LLIOHOOK_FILELOC>::GetPackagedFileDesc(
+	CAkFilePackage *	in_pPackage,	// Package that contains the file.
+	const CAkFilePackageLUT::AkFileEntry * in_pEntry,	// Entry of the file in the package's LUT.
+	AkFileDesc &		out_fileDesc	// Returned file descriptor.
+	)
+{
+	AKASSERT( in_pPackage && in_pEntry );
+    out_fileDesc.deviceID   = T_LLIOHOOK_FILELOC::m_deviceID;
+    out_fileDesc.hFile      = in_pPackage->GetHandle();
+    out_fileDesc.iFileSize	= in_pEntry->iFileSize;
+    out_fileDesc.uSector	= in_pEntry->uStartBlock;
+	out_fileDesc.pCustomParam = NULL;
+	// NOTE: We use the uCustomParamSize to store the block size.
+	// We will determine whether this file was opened from a package by comparing 
+	// uCustomParamSize with 0 (see IsInPackage()).
+    out_fileDesc.uCustomParamSize = in_pEntry->uBlockSize;
+}
+
 // File package loading:
 // Opens a package file, parses its header, fills LUT.
 // Overrides of Open() will search files in loaded LUTs first, then use default Low-Level I/O 
@@ -398,7 +423,13 @@ AKRESULT CAkFilePackageLowLevelIO<T_LLIOHOOK_FILELOC>::LoadFilePackage(
 	
     // Use the current language path (if defined) to set the language ID, 
     // for language specific file mapping.
-    return SetLanguageLUT( pPackage );
+    eRes = SetLanguageLUT( pPackage );
+
+	// Index its files, now that its language is known. They override those of packages loaded before.
+	// If the index cannot grow, Open() falls back on searching each package.
+	m_index.AddPackage( pPackage );
+
+	return eRes;
 }
 
 // Unload a file package.
@@ -415,8 +446,11 @@ AKRESULT CAkFilePackageLowLevelIO<T_LLIOHOOK_FILELOC>::UnloadFilePackage(
 			CAkFilePackage * pPackage = (*it);
 			it = m_packages.Erase( it );
 
+			// Remove its files from the index, and restore those it was overriding.
+			m_index.RemovePackage( pPackage, m_packages );
+
 			// Close package file handle.
-			CAkFileHelpers::CloseFile( pPackage->GetHandle() );
+			ClosePackageFile( pPackage );
 
 			pPackage->Destroy();
 
@@ -441,10 +475,29 @@ void CAkFilePackageLowLevelIO<T_LLIOHOOK_FILELOC>::UnloadAllFilePackages()
 		it = m_packages.Erase( it );
 
 		// Close package file handle.
-		CAkFileHelpers::CloseFile( pPackage->GetHandle() );
+		ClosePackageFile( pPackage );
 
 		pPackage->Destroy();
 	}
+
+	m_index.Term();
+}
+
+// Closes the file handle of a package through the base class, which opened it in LoadFilePackage(),
+// so that it may release any resource it associated with the handle.
+template <class T_LLIOHOOK_FILELOC>
+void CAkFilePackageLowLevelIO<T_LLIOHOOK_FILELOC>::ClosePackageFile(
+	CAkFilePackage *	in_pPackage		// File package item.
+	)
+{
+	AkFileDesc fileDesc;
+	fileDesc.iFileSize			= 0;
+	fileDesc.uSector			= 0;
+	fileDesc.hFile				= in_pPackage->GetHandle();
+	fileDesc.pCustomParam		= NULL;
+	fileDesc.uCustomParamSize	= 0;	// Not in package: the handle belongs to the base class.
+	fileDesc.deviceID			= T_LLIOHOOK_FILELOC::m_deviceID;
+	T_LLIOHOOK_FILELOC::Close( fileDesc );
 }
 
 // This method uses the language-specific directory name (obtained from policy
@@ -0,0 +1,187 @@
+//////////////////////////////////////////////////////////////////////
+//
+// AkFilePackageStringMapWriter.cpp
+//
+// Packager-side writer of the hashed string maps of file packages
+// (version 2 and up, see AkFilePackageLUT.h).
+//
+// Copyright (c) 2007-2009 Audiokinetic Inc. / All Rights Reserved
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "AkFilePackageStringMapWriter.h"
+#include <string.h>
+
+// Maximum number of displacements tried for a bucket before giving up.
+#define AK_STRING_MAP_MAX_DISPLACEMENT	(0x100000)
+
+// Returns the number of buckets of a map.
+AkUInt32 CAkFilePackageStringMapWriter::GetNumBuckets(
+	AkUInt32				in_uNumStrings			// Number of strings.
+	)
+{
+	// Average of 2 strings per bucket.
+	return ( in_uNumStrings > 0 ) ? in_uNumStrings / 2 + 1 : 0;
+}
+
+// Returns the size of a map, in bytes.
+AkUInt32 CAkFilePackageStringMapWriter::GetMapSize(
+	const AkStringMapItem *	in_pItems,				// Strings and IDs.
+	AkUInt32				in_uNumStrings,			// Number of strings.
+	bool					in_bStopAtExtension		// True: extensions are not stored (soundbank names map).
+	)
+{
+	AkUInt32 uSize = sizeof( AkUInt32 )
+		+ in_uNumStrings * sizeof( CAkFilePackageLUT::StringEntry )
+		+ sizeof( AkUInt32 )
+		+ GetNumBuckets( in_uNumStrings ) * sizeof( AkUInt32 );
+
+	for ( AkUInt32 uString = 0; uString < in_uNumStrings; uString++ )
+		uSize += ( GetStoredLength( in_pItems[uString].pszString, in_bStopAtExtension ) + 1 ) * sizeof( AkOSChar );
+
+	// Keep following sections aligned.
+	return ( uSize + 3 ) & ~3;
+}
+
+// Returns the size of the work buffer required by Write(), in bytes.
+AkUInt32 CAkFilePackageStringMapWriter::GetWorkBufferSize(
+	AkUInt32				in_uNumStrings			// Number of strings.
+	)
+{
+	// Hashes, strings sorted by bucket, slots of the bucket being placed, start of each bucket, slot flags.
+	return in_uNumStrings * 4 * sizeof( AkUInt32 )
+		+ ( GetNumBuckets( in_uNumStrings ) + 1 ) * sizeof( AkUInt32 )
+		+ in_uNumStrings;
+}
+
+// Writes a map.
+// Returns AK_Success, AK_InvalidParameter if the map size is wrong, or AK_Fail if
+// the hash function could not be built (strings are not unique).
+AKRESULT CAkFilePackageStringMapWriter::Write(
+	const AkStringMapItem *	in_pItems,				// Strings and IDs.
+	AkUInt32				in_uNumStrings,			// Number of strings.
+	bool					in_bStopAtExtension,	// True: extensions are not stored (soundbank names map).
+	void *					out_pMap,				// Returned map.
+	AkUInt32				in_uMapSize,			// Size of out_pMap, as returned by GetMapSize().
+	void *					in_pWorkBuffer			// Work buffer, of the size returned by GetWorkBufferSize().
+	)
+{
+	if ( !out_pMap
+		|| ( in_uNumStrings > 0 && ( !in_pItems || !in_pWorkBuffer ) )
+		|| in_uMapSize != GetMapSize( in_pItems, in_uNumStrings, in_bStopAtExtension ) )
+		return AK_InvalidParameter;
+
+	memset( out_pMap, 0, in_uMapSize );
+
+	AkUInt32 uNumBuckets = GetNumBuckets( in_uNumStrings );
+	AkUInt32 * pNumStrings = (AkUInt32*)out_pMap;
+	CAkFilePackageLUT::StringEntry * pTable = (CAkFilePackageLUT::StringEntry*)( pNumStrings + 1 );
+	AkUInt32 * pNumBuckets = (AkUInt32*)( pTable + in_uNumStrings );
+	AkUInt32 * pDisplacements = pNumBuckets + 1;
+	AkUInt8 * pStrings = (AkUInt8*)( pDisplacements + uNumBuckets );
+	*pNumStrings = in_uNumStrings;
+	*pNumBuckets = uNumBuckets;
+
+	if ( in_uNumStrings == 0 )
+		return AK_Success;
+
+	// Work buffer.
+	AkUInt32 * pHash1		= (AkUInt32*)in_pWorkBuffer;
+	AkUInt32 * pHash2		= pHash1 + in_uNumStrings;
+	AkUInt32 * pOrder		= pHash2 + in_uNumStrings;		// Strings sorted by bucket.
+	AkUInt32 * pSlots		= pOrder + in_uNumStrings;		// Slots of the strings of the bucket being placed.
+	AkUInt32 * pBucketStart	= pSlots + in_uNumStrings;		// Start of each bucket in pOrder.
+	AkUInt8 * pSlotUsed		= (AkUInt8*)( pBucketStart + uNumBuckets + 1 );
+	memset( pBucketStart, 0, ( uNumBuckets + 1 ) * sizeof( AkUInt32 ) );
+	memset( pSlotUsed, 0, in_uNumStrings );
+
+	// Hash strings, and sort them by bucket (counting sort).
+	AkUInt32 uString;
+	for ( uString = 0; uString < in_uNumStrings; uString++ )
+	{
+		CAkFilePackageLUT::HashString( in_pItems[uString].pszString, in_bStopAtExtension, pHash1[uString], pHash2[uString] );
+		++pBucketStart[ pHash1[uString] % uNumBuckets + 1 ];
+	}
+	AkUInt32 uBucket, uMaxBucketSize = 0;
+	for ( uBucket = 0; uBucket < uNumBuckets; uBucket++ )
+	{
+		if ( pBucketStart[uBucket + 1] > uMaxBucketSize )
+			uMaxBucketSize = pBucketStart[uBucket + 1];
+		pBucketStart[uBucket + 1] += pBucketStart[uBucket];
+	}
+	// Fill each bucket, using pSlots as fill counters for now (there are fewer buckets than strings).
+	memset( pSlots, 0, in_uNumStrings * sizeof( AkUInt32 ) );
+	for ( uString = 0; uString < in_uNumStrings; uString++ )
+	{
+		AkUInt32 uStringBucket = pHash1[uString] % uNumBuckets;
+		pOrder[ pBucketStart[uStringBucket] + pSlots[uStringBucket]++ ] = uString;
+	}
+
+	// Place buckets from the biggest to the smallest.
+	for ( AkUInt32 uBucketSize = uMaxBucketSize; uBucketSize > 0; uBucketSize-- )
+	{
+		for ( uBucket = 0; uBucket < uNumBuckets; uBucket++ )
+		{
+			AkUInt32 uStart = pBucketStart[uBucket];
+			if ( pBucketStart[uBucket + 1] - uStart != uBucketSize )
+				continue;
+
+			// Find a displacement that sends all strings of the bucket to free slots.
+			AkUInt32 uDisplacement = 0;
+			for (;;)
+			{
+				AkUInt32 uPlaced = 0;
+				while ( uPlaced < uBucketSize )
+				{
+					AkUInt32 uThis = pOrder[uStart + uPlaced];
+					AkUInt32 uSlot = CAkFilePackageLUT::GetHashedSlot( pHash1[uThis], pHash2[uThis], uDisplacement, in_uNumStrings );
+					if ( pSlotUsed[uSlot] )
+						break;
+					pSlotUsed[uSlot] = 1;
+					pSlots[uPlaced++] = uSlot;
+				}
+				if ( uPlaced == uBucketSize )
+					break;
+
+				// Collision: release slots and try next displacement.
+				while ( uPlaced > 0 )
+					pSlotUsed[ pSlots[--uPlaced] ] = 0;
+				if ( ++uDisplacement == AK_STRING_MAP_MAX_DISPLACEMENT )
+					return AK_Fail;	// Duplicate strings.
+			}
+			pDisplacements[uBucket] = uDisplacement;
+		}
+	}
+
+	// Write string entries in slot order, and strings in lower case.
+	AkUInt32 uOffset = (AkUInt32)( pStrings - (AkUInt8*)out_pMap );
+	for ( uString = 0; uString < in_uNumStrings; uString++ )
+	{
+		AkUInt32 uSlot = CAkFilePackageLUT::GetHashedSlot( pHash1[uString], pHash2[uString], pDisplacements[ pHash1[uString] % uNumBuckets ], in_uNumStrings );
+		pTable[uSlot].uOffset	= uOffset;
+		pTable[uSlot].uID		= in_pItems[uString].uID;
+
+		AkOSChar * pString = (AkOSChar*)( (AkUInt8*)out_pMap + uOffset );
+		AkUInt32 uLength = GetStoredLength( in_pItems[uString].pszString, in_bStopAtExtension );
+		for ( AkUInt32 uChar = 0; uChar < uLength; uChar++ )
+			pString[uChar] = CAkFilePackageLUT::ToLower( in_pItems[uString].pszString[uChar] );
+		pString[uLength] = 0;
+		uOffset += ( uLength + 1 ) * sizeof( AkOSChar );
+	}
+	AKASSERT( uOffset <= in_uMapSize );
+
+	return AK_Success;
+}
+
+// Returns the number of characters of a string that are stored in the map (excluding the NULL character).
+AkUInt32 CAkFilePackageStringMapWriter::GetStoredLength(
+	const AkOSChar *		in_pszString,			// String.
+	bool					in_bStopAtExtension		// True: ignore the extension.
+	)
+{
+	AkUInt32 uLength = 0;
+	while ( !CAkFilePackageLUT::IsEndOfString( in_pszString[uLength], in_bStopAtExtension ) )
+		++uLength;
+	return uLength;
+}
@@ -0,0 +1,88 @@
+//////////////////////////////////////////////////////////////////////
+//
+// AkFilePackageStringMapWriter.h
+//
+// Packager-side writer of the hashed string maps of file packages
+// (version 2 and up, see AkFilePackageLUT.h). It is not used at run-time:
+// it is meant to be compiled with tools that create file packages, so that
+// they share the string hash functions of CAkFilePackageLUT.
+//
+// A hashed string map contains a minimal perfect hash function, built with
+// the "hash, displace" method: strings are distributed in buckets with their
+// first hash, then buckets are placed from the biggest to the smallest, by
+// finding for each a displacement of the second hash of its strings that
+// sends them all to free slots. The string entries are then written in slot
+// order, so that a string is found at run-time with a single hash, and verified
+// with a single comparison.
+//
+// Layout of a hashed string map:
+// [uNumStrings][StringEntry x uNumStrings][uNumBuckets][AkUInt32 displacement x uNumBuckets][strings]
+// String offsets are expressed from the beginning of the map. Strings are
+// stored in lower case, NULL-terminated. The size of the map is a multiple of 4 bytes.
+//
+// Copyright (c) 2007-2009 Audiokinetic Inc. / All Rights Reserved
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef _AK_FILE_PACKAGE_STRING_MAP_WRITER_H_
+#define _AK_FILE_PACKAGE_STRING_MAP_WRITER_H_
+
+#include "AkFilePackageLUT.h"
+
+//-----------------------------------------------------------------------------
+// Name: class CAkFilePackageStringMapWriter.
+// Desc: Writes the hashed string maps of file packages (languages and soundbank
+//		 names). Memory is provided by the caller: compute the size of the map
+//		 with GetMapSize() and the size of the temporary work buffer with
+//		 GetWorkBufferSize(), then call Write().
+//-----------------------------------------------------------------------------
+class CAkFilePackageStringMapWriter
+{
+public:
+
+	// A string and its ID.
+	struct AkStringMapItem
+	{
+		const AkOSChar *	pszString;	// String. Case insensitive. Must be unique in the map.
+		AkUInt32			uID;		// ID. For soundbank names, ID returned by AK::SoundEngine::GetIDFromString().
+	};
+
+	// Returns the number of buckets of a map.
+	static AkUInt32 GetNumBuckets(
+		AkUInt32				in_uNumStrings			// Number of strings.
+		);
+
+	// Returns the size of a map, in bytes.
+	static AkUInt32 GetMapSize(
+		const AkStringMapItem *	in_pItems,				// Strings and IDs.
+		AkUInt32				in_uNumStrings,			// Number of strings.
+		bool					in_bStopAtExtension		// True: extensions are not stored (soundbank names map).
+		);
+
+	// Returns the size of the work buffer required by Write(), in bytes.
+	static AkUInt32 GetWorkBufferSize(
+		AkUInt32				in_uNumStrings			// Number of strings.
+		);
+
+	// Writes a map.
+	// Returns AK_Success, AK_InvalidParameter if the map size is wrong, or AK_Fail if
+	// the hash function could not be built (strings are not unique).
+	static AKRESULT Write(
+		const AkStringMapItem *	in_pItems,				// Strings and IDs.
+		AkUInt32				in_uNumStrings,			// Number of strings.
+		bool					in_bStopAtExtension,	// True: extensions are not stored (soundbank names map).
+		void *					out_pMap,				// Returned map.
+		AkUInt32				in_uMapSize,			// Size of out_pMap, as returned by GetMapSize().
+		void *					in_pWorkBuffer			// Work buffer, of the size returned by GetWorkBufferSize().
+		);
+
+protected:
+
+	// Returns the number of characters of a string that are stored in the map (excluding the NULL character).
+	static AkUInt32 GetStoredLength(
+		const AkOSChar *		in_pszString,			// String.
+		bool					in_bStopAtExtension		// True: ignore the extension.
+		);
+};
+
+#endif //_AK_FILE_PACKAGE_STRING_MAP_WRITER_H_
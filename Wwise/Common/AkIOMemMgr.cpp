@@ -0,0 +1,212 @@
+//////////////////////////////////////////////////////////////////////
+//
+// AkIOMemMgr.cpp
+//
+// I/O memory manager of devices: buddy allocator that serves stream
+// buffers of various sizes out of the I/O memory of a device.
+//
+// Copyright (c) 2006 Audiokinetic Inc. / All Rights Reserved
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "AkIOMemMgr.h"
+#include <AK/Tools/Common/AkAutoLock.h>
+#include <string.h>
+
+using namespace AK::StreamMgr;
+
+CAkIOMemMgr::CAkIOMemMgr()
+: m_pMemory( NULL )
+, m_pBlockTable( NULL )
+, m_uUnitSize( 0 )
+, m_uNumUnits( 0 )
+, m_uMaxOrder( 0 )
+{
+	memset( m_arFreeLists, 0, sizeof( m_arFreeLists ) );
+}
+
+CAkIOMemMgr::~CAkIOMemMgr()
+{
+	AKASSERT( !m_pBlockTable || !"Term() was not called" );
+}
+
+// Divides the memory in blocks.
+AKRESULT CAkIOMemMgr::Init(
+	void *			in_pMemory,			// I/O memory. Must be aligned on in_uAlignment.
+	AkUInt32		in_uMemorySize,		// Size of I/O memory.
+	AkUInt32		in_uGranularity,	// Device granularity.
+	AkUInt32		in_uAlignment		// Required buffer alignment. 0 if none.
+	)
+{
+	AKASSERT( in_pMemory && in_uGranularity > 0 );
+
+	// Unit: halve granularity while it remains a multiple of the alignment.
+	if ( in_uAlignment == 0 )
+		in_uAlignment = 1;
+	m_uUnitSize = in_uGranularity;
+	for ( AkUInt32 uSplit = 0; uSplit < AK_IO_MEM_MAX_SPLITS; ++uSplit )
+	{
+		AkUInt32 uHalf = m_uUnitSize / 2;
+		if ( ( m_uUnitSize % 2 ) != 0
+			|| uHalf < AK_IO_MEM_MIN_UNIT_SIZE
+			|| ( uHalf % in_uAlignment ) != 0 )
+			break;
+		m_uUnitSize = uHalf;
+	}
+
+	m_uNumUnits = in_uMemorySize / m_uUnitSize;
+	if ( m_uNumUnits == 0 )
+		return AK_Success;
+
+	m_pBlockTable = (AkUInt8*)AkAlloc( CAkStreamMgr::GetObjPoolID(), m_uNumUnits );
+	if ( !m_pBlockTable )
+	{
+		m_uNumUnits = 0;
+		return AK_InsufficientMemory;
+	}
+	memset( m_pBlockTable, 0, m_uNumUnits );
+	m_pMemory = (AkUInt8*)in_pMemory;
+
+	// Cover the memory with top-level blocks of decreasing size, so that each is aligned on its size.
+	m_uMaxOrder = 0;
+	AkUInt32 uUnit = 0;
+	for ( AkInt32 iOrder = AK_IO_MEM_MAX_ORDERS - 1; iOrder >= 0; --iOrder )
+	{
+		if ( m_uNumUnits & ( 1U << iOrder ) )
+		{
+			if ( uUnit == 0 )
+				m_uMaxOrder = iOrder;
+			PushFree( uUnit, iOrder );
+			uUnit += ( 1U << iOrder );
+		}
+	}
+	AKASSERT( uUnit == m_uNumUnits );
+
+	return AK_Success;
+}
+
+void CAkIOMemMgr::Term()
+{
+	if ( m_pBlockTable )
+	{
+		AkFree( CAkStreamMgr::GetObjPoolID(), m_pBlockTable );
+		m_pBlockTable = NULL;
+	}
+	memset( m_arFreeLists, 0, sizeof( m_arFreeLists ) );
+	m_pMemory = NULL;
+	m_uNumUnits = 0;
+}
+
+// Returns a block of at least in_uSize bytes, NULL if there is none.
+void * CAkIOMemMgr::Alloc(
+	AkUInt32		in_uSize			// Required size.
+	)
+{
+	if ( m_uNumUnits == 0 )
+		return NULL;
+	AkUInt32 uOrder = GetOrder( in_uSize );
+	if ( uOrder > m_uMaxOrder )
+		return NULL;
+
+	AkAutoLock<CAkLock> lock( m_lock );
+
+	// Find the smallest free block that is large enough.
+	AkUInt32 uFreeOrder = uOrder;
+	while ( !m_arFreeLists[uFreeOrder] )
+	{
+		if ( ++uFreeOrder > m_uMaxOrder )
+			return NULL;
+	}
+
+	AkUInt32 uUnit = GetUnit( m_arFreeLists[uFreeOrder] );
+	RemoveFree( uUnit, uFreeOrder );
+
+	// Split it, freeing upper halves.
+	while ( uFreeOrder > uOrder )
+	{
+		--uFreeOrder;
+		PushFree( uUnit + ( 1U << uFreeOrder ), uFreeOrder );
+	}
+
+	m_pBlockTable[uUnit] = (AkUInt8)uOrder;
+	return GetBlock( uUnit );
+}
+
+// Frees a block returned by Alloc().
+void CAkIOMemMgr::Free(
+	void *			in_pBuffer			// Block.
+	)
+{
+	AkAutoLock<CAkLock> lock( m_lock );
+
+	AkUInt32 uUnit = GetUnit( in_pBuffer );
+	AKASSERT( !( m_pBlockTable[uUnit] & AK_IO_MEM_FREE ) || !"Block freed twice" );
+	AkUInt32 uOrder = m_pBlockTable[uUnit] & AK_IO_MEM_ORDER_MASK;
+
+	// Merge with free buddies.
+	// Note: The buddy of a top-level block is either outside memory or a smaller top-level block: it never
+	// matches as a free block of the same order.
+	while ( uOrder < m_uMaxOrder )
+	{
+		AkUInt32 uBuddy = uUnit ^ ( 1U << uOrder );
+		if ( uBuddy >= m_uNumUnits
+			|| m_pBlockTable[uBuddy] != ( AK_IO_MEM_FREE | uOrder ) )
+			break;
+		RemoveFree( uBuddy, uOrder );
+		if ( uBuddy < uUnit )
+			uUnit = uBuddy;
+		++uOrder;
+	}
+
+	PushFree( uUnit, uOrder );
+}
+
+// Returns the size of the block that would be returned by Alloc( in_uSize ), 0 if in_uSize is too large.
+AkUInt32 CAkIOMemMgr::GetAllocSize(
+	AkUInt32		in_uSize			// Required size.
+	)
+{
+	if ( m_uNumUnits == 0 )
+		return 0;
+	AkUInt32 uOrder = GetOrder( in_uSize );
+	if ( uOrder > m_uMaxOrder )
+		return 0;
+	return m_uUnitSize << uOrder;
+}
+
+// Returns the smallest order that holds in_uSize bytes (may exceed m_uMaxOrder).
+AkUInt32 CAkIOMemMgr::GetOrder( AkUInt32 in_uSize )
+{
+	AKASSERT( m_uUnitSize > 0 );
+	AkUInt32 uNumUnits = in_uSize / m_uUnitSize + ( ( in_uSize % m_uUnitSize ) ? 1 : 0 );
+	AkUInt32 uOrder = 0;
+	while ( uOrder < AK_IO_MEM_MAX_ORDERS && ( 1U << uOrder ) < uNumUnits )
+		++uOrder;
+	return uOrder;
+}
+
+// Free lists. Sync: Lock must be held.
+void CAkIOMemMgr::PushFree( AkUInt32 in_uUnit, AkUInt32 in_uOrder )
+{
+	AkFreeBlock * pBlock = GetBlock( in_uUnit );
+	pBlock->pPrev = NULL;
+	pBlock->pNext = m_arFreeLists[in_uOrder];
+	if ( pBlock->pNext )
+		pBlock->pNext->pPrev = pBlock;
+	m_arFreeLists[in_uOrder] = pBlock;
+	m_pBlockTable[in_uUnit] = (AkUInt8)( AK_IO_MEM_FREE | in_uOrder );
+}
+
+void CAkIOMemMgr::RemoveFree( AkUInt32 in_uUnit, AkUInt32 in_uOrder )
+{
+	AKASSERT( m_pBlockTable[in_uUnit] == ( AK_IO_MEM_FREE | in_uOrder ) );
+	AkFreeBlock * pBlock = GetBlock( in_uUnit );
+	if ( pBlock->pPrev )
+		pBlock->pPrev->pNext = pBlock->pNext;
+	else
+		m_arFreeLists[in_uOrder] = pBlock->pNext;
+	if ( pBlock->pNext )
+		pBlock->pNext->pPrev = pBlock->pPrev;
+	m_pBlockTable[in_uUnit] = (AkUInt8)in_uOrder;
+}
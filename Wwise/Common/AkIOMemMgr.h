@@ -0,0 +1,137 @@
+//////////////////////////////////////////////////////////////////////
+//
+// AkIOMemMgr.h
+//
+// I/O memory manager of devices: buddy allocator that serves stream
+// buffers of various sizes out of the I/O memory of a device.
+//
+// The I/O memory is divided in units, a power-of-two fraction of the
+// device granularity. Blocks are made of a power-of-two number of units
+// (their order), and are aligned on their size relative to the beginning
+// of their top-level block. A block of order N is split in two "buddies"
+// of order N-1 to serve smaller requests, and freed buddies are merged
+// back. When the memory size is not a power-of-two multiple of the unit,
+// it is covered by top-level blocks of decreasing size.
+//
+// Copyright (c) 2006 Audiokinetic Inc. / All Rights Reserved
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef _AK_IO_MEM_MGR_H_
+#define _AK_IO_MEM_MGR_H_
+
+#include "AkStreamMgr.h"
+#include <AK/Tools/Common/AkLock.h>
+
+// Maximum number of orders of the buddy allocator (number of units fits in 32 bits).
+#define AK_IO_MEM_MAX_ORDERS		(32)
+// Maximum number of times the device granularity is halved to obtain the unit.
+#define AK_IO_MEM_MAX_SPLITS		(2)
+// Minimum unit size, in bytes.
+#define AK_IO_MEM_MIN_UNIT_SIZE		(2048)
+// Block table: the lower bits of an entry hold the order of the block that starts at this unit.
+#define AK_IO_MEM_ORDER_MASK		(0x3F)
+#define AK_IO_MEM_FREE				(0x80)		// The block that starts at this unit is free.
+
+namespace AK
+{
+namespace StreamMgr
+{
+	//-----------------------------------------------------------------------------
+	// Name: class CAkIOMemMgr.
+	// Desc: Buddy allocator of I/O buffers. Memory is provided at Init() and is
+	//		 not owned. Block state is kept in a one-byte-per-unit table, and free
+	//		 blocks are linked through their first bytes.
+	//		 Thread-safe: buffers may be allocated and freed from any thread.
+	//-----------------------------------------------------------------------------
+	class CAkIOMemMgr
+	{
+	public:
+		CAkIOMemMgr();
+		~CAkIOMemMgr();
+
+		// Divides the memory in blocks. The unit is the greatest fraction of the granularity that
+		// is a multiple of in_uAlignment, within AK_IO_MEM_MAX_SPLITS and AK_IO_MEM_MIN_UNIT_SIZE.
+		// Returns AK_InsufficientMemory if the block table cannot be allocated.
+		AKRESULT Init(
+			void *			in_pMemory,			// I/O memory. Must be aligned on in_uAlignment.
+			AkUInt32		in_uMemorySize,		// Size of I/O memory.
+			AkUInt32		in_uGranularity,	// Device granularity.
+			AkUInt32		in_uAlignment		// Required buffer alignment. 0 if none.
+			);
+		void Term();
+
+		// Returns a block of at least in_uSize bytes, NULL if there is none.
+		void * Alloc(
+			AkUInt32		in_uSize			// Required size.
+			);
+
+		// Frees a block returned by Alloc().
+		void Free(
+			void *			in_pBuffer			// Block.
+			);
+
+		// Returns the size of a block returned by Alloc().
+		inline AkUInt32 GetBlockSize(
+			void *			in_pBuffer			// Block.
+			)
+		{
+			return m_uUnitSize << ( m_pBlockTable[ GetUnit( in_pBuffer ) ] & AK_IO_MEM_ORDER_MASK );
+		}
+
+		// Returns the size of the block that would be returned by Alloc( in_uSize ), 0 if in_uSize is too large.
+		AkUInt32 GetAllocSize(
+			AkUInt32		in_uSize			// Required size.
+			);
+
+		// Returns the size of the largest block.
+		inline AkUInt32 GetMaxAllocSize()
+		{
+			return ( m_uNumUnits > 0 ) ? m_uUnitSize << m_uMaxOrder : 0;
+		}
+
+		// Returns the maximum number of blocks that can be allocated at once.
+		inline AkUInt32 GetMaxNumBlocks()
+		{
+			return m_uNumUnits;
+		}
+
+	protected:
+
+		// Free block header, stored at the beginning of free blocks.
+		struct AkFreeBlock
+		{
+			AkFreeBlock *	pPrev;
+			AkFreeBlock *	pNext;
+		};
+
+		inline AkUInt32 GetUnit( void * in_pBuffer )
+		{
+			AKASSERT( (AkUInt8*)in_pBuffer >= m_pMemory
+					&& (AkUInt8*)in_pBuffer < m_pMemory + m_uNumUnits * m_uUnitSize );
+			return (AkUInt32)( ( (AkUInt8*)in_pBuffer - m_pMemory ) / m_uUnitSize );
+		}
+		inline AkFreeBlock * GetBlock( AkUInt32 in_uUnit )
+		{
+			return (AkFreeBlock*)( m_pMemory + in_uUnit * m_uUnitSize );
+		}
+
+		// Returns the smallest order that holds in_uSize bytes (may exceed m_uMaxOrder).
+		AkUInt32 GetOrder( AkUInt32 in_uSize );
+
+		// Free lists. Sync: Lock must be held.
+		void PushFree( AkUInt32 in_uUnit, AkUInt32 in_uOrder );
+		void RemoveFree( AkUInt32 in_uUnit, AkUInt32 in_uOrder );
+
+	protected:
+		CAkLock			m_lock;
+		AkUInt8 *		m_pMemory;			// I/O memory.
+		AkUInt8 *		m_pBlockTable;		// State of the block that starts at each unit (order and free flag).
+		AkUInt32		m_uUnitSize;
+		AkUInt32		m_uNumUnits;
+		AkUInt32		m_uMaxOrder;		// Order of the largest block.
+		AkFreeBlock *	m_arFreeLists[AK_IO_MEM_MAX_ORDERS];	// Free blocks, by order.
+	};
+}
+}
+#endif //_AK_IO_MEM_MGR_H_
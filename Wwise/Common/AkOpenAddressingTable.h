@@ -0,0 +1,95 @@
+//////////////////////////////////////////////////////////////////////
+//
+// AkOpenAddressingTable.h
+//
+// Probing and erasing in the open-addressing (linear probing) hash
+// tables of the low-level I/O: the index of file packages
+// (CAkFilePackageIndex) and the routing table of the dispatcher
+// (CAkDefaultLowLevelIODispatcher).
+//
+// Slots are keyed on a 32-bit ID and on flags. Flags are 0 if the slot
+// is free. The number of slots is a power of 2, and tables are never
+// full. Slots are erased by shifting back the entries that follow them
+// in their probing sequence, so that no tombstone is needed.
+//
+// Copyright (c) 2006 Audiokinetic Inc. / All Rights Reserved
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef _AK_OPEN_ADDRESSING_TABLE_H_
+#define _AK_OPEN_ADDRESSING_TABLE_H_
+
+#include <AK/SoundEngine/Common/AkTypes.h>
+
+//-----------------------------------------------------------------------------
+// Name: class AkOpenAddressingTable.
+// Desc: Slot operations of an open-addressing hash table of T_SLOT items.
+//		 U_KEYS is the policy that gives access to the ID and flags of a slot:
+//		 static AkUInt32 GetID( const T_SLOT & ) and
+//		 static AkUInt32 & Flags( T_SLOT & ).
+//		 Tables are owned by the users of this class.
+//-----------------------------------------------------------------------------
+template <class T_SLOT, class U_KEYS>
+class AkOpenAddressingTable
+{
+public:
+
+	// Returns the slot at which the search for a key starts.
+	static inline AkUInt32 GetHomeSlot(
+		AkUInt32		in_uID,			// ID.
+		AkUInt32		in_uFlags,		// Key flags.
+		AkUInt32		in_uNumSlots	// Number of slots of the table.
+		)
+	{
+		AkUInt32 uHash = ( in_uID ^ ( in_uFlags << 29 ) ) * 2654435761U;	// Knuth's multiplicative hash.
+		return ( uHash ^ ( uHash >> 16 ) ) & ( in_uNumSlots - 1 );
+	}
+
+	// Returns the slot of a key, or the free slot where it should be inserted.
+	static T_SLOT * FindSlot(
+		T_SLOT *		in_pTable,		// Table.
+		AkUInt32		in_uNumSlots,	// Number of slots of the table.
+		AkUInt32		in_uID,			// ID.
+		AkUInt32		in_uFlags		// Key flags.
+		)
+	{
+		AkUInt32 uMask = in_uNumSlots - 1;
+		AkUInt32 uSlot = GetHomeSlot( in_uID, in_uFlags, in_uNumSlots );
+		while ( U_KEYS::Flags( in_pTable[uSlot] )
+				&& ( U_KEYS::GetID( in_pTable[uSlot] ) != in_uID || U_KEYS::Flags( in_pTable[uSlot] ) != in_uFlags ) )
+		{
+			uSlot = ( uSlot + 1 ) & uMask;
+		}
+		return in_pTable + uSlot;
+	}
+
+	// Frees a slot, and shifts back the entries that follow it in their probing sequence.
+	static void EraseSlot(
+		T_SLOT *		in_pTable,		// Table.
+		AkUInt32		in_uNumSlots,	// Number of slots of the table.
+		T_SLOT *		in_pSlot		// Slot to free.
+		)
+	{
+		AkUInt32 uMask = in_uNumSlots - 1;
+		AkUInt32 uHole = (AkUInt32)( in_pSlot - in_pTable );
+		AkUInt32 uSlot = uHole;
+		for (;;)
+		{
+			uSlot = ( uSlot + 1 ) & uMask;
+			T_SLOT & slot = in_pTable[uSlot];
+			if ( !U_KEYS::Flags( slot ) )
+				break;
+
+			// Move the entry to the hole if the hole lies (cyclically) between its home slot and its current slot.
+			AkUInt32 uHome = GetHomeSlot( U_KEYS::GetID( slot ), U_KEYS::Flags( slot ), in_uNumSlots );
+			if ( ( ( uSlot - uHome ) & uMask ) >= ( ( uSlot - uHole ) & uMask ) )
+			{
+				in_pTable[uHole] = slot;
+				uHole = uSlot;
+			}
+		}
+		U_KEYS::Flags( in_pTable[uHole] ) = 0;
+	}
+};
+
+#endif //_AK_OPEN_ADDRESSING_TABLE_H_
@@ -43,6 +43,7 @@ namespace StreamMgr
 			pOwner = in_pOwner;
 			eStatus = TransferStatus_Pending;
 			bWasLLIOCancelCalled = false;
+			bIsCoalesced = false;
 			info.pBuffer = in_pBuffer;
 			StartPosition( in_uPosition );
 			info.uBufferSize = in_uBufferSize;
@@ -51,6 +52,15 @@ namespace StreamMgr
 			info.pCallback = in_pCallback;
 			info.pCookie = this;	// Keep transfer object in cookie.
 			info.pUserData = NULL;
+			AKPLATFORM::PerformanceCounter( &iSubmitTime );
+		}
+
+		// Time elapsed since the transfer was prepared (it is sent to the Low-Level IO right after), in ms.
+		inline AkReal32 ElapsedSinceSubmit()
+		{
+			AkInt64 iNow;
+			AKPLATFORM::PerformanceCounter( &iNow );
+			return AKPLATFORM::Elapsed( iNow, iSubmitTime );
 		}
 
 		// Returns true if the transfer's data can be added to the stream, in CAkStmTask::Update(). 
@@ -87,6 +97,18 @@ namespace StreamMgr
 			eStatus = TransferStatus_Completed;
 		}
 
+		// Set when the transfer is merged with others in a single read (see AkCoalescedTransfer): the Low-Level IO 
+		// never sees its transfer info, so it cannot be asked to cancel it.
+		inline void TagAsCoalesced()
+		{
+			bIsCoalesced = true;
+		}
+		// Coalesced transfers are sampled once for the I/O model, as a whole (see CoalescedIOCallback()).
+		inline bool IsCoalesced()
+		{
+			return bIsCoalesced;
+		}
+
 		// Cancel a transfer: calls Cancel() on the Low-Level IO if required to do so.
 		// This transfer must have been tagged as 'cancelled' before calling this method.
 		inline void Cancel( 
@@ -100,13 +122,14 @@ namespace StreamMgr
 			
 			if ( in_bCallLowLevelIO )
 			{
-				if ( !bWasLLIOCancelCalled )
+				if ( !bWasLLIOCancelCalled 
+					&& !bIsCoalesced )
 				{
 					in_pLowLevelHook->Cancel( in_fileDesc, info, io_bAllCancelled );
 				}
 				else
 				{
-					// Cancel() was already called. Clear io_bAllCancelled, as we still need to 
+					// Cancel() was already called, or cannot be called. Clear io_bAllCancelled, as we still need to 
 					// ask the Low-Level IO to cancel next transfers, if applicable.
 					io_bAllCancelled = false;
 				}
@@ -139,6 +162,7 @@ namespace StreamMgr
 
 	private:
 		AkUInt64		uExpectedFilePosition;	// Expected file position after transfer completed successfully.
+		AkInt64			iSubmitTime;			// Time when the transfer was prepared (for the device's I/O model).
 		CAkStmTask *	pOwner;					// Owner task.
 	public:
 		CAkPendingTransfer *	pNextTransfer;	// Pointer to next transfer (required by AkListbareXX): PendingTransfersList or CancelledTransfersList.
@@ -146,6 +170,7 @@ namespace StreamMgr
 	private:
 		AkUInt32 /*TransferStatusType*/	eStatus	:3;	// Status type. Starts as Pending, then becomes completed or cancelled.
 		AkUInt32		bWasLLIOCancelCalled	:1;	// This bit is set when IAkLowLevelIO::Cancel() is called (to avoid calling it more than once).
+		AkUInt32		bIsCoalesced			:1;	// Transfer was merged in a single read with others (see TagAsCoalesced()).
 	};
 
 	// Next item policy for list bare.
@@ -32,7 +32,8 @@ namespace StreamMgr
     public:
 
 		CAkDeviceDeferredLinedUpBase( IAkLowLevelIOHook * in_pLowLevelHook )
-			:CAkDeviceBase( in_pLowLevelHook ) {}
+			:CAkDeviceBase( in_pLowLevelHook )
+			,m_uNumFreeTransferObjs( 0 ) {}
 		virtual ~CAkDeviceDeferredLinedUpBase() {}
 		
 		// Get/release cached transfer objects. CAkPendingTransfers are cached at device initialization
@@ -45,18 +46,21 @@ namespace StreamMgr
 			CAkPendingTransfer * pTransferObj = m_listFreeTransferObjs.First();
 			AKASSERT( pTransferObj || !"Not enough cached transfer objects" );
 			m_listFreeTransferObjs.RemoveFirst();
+			--m_uNumFreeTransferObjs;
 			return pTransferObj;
 		}
 		inline void ReleaseTransferObject( CAkPendingTransfer * in_pTransferObj )
 		{
 			AkAutoLock<CAkIOThread> transferCache( *this );
 			m_listFreeTransferObjs.AddFirst( in_pTransferObj );
+			++m_uNumFreeTransferObjs;
 		}
 
     protected:
 
 		typedef AkListBareLight<CAkPendingTransfer, AkListBareNextTransfer> FreeTransfersList;
         FreeTransfersList	m_listFreeTransferObjs;	// List of free transfers.
+		AkUInt32			m_uNumFreeTransferObjs;	// Number of free transfers: maximum number of transfers that can be issued now.
     };
 
 	template <class TStmBase>
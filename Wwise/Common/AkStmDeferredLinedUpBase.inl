@@ -95,6 +95,11 @@ void CAkStmDeferredLinedUpBase<TStmBase>::Update(
 	// in_pCookie must be set to valid transfer reference if IO was successful.
 	AKASSERT( in_eIOResult != AK_Success || pTransfer );
 
+	// Feed the device's I/O model. Coalesced transfers are sampled as a whole.
+	if ( AK_Success == in_eIOResult 
+		&& !pTransfer->IsCoalesced() )
+		TStmBase::m_pDevice->AddTransferSample( in_uActualIOSize, pTransfer->ElapsedSinceSubmit() );
+
 	bool bStoreData = ( AK_Success == in_eIOResult 
 					&& pTransfer->DoStoreData( in_uPosition + in_uActualIOSize ) );
 
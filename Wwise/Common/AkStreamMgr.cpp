@@ -126,6 +126,18 @@ void AK::StreamMgr::GetDefaultDeviceSettings(
 	out_settings.uMaxConcurrentIO			= AK_DEFAULT_MAX_CONCURRENT_IO;
 }
 
+void AK::StreamMgr::GetDefaultDeviceSettingsEx(
+	AkDeviceSettingsEx &		out_settings
+	)
+{
+	out_settings.pBatchHook				= NULL;
+	out_settings.pResidentDataHook		= NULL;
+	out_settings.uNumIOWorkers			= AK_DEFAULT_NUM_IO_WORKERS;
+	out_settings.fMeasuredThroughputWeight	= AK_DEFAULT_MEASURED_THROUGHPUT_WEIGHT;
+	out_settings.uMaxCoalescedSize		= AK_DEFAULT_MAX_COALESCED_SIZE;
+	out_settings.uCoalescingGap			= AK_DEFAULT_COALESCING_GAP;
+}
+
 AK::StreamMgr::IAkFileLocationResolver * AK::StreamMgr::GetFileLocationResolver()
 {
 	AKASSERT( AK::IAkStreamMgr::m_pStreamMgr 
@@ -148,7 +160,17 @@ AkDeviceID AK::StreamMgr::CreateDevice(
 	IAkLowLevelIOHook *			in_pLowLevelHook	// Device specific low-level I/O hook.
     )
 {
-    return static_cast<CAkStreamMgr*>(AK::IAkStreamMgr::Get())->CreateDevice( in_settings, in_pLowLevelHook );
+	AkDeviceSettingsEx settingsEx;
+	GetDefaultDeviceSettingsEx( settingsEx );
+    return static_cast<CAkStreamMgr*>(AK::IAkStreamMgr::Get())->CreateDevice( in_settings, settingsEx, in_pLowLevelHook );
+}
+AkDeviceID AK::StreamMgr::CreateDeviceEx(
+    const AkDeviceSettings &	in_settings,		// Device settings.
+	const AkDeviceSettingsEx &	in_settingsEx,		// Optional device settings.
+	IAkLowLevelIOHook *			in_pLowLevelHook	// Device specific low-level I/O hook.
+    )
+{
+    return static_cast<CAkStreamMgr*>(AK::IAkStreamMgr::Get())->CreateDevice( in_settings, in_settingsEx, in_pLowLevelHook );
 }
 AKRESULT AK::StreamMgr::DestroyDevice(
     AkDeviceID                  in_deviceID         // Device ID.
@@ -225,6 +247,7 @@ void CAkStreamMgr::Term()
 // Device creation.
 AkDeviceID CAkStreamMgr::CreateDevice(
     const AkDeviceSettings &	in_settings,		// Device settings.
+	const AkDeviceSettingsEx &	in_settingsEx,		// Optional device settings.
 	IAkLowLevelIOHook *			in_pLowLevelHook	// Device specific low-level I/O hook.
     )
 {
@@ -264,6 +287,7 @@ AkDeviceID CAkStreamMgr::CreateDevice(
         {
             eResult = pNewDevice->Init( 
 				in_settings,
+				in_settingsEx,
 				newDeviceID );
         }
         AKASSERT( eResult == AK_Success || !"Cannot initialize IO device" );
@@ -276,6 +300,7 @@ AkDeviceID CAkStreamMgr::CreateDevice(
         {
             eResult = pNewDevice->Init( 
 				in_settings,
+				in_settingsEx,
 				newDeviceID );
         }
         AKASSERT( eResult == AK_Success || !"Cannot initialize IO device" );
@@ -599,6 +624,7 @@ AKRESULT CAkStreamMgr::CreateAuto(
 	if ( bSyncOpen )
 	{
 		pTask->SetFileOpen();
+		pTask->OnSyncFileOpen();
 	}
 	else
 	{
@@ -690,6 +716,7 @@ AKRESULT CAkStreamMgr::CreateAuto(
 	if ( bSyncOpen )
 	{
 		pTask->SetFileOpen();
+		pTask->OnSyncFileOpen();
 	}
 	else
 	{
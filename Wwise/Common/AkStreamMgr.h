@@ -49,6 +49,9 @@ namespace StreamMgr
 		void GetDefaultDeviceSettings(
 			AkDeviceSettings &			out_settings
 			);
+		void GetDefaultDeviceSettingsEx(
+			AkDeviceSettingsEx &		out_settings
+			);
 
 		// Public file location handler getter/setter.
 		friend IAkFileLocationResolver * GetFileLocationResolver();
@@ -63,6 +66,11 @@ namespace StreamMgr
             const AkDeviceSettings &    in_settings,		// Device settings.
 			IAkLowLevelIOHook *			in_pLowLevelHook	// Device specific low-level I/O hook.
             );
+        friend AkDeviceID CreateDeviceEx(
+            const AkDeviceSettings &    in_settings,		// Device settings.
+			const AkDeviceSettingsEx &	in_settingsEx,		// Optional device settings.
+			IAkLowLevelIOHook *			in_pLowLevelHook	// Device specific low-level I/O hook.
+            );
         // Warning: This function is not thread safe. No stream should exist for that device when it is destroyed.
         friend AKRESULT   DestroyDevice(
             AkDeviceID                  in_deviceID         // Device ID.
@@ -178,6 +186,7 @@ namespace StreamMgr
         // Warning: This function is not thread safe.
         AkDeviceID CreateDevice(
             const AkDeviceSettings &    in_settings,		// Device settings.
+			const AkDeviceSettingsEx &	in_settingsEx,		// Optional device settings.
 			IAkLowLevelIOHook *			in_pLowLevelHook	// Device specific low-level I/O hook.
             );
         // Warning: This function is not thread safe. No stream should exist for that device when it is destroyed.
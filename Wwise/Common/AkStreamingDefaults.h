@@ -20,7 +20,7 @@
 															// cancellation, or CPU spikes. I/O memory should be bound by the size of each device's I/O pool instead.
 
 // Device settings.
-#define AK_DEFAULT_DEVICE_IO_POOL_SIZE		(2*1024*1024)	// 2 MB for I/O. Pool is split up in blocks of size AkDeviceSettings::uGranularity.
+#define AK_DEFAULT_DEVICE_IO_POOL_SIZE		(2*1024*1024)	// 2 MB for I/O. Pool is split up in buffers of each stream's size (AkDeviceSettings::uGranularity by default).
 															// The smaller the granularity, the smaller this pool can be to handle the same number of streams.
 															// However, having a small granularity is often inefficient regarding I/O throughput.
 															// As a rule of thumb, use the smallest granularity that does not degrade I/O throughput.
@@ -36,6 +36,10 @@
 #define AK_DEFAULT_DEVICE_BUFFERING_LENGTH	(380.f)			// 380 ms. 
 #define AK_DEFAULT_IDLE_WAIT_TIME			(AK_INFINITE)	// Infinite. The thread will only wake up when one of its streams gets below its target buffering length.
 #define AK_DEFAULT_MAX_CONCURRENT_IO		(8)				// 8. With AK_SCHEDULER_BLOCKING, it is always 1 anyway. Default is arbitrarily set to 8 for deferred device.
+#define AK_DEFAULT_NUM_IO_WORKERS			(1)				// 1. The I/O thread of a AK_SCHEDULER_BLOCKING device performs transfers itself.
+#define AK_DEFAULT_MEASURED_THROUGHPUT_WEIGHT	(0.f)		// 0. Automatic streams are scheduled according to their throughput heuristic only.
+#define AK_DEFAULT_MAX_COALESCED_SIZE		(0)				// 0. Transfers are not coalesced.
+#define AK_DEFAULT_COALESCING_GAP			(0)				// 0. Only adjacent transfers are coalesced.
 
 
 #endif //_STREAMING_DEFAULTS_H_
\ No newline at end of file
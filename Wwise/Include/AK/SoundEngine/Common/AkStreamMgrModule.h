@@ -70,6 +70,13 @@ struct AkDeviceSettings
 /// which needs data the most, and calls the asynchronous overloads of AK::IAkLowLevelIO::Read() and AK::IAkLowLevelIO::Write().
 /// Up to AkDeviceSettings::uMaxConcurrentIO requests can be sent to the Low-Level I/O at the same time.
 #define AK_SCHEDULER_DEFERRED_LINED_UP (0x02)
+/// Elevator dispatch: combine with AK_SCHEDULER_BLOCKING or AK_SCHEDULER_DEFERRED_LINED_UP, for media where seeking is expensive (hard 
+/// disks, optical discs). Among tasks whose deadline is not at risk, the scheduler chooses the one whose next transfer starts nearest after
+/// the end of the previous one, sweeping file positions in one direction and wrapping around (C-LOOK). Tasks that are starving, or 
+/// whose deadline would be missed if another transfer was inserted before theirs, still preempt the sweep. File positions 
+/// (AkFileDesc::uSector plus offset) are compared as such, so the policy is most effective when streamed files share a file 
+/// handle (for example, files of the same file package).
+#define AK_SCHEDULER_ELEVATOR          (0x04)
 
 /// File descriptor. File identification for the low-level I/O.
 /// \sa
@@ -134,6 +141,56 @@ struct AkIoHeuristics
 	AkPriority		priority;			///< Operation priority (at the time it was scheduled and sent to the Low-Level I/O). Range is [AK_MIN_PRIORITY,AK_MAX_PRIORITY], inclusively.
 };
 
+/// Transfer of a batch submitted to the Low-Level IO.
+/// \sa 
+/// - AK::StreamMgr::IAkIOHookDeferredBatch::BatchRead()
+/// - AK::StreamMgr::IAkIOHookDeferredBatch::BatchWrite()
+struct AkAsyncIOBatchTransfer
+{
+	AkFileDesc *			pFileDesc;		///< File descriptor.
+	AkAsyncIOTransferInfo *	pTransferInfo;	///< Asynchronous data transfer info.
+	AkIoHeuristics			heuristics;		///< Heuristics for this data transfer.
+	AKRESULT				eResult;		///< Returned result of the submission of this transfer. Same meaning as the return code of Read()/Write().
+};
+
+namespace AK
+{
+	namespace StreamMgr
+	{
+		class IAkIOHookDeferredBatch;
+		class IAkIOHookResidentData;
+	}
+}
+
+/// Optional settings of high-level IO devices, and optional interfaces implemented by their Low-Level I/O hook.
+/// They are kept apart from AkDeviceSettings, whose layout is fixed, and are only read by AK::StreamMgr::CreateDeviceEx().
+/// Devices created with AK::StreamMgr::CreateDevice() use the values returned by AK::StreamMgr::GetDefaultDeviceSettingsEx(),
+/// with which all these features are disabled.
+/// \sa 
+/// - AK::StreamMgr::CreateDeviceEx()
+/// - AK::StreamMgr::GetDefaultDeviceSettingsEx()
+struct AkDeviceSettingsEx
+{
+	AK::StreamMgr::IAkIOHookDeferredBatch * pBatchHook;	///< Batch interface of the Low-Level I/O hook (applies to AK_SCHEDULER_DEFERRED_LINED_UP device only). 
+													///< NULL (default) if the hook does not implement it: transfers are then sent one by one.
+	AK::StreamMgr::IAkIOHookResidentData * pResidentDataHook;	///< Resident data interface of the Low-Level I/O hook. NULL (default) if the hook does not implement it: 
+													///< automatic streams are then always read with the device's I/O memory.
+	AkUInt32			uNumIOWorkers;				///< Number of I/O worker threads (applies to AK_SCHEDULER_BLOCKING device only). With 1 (default), the I/O thread performs blocking transfers itself.
+													///< With more, the I/O thread only schedules transfers, and up to uNumIOWorkers blocking transfers are executed in parallel by worker threads
+													///< that share the scheduler. Workers have a local queue and steal transfers from each other. They use AkDeviceSettings::threadProperties. 
+													///< <b>Important: </b> The Low-Level IO hook's Open(), Read() and Write() are then called concurrently from several threads.
+	AkReal32			fMeasuredThroughputWeight;	///< Weight, between 0 and 1, of the throughput measured on automatic streams, versus their AkAutoStmHeuristics::fThroughput heuristic.
+													///< Automatic streams measure the rate at which their client consumes data. With 0 (default), scheduling deadlines and target buffering
+													///< are based on the heuristic only. With 1, they are based on the measured rate only, once it is known.
+	AkUInt32			uMaxCoalescedSize;			///< Maximum size of a read that merges transfers of different streams (applies to AK_SCHEDULER_DEFERRED_LINED_UP device only).
+													///< Reads that are scheduled together, on the same file handle (for example, files of the same file package), and whose ranges 
+													///< are adjacent or close (see uCoalescingGap), are sent to the Low-Level I/O as one read. If the buffers of the streams follow 
+													///< each other in I/O memory, data is read directly into them. Otherwise it is read into a buffer of the I/O memory, then copied 
+													///< to each stream: at most uMaxCoalescedSize bytes (rounded up to a block of I/O memory) are used for this at any time, 
+													///< and should be accounted for in AkDeviceSettings::uIOMemorySize. 0 (default) disables coalescing.
+	AkUInt32			uCoalescingGap;				///< Maximum number of bytes between two reads that are merged. These bytes are read and discarded. 0 (default) merges adjacent reads only.
+};
+
 
 
 //@}
@@ -344,6 +401,79 @@ namespace AK
 				) = 0;
 		};
 
+		/// Optional interface for deferred Low-Level I/O hooks that submit several transfers at once more 
+		/// cheaply than one by one (for example, with a single system call). It is implemented alongside
+		/// IAkIOHookDeferred, and registered to the device in AkDeviceSettingsEx::pBatchHook when it is created 
+		/// with AK::StreamMgr::CreateDeviceEx(). The device then sends the transfers that it schedules in the same 
+		/// pass in a single call, consecutive transfers of the same direction together. Cancel() is still called 
+		/// on IAkIOHookDeferred for each transfer.
+		/// \sa
+		/// - AK::StreamMgr::IAkIOHookDeferred
+		/// - AkDeviceSettingsEx
+		class IAkIOHookDeferredBatch
+		{
+		protected:
+			/// Virtual destructor on interface to avoid warnings.
+			virtual ~IAkIOHookDeferredBatch(){}
+
+		public:
+
+			/// Reads data from files (asynchronous), for a batch of transfers.
+			/// \remarks 
+			/// Each transfer follows the rules of IAkIOHookDeferred::Read(). Set AkAsyncIOBatchTransfer::eResult of each 
+			/// transfer as you would return it from Read(); the callback must only be called for transfers that are set to AK_Success.
+			virtual void BatchRead(
+				AkUInt32				in_uNumTransfers,	///< Number of transfers in io_arTransfers.
+				AkAsyncIOBatchTransfer * io_arTransfers		///< Transfers to submit.
+				) = 0;
+
+			/// Writes data to files (asynchronous), for a batch of transfers.
+			/// \remarks 
+			/// Each transfer follows the rules of IAkIOHookDeferred::Write(). Set AkAsyncIOBatchTransfer::eResult of each 
+			/// transfer as you would return it from Write(); the callback must only be called for transfers that are set to AK_Success.
+			virtual void BatchWrite(
+				AkUInt32				in_uNumTransfers,	///< Number of transfers in io_arTransfers.
+				AkAsyncIOBatchTransfer * io_arTransfers		///< Transfers to submit.
+				) = 0;
+		};
+
+		/// Optional interface for Low-Level I/O hooks that keep the content of some files resident in memory 
+		/// (for example, a memory-mapped file package). It is implemented alongside IAkIOHookBlocking or 
+		/// IAkIOHookDeferred, and registered to the device in AkDeviceSettingsEx::pResidentDataHook when it is created 
+		/// with AK::StreamMgr::CreateDeviceEx(). Automatic streams opened on resident files grant buffers that point 
+		/// directly into this memory: they are never scheduled for I/O, and do not use the device's I/O memory.
+		/// \sa
+		/// - AkDeviceSettingsEx
+		class IAkIOHookResidentData
+		{
+		protected:
+			/// Virtual destructor on interface to avoid warnings.
+			virtual ~IAkIOHookResidentData(){}
+
+		public:
+
+			/// Returns the address of the content of a file that is resident in memory, and adds a reference to it.
+			/// \return
+			/// The address of position 0 of the file handle (AkFileDesc::uSector is relative to it), or NULL
+			/// if the data is not resident. The memory must remain valid and cover the whole file
+			/// (AkFileDesc::uSector * GetBlockSize() + AkFileDesc::iFileSize bytes) until ReleaseResidentData()
+			/// is called, even if the file handle is closed in the meantime.
+			/// \remarks
+			/// Only called for files opened for reading synchronously, before the stream is handed to its client.
+			/// \sa
+			/// - AK::StreamMgr::IAkIOHookResidentData::ReleaseResidentData()
+			virtual const void * AddRefResidentData(
+				AkFileDesc &			in_fileDesc			///< File descriptor.
+				) = 0;
+
+			/// Releases a reference obtained with AddRefResidentData(). Called before Close() when the stream
+			/// is destroyed.
+			virtual void ReleaseResidentData(
+				AkFileDesc &			in_fileDesc,		///< File descriptor.
+				const void *			in_pData			///< Address returned by AddRefResidentData().
+				) = 0;
+		};
+
 		/// File location resolver interface. There is one and only one File Location Resolver that is
 		/// registered to the Stream Manager (using AK::StreamMgr::SetFileLocationResolver()). Its purpose
 		/// is to map a file name or ID to 
@@ -530,6 +660,20 @@ namespace AK
 			const AkDeviceSettings &	in_settings,		///< Device settings.
 			IAkLowLevelIOHook *			in_pLowLevelHook	///< Associated low-level I/O hook. Pass either a IAkIOHookBlocking or a IAkIOHookDeferred interface, consistent with the type of the scheduler.
 			);
+		/// Streaming device creation, with optional settings and interfaces of the low-level I/O hook.
+		/// Same as AK::StreamMgr::CreateDevice() otherwise, which uses the default optional settings.
+		/// \return The device ID. AK_INVALID_DEVICE_ID if there was an error and it could not be created.
+		/// \warning This function is not thread-safe.
+		/// \remarks You may use AK::StreamMgr::GetDefaultDeviceSettingsEx() first to get default values for the 
+		/// optional settings, then change those you want.
+		/// \sa
+		/// - AK::StreamMgr::CreateDevice()
+		/// - AK::StreamMgr::GetDefaultDeviceSettingsEx()
+		extern AKSTREAMMGR_API AkDeviceID CreateDeviceEx(
+			const AkDeviceSettings &	in_settings,		///< Device settings.
+			const AkDeviceSettingsEx &	in_settingsEx,		///< Optional device settings.
+			IAkLowLevelIOHook *			in_pLowLevelHook	///< Associated low-level I/O hook. Pass either a IAkIOHookBlocking or a IAkIOHookDeferred interface, consistent with the type of the scheduler.
+			);
 		/// Streaming device destruction.
 		/// \return AK_Success if the device was successfully destroyed.
 		/// \warning This function is not thread-safe. No stream should exist for that device when it is destroyed.
@@ -546,6 +690,15 @@ namespace AK
 		extern AKSTREAMMGR_API void GetDefaultDeviceSettings(
 			AkDeviceSettings &			out_settings		///< Returned AkDeviceSettings structure with default values.
 			);
+
+		/// Get the default values for the streaming device's optional settings. Recommended usage
+		/// is to call this function first, then pass the settings to AK::StreamMgr::CreateDeviceEx().
+		/// \sa 
+		/// - AK::StreamMgr::CreateDeviceEx()
+		/// - AkDeviceSettingsEx
+		extern AKSTREAMMGR_API void GetDefaultDeviceSettingsEx(
+			AkDeviceSettingsEx &		out_settings		///< Returned AkDeviceSettingsEx structure with default values.
+			);
 		//@}
 	}
 }
@@ -97,7 +97,8 @@ struct AkAutoStmHeuristics
 struct AkAutoStmBufSettings
 {
     AkUInt32			uBufferSize;		///< Hard user constraint: When non-zero, forces the I/O buffer to be of size uBufferSize
-											///< (overriding the device's granularity).
+											///< (overriding the device's granularity). It may be smaller or greater than the granularity: the I/O memory
+											///< of devices is divided in buffers of various sizes, and automatic streams read one buffer per transfer.
 											///< Otherwise, the size is determined by the device's granularity.
     AkUInt32            uMinBufferSize;     ///< Soft user constraint: When non-zero, specifies a minimum buffer size
                                             ///< \remarks Ignored if uBufferSize is specified.
@@ -118,6 +119,16 @@ struct AkDeviceDesc
     AkUInt32            uStringSize;        ///< Device name string's size (number of characters)
 };
 
+/// Device I/O model: latency and bandwidth of a device, measured by the Stream Manager from the time
+/// transfers take between their submission to the Low-Level IO and their completion.
+/// The expected duration of a transfer of N bytes is fLatency + N / fBandwidth.
+struct AkDeviceIOModel
+{
+    AkReal32            fLatency;           ///< Fixed cost of a transfer, in ms
+    AkReal32            fBandwidth;         ///< Bandwidth, in bytes/ms. 0 if unknown (no transfer measured yet)
+    AkUInt32            uNumSamples;        ///< Number of transfers measured
+};
+
 /// Stream general information.
 struct AkStreamRecord
 {
@@ -233,6 +244,14 @@ namespace AK
         virtual IAkStreamProfile * GetStreamProfile( 
 			AkUInt32    in_uStreamIndex     ///< Stream index: [0,numStreams[
             ) = 0;
+
+        /// Query the device's I/O model, as measured by the Stream Manager and used by its scheduler.
+		/// \sa
+		/// - \ref streamingdevicemanager
+		/// - \ref streamingmanager_overriding
+        virtual void    GetIOModel(
+            AkDeviceIOModel & out_ioModel       ///< Returned I/O model.
+            ) = 0;
     };
 
     /// Profiling interface of the Stream Manager.
@@ -578,6 +597,59 @@ namespace AK
 		/// - \ref streamingmanager_overriding
         virtual AKRESULT ReleaseBuffer() = 0;
         //@}
+
+        /// \name Seek hints.
+        //@{
+
+        /// Give hints on the positions that the stream is likely to be set to next with AK::IAkAutoStream::SetPosition().
+        /// \remarks When the device has idle bandwidth, a window of data is prefetched at these positions into the stream's
+        /// segment cache (see AK::IAkAutoStream::SetSegmentCacheSize()), so that seeking there does not wait for I/O. 
+        /// Streams without a segment cache ignore hints.
+        /// \remarks Hints replace the previous ones. Pass 0 positions to clear them. Independently of hints, the stream 
+        /// learns the targets of its recurring seeks. A stream tracks a limited number of targets: extra positions are ignored.
+        /// \remarks Positions round down to the low-level I/O block size. Positions past the end of file are ignored.
+        /// \return AK_Success, or AK_InvalidParameter if in_puPositions is NULL while in_uNumPositions is not 0
+		/// \sa
+		/// - \ref streamingdevicemanager
+		/// - \ref streamingmanager_overriding
+        virtual AKRESULT SetSeekTargets(
+            const AkUInt64 * in_puPositions,    ///< Array of positions (offsets from the beginning of the stream)
+            AkUInt32        in_uNumPositions    ///< Number of positions in array
+            ) = 0;
+        //@}
+
+        /// \name Storage settings.
+        //@{
+
+        /// Set the size of the stream's ring buffer. When non-zero, the stream reads into a contiguous ring of I/O memory 
+        /// of about that size, reserved for it while it streams (ring-buffer storage mode). Consecutive transfers are granted 
+        /// as a single buffer when they are contiguous in the ring. Recommended for long sequential streams.
+        /// \remarks Streams do not use a ring buffer by default. 
+        /// \remarks Must be called before the stream is started. The ring is rounded to a whole number of stream buffers, 
+        /// and is limited by the largest block of the device's I/O memory: a ring of less than 2 buffers is ignored.
+        /// \return AK_Success, or AK_Fail if the stream was already started or has data buffered
+		/// \sa
+		/// - \ref streamingdevicemanager
+		/// - \ref streamingmanager_overriding
+        virtual AKRESULT SetRingBufferSize(
+            AkUInt32        in_uRingBufferSize  ///< Ring size, in bytes. 0 disables the ring buffer
+            ) = 0;
+
+        /// Set the size of the stream's segment cache: the maximum size of data that the stream keeps after it is flushed by 
+        /// AK::IAkAutoStream::SetPosition(), or released by the client at the beginning of the file or of the loop region. 
+        /// A later SetPosition() back into these ranges is served without I/O. Recommended for music segments that are 
+        /// jumped to or re-entered. The cache also holds data prefetched at likely seek targets (see AK::IAkAutoStream::SetSeekTargets()).
+        /// \remarks Streams do not cache data by default. 
+        /// \remarks Cached data is taken from the device's I/O memory, and is given away first when memory is needed. 
+        /// Reducing the size evicts the oldest cached data. Data of the ring buffer is never cached.
+        /// \return AK_Success
+		/// \sa
+		/// - \ref streamingdevicemanager
+		/// - \ref streamingmanager_overriding
+        virtual AKRESULT SetSegmentCacheSize(
+            AkUInt32        in_uSegmentCacheSize ///< Maximum size of cached data, in bytes. 0 disables the cache
+            ) = 0;
+        //@}
     };
 
     //@}
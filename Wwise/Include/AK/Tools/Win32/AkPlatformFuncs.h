@@ -117,6 +117,20 @@ namespace AKPLATFORM
 		return InterlockedDecrement( pValue );
 	}
 
+	/// Platform Independent Helper
+	/// Returns the initial value of *io_ppDest.
+	inline void * AkInterlockedCompareExchangePointer( void * volatile * io_ppDest, void * in_pExchange, void * in_pComparand )
+	{
+		return InterlockedCompareExchangePointer( io_ppDest, in_pExchange, in_pComparand );
+	}
+
+	/// Platform Independent Helper
+	/// Returns the initial value of *io_ppDest.
+	inline void * AkInterlockedExchangePointer( void * volatile * io_ppDest, void * in_pValue )
+	{
+		return InterlockedExchangePointer( io_ppDest, in_pValue );
+	}
+
     // Threads
     // ------------------------------------------------------------------
 
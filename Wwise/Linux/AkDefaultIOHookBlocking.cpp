@@ -0,0 +1,406 @@
+//////////////////////////////////////////////////////////////////////
+//
+// AkDefaultIOHookBlocking.cpp
+//
+// Default blocking low level IO hook (AK::StreamMgr::IAkIOHookBlocking)
+// and file system (AK::StreamMgr::IAkFileLocationResolver) implementation
+// on Linux. It can be used as a standalone implementation of the
+// Low-Level I/O system.
+//
+// See AkDefaultIOHookBlocking.h for details.
+//
+// Copyright (c) 2006 Audiokinetic Inc. / All Rights Reserved
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "AkDefaultIOHookBlocking.h"
+#include "AkFileHelpers.h"
+#include <time.h>
+
+
+#define LINUX_BLOCKING_DEVICE_NAME		("Linux Blocking")	// Default blocking device name.
+
+// Read-ahead hints for sequential reads (buffered mode only). After each read, the range that
+// the stream should consume in the next LINUX_BLOCKING_READAHEAD_TIME ms is advised with
+// POSIX_FADV_WILLNEED, up to LINUX_BLOCKING_MAX_READAHEAD bytes.
+#define LINUX_BLOCKING_READAHEAD_TIME	(500.f)				// ms
+#define LINUX_BLOCKING_MAX_READAHEAD	(2*1024*1024)		// bytes
+// Weight of the last measurement in the throughput of a tracked read.
+#define LINUX_BLOCKING_THROUGHPUT_SMOOTHING	(0.25f)
+
+CAkDefaultIOHookBlocking::CAkDefaultIOHookBlocking()
+: m_deviceID( AK_INVALID_DEVICE_ID )
+, m_bAsyncOpen( false )
+, m_bUnbufferedIO( false )
+{
+	pthread_mutex_init( &m_lockTrackedReads, NULL );
+	for ( AkUInt32 uSlot = 0; uSlot < LINUX_BLOCKING_MAX_TRACKED_READS; ++uSlot )
+		m_arTrackedReads[uSlot].hFile = AK_INVALID_FILE_HANDLE;
+}
+
+CAkDefaultIOHookBlocking::~CAkDefaultIOHookBlocking()
+{
+	pthread_mutex_destroy( &m_lockTrackedReads );
+}
+
+// Initialization/termination. Init() registers this object as the one and
+// only File Location Resolver if none were registered before. Then
+// it creates a streaming device with scheduler type AK_SCHEDULER_BLOCKING.
+AKRESULT CAkDefaultIOHookBlocking::Init(
+	const AkDeviceSettings &	in_deviceSettings,			// Device settings.
+	bool						in_bAsyncOpen/*=false*/,	// If true, files are opened asynchronously when possible.
+	bool						in_bUnbufferedIO/*=false*/,	// If true, files opened for reading use O_DIRECT.
+	const AkDeviceSettingsEx *	in_pDeviceSettingsEx/*=NULL*/	// Optional device settings. Pass NULL to use defaults.
+	)
+{
+	if ( ( in_deviceSettings.uSchedulerTypeFlags & ~AK_SCHEDULER_ELEVATOR ) != AK_SCHEDULER_BLOCKING )
+	{
+		assert( !"CAkDefaultIOHookBlocking I/O hook only works with AK_SCHEDULER_BLOCKING devices" );
+		return AK_Fail;
+	}
+
+	m_bAsyncOpen = in_bAsyncOpen;
+	m_bUnbufferedIO = in_bUnbufferedIO;
+
+	// If the Stream Manager's File Location Resolver was not set yet, set this object as the
+	// File Location Resolver (this I/O hook is also able to resolve file location).
+	if ( !AK::StreamMgr::GetFileLocationResolver() )
+		AK::StreamMgr::SetFileLocationResolver( this );
+
+	// Create a device in the Stream Manager, specifying this as the hook.
+	if ( in_pDeviceSettingsEx )
+		m_deviceID = AK::StreamMgr::CreateDeviceEx( in_deviceSettings, *in_pDeviceSettingsEx, this );
+	else
+		m_deviceID = AK::StreamMgr::CreateDevice( in_deviceSettings, this );
+	if ( m_deviceID != AK_INVALID_DEVICE_ID )
+		return AK_Success;
+
+	return AK_Fail;
+}
+
+void CAkDefaultIOHookBlocking::Term()
+{
+	if ( AK::StreamMgr::GetFileLocationResolver() == this )
+		AK::StreamMgr::SetFileLocationResolver( NULL );
+	AK::StreamMgr::DestroyDevice( m_deviceID );
+}
+
+//
+// IAkFileLocationAware interface.
+//-----------------------------------------------------------------------------
+
+// Returns a file descriptor for a given file name (string).
+AKRESULT CAkDefaultIOHookBlocking::Open(
+    const AkOSChar* in_pszFileName,     // File name.
+    AkOpenMode      in_eOpenMode,       // Open mode.
+    AkFileSystemFlags * in_pFlags,      // Special flags. Can pass NULL.
+	bool &			io_bSyncOpen,		// If true, the file must be opened synchronously. Otherwise it is left at the File Location Resolver's discretion. Return false if Open needs to be deferred.
+    AkFileDesc &    out_fileDesc        // Returned file descriptor.
+    )
+{
+	// We normally consider that calls to ::open() on a hard drive are fast enough to execute in the
+	// client thread. If you want files to be opened asynchronously when it is possible, this device should
+	// be initialized with the flag in_bAsyncOpen set to true.
+	if ( io_bSyncOpen || !m_bAsyncOpen )
+	{
+		io_bSyncOpen = true;
+
+		// Get the full file path, using path concatenation logic.
+		AkOSChar szFullFilePath[AK_MAX_PATH];
+		if ( GetFullFilePath( in_pszFileName, in_pFlags, in_eOpenMode, szFullFilePath ) == AK_Success )
+			return OpenFile( szFullFilePath, in_eOpenMode, out_fileDesc );
+
+		return AK_Fail;
+	}
+	else
+	{
+		// The client allows us to perform asynchronous opening.
+		// We only need to specify the deviceID, and leave the boolean to false.
+		out_fileDesc.iFileSize			= 0;
+		out_fileDesc.uSector			= 0;
+		out_fileDesc.deviceID			= m_deviceID;
+		out_fileDesc.pCustomParam		= NULL;
+		out_fileDesc.uCustomParamSize	= 0;
+		out_fileDesc.hFile				= AK_INVALID_FILE_HANDLE;
+		return AK_Success;
+	}
+}
+
+// Returns a file descriptor for a given file ID.
+AKRESULT CAkDefaultIOHookBlocking::Open(
+    AkFileID        in_fileID,          // File ID.
+    AkOpenMode      in_eOpenMode,       // Open mode.
+    AkFileSystemFlags * in_pFlags,      // Special flags. Can pass NULL.
+	bool &			io_bSyncOpen,		// If true, the file must be opened synchronously. Otherwise it is left at the File Location Resolver's discretion. Return false if Open needs to be deferred.
+    AkFileDesc &    out_fileDesc        // Returned file descriptor.
+    )
+{
+	// We normally consider that calls to ::open() on a hard drive are fast enough to execute in the
+	// client thread. If you want files to be opened asynchronously when it is possible, this device should
+	// be initialized with the flag in_bAsyncOpen set to true.
+	if ( io_bSyncOpen || !m_bAsyncOpen )
+	{
+		io_bSyncOpen = true;
+
+		// Get the full file path, using path concatenation logic.
+		AkOSChar szFullFilePath[AK_MAX_PATH];
+		if ( GetFullFilePath( in_fileID, in_pFlags, in_eOpenMode, szFullFilePath ) == AK_Success )
+			return OpenFile( szFullFilePath, in_eOpenMode, out_fileDesc );
+
+		return AK_Fail;
+	}
+	else
+	{
+		// The client allows us to perform asynchronous opening.
+		// We only need to specify the deviceID, and leave the boolean to false.
+		out_fileDesc.iFileSize			= 0;
+		out_fileDesc.uSector			= 0;
+		out_fileDesc.deviceID			= m_deviceID;
+		out_fileDesc.pCustomParam		= NULL;
+		out_fileDesc.uCustomParamSize	= 0;
+		out_fileDesc.hFile				= AK_INVALID_FILE_HANDLE;
+		return AK_Success;
+	}
+}
+
+// Helpers for file opening (common to both Open() overloads).
+AKRESULT CAkDefaultIOHookBlocking::OpenFile(
+	const AkOSChar *		in_pszFullFilePath,	// Full file path.
+	AkOpenMode				in_eOpenMode,		// Open mode.
+	AkFileDesc &			out_fileDesc		// Returned file descriptor.
+	)
+{
+	// O_DIRECT is only used for reading: written files would require block-multiple sizes,
+	// which the Stream Manager does not guarantee for the last write.
+	bool bUnbuffered = m_bUnbufferedIO && in_eOpenMode == AK_OpenModeRead;
+
+	AKRESULT eResult = CAkFileHelpers::OpenFile(
+		in_pszFullFilePath,
+		in_eOpenMode,
+		bUnbuffered,
+		out_fileDesc.hFile );
+	if ( eResult == AK_Success )
+	{
+		out_fileDesc.iFileSize			= CAkFileHelpers::GetFileSize( out_fileDesc.hFile );
+		out_fileDesc.uSector			= 0;
+		out_fileDesc.deviceID			= m_deviceID;
+		out_fileDesc.pCustomParam		= NULL;
+		out_fileDesc.uCustomParamSize	= 0;
+
+		// Streams are mostly read forward: let the kernel use a larger read-ahead window.
+		if ( !bUnbuffered && in_eOpenMode == AK_OpenModeRead )
+			CAkFileHelpers::Advise( out_fileDesc.hFile, 0, 0, POSIX_FADV_SEQUENTIAL );
+	}
+	return eResult;
+}
+
+//
+// IAkIOHookBlocking implementation.
+//-----------------------------------------------------------------------------
+
+// Reads data from a file (synchronous).
+AKRESULT CAkDefaultIOHookBlocking::Read(
+    AkFileDesc &			in_fileDesc,        // File descriptor.
+	const AkIoHeuristics & /*in_heuristics*/,	// Heuristics for this data transfer (not used in this implementation).
+    void *					out_pBuffer,        // Buffer to be filled with data.
+    AkIOTransferInfo &		io_transferInfo		// Synchronous data transfer info.
+    )
+{
+    assert( out_pBuffer &&
+            in_fileDesc.hFile != AK_INVALID_FILE_HANDLE );
+
+	// Note: With a file opened with O_DIRECT, reads support sizes that go beyond the end of file, but
+	// not sizes that are not a multiple of the block size. The requested size is truncated at the end of
+	// file (and is arbitrary for standard streams), so it is rounded up to the block size. The buffer is
+	// a multiple of the block size, so it can hold the extra data. 
+	AkUInt32 uSizeToRead = io_transferInfo.uRequestedSize;
+	AkUInt32 uBlockSize = GetBlockSize( in_fileDesc );
+	if ( uBlockSize > 1 )
+	{
+		uSizeToRead = ( ( uSizeToRead + uBlockSize - 1 ) / uBlockSize ) * uBlockSize;
+		assert( uSizeToRead <= io_transferInfo.uBufferSize );
+	}
+
+	AKRESULT eResult = CAkFileHelpers::ReadAt(
+		in_fileDesc.hFile,
+		out_pBuffer,
+		io_transferInfo.uFilePosition,
+		uSizeToRead,
+		io_transferInfo.uSizeTransferred );
+
+	// Only report the data that was requested.
+	if ( io_transferInfo.uSizeTransferred > io_transferInfo.uRequestedSize )
+		io_transferInfo.uSizeTransferred = io_transferInfo.uRequestedSize;
+
+	// Sequential reads: hint the kernel about the data that will be needed next, so that it is
+	// read while the stream is consuming this buffer. Pointless with O_DIRECT.
+	if ( eResult != AK_Success 
+		|| m_bUnbufferedIO )
+		return eResult;
+
+	AkReal32 fThroughput = TrackRead( in_fileDesc.hFile, io_transferInfo.uFilePosition, io_transferInfo.uSizeTransferred );
+	if ( fThroughput > 0 )
+	{
+		AkInt64 iNextPosition = (AkInt64)( io_transferInfo.uFilePosition + io_transferInfo.uSizeTransferred );
+		AkInt64 iLength = (AkInt64)( fThroughput * LINUX_BLOCKING_READAHEAD_TIME );
+		if ( iLength > LINUX_BLOCKING_MAX_READAHEAD )
+			iLength = LINUX_BLOCKING_MAX_READAHEAD;
+		if ( iNextPosition + iLength > in_fileDesc.iFileSize )
+			iLength = in_fileDesc.iFileSize - iNextPosition;
+		if ( iLength > 0 )
+			CAkFileHelpers::Advise( in_fileDesc.hFile, iNextPosition, iLength, POSIX_FADV_WILLNEED );
+	}
+
+	return eResult;
+}
+
+// Records a read, and returns the throughput of the sequential reads that it continues (bytes/ms).
+// A read continues a tracked read if it is on the same handle and starts where it ended. The blocking
+// device reads a stream again when the client has consumed enough of its buffering, so the throughput 
+// is the size of a read over the time until the next one. It is smoothed to absorb bursts, for example
+// while the stream is filling its buffering. Other reads replace the least recently tracked read.
+// Returns 0 until it is known.
+AkReal32 CAkDefaultIOHookBlocking::TrackRead(
+	AkFileHandle			in_hFile,			// File handle.
+	AkUInt64				in_uFilePosition,	// Position of the read.
+	AkUInt32				in_uSize			// Size of the read.
+	)
+{
+	struct timespec now;
+	::clock_gettime( CLOCK_MONOTONIC, &now );
+	AkInt64 iNow = (AkInt64)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+	pthread_mutex_lock( &m_lockTrackedReads );
+
+	AkTrackedRead * pRead = NULL;
+	AkTrackedRead * pOldest = &m_arTrackedReads[0];
+	for ( AkUInt32 uSlot = 0; uSlot < LINUX_BLOCKING_MAX_TRACKED_READS; ++uSlot )
+	{
+		AkTrackedRead & read = m_arTrackedReads[uSlot];
+		if ( read.hFile == in_hFile 
+			&& read.uNextPosition == in_uFilePosition )
+		{
+			pRead = &read;
+			break;
+		}
+		if ( read.hFile == AK_INVALID_FILE_HANDLE )
+			pOldest = &read;
+		else if ( pOldest->hFile != AK_INVALID_FILE_HANDLE 
+				&& read.iLastTime < pOldest->iLastTime )
+			pOldest = &read;
+	}
+
+	if ( pRead )
+	{
+		AkInt64 iElapsed = iNow - pRead->iLastTime;
+		if ( iElapsed > 0 )
+		{
+			AkReal32 fMeasured = (AkReal32)pRead->uLastSize / (AkReal32)iElapsed;
+			if ( pRead->fThroughput > 0 )
+				pRead->fThroughput += LINUX_BLOCKING_THROUGHPUT_SMOOTHING * ( fMeasured - pRead->fThroughput );
+			else
+				pRead->fThroughput = fMeasured;
+		}
+	}
+	else
+	{
+		pRead = pOldest;
+		pRead->hFile = in_hFile;
+		pRead->fThroughput = 0;
+	}
+	pRead->uNextPosition = in_uFilePosition + in_uSize;
+	pRead->uLastSize = in_uSize;
+	pRead->iLastTime = iNow;
+	AkReal32 fThroughput = pRead->fThroughput;
+
+	pthread_mutex_unlock( &m_lockTrackedReads );
+
+	return fThroughput;
+}
+
+// Writes data to a file (synchronous).
+AKRESULT CAkDefaultIOHookBlocking::Write(
+	AkFileDesc &			in_fileDesc,        // File descriptor.
+	const AkIoHeuristics & /*in_heuristics*/,	// Heuristics for this data transfer (not used in this implementation).
+    void *					in_pData,           // Data to be written.
+    AkIOTransferInfo &		io_transferInfo		// Synchronous data transfer info.
+    )
+{
+    assert( in_pData &&
+            in_fileDesc.hFile != AK_INVALID_FILE_HANDLE );
+
+	return CAkFileHelpers::WriteAt(
+		in_fileDesc.hFile,
+		in_pData,
+		io_transferInfo.uFilePosition,
+		io_transferInfo.uRequestedSize,
+		io_transferInfo.uSizeTransferred );
+}
+
+// Cleans up a file.
+AKRESULT CAkDefaultIOHookBlocking::Close(
+    AkFileDesc & in_fileDesc      // File descriptor.
+    )
+{
+	// Forget reads of this handle: its descriptor may be reused by another file.
+	pthread_mutex_lock( &m_lockTrackedReads );
+	for ( AkUInt32 uSlot = 0; uSlot < LINUX_BLOCKING_MAX_TRACKED_READS; ++uSlot )
+	{
+		if ( m_arTrackedReads[uSlot].hFile == in_fileDesc.hFile )
+			m_arTrackedReads[uSlot].hFile = AK_INVALID_FILE_HANDLE;
+	}
+	pthread_mutex_unlock( &m_lockTrackedReads );
+
+	return CAkFileHelpers::CloseFile( in_fileDesc.hFile );
+}
+
+// Returns the block size for the file or its storage device.
+AkUInt32 CAkDefaultIOHookBlocking::GetBlockSize(
+    AkFileDesc &  in_fileDesc     // File descriptor.
+    )
+{
+	if ( !m_bUnbufferedIO )
+	{
+		// No constraint on block size (file seeking).
+		return 1;
+	}
+
+	// The file was not opened yet (deferred open): we cannot know if it will be opened with
+	// O_DIRECT, nor query its block size. Return the default block size, which is a multiple
+	// of the logical block size of common storage devices.
+	if ( in_fileDesc.hFile == AK_INVALID_FILE_HANDLE )
+		return AK_LINUX_DEFAULT_BLOCK_SIZE;
+
+	// Files opened for writing are not opened with O_DIRECT.
+	int iFlags = ::fcntl( AK_FILE_HANDLE_TO_FD( in_fileDesc.hFile ), F_GETFL );
+	if ( iFlags < 0 || !( iFlags & O_DIRECT ) )
+		return 1;
+
+	return CAkFileHelpers::GetBlockSize( in_fileDesc.hFile );
+}
+
+
+// Returns a description for the streaming device above this low-level hook.
+AKRESULT CAkDefaultIOHookBlocking::GetDeviceDesc(
+    AkDeviceDesc &
+#ifndef AK_OPTIMIZED
+	out_deviceDesc      // Description of associated low-level I/O device.
+#endif
+    )
+{
+#ifndef AK_OPTIMIZED
+	if ( m_deviceID != AK_INVALID_DEVICE_ID )
+	{
+		out_deviceDesc.deviceID       = m_deviceID;
+		out_deviceDesc.bCanRead       = true;
+		out_deviceDesc.bCanWrite      = true;
+		AK_CHAR_TO_UTF16( out_deviceDesc.szDeviceName, LINUX_BLOCKING_DEVICE_NAME, AK_MONITOR_DEVICENAME_MAXLENGTH );
+		out_deviceDesc.uStringSize   = (AkUInt32)AKPLATFORM::AkUtf16StrLen( out_deviceDesc.szDeviceName ) + 1;
+
+		return AK_Success;
+	}
+
+	assert( !"Low-Level device was not initialized" );
+#endif
+	return AK_Fail;
+}
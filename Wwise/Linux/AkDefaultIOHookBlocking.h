@@ -0,0 +1,179 @@
+//////////////////////////////////////////////////////////////////////
+//
+// AkDefaultIOHookBlocking.h
+//
+// Default blocking low level IO hook (AK::StreamMgr::IAkIOHookBlocking) 
+// and file system (AK::StreamMgr::IAkFileLocationResolver) implementation 
+// on Linux. It can be used as a standalone implementation of the 
+// Low-Level I/O system.
+// 
+// AK::StreamMgr::IAkFileLocationResolver: 
+// Resolves file location using simple path concatenation logic 
+// (implemented in ../Common/CAkFileLocationBase). It can be used as a 
+// standalone Low-Level IO system, or as part of a multi device system. 
+// In the latter case, you should manage multiple devices by implementing 
+// AK::StreamMgr::IAkFileLocationResolver elsewhere (you may take a look 
+// at class CAkDefaultLowLevelIODispatcher).
+//
+// AK::StreamMgr::IAkIOHookBlocking: 
+// Uses positioned ::pread() and ::pwrite(): the file offset is never 
+// moved, so a file handle (e.g. a file package's) may be used from 
+// several threads without locking.
+// - Unbuffered mode (Init() argument in_bUnbufferedIO): files opened for 
+// reading use O_DIRECT, and bypass the page cache. GetBlockSize() then 
+// returns the logical block size reported for each file, and the device's 
+// I/O memory must be aligned accordingly (AkDeviceSettings::uIOMemoryAlignment).
+// - Buffered mode (default): files opened for reading are advised with 
+// POSIX_FADV_SEQUENTIAL, and each sequential read is followed by a 
+// POSIX_FADV_WILLNEED hint on the range that the stream is expected to 
+// read next. Its throughput is measured by the hook: consecutive reads 
+// are matched by file handle and position (see TrackRead()), and the 
+// rate is the size of a read over the time until the next one.
+// The AK::StreamMgr::IAkIOHookBlocking interface is meant to be used with
+// AK_SCHEDULER_BLOCKING streaming devices. 
+//
+// Init() creates a streaming device (by calling AK::StreamMgr::CreateDevice(), or
+// AK::StreamMgr::CreateDeviceEx() if optional device settings are passed).
+// AkDeviceSettings::uSchedulerTypeFlags is set inside to AK_SCHEDULER_BLOCKING.
+// If there was no AK::StreamMgr::IAkFileLocationResolver previously registered 
+// to the Stream Manager, this object registers itself as the File Location Resolver.
+// See ../AkDefaultIOHookBlocking.h for examples of streaming initialization.
+//
+// Copyright (c) 2006 Audiokinetic Inc. / All Rights Reserved
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef _AK_DEFAULT_IO_HOOK_BLOCKING_H_
+#define _AK_DEFAULT_IO_HOOK_BLOCKING_H_
+
+#include <AK/SoundEngine/Common/AkStreamMgrModule.h>
+#include "../Common/AkFileLocationBase.h"
+#include <pthread.h>
+
+// Number of sequential reads whose throughput is tracked at the same time, for read-ahead hints.
+#define LINUX_BLOCKING_MAX_TRACKED_READS	(32)
+
+//-----------------------------------------------------------------------------
+// Name: class CAkDefaultIOHookBlocking.
+// Desc: Implements IAkIOHookBlocking low-level I/O hook, and 
+//		 IAkFileLocationResolver. Can be used as a standalone Low-Level I/O
+//		 system, or as part of a system with multiple devices.
+//		 File location is resolved using simple path concatenation logic
+//		 (implemented in CAkFileLocationBase).
+//-----------------------------------------------------------------------------
+class CAkDefaultIOHookBlocking : public AK::StreamMgr::IAkFileLocationResolver
+								,public AK::StreamMgr::IAkIOHookBlocking
+								,public CAkFileLocationBase
+{
+public:
+
+	CAkDefaultIOHookBlocking();
+	virtual ~CAkDefaultIOHookBlocking();
+
+	// Initialization/termination. Init() registers this object as the one and 
+	// only File Location Resolver if none were registered before. Then 
+	// it creates a streaming device with scheduler type AK_SCHEDULER_BLOCKING.
+	AKRESULT Init(
+		const AkDeviceSettings &	in_deviceSettings,		// Device settings.
+		bool						in_bAsyncOpen=false,	// If true, files are opened asynchronously when possible.
+		bool						in_bUnbufferedIO=false,	// If true, files opened for reading use O_DIRECT.
+		const AkDeviceSettingsEx *	in_pDeviceSettingsEx=NULL	// Optional device settings (e.g. AkDeviceSettingsEx::uNumIOWorkers). Pass NULL to use defaults.
+		);
+	void Term();
+
+
+	//
+	// IAkFileLocationAware interface.
+	//-----------------------------------------------------------------------------
+
+	// Returns a file descriptor for a given file name (string).
+    virtual AKRESULT Open( 
+        const AkOSChar*			in_pszFileName,		// File name.
+		AkOpenMode				in_eOpenMode,		// Open mode.
+        AkFileSystemFlags *		in_pFlags,			// Special flags. Can pass NULL.
+		bool &					io_bSyncOpen,		// If true, the file must be opened synchronously. Otherwise it is left at the File Location Resolver's discretion. Return false if Open needs to be deferred.
+        AkFileDesc &			out_fileDesc        // Returned file descriptor.
+        );
+
+    // Returns a file descriptor for a given file ID.
+    virtual AKRESULT Open( 
+        AkFileID				in_fileID,          // File ID.
+        AkOpenMode				in_eOpenMode,       // Open mode.
+        AkFileSystemFlags *		in_pFlags,			// Special flags. Can pass NULL.
+		bool &					io_bSyncOpen,		// If true, the file must be opened synchronously. Otherwise it is left at the File Location Resolver's discretion. Return false if Open needs to be deferred.
+        AkFileDesc &			out_fileDesc        // Returned file descriptor.
+        );
+
+
+	//
+	// IAkIOHookBlocking interface.
+	//-----------------------------------------------------------------------------
+
+	// Reads data from a file (synchronous). 
+	virtual AKRESULT Read(
+        AkFileDesc &			in_fileDesc,        // File descriptor.
+		const AkIoHeuristics &	in_heuristics,		// Heuristics for this data transfer.
+        void *					out_pBuffer,        // Buffer to be filled with data.
+        AkIOTransferInfo &		io_transferInfo		// Synchronous data transfer info. 
+        );
+
+    // Writes data to a file (synchronous). 
+	virtual AKRESULT Write(
+		AkFileDesc &			in_fileDesc,        // File descriptor.
+		const AkIoHeuristics &	in_heuristics,		// Heuristics for this data transfer.
+        void *					in_pData,           // Data to be written.
+        AkIOTransferInfo &		io_transferInfo		// Synchronous data transfer info. 
+        );
+
+	// Cleans up a file.
+    virtual AKRESULT Close(
+        AkFileDesc &			in_fileDesc			// File descriptor.
+        );
+
+	// Returns the block size for the file or its storage device. 
+	virtual AkUInt32 GetBlockSize(
+        AkFileDesc &  			in_fileDesc			// File descriptor.
+        );
+
+	// Returns a description for the streaming device above this low-level hook.
+    virtual AKRESULT GetDeviceDesc(
+        AkDeviceDesc &  		out_deviceDesc      // Device description.
+        );
+
+protected:
+
+	// Helpers for file opening (common to both Open() overloads).
+	AKRESULT OpenFile(
+		const AkOSChar *		in_pszFullFilePath,	// Full file path.
+		AkOpenMode				in_eOpenMode,		// Open mode.
+		AkFileDesc &			out_fileDesc		// Returned file descriptor.
+		);
+
+	// Records a read, and returns the throughput of the sequential reads that it continues (bytes/ms),
+	// measured by this hook. Returns 0 until it is known.
+	AkReal32 TrackRead(
+		AkFileHandle			in_hFile,			// File handle.
+		AkUInt64				in_uFilePosition,	// Position of the read.
+		AkUInt32				in_uSize			// Size of the read.
+		);
+
+	// Sequential reads that are tracked, to measure their throughput.
+	struct AkTrackedRead
+	{
+		AkFileHandle	hFile;			// File handle. AK_INVALID_FILE_HANDLE if the slot is free.
+		AkUInt64		uNextPosition;	// Position following the last read.
+		AkUInt32		uLastSize;		// Size of the last read.
+		AkInt64			iLastTime;		// Time of the last read (ms).
+		AkReal32		fThroughput;	// Measured throughput (bytes/ms). 0 until known.
+	};
+
+protected:
+	AkDeviceID	m_deviceID;
+	bool		m_bAsyncOpen;		// If true, opens files asynchronously when it can.
+	bool		m_bUnbufferedIO;	// If true, files opened for reading use O_DIRECT.
+
+	AkTrackedRead	m_arTrackedReads[LINUX_BLOCKING_MAX_TRACKED_READS];
+	pthread_mutex_t	m_lockTrackedReads;	// Read() and Close() may be called concurrently by the device's I/O workers.
+};
+
+#endif //_AK_DEFAULT_IO_HOOK_BLOCKING_H_
@@ -0,0 +1,241 @@
+//////////////////////////////////////////////////////////////////////
+//
+// AkFileHelpers.h
+//
+// Platform-specific helpers for files (Linux).
+// AkFileHandle holds a POSIX file descriptor.
+//
+// Copyright (c) 2006 Audiokinetic Inc. / All Rights Reserved
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef _AK_FILE_HELPERS_H_
+#define _AK_FILE_HELPERS_H_
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <AK/SoundEngine/Common/IAkStreamMgr.h>
+
+// AkFileHandle <-> POSIX file descriptor.
+#define AK_FILE_HANDLE_TO_FD( _hFile_ )		( (int)(intptr_t)( _hFile_ ) )
+#define AK_FD_TO_FILE_HANDLE( _fd_ )		( (AkFileHandle)(intptr_t)( _fd_ ) )
+#define AK_INVALID_FILE_HANDLE				AK_FD_TO_FILE_HANDLE( -1 )
+
+// Block size assumed for O_DIRECT transfers when it cannot be queried.
+#define AK_LINUX_DEFAULT_BLOCK_SIZE			(4096)
+
+class CAkFileHelpers
+{
+public:
+
+	// Wrapper for POSIX open().
+	static AKRESULT OpenFile(
+        const AkOSChar* in_pszFilename,     // File name.
+        AkOpenMode      in_eOpenMode,       // Open mode.
+        bool            in_bUnbufferedIO,   // Use O_DIRECT flag.
+        AkFileHandle &  out_hFile           // Returned file identifier/handle.
+        )
+	{
+		// Check parameters.
+		if ( !in_pszFilename )
+		{
+			assert( !"NULL file name" );
+			return AK_InvalidParameter;
+		}
+
+		// Open mode
+		int iFlags;
+		switch ( in_eOpenMode )
+		{
+			case AK_OpenModeRead:
+					iFlags = O_RDONLY;
+				break;
+			case AK_OpenModeWrite:
+					iFlags = O_WRONLY | O_CREAT;
+				break;
+			case AK_OpenModeWriteOvrwr:
+					iFlags = O_WRONLY | O_CREAT | O_TRUNC;
+				break;
+			case AK_OpenModeReadWrite:
+					iFlags = O_RDWR | O_CREAT;
+				break;
+			default:
+					assert( !"Invalid open mode" );
+					out_hFile = AK_INVALID_FILE_HANDLE;
+					return AK_InvalidParameter;
+				break;
+		}
+
+		// Flags
+		iFlags |= O_CLOEXEC;
+		if ( in_bUnbufferedIO )
+			iFlags |= O_DIRECT;
+
+		// Open the file.
+		int fd;
+		do
+		{
+			fd = ::open( in_pszFilename, iFlags, 0644 );
+		}
+		while ( fd < 0 && errno == EINTR );
+
+		out_hFile = AK_FD_TO_FILE_HANDLE( fd );
+		if ( fd < 0 )
+		{
+			if ( ENOENT == errno || ENOTDIR == errno )
+				return AK_FileNotFound;
+
+			return AK_Fail;
+		}
+
+		return AK_Success;
+	}
+
+	// Wrapper for system file handle closing.
+	static AKRESULT CloseFile( AkFileHandle in_hFile )
+	{
+		if ( ::close( AK_FILE_HANDLE_TO_FD( in_hFile ) ) == 0 )
+			return AK_Success;
+
+		assert( !"Failed to close file handle" );
+		return AK_Fail;
+	}
+
+	// Returns the size of an opened file, in bytes. Returns 0 on error.
+	static AkInt64 GetFileSize( AkFileHandle in_hFile )
+	{
+		struct stat fileStat;
+		if ( ::fstat( AK_FILE_HANDLE_TO_FD( in_hFile ), &fileStat ) == 0 )
+			return (AkInt64)fileStat.st_size;
+		return 0;
+	}
+
+	// Returns the logical block size to which transfers on a file opened with O_DIRECT must be
+	// aligned (file offset, size and buffer address). Uses statx(STATX_DIOALIGN) when the kernel
+	// reports it, otherwise the file system's preferred block size, which is a safe multiple.
+	static AkUInt32 GetBlockSize( AkFileHandle in_hFile )
+	{
+		int fd = AK_FILE_HANDLE_TO_FD( in_hFile );
+#ifdef STATX_DIOALIGN
+		struct statx fileStatx;
+		if ( ::statx( fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &fileStatx ) == 0
+			&& ( fileStatx.stx_mask & STATX_DIOALIGN )
+			&& fileStatx.stx_dio_offset_align > 0 )
+		{
+			// Buffers are allocated by the Stream Manager with the same granularity as offsets.
+			AkUInt32 uBlockSize = fileStatx.stx_dio_offset_align;
+			if ( fileStatx.stx_dio_mem_align > uBlockSize )
+				uBlockSize = fileStatx.stx_dio_mem_align;
+			return uBlockSize;
+		}
+#endif
+		struct stat fileStat;
+		if ( ::fstat( fd, &fileStat ) == 0 
+			&& fileStat.st_blksize > 0 )
+			return (AkUInt32)fileStat.st_blksize;
+		return AK_LINUX_DEFAULT_BLOCK_SIZE;
+	}
+
+	// Wrapper for posix_fadvise(). Hints are best effort: errors are ignored.
+	static void Advise(
+		AkFileHandle	in_hFile,			// File handle.
+		AkInt64			in_iOffset,			// Start of the range.
+		AkInt64			in_iLength,			// Length of the range. 0 means "up to the end of the file".
+		int				in_iAdvice			// POSIX_FADV_xxx.
+		)
+	{
+		::posix_fadvise( AK_FILE_HANDLE_TO_FD( in_hFile ), (off_t)in_iOffset, (off_t)in_iLength, in_iAdvice );
+	}
+
+	// Positioned blocking read: a single pread() call per chunk, which does not move the file 
+	// offset. It can thus be used concurrently from several threads on the same file handle.
+	// Loops on interruptions and short reads. out_uSizeRead is smaller than in_uSizeToRead only
+	// when the end of file was reached.
+	static AKRESULT ReadAt(
+		AkFileHandle	in_hFile,			// File handle.
+		void *			out_pBuffer,		// Buffer to be filled with data.
+		AkUInt64		in_uPosition,		// Position from which to start reading.
+		AkUInt32		in_uSizeToRead,		// Size to read.
+		AkUInt32 &		out_uSizeRead		// Returned size read.
+		)
+	{
+		int fd = AK_FILE_HANDLE_TO_FD( in_hFile );
+		out_uSizeRead = 0;
+		while ( out_uSizeRead < in_uSizeToRead )
+		{
+			ssize_t iRead = ::pread( fd, (AkUInt8*)out_pBuffer + out_uSizeRead, in_uSizeToRead - out_uSizeRead, (off_t)( in_uPosition + out_uSizeRead ) );
+			if ( iRead > 0 )
+				out_uSizeRead += (AkUInt32)iRead;
+			else if ( iRead == 0 )
+				break;	// End of file.
+			else if ( errno != EINTR )
+				return AK_Fail;
+		}
+		return AK_Success;
+	}
+
+	// Positioned blocking write, counterpart of ReadAt().
+	static AKRESULT WriteAt(
+		AkFileHandle	in_hFile,			// File handle.
+		const void *	in_pData,			// Data to be written.
+		AkUInt64		in_uPosition,		// Position from which to start writing.
+		AkUInt32		in_uSizeToWrite,	// Size to write.
+		AkUInt32 &		out_uSizeWritten	// Returned size written.
+		)
+	{
+		int fd = AK_FILE_HANDLE_TO_FD( in_hFile );
+		out_uSizeWritten = 0;
+		while ( out_uSizeWritten < in_uSizeToWrite )
+		{
+			ssize_t iWritten = ::pwrite( fd, (const AkUInt8*)in_pData + out_uSizeWritten, in_uSizeToWrite - out_uSizeWritten, (off_t)( in_uPosition + out_uSizeWritten ) );
+			if ( iWritten > 0 )
+				out_uSizeWritten += (AkUInt32)iWritten;
+			else if ( iWritten == 0 || errno != EINTR )
+				return AK_Fail;
+		}
+		return AK_Success;
+	}
+
+	//
+	// Simple platform-independent API to open and read files using AkFileHandles, 
+	// with blocking calls and minimal constraints.
+	// ---------------------------------------------------------------------------
+
+	// Open file to use with ReadBlocking().
+	static AKRESULT OpenBlocking(
+        const AkOSChar* in_pszFilename,     // File name.
+        AkFileHandle &  out_hFile           // Returned file handle.
+		)
+	{
+		return OpenFile( 
+			in_pszFilename,
+			AK_OpenModeRead,
+			false,
+			out_hFile );
+	}
+
+	// Required block size for reads (used by ReadBlocking() below).
+	static const AkUInt32 s_uRequiredBlockSize = 1;
+
+	// Simple blocking read method.
+	static AKRESULT ReadBlocking(
+        AkFileHandle &	in_hFile,			// Returned file identifier/handle.
+		void *			in_pBuffer,			// Buffer. Must be aligned on CAkFileHelpers::s_uRequiredBlockSize boundary.
+		AkUInt32		in_uPosition,		// Position from which to start reading.
+		AkUInt32		in_uSizeToRead,		// Size to read. Must be a multiple of CAkFileHelpers::s_uRequiredBlockSize.
+		AkUInt32 &		out_uSizeRead		// Returned size read.        
+		)
+	{
+		assert( in_uSizeToRead % s_uRequiredBlockSize == 0 
+			&& in_uPosition % s_uRequiredBlockSize == 0 );
+
+		return ReadAt( in_hFile, in_pBuffer, in_uPosition, in_uSizeToRead, out_uSizeRead );
+	}
+};
+
+#endif //_AK_FILE_HELPERS_H_
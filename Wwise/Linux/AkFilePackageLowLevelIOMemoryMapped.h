@@ -0,0 +1,33 @@
+//////////////////////////////////////////////////////////////////////
+//
+// AkFilePackageLowLevelIOMemoryMapped.h
+//
+// Extends the CAkMemoryMappedIOHookBlocking low level I/O hook with File 
+// Package handling functionality. File packages are mapped in memory 
+// when they are loaded, and the files they contain are read from the 
+// mapping.
+//
+// See AkMemoryMappedIOHookBlocking.h for details on using the memory 
+// mapped low level I/O hook. 
+// 
+// See AkFilePackageLowLevelIO.h for details on using file packages.
+// 
+// Copyright (c) 2006 Audiokinetic Inc. / All Rights Reserved
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef _AK_FILE_PACKAGE_LOW_LEVEL_IO_MEMORY_MAPPED_H_
+#define _AK_FILE_PACKAGE_LOW_LEVEL_IO_MEMORY_MAPPED_H_
+
+#include "../Common/AkFilePackageLowLevelIO.h"
+#include "AkMemoryMappedIOHookBlocking.h"
+
+class CAkFilePackageLowLevelIOMemoryMapped 
+	: public CAkFilePackageLowLevelIO<CAkMemoryMappedIOHookBlocking>
+{
+public:
+	CAkFilePackageLowLevelIOMemoryMapped() {}
+	virtual ~CAkFilePackageLowLevelIOMemoryMapped() {}
+};
+
+#endif //_AK_FILE_PACKAGE_LOW_LEVEL_IO_MEMORY_MAPPED_H_
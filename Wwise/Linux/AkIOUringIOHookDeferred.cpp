@@ -0,0 +1,746 @@
+//////////////////////////////////////////////////////////////////////
+//
+// AkIOUringIOHookDeferred.cpp
+//
+// Deferred low level IO hook (AK::StreamMgr::IAkIOHookDeferred)
+// and file system (AK::StreamMgr::IAkFileLocationResolver) implementation
+// on Linux, based on io_uring.
+//
+// See AkIOUringIOHookDeferred.h for details.
+//
+// Copyright (c) 2006 Audiokinetic Inc. / All Rights Reserved
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "AkIOUringIOHookDeferred.h"
+#include "AkFileHelpers.h"
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+
+// Device info.
+#define LINUX_URING_DEVICE_NAME			("Linux io_uring")	// Default deferred device name.
+
+// With files opened with O_DIRECT, accesses should be made in multiple of the logical block size
+// of the storage device. We don't know what it is, so we choose a safe value of 4 KB.
+#define LINUX_URING_BLOCK_SIZE			(4096)
+
+// AkAsyncIOTransferInfo addresses are used as io_uring user data. These values are reserved.
+#define LINUX_URING_USERDATA_CANCEL		(0)	// Completion of a cancellation request: ignored.
+#define LINUX_URING_USERDATA_EXIT		(1)	// Completion of the request that stops the completion thread.
+
+namespace
+{
+	// io_uring system calls.
+	inline int IOUringSetup( unsigned in_uEntries, io_uring_params * io_pParams )
+	{
+		return (int)syscall( __NR_io_uring_setup, in_uEntries, io_pParams );
+	}
+	inline int IOUringEnter( int in_ringFd, unsigned in_uToSubmit, unsigned in_uMinComplete, unsigned in_uFlags )
+	{
+		return (int)syscall( __NR_io_uring_enter, in_ringFd, in_uToSubmit, in_uMinComplete, in_uFlags, NULL, 0 );
+	}
+	inline int IOUringRegister( int in_ringFd, unsigned in_uOpCode, const void * in_pArg, unsigned in_uNumArgs )
+	{
+		return (int)syscall( __NR_io_uring_register, in_ringFd, in_uOpCode, in_pArg, in_uNumArgs );
+	}
+}
+
+CAkIOUringIOHookDeferred::CAkIOUringIOHookDeferred()
+: m_deviceID( AK_INVALID_DEVICE_ID )
+, m_bAsyncOpen( false )
+, m_ringFd( -1 )
+, m_pSqRing( MAP_FAILED )
+, m_uSqRingSize( 0 )
+, m_pCqRing( MAP_FAILED )
+, m_uCqRingSize( 0 )
+, m_pSqes( (io_uring_sqe*)MAP_FAILED )
+, m_uSqesSize( 0 )
+, m_bCompletionThreadStarted( false )
+, m_pRegisteredMem( NULL )
+, m_uRegisteredMemSize( 0 )
+, m_bFilesRegistered( false )
+{
+	pthread_mutex_init( &m_lockSubmission, NULL );
+	for ( AkUInt32 uSlot = 0; uSlot < LINUX_URING_MAX_REGISTERED_FILES; ++uSlot )
+		m_arRegisteredFiles[uSlot] = -1;
+}
+
+CAkIOUringIOHookDeferred::~CAkIOUringIOHookDeferred()
+{
+	pthread_mutex_destroy( &m_lockSubmission );
+}
+
+// Initialization/termination. Init() registers this object as the one and
+// only File Location Resolver if none were registered before. Then
+// it creates a streaming device with scheduler type AK_SCHEDULER_DEFERRED_LINED_UP.
+AKRESULT CAkIOUringIOHookDeferred::Init(
+	const AkDeviceSettings &	in_deviceSettings,		// Device settings.
+	bool						in_bAsyncOpen/*=false*/,	// If true, files are opened asynchronously when possible.
+	const AkDeviceSettingsEx *	in_pDeviceSettingsEx/*=NULL*/	// Optional device settings. Pass NULL to use defaults.
+	)
+{
+	if ( ( in_deviceSettings.uSchedulerTypeFlags & ~AK_SCHEDULER_ELEVATOR ) != AK_SCHEDULER_DEFERRED_LINED_UP )
+	{
+		assert( !"CAkIOUringIOHookDeferred I/O hook only works with AK_SCHEDULER_DEFERRED_LINED_UP devices" );
+		return AK_Fail;
+	}
+
+	m_bAsyncOpen = in_bAsyncOpen;
+
+	// Set up the ring before creating the device, since the device may issue transfers as soon as it exists.
+	// There are never more than uMaxConcurrentIO transfers in flight.
+	if ( SetupRing( in_deviceSettings.uMaxConcurrentIO ) != AK_Success )
+	{
+		TermRing();
+		return AK_Fail;
+	}
+
+	// Register the device's I/O memory if it is provided by the application. Automatic streams
+	// transfer data into it with IORING_OP_READ_FIXED. This is only an optimization, so failure
+	// (e.g. RLIMIT_MEMLOCK) is not an error.
+	if ( in_deviceSettings.pIOMemory && in_deviceSettings.uIOMemorySize )
+	{
+		struct iovec ioMemory;
+		ioMemory.iov_base = in_deviceSettings.pIOMemory;
+		ioMemory.iov_len = in_deviceSettings.uIOMemorySize;
+		if ( IOUringRegister( m_ringFd, IORING_REGISTER_BUFFERS, &ioMemory, 1 ) == 0 )
+		{
+			m_pRegisteredMem = (AkUInt8*)in_deviceSettings.pIOMemory;
+			m_uRegisteredMemSize = in_deviceSettings.uIOMemorySize;
+		}
+	}
+
+	// Register an empty (sparse) file table. Slots are filled as files are opened.
+	m_bFilesRegistered = ( IOUringRegister( m_ringFd, IORING_REGISTER_FILES, m_arRegisteredFiles, LINUX_URING_MAX_REGISTERED_FILES ) == 0 );
+
+	// Start the completion thread.
+	if ( pthread_create( &m_completionThread, NULL, CompletionThreadFunc, this ) != 0 )
+	{
+		assert( !"Failed creating completion thread for asynchronous device" );
+		TermRing();
+		return AK_Fail;
+	}
+	m_bCompletionThreadStarted = true;
+
+	// If the Stream Manager's File Location Resolver was not set yet, set this object as the
+	// File Location Resolver (this I/O hook is also able to resolve file location).
+	if ( !AK::StreamMgr::GetFileLocationResolver() )
+		AK::StreamMgr::SetFileLocationResolver( this );
+
+	// Create a device in the Stream Manager, specifying this as the hook, and
+	// registering its batch interface.
+	AkDeviceSettingsEx deviceSettingsEx;
+	if ( in_pDeviceSettingsEx )
+		deviceSettingsEx = *in_pDeviceSettingsEx;
+	else
+		AK::StreamMgr::GetDefaultDeviceSettingsEx( deviceSettingsEx );
+	deviceSettingsEx.pBatchHook = this;
+	m_deviceID = AK::StreamMgr::CreateDeviceEx( in_deviceSettings, deviceSettingsEx, this );
+	if ( m_deviceID != AK_INVALID_DEVICE_ID )
+		return AK_Success;
+
+	return AK_Fail;
+}
+
+void CAkIOUringIOHookDeferred::Term()
+{
+	if ( AK::StreamMgr::GetFileLocationResolver() == this )
+		AK::StreamMgr::SetFileLocationResolver( NULL );
+
+	// Destroying the device waits for pending transfers: the completion thread must still be running.
+	AK::StreamMgr::DestroyDevice( m_deviceID );
+
+	if ( m_bCompletionThreadStarted )
+	{
+		// Post a request whose completion stops the completion thread.
+		pthread_mutex_lock( &m_lockSubmission );
+		unsigned uTail = *m_pSqTail;
+		io_uring_sqe * pSqe = &m_pSqes[uTail & m_uSqMask];
+		memset( pSqe, 0, sizeof( io_uring_sqe ) );
+		pSqe->opcode = IORING_OP_NOP;
+		pSqe->fd = -1;
+		pSqe->user_data = LINUX_URING_USERDATA_EXIT;
+		__atomic_store_n( m_pSqTail, uTail + 1, __ATOMIC_RELEASE );
+		AkUInt32 uNumFailed = SubmitQueued( 1 );
+		pthread_mutex_unlock( &m_lockSubmission );
+
+		if ( uNumFailed == 0 )
+			pthread_join( m_completionThread, NULL );
+		else
+		{
+			assert( !"Could not stop completion thread" );
+			pthread_cancel( m_completionThread );
+			pthread_join( m_completionThread, NULL );
+		}
+		m_bCompletionThreadStarted = false;
+	}
+
+	TermRing();
+}
+
+// Ring setup.
+AKRESULT CAkIOUringIOHookDeferred::SetupRing(
+	AkUInt32				in_uNumEntries		// Number of submission queue entries.
+	)
+{
+	io_uring_params params;
+	memset( &params, 0, sizeof( io_uring_params ) );
+	m_ringFd = IOUringSetup( in_uNumEntries, &params );
+	if ( m_ringFd < 0 )
+	{
+		assert( !"io_uring is not supported" );
+		return AK_Fail;
+	}
+
+	m_uSqRingSize = params.sq_off.array + params.sq_entries * sizeof( unsigned );
+	m_uCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof( io_uring_cqe );
+	bool bSingleMmap = ( params.features & IORING_FEAT_SINGLE_MMAP ) != 0;
+	if ( bSingleMmap )
+	{
+		if ( m_uCqRingSize > m_uSqRingSize )
+			m_uSqRingSize = m_uCqRingSize;
+		m_uCqRingSize = m_uSqRingSize;
+	}
+
+	m_pSqRing = mmap( NULL, m_uSqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING );
+	if ( m_pSqRing == MAP_FAILED )
+		return AK_Fail;
+
+	if ( bSingleMmap )
+		m_pCqRing = m_pSqRing;
+	else
+	{
+		m_pCqRing = mmap( NULL, m_uCqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING );
+		if ( m_pCqRing == MAP_FAILED )
+			return AK_Fail;
+	}
+
+	m_uSqesSize = params.sq_entries * sizeof( io_uring_sqe );
+	m_pSqes = (io_uring_sqe*)mmap( NULL, m_uSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES );
+	if ( m_pSqes == MAP_FAILED )
+		return AK_Fail;
+
+	AkUInt8 * pSqRing = (AkUInt8*)m_pSqRing;
+	m_pSqHead		= (unsigned*)( pSqRing + params.sq_off.head );
+	m_pSqTail		= (unsigned*)( pSqRing + params.sq_off.tail );
+	m_uSqMask		= *(unsigned*)( pSqRing + params.sq_off.ring_mask );
+	m_uSqEntries	= *(unsigned*)( pSqRing + params.sq_off.ring_entries );
+
+	// Submission queue entries are always used in order: map them once and for all.
+	unsigned * pSqArray = (unsigned*)( pSqRing + params.sq_off.array );
+	for ( unsigned uEntry = 0; uEntry < m_uSqEntries; ++uEntry )
+		pSqArray[uEntry] = uEntry;
+
+	AkUInt8 * pCqRing = (AkUInt8*)m_pCqRing;
+	m_pCqHead		= (unsigned*)( pCqRing + params.cq_off.head );
+	m_pCqTail		= (unsigned*)( pCqRing + params.cq_off.tail );
+	m_uCqMask		= *(unsigned*)( pCqRing + params.cq_off.ring_mask );
+	m_pCqes			= (io_uring_cqe*)( pCqRing + params.cq_off.cqes );
+
+	return AK_Success;
+}
+
+// Ring teardown. Also releases registered buffers and files.
+void CAkIOUringIOHookDeferred::TermRing()
+{
+	if ( m_pSqes != MAP_FAILED )
+	{
+		munmap( m_pSqes, m_uSqesSize );
+		m_pSqes = (io_uring_sqe*)MAP_FAILED;
+	}
+	if ( m_pCqRing != MAP_FAILED && m_pCqRing != m_pSqRing )
+		munmap( m_pCqRing, m_uCqRingSize );
+	m_pCqRing = MAP_FAILED;
+	if ( m_pSqRing != MAP_FAILED )
+	{
+		munmap( m_pSqRing, m_uSqRingSize );
+		m_pSqRing = MAP_FAILED;
+	}
+	if ( m_ringFd >= 0 )
+	{
+		::close( m_ringFd );
+		m_ringFd = -1;
+	}
+
+	m_pRegisteredMem = NULL;
+	m_uRegisteredMemSize = 0;
+	m_bFilesRegistered = false;
+	for ( AkUInt32 uSlot = 0; uSlot < LINUX_URING_MAX_REGISTERED_FILES; ++uSlot )
+		m_arRegisteredFiles[uSlot] = -1;
+}
+
+//
+// IAkFileLocationAware implementation.
+//-----------------------------------------------------------------------------
+
+// Returns a file descriptor for a given file name (string).
+AKRESULT CAkIOUringIOHookDeferred::Open(
+    const AkOSChar* in_pszFileName,     // File name.
+    AkOpenMode      in_eOpenMode,       // Open mode.
+    AkFileSystemFlags * in_pFlags,      // Special flags. Can pass NULL.
+	bool &			io_bSyncOpen,		// If true, the file must be opened synchronously. Otherwise it is left at the File Location Resolver's discretion. Return false if Open needs to be deferred.
+    AkFileDesc &    out_fileDesc        // Returned file descriptor.
+    )
+{
+	// We normally consider that calls to ::open() on a hard drive are fast enough to execute in the
+	// client thread. If you want files to be opened asynchronously when it is possible, this device should
+	// be initialized with the flag in_bAsyncOpen set to true.
+	if ( io_bSyncOpen || !m_bAsyncOpen )
+	{
+		io_bSyncOpen = true;
+
+	    // Get the full file path, using path concatenation logic.
+	    AkOSChar szFullFilePath[AK_MAX_PATH];
+	    if ( GetFullFilePath( in_pszFileName, in_pFlags, in_eOpenMode, szFullFilePath ) == AK_Success )
+			return OpenFile( szFullFilePath, in_eOpenMode, out_fileDesc );
+
+		return AK_Fail;
+	}
+	else
+	{
+		// The client allows us to perform asynchronous opening.
+		// We only need to specify the deviceID, and leave the boolean to false.
+		out_fileDesc.iFileSize			= 0;
+		out_fileDesc.uSector			= 0;
+		out_fileDesc.deviceID			= m_deviceID;
+		out_fileDesc.pCustomParam		= NULL;
+		out_fileDesc.uCustomParamSize	= 0;
+		return AK_Success;
+	}
+}
+
+// Returns a file descriptor for a given file ID.
+AKRESULT CAkIOUringIOHookDeferred::Open(
+    AkFileID        in_fileID,          // File ID.
+    AkOpenMode      in_eOpenMode,       // Open mode.
+    AkFileSystemFlags * in_pFlags,      // Special flags. Can pass NULL.
+	bool &			io_bSyncOpen,		// If true, the file must be opened synchronously. Otherwise it is left at the File Location Resolver's discretion. Return false if Open needs to be deferred.
+    AkFileDesc &    out_fileDesc        // Returned file descriptor.
+    )
+{
+	// We normally consider that calls to ::open() on a hard drive are fast enough to execute in the
+	// client thread. If you want files to be opened asynchronously when it is possible, this device should
+	// be initialized with the flag in_bAsyncOpen set to true.
+	if ( io_bSyncOpen || !m_bAsyncOpen )
+	{
+		io_bSyncOpen = true;
+
+	    // Get the full file path, using path concatenation logic.
+	    AkOSChar szFullFilePath[AK_MAX_PATH];
+	    if ( GetFullFilePath( in_fileID, in_pFlags, in_eOpenMode, szFullFilePath ) == AK_Success )
+			return OpenFile( szFullFilePath, in_eOpenMode, out_fileDesc );
+
+		return AK_Fail;
+	}
+	else
+	{
+		// The client allows us to perform asynchronous opening.
+		// We only need to specify the deviceID, and leave the boolean to false.
+		out_fileDesc.iFileSize			= 0;
+		out_fileDesc.uSector			= 0;
+		out_fileDesc.deviceID			= m_deviceID;
+		out_fileDesc.pCustomParam		= NULL;
+		out_fileDesc.uCustomParamSize	= 0;
+		return AK_Success;
+	}
+}
+
+// Helpers for file opening (common to both Open() overloads).
+AKRESULT CAkIOUringIOHookDeferred::OpenFile(
+	const AkOSChar *		in_pszFullFilePath,	// Full file path.
+	AkOpenMode				in_eOpenMode,		// Open mode.
+	AkFileDesc &			out_fileDesc		// Returned file descriptor.
+	)
+{
+	// Open the file with O_DIRECT flag.
+	AKRESULT eResult = CAkFileHelpers::OpenFile(
+		in_pszFullFilePath,
+		in_eOpenMode,
+		true,
+		out_fileDesc.hFile );
+	if ( eResult == AK_Success )
+	{
+		out_fileDesc.iFileSize			= CAkFileHelpers::GetFileSize( out_fileDesc.hFile );
+		out_fileDesc.uSector			= 0;
+		out_fileDesc.deviceID			= m_deviceID;
+		out_fileDesc.pCustomParam		= NULL;
+		out_fileDesc.uCustomParamSize	= 0;
+
+		pthread_mutex_lock( &m_lockSubmission );
+		RegisterFile( AK_FILE_HANDLE_TO_FD( out_fileDesc.hFile ) );
+		pthread_mutex_unlock( &m_lockSubmission );
+	}
+	return eResult;
+}
+
+//
+// IAkIOHookDeferred implementation.
+//-----------------------------------------------------------------------------
+
+// Reads data from a file (asynchronous overload).
+AKRESULT CAkIOUringIOHookDeferred::Read(
+	AkFileDesc &			in_fileDesc,        // File descriptor.
+	const AkIoHeuristics & /*in_heuristics*/,	// Heuristics for this data transfer (not used in this implementation).
+	AkAsyncIOTransferInfo & io_transferInfo		// Asynchronous data transfer info.
+	)
+{
+	assert( in_fileDesc.hFile != AK_INVALID_FILE_HANDLE
+			&& io_transferInfo.uRequestedSize > 0
+			&& io_transferInfo.uBufferSize >= io_transferInfo.uRequestedSize );
+
+	// If this assert comes up, it might be beacause this hook's GetBlockSize() return value is incompatible
+	// with the system's handling of file reading for this specific file handle.
+	// If you are using the File Package extension, did you create your package with a compatible
+	// block size? It should be a multiple of LINUX_URING_BLOCK_SIZE. (check -blocksize argument in the File Packager command line)
+	assert( ( io_transferInfo.uFilePosition % LINUX_URING_BLOCK_SIZE ) == 0
+			|| !"Requested file position for I/O transfer is inconsistent with block size" );
+
+	pthread_mutex_lock( &m_lockSubmission );
+	QueueTransfer( IORING_OP_READ, in_fileDesc, io_transferInfo );
+	AkUInt32 uNumFailed = SubmitQueued( 1 );
+	pthread_mutex_unlock( &m_lockSubmission );
+
+	return ( uNumFailed == 0 ) ? AK_Success : AK_Fail;
+}
+
+// Writes data to a file (asynchronous overload).
+AKRESULT CAkIOUringIOHookDeferred::Write(
+	AkFileDesc &			in_fileDesc,        // File descriptor.
+	const AkIoHeuristics & /*in_heuristics*/,	// Heuristics for this data transfer (not used in this implementation).
+	AkAsyncIOTransferInfo & io_transferInfo		// Platform-specific asynchronous IO operation info.
+	)
+{
+	assert( in_fileDesc.hFile != AK_INVALID_FILE_HANDLE
+			&& io_transferInfo.uRequestedSize > 0 );
+
+	// If this assert comes up, it might be beacause this hook's GetBlockSize() return value is incompatible
+	// with the system's handling of file reading for this specific file handle.
+	// Are you using the File Package Low-Level I/O with incompatible block size? (check -blocksize argument in the File Packager command line)
+	assert( io_transferInfo.uFilePosition % LINUX_URING_BLOCK_SIZE == 0
+			|| !"Requested file position for I/O transfer is inconsistent with block size" );
+
+	pthread_mutex_lock( &m_lockSubmission );
+	QueueTransfer( IORING_OP_WRITE, in_fileDesc, io_transferInfo );
+	AkUInt32 uNumFailed = SubmitQueued( 1 );
+	pthread_mutex_unlock( &m_lockSubmission );
+
+	return ( uNumFailed == 0 ) ? AK_Success : AK_Fail;
+}
+
+// Reads data from files (asynchronous), for a batch of transfers.
+void CAkIOUringIOHookDeferred::BatchRead(
+	AkUInt32				in_uNumTransfers,	// Number of transfers in io_arTransfers.
+	AkAsyncIOBatchTransfer * io_arTransfers		// Transfers to submit.
+	)
+{
+	SubmitBatch( IORING_OP_READ, in_uNumTransfers, io_arTransfers );
+}
+
+// Writes data to files (asynchronous), for a batch of transfers.
+void CAkIOUringIOHookDeferred::BatchWrite(
+	AkUInt32				in_uNumTransfers,	// Number of transfers in io_arTransfers.
+	AkAsyncIOBatchTransfer * io_arTransfers		// Transfers to submit.
+	)
+{
+	SubmitBatch( IORING_OP_WRITE, in_uNumTransfers, io_arTransfers );
+}
+
+// Common to BatchRead() and BatchWrite(): all transfers are queued, then submitted with one system call.
+void CAkIOUringIOHookDeferred::SubmitBatch(
+	AkUInt8					in_uOpCode,			// IORING_OP_READ or IORING_OP_WRITE.
+	AkUInt32				in_uNumTransfers,	// Number of transfers in io_arTransfers.
+	AkAsyncIOBatchTransfer * io_arTransfers		// Transfers to submit.
+	)
+{
+	pthread_mutex_lock( &m_lockSubmission );
+
+	for ( AkUInt32 uTransfer = 0; uTransfer < in_uNumTransfers; ++uTransfer )
+	{
+		assert( io_arTransfers[uTransfer].pTransferInfo->uFilePosition % LINUX_URING_BLOCK_SIZE == 0
+				|| !"Requested file position for I/O transfer is inconsistent with block size" );
+		QueueTransfer( in_uOpCode, *io_arTransfers[uTransfer].pFileDesc, *io_arTransfers[uTransfer].pTransferInfo );
+	}
+
+	// Transfers that could not be submitted are the last ones.
+	AkUInt32 uNumSubmitted = in_uNumTransfers - SubmitQueued( in_uNumTransfers );
+
+	pthread_mutex_unlock( &m_lockSubmission );
+
+	for ( AkUInt32 uTransfer = 0; uTransfer < in_uNumTransfers; ++uTransfer )
+		io_arTransfers[uTransfer].eResult = ( uTransfer < uNumSubmitted ) ? AK_Success : AK_Fail;
+}
+
+// Queue a transfer in the submission ring, without submitting it.
+// Sync: Submission lock must be held.
+void CAkIOUringIOHookDeferred::QueueTransfer(
+	AkUInt8					in_uOpCode,			// IORING_OP_READ or IORING_OP_WRITE.
+	AkFileDesc &			in_fileDesc,		// File descriptor.
+	AkAsyncIOTransferInfo & io_transferInfo		// Transfer info.
+	)
+{
+	unsigned uTail = *m_pSqTail;
+	assert( uTail - __atomic_load_n( m_pSqHead, __ATOMIC_ACQUIRE ) < m_uSqEntries || !"Too many concurrent transfers in the Low-Level IO" );
+
+	io_uring_sqe * pSqe = &m_pSqes[uTail & m_uSqMask];
+	memset( pSqe, 0, sizeof( io_uring_sqe ) );
+
+	// Note: With a file opened with O_DIRECT, reads support sizes that go beyond the end of file, but
+	// not sizes that are not a multiple of the block size. Since the buffer size is always a multiple of
+	// the block size, let's use io_transferInfo.uBufferSize instead of io_transferInfo.uRequestedSize.
+	AkUInt32 uSize = ( in_uOpCode == IORING_OP_READ ) ? io_transferInfo.uBufferSize : io_transferInfo.uRequestedSize;
+
+	// Use the registered buffer if the transfer lies within it.
+	AkUInt8 * pBuffer = (AkUInt8*)io_transferInfo.pBuffer;
+	if ( m_pRegisteredMem
+		&& pBuffer >= m_pRegisteredMem
+		&& pBuffer + uSize <= m_pRegisteredMem + m_uRegisteredMemSize )
+	{
+		pSqe->opcode = ( in_uOpCode == IORING_OP_READ ) ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+		pSqe->buf_index = 0;
+	}
+	else
+		pSqe->opcode = in_uOpCode;
+
+	// Use the registered file if there is one.
+	int fd = AK_FILE_HANDLE_TO_FD( in_fileDesc.hFile );
+	int iSlot = FindRegisteredFile( fd );
+	if ( iSlot >= 0 )
+	{
+		pSqe->fd = iSlot;
+		pSqe->flags = IOSQE_FIXED_FILE;
+	}
+	else
+		pSqe->fd = fd;
+
+	pSqe->off		= io_transferInfo.uFilePosition;
+	pSqe->addr		= (__u64)(uintptr_t)pBuffer;
+	pSqe->len		= uSize;
+	pSqe->user_data	= (__u64)(uintptr_t)&io_transferInfo;
+
+	__atomic_store_n( m_pSqTail, uTail + 1, __ATOMIC_RELEASE );
+}
+
+// Submit queued entries to the kernel. Returns the number of entries that could not be
+// submitted: they are the last ones that were queued, and they are removed from the ring.
+// Sync: Submission lock must be held.
+AkUInt32 CAkIOUringIOHookDeferred::SubmitQueued(
+	AkUInt32				in_uNumQueued		// Number of entries queued since last submission.
+	)
+{
+	AkUInt32 uToSubmit = in_uNumQueued;
+	while ( uToSubmit > 0 )
+	{
+		int iNumSubmitted = IOUringEnter( m_ringFd, uToSubmit, 0, 0 );
+		if ( iNumSubmitted < 0 && errno == EINTR )
+			continue;
+		if ( iNumSubmitted <= 0 )
+			break;
+		uToSubmit -= iNumSubmitted;
+	}
+
+	// Take back entries that the kernel did not consume.
+	if ( uToSubmit > 0 )
+		__atomic_store_n( m_pSqTail, *m_pSqTail - uToSubmit, __ATOMIC_RELEASE );
+
+	return uToSubmit;
+}
+
+// Cancel transfer(s).
+void CAkIOUringIOHookDeferred::Cancel(
+	AkFileDesc &			/*in_fileDesc*/,	// File descriptor.
+	AkAsyncIOTransferInfo & io_transferInfo,	// Transfer info to cancel.
+	bool & io_bCancelAllTransfersForThisFile	// Flag indicating whether all transfers should be cancelled for this file (see notes in function description).
+	)
+{
+	// Cancel this transfer only. The transfer completes with -ECANCELED if it is cancelled in time,
+	// or normally otherwise. Either way, its callback is called by the completion thread.
+	pthread_mutex_lock( &m_lockSubmission );
+	unsigned uTail = *m_pSqTail;
+	io_uring_sqe * pSqe = &m_pSqes[uTail & m_uSqMask];
+	memset( pSqe, 0, sizeof( io_uring_sqe ) );
+	pSqe->opcode	= IORING_OP_ASYNC_CANCEL;
+	pSqe->fd		= -1;
+	pSqe->addr		= (__u64)(uintptr_t)&io_transferInfo;
+	pSqe->user_data	= LINUX_URING_USERDATA_CANCEL;
+	__atomic_store_n( m_pSqTail, uTail + 1, __ATOMIC_RELEASE );
+	SubmitQueued( 1 );
+	pthread_mutex_unlock( &m_lockSubmission );
+
+	// Cancellation is per transfer: ask to be called for each transfer to cancel.
+	io_bCancelAllTransfersForThisFile = false;
+}
+
+// Close a file.
+AKRESULT CAkIOUringIOHookDeferred::Close(
+    AkFileDesc & in_fileDesc      // File descriptor.
+    )
+{
+	pthread_mutex_lock( &m_lockSubmission );
+	UnregisterFile( AK_FILE_HANDLE_TO_FD( in_fileDesc.hFile ) );
+	pthread_mutex_unlock( &m_lockSubmission );
+
+    return CAkFileHelpers::CloseFile( in_fileDesc.hFile );
+}
+
+// Returns the block size for the file or its storage device.
+AkUInt32 CAkIOUringIOHookDeferred::GetBlockSize(
+    AkFileDesc &  /*in_fileDesc*/     // File descriptor.
+    )
+{
+    return LINUX_URING_BLOCK_SIZE;
+}
+
+// Returns a description for the streaming device above this low-level hook.
+AKRESULT CAkIOUringIOHookDeferred::GetDeviceDesc(
+    AkDeviceDesc &
+#ifndef AK_OPTIMIZED
+	out_deviceDesc      // Description of associated low-level I/O device.
+#endif
+    )
+{
+#ifndef AK_OPTIMIZED
+	if ( m_deviceID != AK_INVALID_DEVICE_ID )
+	{
+		// Deferred scheduler.
+		out_deviceDesc.deviceID       = m_deviceID;
+		out_deviceDesc.bCanRead       = true;
+		out_deviceDesc.bCanWrite      = true;
+		AK_CHAR_TO_UTF16( out_deviceDesc.szDeviceName, LINUX_URING_DEVICE_NAME, AK_MONITOR_DEVICENAME_MAXLENGTH );
+		out_deviceDesc.uStringSize   = (AkUInt32)AKPLATFORM::AkUtf16StrLen( out_deviceDesc.szDeviceName ) + 1;
+
+		return AK_Success;
+	}
+
+	assert( !"Low-Level device was not initialized" );
+#endif
+	return AK_Fail;
+}
+
+//
+// Registered files.
+//-----------------------------------------------------------------------------
+
+// Puts a file in a free slot of the registered file table, if any.
+// Sync: Submission lock must be held.
+void CAkIOUringIOHookDeferred::RegisterFile( int in_fd )
+{
+	if ( !m_bFilesRegistered )
+		return;
+
+	for ( AkUInt32 uSlot = 0; uSlot < LINUX_URING_MAX_REGISTERED_FILES; ++uSlot )
+	{
+		if ( m_arRegisteredFiles[uSlot] < 0 )
+		{
+			io_uring_files_update update;
+			memset( &update, 0, sizeof( io_uring_files_update ) );
+			update.offset = uSlot;
+			update.fds = (__u64)(uintptr_t)&in_fd;
+			if ( IOUringRegister( m_ringFd, IORING_REGISTER_FILES_UPDATE, &update, 1 ) == 1 )
+				m_arRegisteredFiles[uSlot] = in_fd;
+			return;
+		}
+	}
+	// No free slot: this file is used without registration.
+}
+
+// Frees the slot of a file in the registered file table, if it has one.
+// Sync: Submission lock must be held.
+void CAkIOUringIOHookDeferred::UnregisterFile( int in_fd )
+{
+	int iSlot = FindRegisteredFile( in_fd );
+	if ( iSlot < 0 )
+		return;
+
+	int fdNone = -1;
+	io_uring_files_update update;
+	memset( &update, 0, sizeof( io_uring_files_update ) );
+	update.offset = iSlot;
+	update.fds = (__u64)(uintptr_t)&fdNone;
+	IOUringRegister( m_ringFd, IORING_REGISTER_FILES_UPDATE, &update, 1 );
+	m_arRegisteredFiles[iSlot] = -1;
+}
+
+// Returns the slot of a file in the registered file table, -1 if it is not registered.
+// Sync: Submission lock must be held.
+int CAkIOUringIOHookDeferred::FindRegisteredFile( int in_fd )
+{
+	if ( m_bFilesRegistered )
+	{
+		for ( AkUInt32 uSlot = 0; uSlot < LINUX_URING_MAX_REGISTERED_FILES; ++uSlot )
+		{
+			if ( m_arRegisteredFiles[uSlot] == in_fd )
+				return (int)uSlot;
+		}
+	}
+	return -1;
+}
+
+//
+// Completion thread.
+//-----------------------------------------------------------------------------
+
+void * CAkIOUringIOHookDeferred::CompletionThreadFunc( void * in_pParam )
+{
+	static_cast<CAkIOUringIOHookDeferred*>( in_pParam )->ProcessCompletions();
+	return NULL;
+}
+
+// Reaps the completion ring and notifies the high-level device, until the exit request completes.
+void CAkIOUringIOHookDeferred::ProcessCompletions()
+{
+	for (;;)
+	{
+		unsigned uHead = *m_pCqHead;
+		unsigned uTail = __atomic_load_n( m_pCqTail, __ATOMIC_ACQUIRE );
+		if ( uHead == uTail )
+		{
+			// Nothing to reap: wait for at least one completion.
+			if ( IOUringEnter( m_ringFd, 0, 1, IORING_ENTER_GETEVENTS ) < 0 && errno != EINTR )
+			{
+				assert( !"io_uring_enter() failed while waiting for completions" );
+				return;
+			}
+			continue;
+		}
+
+		bool bExit = false;
+		while ( uHead != uTail )
+		{
+			io_uring_cqe * pCqe = &m_pCqes[uHead & m_uCqMask];
+			__u64 userData = pCqe->user_data;
+			__s32 iResult = pCqe->res;
+
+			// Release the entry before calling back.
+			++uHead;
+			__atomic_store_n( m_pCqHead, uHead, __ATOMIC_RELEASE );
+
+			if ( userData == LINUX_URING_USERDATA_EXIT )
+				bExit = true;
+			else if ( userData != LINUX_URING_USERDATA_CANCEL )
+			{
+				AkAsyncIOTransferInfo * pXferInfo = (AkAsyncIOTransferInfo*)(uintptr_t)userData;
+
+				// Cancelled transfers must be notified with AK_Success: the device flushes them.
+				AKRESULT eResult = AK_Fail;
+				if ( iResult >= 0 )
+				{
+					eResult = AK_Success;
+					pXferInfo->uSizeTransferred = (AkUInt32)iResult;
+				}
+				else if ( iResult == -ECANCELED )
+				{
+					eResult = AK_Success;
+					pXferInfo->uSizeTransferred = 0;
+				}
+
+				pXferInfo->pCallback( pXferInfo, eResult );
+			}
+		}
+
+		if ( bExit )
+			return;
+	}
+}
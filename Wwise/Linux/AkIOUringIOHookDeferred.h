@@ -0,0 +1,257 @@
+//////////////////////////////////////////////////////////////////////
+//
+// AkIOUringIOHookDeferred.h
+//
+// Deferred low level IO hook (AK::StreamMgr::IAkIOHookDeferred)
+// and file system (AK::StreamMgr::IAkFileLocationResolver) implementation
+// on Linux, based on io_uring.
+//
+// AK::StreamMgr::IAkFileLocationResolver:
+// Resolves file location using simple path concatenation logic
+// (implemented in ../Common/CAkFileLocationBase). It can be used as a
+// standalone Low-Level IO system, or as part of a multi device system.
+// In the latter case, you should manage multiple devices by implementing
+// AK::StreamMgr::IAkFileLocationResolver elsewhere (you may take a look
+// at class CAkDefaultLowLevelIODispatcher).
+//
+// AK::StreamMgr::IAkIOHookDeferred:
+// Transfers are queued in the submission ring of an io_uring instance,
+// and submitted to the kernel with a single io_uring_enter() call per
+// Read()/Write(), or per batch (BatchRead()/BatchWrite() of
+// AK::StreamMgr::IAkIOHookDeferredBatch, registered to the device in
+// AkDeviceSettingsEx::pBatchHook). Files are opened with O_DIRECT.
+// A completion thread reaps the completion ring and calls the AkAIOCallback.
+// Cancel() submits an IORING_OP_ASYNC_CANCEL request: cancelled transfers
+// complete with -ECANCELED, and are notified with AK_Success, as required.
+//
+// - Registered buffers: if the device's I/O memory is provided by the
+// application (AkDeviceSettings::pIOMemory), it is registered to the ring,
+// and transfers of automatic streams use IORING_OP_READ_FIXED/WRITE_FIXED.
+// - Registered files: files opened by this hook are registered to the ring
+// as long as there are free slots (LINUX_URING_MAX_REGISTERED_FILES). This
+// mostly benefits file packages, whose handle is shared by all packaged files.
+//
+// The AK::StreamMgr::IAkIOHookDeferred interface is meant to be used with
+// AK_SCHEDULER_DEFERRED_LINED_UP streaming devices.
+// Requires Linux 5.6 or later (IORING_OP_READ/WRITE, sparse file registration).
+//
+// Init() creates a streaming device (by calling AK::StreamMgr::CreateDeviceEx()).
+// AkDeviceSettings::uSchedulerTypeFlags is set inside to AK_SCHEDULER_DEFERRED_LINED_UP.
+// If there was no AK::StreamMgr::IAkFileLocationResolver previously registered
+// to the Stream Manager, this object registers itself as the File Location Resolver.
+// See AkDefaultIOHookDeferred.h for examples of streaming initialization.
+//
+// Copyright (c) 2006 Audiokinetic Inc. / All Rights Reserved
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef _AK_IO_URING_IO_HOOK_DEFERRED_H_
+#define _AK_IO_URING_IO_HOOK_DEFERRED_H_
+
+#include <AK/SoundEngine/Common/AkStreamMgrModule.h>
+#include "../Common/AkFileLocationBase.h"
+#include <assert.h>
+#include <pthread.h>
+#include <linux/io_uring.h>
+
+// Number of slots of the registered file table.
+#define LINUX_URING_MAX_REGISTERED_FILES	(64)
+
+//-----------------------------------------------------------------------------
+// Name: class CAkIOUringIOHookDeferred.
+// Desc: Implements IAkIOHookDeferred and IAkIOHookDeferredBatch low-level I/O
+//		 hook with io_uring, and IAkFileLocationResolver. Can be used as a
+//		 standalone Low-Level I/O system, or as part of a system with multiple devices.
+//		 File location is resolved using simple path concatenation logic
+//		 (implemented in CAkFileLocationBase).
+//-----------------------------------------------------------------------------
+class CAkIOUringIOHookDeferred : public AK::StreamMgr::IAkFileLocationResolver
+								,public AK::StreamMgr::IAkIOHookDeferred
+								,public AK::StreamMgr::IAkIOHookDeferredBatch
+								,public CAkFileLocationBase
+{
+public:
+
+	CAkIOUringIOHookDeferred();
+	virtual ~CAkIOUringIOHookDeferred();
+
+	// Initialization/termination. Init() registers this object as the one and
+	// only File Location Resolver if none were registered before. Then
+	// it creates a streaming device with scheduler type AK_SCHEDULER_DEFERRED_LINED_UP.
+	AKRESULT Init(
+		const AkDeviceSettings &	in_deviceSettings,	// Device settings.
+		bool						in_bAsyncOpen=false,	// If true, files are opened asynchronously when possible.
+		const AkDeviceSettingsEx *	in_pDeviceSettingsEx=NULL	// Optional device settings (e.g. AkDeviceSettingsEx::fMeasuredThroughputWeight). Pass NULL to use defaults.
+		);
+	void Term();
+
+
+	//
+	// IAkFileLocationAware interface.
+	//-----------------------------------------------------------------------------
+
+    // Returns a file descriptor for a given file name (string).
+    virtual AKRESULT Open(
+        const AkOSChar*			in_pszFileName,		// File name.
+		AkOpenMode				in_eOpenMode,		// Open mode.
+        AkFileSystemFlags *		in_pFlags,			// Special flags. Can pass NULL.
+		bool &					io_bSyncOpen,		// If true, the file must be opened synchronously. Otherwise it is left at the File Location Resolver's discretion. Return false if Open needs to be deferred.
+        AkFileDesc &			out_fileDesc        // Returned file descriptor.
+        );
+
+    // Returns a file descriptor for a given file ID.
+    virtual AKRESULT Open(
+        AkFileID				in_fileID,          // File ID.
+        AkOpenMode				in_eOpenMode,       // Open mode.
+        AkFileSystemFlags *		in_pFlags,			// Special flags. Can pass NULL.
+		bool &					io_bSyncOpen,		// If true, the file must be opened synchronously. Otherwise it is left at the File Location Resolver's discretion. Return false if Open needs to be deferred.
+        AkFileDesc &			out_fileDesc        // Returned file descriptor.
+        );
+
+
+	//
+	// IAkIOHookDeferred interface.
+	//-----------------------------------------------------------------------------
+
+    // Reads data from a file (asynchronous).
+    virtual AKRESULT Read(
+		AkFileDesc &			in_fileDesc,        // File descriptor.
+		const AkIoHeuristics &	in_heuristics,		// Heuristics for this data transfer.
+		AkAsyncIOTransferInfo & io_transferInfo		// Asynchronous data transfer info.
+		);
+
+    // Writes data to a file (asynchronous).
+    virtual AKRESULT Write(
+		AkFileDesc &			in_fileDesc,        // File descriptor.
+		const AkIoHeuristics &	in_heuristics,		// Heuristics for this data transfer.
+		AkAsyncIOTransferInfo & io_transferInfo		// Platform-specific asynchronous IO operation info.
+		);
+
+    // Notifies that a transfer request is cancelled. It will be flushed by the streaming device when completed.
+    virtual void Cancel(
+		AkFileDesc &			in_fileDesc,		// File descriptor.
+		AkAsyncIOTransferInfo & io_transferInfo,	// Transfer info to cancel.
+		bool & io_bCancelAllTransfersForThisFile	// Flag indicating whether all transfers should be cancelled for this file (see notes in function description).
+		);
+
+	// Cleans up a file.
+	virtual AKRESULT Close(
+        AkFileDesc &			in_fileDesc			// File descriptor.
+        );
+
+	// Returns the block size for the file or its storage device.
+	virtual AkUInt32 GetBlockSize(
+        AkFileDesc &  			in_fileDesc			// File descriptor.
+        );
+
+	// Returns a description for the streaming device above this low-level hook.
+    virtual AKRESULT GetDeviceDesc(
+        AkDeviceDesc &  		out_deviceDesc      // Description of associated low-level I/O device.
+        );
+
+
+	//
+	// IAkIOHookDeferredBatch interface.
+	// Batches are queued and submitted with a single system call.
+	//-----------------------------------------------------------------------------
+
+	// Reads data from files (asynchronous), for a batch of transfers.
+	virtual void BatchRead(
+		AkUInt32				in_uNumTransfers,	// Number of transfers in io_arTransfers.
+		AkAsyncIOBatchTransfer * io_arTransfers		// Transfers to submit.
+		);
+
+	// Writes data to files (asynchronous), for a batch of transfers.
+	virtual void BatchWrite(
+		AkUInt32				in_uNumTransfers,	// Number of transfers in io_arTransfers.
+		AkAsyncIOBatchTransfer * io_arTransfers		// Transfers to submit.
+		);
+
+protected:
+
+	// Ring setup/teardown.
+	AKRESULT SetupRing(
+		AkUInt32				in_uNumEntries		// Number of submission queue entries.
+		);
+	void TermRing();
+
+	// Helpers for file opening (common to both Open() overloads).
+	AKRESULT OpenFile(
+		const AkOSChar *		in_pszFullFilePath,	// Full file path.
+		AkOpenMode				in_eOpenMode,		// Open mode.
+		AkFileDesc &			out_fileDesc		// Returned file descriptor.
+		);
+
+	// Queue a transfer in the submission ring, without submitting it.
+	// Sync: Submission lock must be held.
+	void QueueTransfer(
+		AkUInt8					in_uOpCode,			// IORING_OP_READ or IORING_OP_WRITE.
+		AkFileDesc &			in_fileDesc,		// File descriptor.
+		AkAsyncIOTransferInfo & io_transferInfo		// Transfer info.
+		);
+
+	// Submit queued entries to the kernel. Returns the number of entries that could not be
+	// submitted: they are the last ones that were queued, and they are removed from the ring.
+	// Sync: Submission lock must be held.
+	AkUInt32 SubmitQueued(
+		AkUInt32				in_uNumQueued		// Number of entries queued since last submission.
+		);
+
+	// Common to BatchRead() and BatchWrite().
+	void SubmitBatch(
+		AkUInt8					in_uOpCode,			// IORING_OP_READ or IORING_OP_WRITE.
+		AkUInt32				in_uNumTransfers,	// Number of transfers in io_arTransfers.
+		AkAsyncIOBatchTransfer * io_arTransfers		// Transfers to submit.
+		);
+
+	// Registered file table.
+	// Sync: Submission lock must be held.
+	void RegisterFile( int in_fd );
+	void UnregisterFile( int in_fd );
+	int FindRegisteredFile( int in_fd );
+
+	// Completion thread.
+	static void * CompletionThreadFunc( void * in_pParam );
+	void ProcessCompletions();
+
+protected:
+
+	AkDeviceID			m_deviceID;
+	bool				m_bAsyncOpen;	// If true, opens files asynchronously when it can.
+
+	// Ring.
+	int					m_ringFd;		// io_uring file descriptor. -1 if not set up.
+	void *				m_pSqRing;		// Mapped submission ring.
+	size_t				m_uSqRingSize;
+	void *				m_pCqRing;		// Mapped completion ring (same as m_pSqRing with IORING_FEAT_SINGLE_MMAP).
+	size_t				m_uCqRingSize;
+	io_uring_sqe *		m_pSqes;		// Mapped submission queue entries.
+	size_t				m_uSqesSize;
+
+	// Pointers inside the mapped rings.
+	unsigned *			m_pSqHead;
+	unsigned *			m_pSqTail;
+	unsigned			m_uSqMask;
+	unsigned			m_uSqEntries;
+	unsigned *			m_pCqHead;
+	unsigned *			m_pCqTail;
+	unsigned			m_uCqMask;
+	io_uring_cqe *		m_pCqes;
+
+	// The submission ring is accessed from the I/O thread (Read/Write) and from client threads (Cancel).
+	pthread_mutex_t		m_lockSubmission;
+
+	// Completion thread. Only it accesses the completion ring.
+	pthread_t			m_completionThread;
+	bool				m_bCompletionThreadStarted;
+
+	// Registered buffer: the device's I/O memory, if it was provided by the application.
+	AkUInt8 *			m_pRegisteredMem;
+	AkUInt32			m_uRegisteredMemSize;
+
+	// Registered files: file descriptor in each slot of the table, -1 for free slots.
+	bool				m_bFilesRegistered;
+	int					m_arRegisteredFiles[LINUX_URING_MAX_REGISTERED_FILES];
+};
+
+#endif //_AK_IO_URING_IO_HOOK_DEFERRED_H_
@@ -0,0 +1,436 @@
+//////////////////////////////////////////////////////////////////////
+//
+// AkMemoryMappedIOHookBlocking.cpp
+//
+// Blocking low level IO hook (AK::StreamMgr::IAkIOHookBlocking)
+// and file system (AK::StreamMgr::IAkFileLocationResolver) implementation
+// on Linux, that serves reads from memory-mapped files.
+//
+// See AkMemoryMappedIOHookBlocking.h for details.
+//
+// Copyright (c) 2006 Audiokinetic Inc. / All Rights Reserved
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "AkMemoryMappedIOHookBlocking.h"
+#include "AkFileHelpers.h"
+#include <string.h>
+#include <sys/mman.h>
+
+
+#define LINUX_MAPPED_DEVICE_NAME		("Linux Memory Mapped")	// Default device name.
+
+CAkMemoryMappedIOHookBlocking::CAkMemoryMappedIOHookBlocking()
+: m_deviceID( AK_INVALID_DEVICE_ID )
+, m_bAsyncOpen( false )
+, m_bPopulate( false )
+, m_iMaxMappedFileSize( LINUX_MAPPED_DEFAULT_MAX_FILE_SIZE )
+{
+	pthread_mutex_init( &m_lockMappings, NULL );
+	for ( AkUInt32 uSlot = 0; uSlot < LINUX_MAPPED_MAX_FILES; ++uSlot )
+	{
+		m_arMappedFiles[uSlot].hFile = AK_INVALID_FILE_HANDLE;
+		m_arMappedFiles[uSlot].pData = NULL;
+		m_arMappedFiles[uSlot].iSize = 0;
+		m_arMappedFiles[uSlot].uRefCount = 0;
+	}
+}
+
+CAkMemoryMappedIOHookBlocking::~CAkMemoryMappedIOHookBlocking()
+{
+	pthread_mutex_destroy( &m_lockMappings );
+}
+
+// Initialization/termination. Init() registers this object as the one and
+// only File Location Resolver if none were registered before. Then
+// it creates a streaming device with scheduler type AK_SCHEDULER_BLOCKING.
+AKRESULT CAkMemoryMappedIOHookBlocking::Init(
+	const AkDeviceSettings &	in_deviceSettings,			// Device settings.
+	bool						in_bAsyncOpen/*=false*/,	// If true, files are opened asynchronously when possible.
+	AkInt64						in_iMaxMappedFileSize/*=LINUX_MAPPED_DEFAULT_MAX_FILE_SIZE*/,	// Files bigger than this are not mapped.
+	bool						in_bPopulate/*=false*/,		// If true, mapped files are read entirely when they are opened (MAP_POPULATE).
+	const AkDeviceSettingsEx *	in_pDeviceSettingsEx/*=NULL*/	// Optional device settings. Pass NULL to use defaults.
+	)
+{
+	if ( ( in_deviceSettings.uSchedulerTypeFlags & ~AK_SCHEDULER_ELEVATOR ) != AK_SCHEDULER_BLOCKING )
+	{
+		assert( !"CAkMemoryMappedIOHookBlocking I/O hook only works with AK_SCHEDULER_BLOCKING devices" );
+		return AK_Fail;
+	}
+
+	m_bAsyncOpen = in_bAsyncOpen;
+	m_iMaxMappedFileSize = in_iMaxMappedFileSize;
+	m_bPopulate = in_bPopulate;
+
+	// If the Stream Manager's File Location Resolver was not set yet, set this object as the
+	// File Location Resolver (this I/O hook is also able to resolve file location).
+	if ( !AK::StreamMgr::GetFileLocationResolver() )
+		AK::StreamMgr::SetFileLocationResolver( this );
+
+	// Create a device in the Stream Manager, specifying this as the hook, and
+	// registering its resident data interface.
+	AkDeviceSettingsEx deviceSettingsEx;
+	if ( in_pDeviceSettingsEx )
+		deviceSettingsEx = *in_pDeviceSettingsEx;
+	else
+		AK::StreamMgr::GetDefaultDeviceSettingsEx( deviceSettingsEx );
+	deviceSettingsEx.pResidentDataHook = this;
+	m_deviceID = AK::StreamMgr::CreateDeviceEx( in_deviceSettings, deviceSettingsEx, this );
+	if ( m_deviceID != AK_INVALID_DEVICE_ID )
+		return AK_Success;
+
+	return AK_Fail;
+}
+
+void CAkMemoryMappedIOHookBlocking::Term()
+{
+	if ( AK::StreamMgr::GetFileLocationResolver() == this )
+		AK::StreamMgr::SetFileLocationResolver( NULL );
+	AK::StreamMgr::DestroyDevice( m_deviceID );
+
+	// All files and streams should have been closed.
+	for ( AkUInt32 uSlot = 0; uSlot < LINUX_MAPPED_MAX_FILES; ++uSlot )
+		assert( m_arMappedFiles[uSlot].pData == NULL || !"File still mapped at termination" );
+}
+
+//
+// IAkFileLocationAware interface.
+//-----------------------------------------------------------------------------
+
+// Returns a file descriptor for a given file name (string).
+AKRESULT CAkMemoryMappedIOHookBlocking::Open(
+    const AkOSChar* in_pszFileName,     // File name.
+    AkOpenMode      in_eOpenMode,       // Open mode.
+    AkFileSystemFlags * in_pFlags,      // Special flags. Can pass NULL.
+	bool &			io_bSyncOpen,		// If true, the file must be opened synchronously. Otherwise it is left at the File Location Resolver's discretion. Return false if Open needs to be deferred.
+    AkFileDesc &    out_fileDesc        // Returned file descriptor.
+    )
+{
+	// Opening a file maps it in memory, which may be slow with MAP_POPULATE. If you want files to
+	// be opened asynchronously when it is possible, this device should be initialized with the
+	// flag in_bAsyncOpen set to true.
+	if ( io_bSyncOpen || !m_bAsyncOpen )
+	{
+		io_bSyncOpen = true;
+
+		// Get the full file path, using path concatenation logic.
+		AkOSChar szFullFilePath[AK_MAX_PATH];
+		if ( GetFullFilePath( in_pszFileName, in_pFlags, in_eOpenMode, szFullFilePath ) == AK_Success )
+			return OpenFile( szFullFilePath, in_eOpenMode, out_fileDesc );
+
+		return AK_Fail;
+	}
+	else
+	{
+		// The client allows us to perform asynchronous opening.
+		// We only need to specify the deviceID, and leave the boolean to false.
+		out_fileDesc.iFileSize			= 0;
+		out_fileDesc.uSector			= 0;
+		out_fileDesc.deviceID			= m_deviceID;
+		out_fileDesc.pCustomParam		= NULL;
+		out_fileDesc.uCustomParamSize	= 0;
+		return AK_Success;
+	}
+}
+
+// Returns a file descriptor for a given file ID.
+AKRESULT CAkMemoryMappedIOHookBlocking::Open(
+    AkFileID        in_fileID,          // File ID.
+    AkOpenMode      in_eOpenMode,       // Open mode.
+    AkFileSystemFlags * in_pFlags,      // Special flags. Can pass NULL.
+	bool &			io_bSyncOpen,		// If true, the file must be opened synchronously. Otherwise it is left at the File Location Resolver's discretion. Return false if Open needs to be deferred.
+    AkFileDesc &    out_fileDesc        // Returned file descriptor.
+    )
+{
+	// Opening a file maps it in memory, which may be slow with MAP_POPULATE. If you want files to
+	// be opened asynchronously when it is possible, this device should be initialized with the
+	// flag in_bAsyncOpen set to true.
+	if ( io_bSyncOpen || !m_bAsyncOpen )
+	{
+		io_bSyncOpen = true;
+
+		// Get the full file path, using path concatenation logic.
+		AkOSChar szFullFilePath[AK_MAX_PATH];
+		if ( GetFullFilePath( in_fileID, in_pFlags, in_eOpenMode, szFullFilePath ) == AK_Success )
+			return OpenFile( szFullFilePath, in_eOpenMode, out_fileDesc );
+
+		return AK_Fail;
+	}
+	else
+	{
+		// The client allows us to perform asynchronous opening.
+		// We only need to specify the deviceID, and leave the boolean to false.
+		out_fileDesc.iFileSize			= 0;
+		out_fileDesc.uSector			= 0;
+		out_fileDesc.deviceID			= m_deviceID;
+		out_fileDesc.pCustomParam		= NULL;
+		out_fileDesc.uCustomParamSize	= 0;
+		return AK_Success;
+	}
+}
+
+// Helpers for file opening (common to both Open() overloads).
+AKRESULT CAkMemoryMappedIOHookBlocking::OpenFile(
+	const AkOSChar *		in_pszFullFilePath,	// Full file path.
+	AkOpenMode				in_eOpenMode,		// Open mode.
+	AkFileDesc &			out_fileDesc		// Returned file descriptor.
+	)
+{
+	AKRESULT eResult = CAkFileHelpers::OpenFile(
+		in_pszFullFilePath,
+		in_eOpenMode,
+		false,
+		out_fileDesc.hFile );
+	if ( eResult == AK_Success )
+	{
+		out_fileDesc.iFileSize			= CAkFileHelpers::GetFileSize( out_fileDesc.hFile );
+		out_fileDesc.uSector			= 0;
+		out_fileDesc.deviceID			= m_deviceID;
+		out_fileDesc.pCustomParam		= NULL;
+		out_fileDesc.uCustomParamSize	= 0;
+
+		if ( in_eOpenMode == AK_OpenModeRead )
+			MapFile( out_fileDesc );
+	}
+	return eResult;
+}
+
+// Maps a file opened for reading, if its size allows it and there is a free slot.
+// Files that are not mapped are read with pread().
+void CAkMemoryMappedIOHookBlocking::MapFile(
+	const AkFileDesc &		in_fileDesc			// File descriptor.
+	)
+{
+	if ( in_fileDesc.iFileSize <= 0
+		|| in_fileDesc.iFileSize > m_iMaxMappedFileSize )
+		return;
+
+	// Map outside of the lock: it may take a while with MAP_POPULATE.
+	int iFlags = MAP_SHARED;
+	if ( m_bPopulate )
+		iFlags |= MAP_POPULATE;
+	void * pData = ::mmap( NULL, (size_t)in_fileDesc.iFileSize, PROT_READ, iFlags, AK_FILE_HANDLE_TO_FD( in_fileDesc.hFile ), 0 );
+	if ( pData == MAP_FAILED )
+		return;
+
+	// Without MAP_POPULATE, have the kernel start reading the file in the background.
+	if ( !m_bPopulate )
+		::madvise( pData, (size_t)in_fileDesc.iFileSize, MADV_WILLNEED );
+
+	pthread_mutex_lock( &m_lockMappings );
+	for ( AkUInt32 uSlot = 0; uSlot < LINUX_MAPPED_MAX_FILES; ++uSlot )
+	{
+		if ( m_arMappedFiles[uSlot].pData == NULL )
+		{
+			m_arMappedFiles[uSlot].hFile = in_fileDesc.hFile;
+			m_arMappedFiles[uSlot].pData = (AkUInt8*)pData;
+			m_arMappedFiles[uSlot].iSize = in_fileDesc.iFileSize;
+			m_arMappedFiles[uSlot].uRefCount = 1;	// Released when the file is closed.
+			pData = NULL;
+			break;
+		}
+	}
+	pthread_mutex_unlock( &m_lockMappings );
+
+	// No free slot: the file will be read with pread().
+	if ( pData )
+		::munmap( pData, (size_t)in_fileDesc.iFileSize );
+}
+
+// Returns the slot of the mapping of an opened file. Returns -1 if the file is not mapped.
+// Sync: Mapping lock must be held.
+int CAkMemoryMappedIOHookBlocking::FindMapping(
+	AkFileHandle			in_hFile			// File handle.
+	)
+{
+	for ( AkUInt32 uSlot = 0; uSlot < LINUX_MAPPED_MAX_FILES; ++uSlot )
+	{
+		if ( m_arMappedFiles[uSlot].hFile == in_hFile 
+			&& m_arMappedFiles[uSlot].pData )
+			return (int)uSlot;
+	}
+	return -1;
+}
+
+// Removes a reference to a mapping, and unmaps it when there are no more references.
+// Sync: Mapping lock must be held.
+void CAkMemoryMappedIOHookBlocking::ReleaseMapping(
+	int						in_iSlot			// Slot of the mapping.
+	)
+{
+	AkMappedFile & mappedFile = m_arMappedFiles[in_iSlot];
+	assert( mappedFile.uRefCount > 0 );
+	if ( --mappedFile.uRefCount == 0 )
+	{
+		::munmap( mappedFile.pData, (size_t)mappedFile.iSize );
+		mappedFile.hFile = AK_INVALID_FILE_HANDLE;
+		mappedFile.pData = NULL;
+		mappedFile.iSize = 0;
+	}
+}
+
+//
+// IAkIOHookBlocking implementation.
+//-----------------------------------------------------------------------------
+
+// Reads data from a file (synchronous).
+AKRESULT CAkMemoryMappedIOHookBlocking::Read(
+    AkFileDesc &			in_fileDesc,        // File descriptor.
+	const AkIoHeuristics & /*in_heuristics*/,	// Heuristics for this data transfer (not used in this implementation).
+    void *					out_pBuffer,        // Buffer to be filled with data.
+    AkIOTransferInfo &		io_transferInfo		// Synchronous data transfer info.
+    )
+{
+    assert( out_pBuffer &&
+            in_fileDesc.hFile != AK_INVALID_FILE_HANDLE );
+
+	// The mapping remains valid until the file is closed, which cannot happen during a transfer,
+	// so the lock only protects the look-up.
+	const AkUInt8 * pMappedData = NULL;
+	AkInt64 iMappedSize = 0;
+	pthread_mutex_lock( &m_lockMappings );
+	int iSlot = FindMapping( in_fileDesc.hFile );
+	if ( iSlot >= 0 )
+	{
+		pMappedData = m_arMappedFiles[iSlot].pData;
+		iMappedSize = m_arMappedFiles[iSlot].iSize;
+	}
+	pthread_mutex_unlock( &m_lockMappings );
+
+	if ( !pMappedData )
+	{
+		return CAkFileHelpers::ReadAt(
+			in_fileDesc.hFile,
+			out_pBuffer,
+			io_transferInfo.uFilePosition,
+			io_transferInfo.uRequestedSize,
+			io_transferInfo.uSizeTransferred );
+	}
+
+	// io_transferInfo.uFilePosition is relative to the handle: for files of a package, it already
+	// includes the file's offset in the package.
+	AkInt64 iSizeToCopy = 0;
+	if ( (AkInt64)io_transferInfo.uFilePosition < iMappedSize )
+	{
+		iSizeToCopy = iMappedSize - (AkInt64)io_transferInfo.uFilePosition;
+		if ( iSizeToCopy > io_transferInfo.uRequestedSize )
+			iSizeToCopy = io_transferInfo.uRequestedSize;
+		memcpy( out_pBuffer, pMappedData + io_transferInfo.uFilePosition, (size_t)iSizeToCopy );
+	}
+	io_transferInfo.uSizeTransferred = (AkUInt32)iSizeToCopy;
+	return AK_Success;
+}
+
+// Writes data to a file (synchronous).
+AKRESULT CAkMemoryMappedIOHookBlocking::Write(
+	AkFileDesc &			in_fileDesc,        // File descriptor.
+	const AkIoHeuristics & /*in_heuristics*/,	// Heuristics for this data transfer (not used in this implementation).
+    void *					in_pData,           // Data to be written.
+    AkIOTransferInfo &		io_transferInfo		// Synchronous data transfer info.
+    )
+{
+    assert( in_pData &&
+            in_fileDesc.hFile != AK_INVALID_FILE_HANDLE );
+
+	// Files opened for writing are never mapped.
+	return CAkFileHelpers::WriteAt(
+		in_fileDesc.hFile,
+		in_pData,
+		io_transferInfo.uFilePosition,
+		io_transferInfo.uRequestedSize,
+		io_transferInfo.uSizeTransferred );
+}
+
+// Cleans up a file.
+AKRESULT CAkMemoryMappedIOHookBlocking::Close(
+    AkFileDesc & in_fileDesc      // File descriptor.
+    )
+{
+	// Detach the mapping from the handle before closing it, since it could be reused right away.
+	// The mapping itself survives the handle as long as resident streams reference it.
+	pthread_mutex_lock( &m_lockMappings );
+	int iSlot = FindMapping( in_fileDesc.hFile );
+	if ( iSlot >= 0 )
+	{
+		m_arMappedFiles[iSlot].hFile = AK_INVALID_FILE_HANDLE;
+		ReleaseMapping( iSlot );
+	}
+	pthread_mutex_unlock( &m_lockMappings );
+
+	return CAkFileHelpers::CloseFile( in_fileDesc.hFile );
+}
+
+// Returns the block size for the file or its storage device.
+AkUInt32 CAkMemoryMappedIOHookBlocking::GetBlockSize(
+    AkFileDesc &  /*in_fileDesc*/     // File descriptor.
+    )
+{
+	// No constraint on block size.
+    return 1;
+}
+
+// Returns the mapping of a file, if it is mapped, and adds a reference to it.
+const void * CAkMemoryMappedIOHookBlocking::AddRefResidentData(
+	AkFileDesc &			in_fileDesc			// File descriptor.
+	)
+{
+	// The mapping must cover the whole file. For files of a package, GetBlockSize() is overridden
+	// and returns the block size of the package's look-up table.
+	AkInt64 iEndPosition = (AkInt64)in_fileDesc.uSector * GetBlockSize( in_fileDesc ) + in_fileDesc.iFileSize;
+
+	const void * pData = NULL;
+	pthread_mutex_lock( &m_lockMappings );
+	int iSlot = FindMapping( in_fileDesc.hFile );
+	if ( iSlot >= 0 
+		&& iEndPosition <= m_arMappedFiles[iSlot].iSize )
+	{
+		++m_arMappedFiles[iSlot].uRefCount;
+		pData = m_arMappedFiles[iSlot].pData;
+	}
+	pthread_mutex_unlock( &m_lockMappings );
+	return pData;
+}
+
+// Releases a reference obtained with AddRefResidentData().
+// The file may already be closed: the mapping is looked up by address.
+void CAkMemoryMappedIOHookBlocking::ReleaseResidentData(
+	AkFileDesc &			/*in_fileDesc*/,	// File descriptor.
+	const void *			in_pData			// Address returned by AddRefResidentData().
+	)
+{
+	pthread_mutex_lock( &m_lockMappings );
+	for ( AkUInt32 uSlot = 0; uSlot < LINUX_MAPPED_MAX_FILES; ++uSlot )
+	{
+		if ( m_arMappedFiles[uSlot].pData == in_pData )
+		{
+			ReleaseMapping( (int)uSlot );
+			break;
+		}
+	}
+	pthread_mutex_unlock( &m_lockMappings );
+}
+
+// Returns a description for the streaming device above this low-level hook.
+AKRESULT CAkMemoryMappedIOHookBlocking::GetDeviceDesc(
+    AkDeviceDesc &
+#ifndef AK_OPTIMIZED
+	out_deviceDesc      // Description of associated low-level I/O device.
+#endif
+    )
+{
+#ifndef AK_OPTIMIZED
+	if ( m_deviceID != AK_INVALID_DEVICE_ID )
+	{
+		out_deviceDesc.deviceID       = m_deviceID;
+		out_deviceDesc.bCanRead       = true;
+		out_deviceDesc.bCanWrite      = true;
+		AK_CHAR_TO_UTF16( out_deviceDesc.szDeviceName, LINUX_MAPPED_DEVICE_NAME, AK_MONITOR_DEVICENAME_MAXLENGTH );
+		out_deviceDesc.uStringSize   = (AkUInt32)AKPLATFORM::AkUtf16StrLen( out_deviceDesc.szDeviceName ) + 1;
+
+		return AK_Success;
+	}
+
+	assert( !"Low-Level device was not initialized" );
+#endif
+	return AK_Fail;
+}
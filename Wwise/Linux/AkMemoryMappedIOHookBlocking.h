@@ -0,0 +1,221 @@
+//////////////////////////////////////////////////////////////////////
+//
+// AkMemoryMappedIOHookBlocking.h
+//
+// Blocking low level IO hook (AK::StreamMgr::IAkIOHookBlocking)
+// and file system (AK::StreamMgr::IAkFileLocationResolver) implementation
+// on Linux, that serves reads from memory-mapped files.
+//
+// AK::StreamMgr::IAkFileLocationResolver:
+// Resolves file location using simple path concatenation logic
+// (implemented in ../Common/CAkFileLocationBase). It can be used as a
+// standalone Low-Level IO system, or as part of a multi device system.
+// In the latter case, you should manage multiple devices by implementing
+// AK::StreamMgr::IAkFileLocationResolver elsewhere (you may take a look
+// at class CAkDefaultLowLevelIODispatcher).
+//
+// AK::StreamMgr::IAkIOHookBlocking:
+// Files opened for reading are mapped in memory as a whole (mmap()),
+// as long as their size does not exceed the limit passed to Init(), and
+// there is a free slot in the mapping table (LINUX_MAPPED_MAX_FILES).
+// Reads are then served with a memory copy from the mapping: there is no
+// system call per transfer, and no intermediate copy in the kernel.
+// Other files are read with ::pread(), and written with ::pwrite().
+//
+// Mappings are looked up by file handle, so this hook is meant to be
+// used with file packages (see AkFilePackageLowLevelIOMemoryMapped.h): the
+// package file is mapped when it is loaded, and all the files it contains
+// are read from the mapping, at the offset computed by the Stream Manager
+// from the package's look-up table (uStartBlock * uBlockSize).
+//
+// Zero-copy: mapped files are exposed to the Stream Manager with
+// AddRefResidentData() (AK::StreamMgr::IAkIOHookResidentData, registered
+// to the device in AkDeviceSettingsEx::pResidentDataHook), so that automatic streams grant buffers that point
+// directly into the mapping, without any transfer. Mappings are reference
+// counted: a package may be unloaded while streams still use its mapping.
+//
+// Warm-up: with in_bPopulate, the mapping is created with MAP_POPULATE, so
+// that the file is read entirely at Open() time (which is then slow, but
+// transfers never fault). Otherwise, the mapping is advised with MADV_WILLNEED
+// and the kernel reads it asynchronously.
+// Note: Truncating a mapped file while it is opened raises SIGBUS on access.
+//
+// The AK::StreamMgr::IAkIOHookBlocking interface is meant to be used with
+// AK_SCHEDULER_BLOCKING streaming devices.
+//
+// Init() creates a streaming device (by calling AK::StreamMgr::CreateDeviceEx()).
+// AkDeviceSettings::uSchedulerTypeFlags is set inside to AK_SCHEDULER_BLOCKING.
+// If there was no AK::StreamMgr::IAkFileLocationResolver previously registered
+// to the Stream Manager, this object registers itself as the File Location Resolver.
+// See ../AkDefaultIOHookBlocking.h for examples of streaming initialization.
+//
+// Copyright (c) 2006 Audiokinetic Inc. / All Rights Reserved
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef _AK_MEMORY_MAPPED_IO_HOOK_BLOCKING_H_
+#define _AK_MEMORY_MAPPED_IO_HOOK_BLOCKING_H_
+
+#include <AK/SoundEngine/Common/AkStreamMgrModule.h>
+#include "../Common/AkFileLocationBase.h"
+#include <pthread.h>
+
+// Number of slots of the mapping table.
+#define LINUX_MAPPED_MAX_FILES				(64)
+
+// Default size limit of mapped files.
+#define LINUX_MAPPED_DEFAULT_MAX_FILE_SIZE	(512*1024*1024)
+
+//-----------------------------------------------------------------------------
+// Name: class CAkMemoryMappedIOHookBlocking.
+// Desc: Implements IAkIOHookBlocking and IAkIOHookResidentData low-level I/O
+//		 hook with memory-mapped files, and IAkFileLocationResolver. Can be used as a standalone
+//		 Low-Level I/O system, or as part of a system with multiple devices.
+//		 File location is resolved using simple path concatenation logic
+//		 (implemented in CAkFileLocationBase).
+//-----------------------------------------------------------------------------
+class CAkMemoryMappedIOHookBlocking : public AK::StreamMgr::IAkFileLocationResolver
+									,public AK::StreamMgr::IAkIOHookBlocking
+									,public AK::StreamMgr::IAkIOHookResidentData
+									,public CAkFileLocationBase
+{
+public:
+
+	CAkMemoryMappedIOHookBlocking();
+	virtual ~CAkMemoryMappedIOHookBlocking();
+
+	// Initialization/termination. Init() registers this object as the one and
+	// only File Location Resolver if none were registered before. Then
+	// it creates a streaming device with scheduler type AK_SCHEDULER_BLOCKING.
+	AKRESULT Init(
+		const AkDeviceSettings &	in_deviceSettings,			// Device settings.
+		bool						in_bAsyncOpen=false,		// If true, files are opened asynchronously when possible.
+		AkInt64						in_iMaxMappedFileSize=LINUX_MAPPED_DEFAULT_MAX_FILE_SIZE,	// Files bigger than this are not mapped.
+		bool						in_bPopulate=false,			// If true, mapped files are read entirely when they are opened (MAP_POPULATE).
+		const AkDeviceSettingsEx *	in_pDeviceSettingsEx=NULL	// Optional device settings (e.g. AkDeviceSettingsEx::uNumIOWorkers). Pass NULL to use defaults.
+		);
+	void Term();
+
+
+	//
+	// IAkFileLocationAware interface.
+	//-----------------------------------------------------------------------------
+
+	// Returns a file descriptor for a given file name (string).
+    virtual AKRESULT Open(
+        const AkOSChar*			in_pszFileName,		// File name.
+		AkOpenMode				in_eOpenMode,		// Open mode.
+        AkFileSystemFlags *		in_pFlags,			// Special flags. Can pass NULL.
+		bool &					io_bSyncOpen,		// If true, the file must be opened synchronously. Otherwise it is left at the File Location Resolver's discretion. Return false if Open needs to be deferred.
+        AkFileDesc &			out_fileDesc        // Returned file descriptor.
+        );
+
+    // Returns a file descriptor for a given file ID.
+    virtual AKRESULT Open(
+        AkFileID				in_fileID,          // File ID.
+        AkOpenMode				in_eOpenMode,       // Open mode.
+        AkFileSystemFlags *		in_pFlags,			// Special flags. Can pass NULL.
+		bool &					io_bSyncOpen,		// If true, the file must be opened synchronously. Otherwise it is left at the File Location Resolver's discretion. Return false if Open needs to be deferred.
+        AkFileDesc &			out_fileDesc        // Returned file descriptor.
+        );
+
+
+	//
+	// IAkIOHookBlocking interface.
+	//-----------------------------------------------------------------------------
+
+	// Reads data from a file (synchronous).
+	virtual AKRESULT Read(
+        AkFileDesc &			in_fileDesc,        // File descriptor.
+		const AkIoHeuristics &	in_heuristics,		// Heuristics for this data transfer.
+        void *					out_pBuffer,        // Buffer to be filled with data.
+        AkIOTransferInfo &		io_transferInfo		// Synchronous data transfer info.
+        );
+
+    // Writes data to a file (synchronous).
+	virtual AKRESULT Write(
+		AkFileDesc &			in_fileDesc,        // File descriptor.
+		const AkIoHeuristics &	in_heuristics,		// Heuristics for this data transfer.
+        void *					in_pData,           // Data to be written.
+        AkIOTransferInfo &		io_transferInfo		// Synchronous data transfer info.
+        );
+
+	// Cleans up a file.
+    virtual AKRESULT Close(
+        AkFileDesc &			in_fileDesc			// File descriptor.
+        );
+
+	// Returns the block size for the file or its storage device.
+	virtual AkUInt32 GetBlockSize(
+        AkFileDesc &  			in_fileDesc			// File descriptor.
+        );
+
+	// Returns a description for the streaming device above this low-level hook.
+    virtual AKRESULT GetDeviceDesc(
+        AkDeviceDesc &  		out_deviceDesc      // Device description.
+        );
+
+
+	//
+	// IAkIOHookResidentData interface.
+	//-----------------------------------------------------------------------------
+
+	// Returns the mapping of a file, if it is mapped, and adds a reference to it.
+	virtual const void * AddRefResidentData(
+		AkFileDesc &			in_fileDesc			// File descriptor.
+		);
+
+	// Releases a reference obtained with AddRefResidentData().
+	virtual void ReleaseResidentData(
+		AkFileDesc &			in_fileDesc,		// File descriptor.
+		const void *			in_pData			// Address returned by AddRefResidentData().
+		);
+
+protected:
+
+	// Helpers for file opening (common to both Open() overloads).
+	AKRESULT OpenFile(
+		const AkOSChar *		in_pszFullFilePath,	// Full file path.
+		AkOpenMode				in_eOpenMode,		// Open mode.
+		AkFileDesc &			out_fileDesc		// Returned file descriptor.
+		);
+
+	// Maps a file opened for reading, if its size allows it and there is a free slot.
+	void MapFile(
+		const AkFileDesc &		in_fileDesc			// File descriptor.
+		);
+
+	// Returns the slot of the mapping of an opened file. Returns -1 if the file is not mapped.
+	// Sync: Mapping lock must be held.
+	int FindMapping(
+		AkFileHandle			in_hFile			// File handle.
+		);
+
+	// Removes a reference to a mapping, and unmaps it when there are no more references.
+	// Sync: Mapping lock must be held.
+	void ReleaseMapping(
+		int						in_iSlot			// Slot of the mapping.
+		);
+
+protected:
+
+	// A mapped file.
+	struct AkMappedFile
+	{
+		AkFileHandle	hFile;		// File handle. AK_INVALID_FILE_HANDLE once the file is closed.
+		AkUInt8 *		pData;		// Address of the mapping. NULL for free slots.
+		AkInt64			iSize;		// Size of the mapping (file size).
+		AkUInt32		uRefCount;	// One for the opened file, plus one for each resident stream.
+	};
+
+	AkDeviceID		m_deviceID;
+	bool			m_bAsyncOpen;		// If true, opens files asynchronously when it can.
+	bool			m_bPopulate;		// If true, maps files with MAP_POPULATE.
+	AkInt64			m_iMaxMappedFileSize;
+
+	// Mapping table. Files are opened and closed from client threads, and read from the I/O thread.
+	pthread_mutex_t	m_lockMappings;
+	AkMappedFile	m_arMappedFiles[LINUX_MAPPED_MAX_FILES];
+};
+
+#endif //_AK_MEMORY_MAPPED_IO_HOOK_BLOCKING_H_